@@ -1,8 +1,18 @@
+#include "OptDebugger/SyntheticCorpus.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 
 struct TestCase {
     std::string name;
@@ -11,7 +21,126 @@ struct TestCase {
     std::string flags;
 };
 
-int main() {
+struct CorpusOptions {
+    std::string out_dir;
+    unsigned units = 1;
+    optdbg::CorpusConfig config;
+};
+
+static void print_corpus_usage() {
+    std::cerr << "usage: generate_tests\n"
+                 "       generate_tests --corpus <dir> [--units U] [--functions N]\n"
+                 "                      [--blocks M] [--instructions K] [--changed P]\n"
+                 "                      [--remarks R] [--seed S]\n";
+}
+
+static bool parse_corpus_options(int argc, char **argv, CorpusOptions &opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--corpus") {
+            opts.out_dir = value;
+            continue;
+        }
+
+        // strtoull skips blanks and negates "-1" into a huge count, so
+        // require plain digits and check the range of the target field
+        unsigned long long limit = arg == "--seed"    ? UINT64_MAX
+                                 : arg == "--changed" ? 100
+                                                      : UINT_MAX;
+        char *end = nullptr;
+        errno = 0;
+        unsigned long long n = std::strtoull(value.c_str(), &end, 10);
+        bool numeric = !value.empty() && std::isdigit((unsigned char)value[0]) && *end == '\0';
+        if (!numeric) {
+            std::cerr << "expected a number for " << arg << ", got '" << value << "'" << std::endl;
+            return false;
+        }
+        if (errno == ERANGE || n > limit) {
+            std::cerr << arg << " must be at most " << limit << ", got '" << value << "'" << std::endl;
+            return false;
+        }
+
+        if (arg == "--units")               opts.units = n;
+        else if (arg == "--functions")      opts.config.Functions = n;
+        else if (arg == "--blocks")         opts.config.BlocksPerFunction = n;
+        else if (arg == "--instructions")   opts.config.InstructionsPerBlock = n;
+        else if (arg == "--changed")        opts.config.ChangedPercent = n;
+        else if (arg == "--remarks")        opts.config.RemarkCount = n;
+        else if (arg == "--seed")           opts.config.Seed = n;
+        else {
+            std::cerr << "unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return !opts.out_dir.empty();
+}
+
+static bool write_corpus_file(const std::string &path,
+                              void (*write)(const optdbg::CorpusConfig &, bool, llvm::raw_ostream &),
+                              const optdbg::CorpusConfig &config, bool after) {
+    std::error_code ec;
+    llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_Text);
+    if (ec) {
+        std::cerr << "cannot write " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    write(config, after, os);
+    return true;
+}
+
+// Writes a synthetic corpus sized to stress each stage:
+//   <dir>/before/unitN.ll + unitN.opt.yaml   (input for --batch, --remarks, aion-remarkdb)
+//   <dir>/after/unitN.ll                     (pair for --before/--after)
+// Every unit uses seed + N, so a command line always yields the same bytes.
+static int generate_corpus(const CorpusOptions &opts) {
+    for (const char *sub : {"/before", "/after"}) {
+        if (std::error_code ec = llvm::sys::fs::create_directories(opts.out_dir + sub)) {
+            std::cerr << "cannot create " << opts.out_dir << sub << ": " << ec.message() << std::endl;
+            return 1;
+        }
+    }
+
+    auto write_remarks = [](const optdbg::CorpusConfig &c, bool, llvm::raw_ostream &os) {
+        optdbg::writeSyntheticRemarks(c, os);
+    };
+
+    for (unsigned u = 0; u < opts.units; ++u) {
+        optdbg::CorpusConfig config = opts.config;
+        config.Seed += u;
+        std::string name = "unit" + std::to_string(u);
+        std::string before = opts.out_dir + "/before/" + name;
+        std::string after = opts.out_dir + "/after/" + name;
+
+        if (!write_corpus_file(before + ".ll", optdbg::writeSyntheticModule, config, false) ||
+            !write_corpus_file(after + ".ll", optdbg::writeSyntheticModule, config, true) ||
+            !write_corpus_file(before + ".opt.yaml", write_remarks, config, false))
+            return 1;
+    }
+
+    const optdbg::CorpusConfig &c = opts.config;
+    unsigned long long insts = 1ull * c.Functions * c.BlocksPerFunction * c.InstructionsPerBlock;
+    std::cout << "Generated " << opts.units << " unit(s) in " << opts.out_dir << ": "
+              << c.Functions << " functions, ~" << insts << " instructions and "
+              << c.RemarkCount << " remarks each, " << c.ChangedPercent
+              << "% of functions changed" << std::endl;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        CorpusOptions opts;
+        if (!parse_corpus_options(argc, argv, opts)) {
+            print_corpus_usage();
+            return 1;
+        }
+        return generate_corpus(opts);
+    }
+
     std::vector<TestCase> cases = {
         // INLINER 
         {"inline_hinted_noinline", "test/inline", 
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "OptDebugger/PassAnalyzer.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/SHA256.h"
+
+#include <optional>
+#include <string>
+
+namespace optdbg {
+
+// incrementally hashes everything an analysis result depends on: input
+// bytes, pipeline, configuration, tool and session format versions
+class CacheKeyBuilder {
+public:
+  explicit CacheKeyBuilder(llvm::StringRef Mode);
+
+  void addString(llvm::StringRef S);
+  llvm::Error addFile(llvm::StringRef Path);
+  void addConfig(const AnalysisConfig &Config);
+
+  // hex digest; the builder must not be used afterwards
+  std::string finalize();
+
+private:
+  llvm::SHA256 Hasher;
+};
+
+// content-addressed store of serialized sessions, laid out as
+// <dir>/<first two hex digits>/<key>.aion
+class AnalysisCache {
+public:
+  explicit AnalysisCache(std::string Directory);
+
+  // returns the cached session, or nothing on a miss or an unreadable entry
+  std::optional<AnalysisSession> lookup(llvm::StringRef Key) const;
+
+  // writes the entry through a temporary file and renames it into place so
+  // concurrent runs never observe a partial entry
+  llvm::Error store(llvm::StringRef Key, const AnalysisSession &Session) const;
+
+  std::string getEntryPath(llvm::StringRef Key) const;
+  const std::string &getDirectory() const { return Directory; }
+
+private:
+  std::string Directory;
+};
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "OptDebugger/Baseline.h"
+#include "OptDebugger/OptReport.h"
+#include "OptDebugger/PassAnalyzer.h"
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+namespace optdbg {
+
+class AnalysisCache;
+
+enum class RequestFormat : uint8_t {
+  Terminal,
+  NDJSON,
+  JSON,
+  SARIF,
+};
+
+// one analysis as sent by a client; paths must be absolute
+struct AnalysisRequest {
+  std::string    InputPath;
+  std::string    IRText;
+  std::string    BeforePath;
+  std::string    AfterPath;
+  std::string    RemarksPath;
+  std::string    BaselinePath;
+  AnalysisConfig Analysis;
+  ReportConfig   Report;
+  RequestFormat  Format      = RequestFormat::Terminal;
+  bool           SummaryOnly = false;
+  SeverityBudget Budget;
+};
+
+llvm::json::Value requestToJSON(const AnalysisRequest &Req);
+llvm::Expected<AnalysisRequest> requestFromJSON(const llvm::json::Value &V);
+
+// resident analysis daemon with a warm PassAnalyzer per worker; messages are
+// a 4-byte little-endian length followed by a JSON payload
+class AnalysisServer {
+public:
+  AnalysisServer(std::string SocketPath, unsigned NumWorkers,
+                 const AnalysisCache *Cache);
+
+  AnalysisServer(const AnalysisServer &)            = delete;
+  AnalysisServer &operator=(const AnalysisServer &) = delete;
+
+  // custom patterns every worker's analyzer uses; set before serve()
+  void setUserPatterns(const PatternDB *DB) { UserPatterns = DB; }
+
+  // closes connections that send nothing for this many seconds; 0 waits
+  // forever
+  void setIdleTimeout(unsigned Seconds) { IdleTimeout = Seconds; }
+
+  // listens until a client sends a shutdown request
+  llvm::Error serve();
+
+private:
+  void workerLoop();
+  void handleConnection(int FD, PassAnalyzer &Analyzer);
+  llvm::json::Value handleRequest(llvm::StringRef Payload,
+                                  PassAnalyzer &Analyzer);
+  void requestStop();
+
+  std::string          SocketPath;
+  unsigned             NumWorkers;
+  const AnalysisCache *Cache;
+  const PatternDB     *UserPatterns = nullptr;
+  unsigned             IdleTimeout  = 30;
+
+  std::mutex              QueueMutex;
+  std::condition_variable QueueCV;
+  std::deque<int>         PendingConnections;
+  bool                    Stopping = false;
+  int                     ListenFD = -1;
+};
+
+// renders a finished session in the requested format and returns the process
+// exit code the standalone tool would have used
+int renderRequestReport(const AnalysisSession &Session,
+                        const AnalysisRequest &Req, llvm::raw_ostream &OS,
+                        const PatternDB *UserPatterns = nullptr);
+
+// client side: runs Req on the server, copies the report to Out and returns
+// the server-side exit code
+llvm::Expected<int> sendAnalysisRequest(llvm::StringRef SocketPath,
+                                        const AnalysisRequest &Req,
+                                        llvm::raw_ostream &Out);
+
+llvm::Error sendShutdownRequest(llvm::StringRef SocketPath);
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "OptDebugger/DiagnosticEngine.h"
+#include "OptDebugger/Support.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace optdbg {
+
+// accepted diagnostics as remark fingerprints, one line per occurrence
+class DiagnosticBaseline {
+public:
+  static llvm::Expected<DiagnosticBaseline> load(llvm::StringRef Path);
+
+  // records every remark that becomes a diagnostic (all but applied ones)
+  static llvm::Error write(const std::vector<Remark> &Remarks,
+                           llvm::StringRef Path);
+
+  static uint64_t fingerprint(const Remark &R);
+
+  // how many diagnostics with this fingerprint the baseline accepts
+  unsigned count(uint64_t Fingerprint) const {
+    return Fingerprints.lookup(Fingerprint);
+  }
+  size_t size() const { return Fingerprints.size(); }
+
+  // hash of the file contents; part of the analysis cache key
+  const std::string &digest() const { return Digest; }
+
+private:
+  llvm::DenseMap<uint64_t, unsigned> Fingerprints;
+  std::string              Digest;
+};
+
+constexpr unsigned NumSeverityLevels = 5;
+
+// per-severity limits on reported diagnostics; with MinHotness set only code
+// known to be at least that hot counts
+struct SeverityBudget {
+  static constexpr int64_t Unlimited = -1;
+  int64_t Limits[NumSeverityLevels] = {0, Unlimited, Unlimited, Unlimited,
+                                       Unlimited};
+  std::optional<float> MinHotness;
+
+  // parses "high=5,medium=20,hot=1000"; levels not named keep their
+  // default, "unlimited" lifts a limit and "hot" sets MinHotness
+  static llvm::Expected<SeverityBudget> parse(llvm::StringRef Spec);
+
+  bool counts(const DiagnosticResult &D) const {
+    return !MinHotness || (D.Hotness && *D.Hotness >= *MinHotness);
+  }
+
+  // the most severe level whose count exceeds its limit, if any
+  std::optional<SeverityLevel>
+  firstExceeded(const std::vector<DiagnosticResult> &Diagnostics,
+                unsigned *Count = nullptr) const;
+};
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "OptDebugger/PassAnalyzer.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace optdbg {
+
+class AnalysisCache;
+
+// one translation unit: its IR and the remarks the compiler saved for it
+struct BatchUnit {
+  std::string IRPath;
+  std::string RemarksPath;
+  uint64_t    Bytes = 0;
+};
+
+struct BatchFailure {
+  std::string IRPath;
+  std::string Message;
+};
+
+// analyzes every TU of a project and merges the results into one session
+class BatchDriver {
+public:
+  BatchDriver(AnalysisConfig Config, unsigned NumWorkers,
+              const AnalysisCache *Cache);
+
+  void setBaseline(const DiagnosticBaseline *B) { Baseline = B; }
+  void setUserPatterns(const PatternDB *DB) { UserPatterns = DB; }
+  void setCodegen(const CodegenOptions *O) { Codegen = O; }
+
+  // finds .ll/.bc files with their .opt.yaml remarks, either through the
+  // entries of a compile_commands.json or by walking a directory tree
+  static llvm::Expected<std::vector<BatchUnit>> discover(llvm::StringRef Root);
+
+  // when KeepDiffs is false the per-instruction diffs are dropped as each
+  // unit finishes, which bounds memory on large projects
+  AnalysisSession run(std::vector<BatchUnit> Units, bool KeepDiffs,
+                      std::vector<BatchFailure> &Failures, bool Progress);
+
+private:
+  static llvm::Expected<std::vector<BatchUnit>>
+  discoverFromCompileCommands(llvm::StringRef Path);
+  static llvm::Expected<std::vector<BatchUnit>>
+  discoverFromDirectory(llvm::StringRef Dir);
+
+  AnalysisConfig       Config;
+  unsigned             NumWorkers;
+  const AnalysisCache *Cache;
+  const DiagnosticBaseline *Baseline = nullptr;
+  const PatternDB          *UserPatterns = nullptr;
+  const CodegenOptions     *Codegen = nullptr;
+};
+
+}
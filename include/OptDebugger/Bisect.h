@@ -0,0 +1,105 @@
+#pragma once
+
+#include "OptDebugger/IRDiff.h"
+#include "OptDebugger/Support.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace optdbg {
+
+enum class BisectCheck : uint8_t {
+  Changed,    // the function's IR differs from before the pipeline
+  Grew,       // the function has more instructions than a limit
+  Vectorized, // the function has vector-typed instructions
+  Remark,     // a remark of the pass (and name) has been emitted
+};
+
+// what to bisect for; its value may flip once between the first and the
+// last pass invocation, and the search finds the invocation that flips it
+struct BisectPredicate {
+  BisectCheck Check = BisectCheck::Changed;
+  // required except for Remark, where it narrows the remarks to one function
+  std::string Function;
+  // Grew: the instruction count to exceed; none compares with the count
+  // before the pipeline
+  std::optional<unsigned> Threshold;
+  // Remark
+  std::string PassName;
+  std::string RemarkName;
+
+  // parses changed:FN, grew:FN[:N], vectorized:FN or
+  // remark:PASS[/NAME][@FN]
+  static llvm::Expected<BisectPredicate> parse(llvm::StringRef Spec);
+
+  std::string describe() const;
+};
+
+// one optional pass the pipeline ran, numbered from 1 as -opt-bisect-limit
+// numbers them
+struct PassInvocation {
+  unsigned    Index = 0;
+  std::string Pass;
+  // "module", "function (f)", "scc (f, g)" or "loop %header in function f"
+  std::string IRUnit;
+};
+
+enum class BisectStatus : uint8_t {
+  Found,
+  // the predicate has the same value before the first and after the last
+  // invocation, so no single pass flips it
+  NoChange,
+};
+
+struct BisectResult {
+  BisectStatus   Status = BisectStatus::NoChange;
+  std::string    Pipeline;
+  // optional pass invocations of the whole pipeline
+  unsigned       Invocations = 0;
+  // the predicate's value after the whole pipeline
+  bool           FinalValue = false;
+  unsigned       Probes = 0;
+  unsigned       Rounds = 0;
+  // functions whose optnone and noinline the probes removed; opt sees the
+  // input unedited
+  unsigned       OptNoneDropped = 0;
+
+  PassInvocation Culprit;
+  // the invocations just before the culprit, oldest first
+  std::vector<PassInvocation> Preceding;
+  // the target function's instruction count without and with the culprit;
+  // -1 when the function does not exist at that point
+  int64_t        InstructionsBefore = -1;
+  int64_t        InstructionsAfter  = -1;
+  // the module with the first Culprit.Index - 1 invocations against the
+  // module with the first Culprit.Index
+  ModuleDiff     Delta;
+};
+
+struct BisectConfig {
+  // a new pass manager pipeline as opt -passes takes it; empty runs the
+  // default pipeline of OptLevel
+  std::string PassPipeline;
+  std::string OptLevel = "O2";
+  // probes run at once; each round splits the remaining range this many
+  // ways
+  unsigned    Threads = 1;
+};
+
+// finds the pass invocation that flips Predicate on IRText, probing
+// -opt-bisect-limit style pass counts in parallel
+llvm::Expected<BisectResult> runBisection(llvm::StringRef IRText,
+                                          const BisectPredicate &Predicate,
+                                          const BisectConfig &Config);
+
+void printBisectReport(const BisectResult &Result,
+                       const BisectPredicate &Predicate,
+                       llvm::raw_ostream &OS, bool UseColor, bool Verbose);
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "OptDebugger/Support.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace optdbg {
+
+struct CodegenOptions {
+  // empty: the module's triple, or the host's when the module has none
+  std::string Triple;
+  // empty: the target's generic CPU; "native" is the host's
+  std::string CPU;
+  // O0-O3; Os and Oz lower like O2
+  std::string OptLevel = "O2";
+};
+
+// what lowering one function left behind, from the register allocator's,
+// frame lowering's and asm printer's remarks and the emitted object
+struct MachineFunctionStats {
+  std::string Function;
+  unsigned    Spills        = 0;
+  unsigned    Reloads       = 0;
+  unsigned    FoldedSpills  = 0;
+  unsigned    FoldedReloads = 0;
+  uint64_t    StackBytes    = 0;
+  unsigned    Instructions  = 0;
+  uint64_t    CodeBytes     = 0;
+
+  unsigned spillsAndReloads() const {
+    return Spills + Reloads + FoldedSpills + FoldedReloads;
+  }
+};
+
+// lowers IRText to an in-memory object for the target; machine remarks go
+// to MachineRemarks and the stats come back in module order
+llvm::Expected<std::vector<MachineFunctionStats>>
+runCodegen(llvm::StringRef IRText, const CodegenOptions &Options,
+           std::vector<Remark> &MachineRemarks);
+
+}
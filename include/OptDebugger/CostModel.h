@@ -0,0 +1,24 @@
+#pragma once
+
+#include "OptDebugger/DiagnosticEngine.h"
+
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <memory>
+#include <vector>
+
+namespace optdbg {
+
+// registers every built-in target, with its asm printer and parser, once
+void initializeTargets();
+
+// the target machine for M's triple, or null when its target is not registered
+std::unique_ptr<llvm::TargetMachine> targetMachineFor(const llvm::Module &M);
+
+// replaces the pattern speedup of every covered diagnostic with one derived
+// from TTI costs of the affected code in M, weighted by loop trip counts
+void applyCostModel(llvm::Module &M,
+                    std::vector<DiagnosticResult> &Diagnostics);
+
+}
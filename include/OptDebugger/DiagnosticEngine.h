@@ -1,17 +1,24 @@
 #pragma once
 
 #include "OptDebugger/IRDiff.h"
+#include "OptDebugger/PatternPredicate.h"
 #include "OptDebugger/Support.h"
 
-#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 
+#include <initializer_list>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace optdbg {
 
+class DiagnosticBaseline;
+class PatternDB;
+
 enum class SeverityLevel : uint8_t {
   Critical,
   High,
@@ -20,14 +27,26 @@ enum class SeverityLevel : uint8_t {
   Info,
 };
 
+// the IR edit a what-if experiment applies to try a fix
+enum class FixEdit : uint8_t {
+  None,
+  RaiseInlineThreshold,
+  AlwaysInline,
+  RemoveNoInline,
+  NoAliasArguments,
+  ReadNoneCallees,
+};
+
 struct FixSuggestion {
   std::string Description;
   std::string CodeExample;
   bool        IsSourceLevel;
   bool        IsIRLevel;
+  FixEdit     Edit = FixEdit::None;
 };
 
 struct DiagnosticResult {
+  std::string               RuleID;
   std::string               PassName;
   std::string               FunctionName;
   SourceLocation            Location;
@@ -37,63 +56,213 @@ struct DiagnosticResult {
   std::string               WhatOptimizerWanted;
   std::vector<FixSuggestion> Suggestions;
   SeverityLevel             Severity;
-  std::optional<FunctionDiff> IRDiff;
+  // shared by every diagnostic of the same function
+  std::shared_ptr<const FunctionDiff> IRDiff;
   double                    EstimatedSpeedup;
+  // cycles per call of the function the target's cost model expects the fix
+  // to save; EstimatedSpeedup is derived from it when SpeedupModeled is set
+  double                    ModeledCyclesSaved = 0.0;
+  bool                      SpeedupModeled     = false;
   bool                      IsMachine = false;
+  // profile count of the remark's code, when the build had profile data
+  std::optional<float>      Hotness;
 
   bool hasFix() const { return !Suggestions.empty(); }
 };
 
+// what a rule says regardless of the remark that triggered it: the pattern's
+// templates as written and its severity before adjustments
+struct RuleDescription {
+  std::string   ShortDescription;
+  std::string   FullDescription;
+  std::string   WhatOptimizerWanted;
+  SeverityLevel DefaultSeverity = SeverityLevel::Medium;
+};
+
+// a fix as written in the pattern database; DiagnosticResult gets an owned
+// copy in FixSuggestion
+struct PatternFix {
+  llvm::StringRef Description;
+  llvm::StringRef CodeExample;
+  bool            IsSourceLevel = true;
+  bool            IsIRLevel     = false;
+  FixEdit         Edit          = FixEdit::None;
+
+  constexpr PatternFix withEdit(FixEdit E) const {
+    PatternFix F = *this;
+    F.Edit = E;
+    return F;
+  }
+};
+
+// an explanation template pre-split at its {Key} placeholders
+struct PatternTemplate {
+  static constexpr size_t MaxPlaceholders = 8;
+
+  // offset of the '{' and length including both braces
+  struct Placeholder {
+    uint32_t Offset = 0;
+    uint32_t Length = 0;
+  };
+
+  llvm::StringRef Text;
+  Placeholder     Placeholders[MaxPlaceholders] = {};
+  size_t          NumPlaceholders = 0;
+  // more than MaxPlaceholders; the rest are rendered as literal text
+  bool            Truncated = false;
+
+  constexpr PatternTemplate() = default;
+  constexpr PatternTemplate(std::string_view T) : Text(T) {
+    for (size_t Open = T.find('{'); Open != std::string_view::npos;
+         Open = T.find('{', Open + 1)) {
+      size_t Close = Open + 1;
+      while (Close < T.size() && isKeyChar(T[Close]))
+        ++Close;
+      if (Close == Open + 1 || Close == T.size() || T[Close] != '}')
+        continue;
+      if (NumPlaceholders == MaxPlaceholders) {
+        Truncated = true;
+        return;
+      }
+      Placeholders[NumPlaceholders++] =
+          Placeholder{uint32_t(Open), uint32_t(Close + 1 - Open)};
+      Open = Close;
+    }
+  }
+
+  void render(const Remark &R, std::string &Out) const;
+  std::string render(const Remark &R) const;
+
+private:
+  static constexpr bool isKeyChar(char C) {
+    return (C >= 'a' && C <= 'z') || (C >= 'A' && C <= 'Z') ||
+           (C >= '0' && C <= '9') || C == '_' || C == '.';
+  }
+};
+
+// overrides a pattern's severity and speedup when its condition holds, so a
+// diagnostic reflects how close the optimizer came to succeeding
+struct PatternAdjustment {
+  PredicateProgram Condition;
+  SeverityLevel    Severity         = SeverityLevel::Medium;
+  double           EstimatedSpeedup = 0.0;
+  bool             HasSeverity      = false;
+  bool             HasSpeedup       = false;
+};
+
+// one constant-initialized entry of the built-in pattern database
 struct OptimizationPattern {
+  static constexpr size_t MaxSuggestions  = 6;
+  static constexpr size_t MaxAdjustments  = 3;
+  static constexpr size_t MaxRuleIDLength = 96;
+
   llvm::StringRef PassNameSubstr;
   llvm::StringRef RemarkNameSubstr;
   llvm::StringRef MessageSubstr;
-  std::string     ShortReason;
-  std::string     DetailedExplanation;
-  std::string     RootCause;
-  std::string     WhatOptimizerWanted;
-  std::vector<FixSuggestion> Suggestions;
+  llvm::StringRef ShortReason;
+  PatternTemplate DetailedExplanation;
+  PatternTemplate RootCause;
+  PatternTemplate WhatOptimizerWanted;
+  PatternFix      Fixes[MaxSuggestions] = {};
+  size_t          NumFixes = 0;
   SeverityLevel   Severity;
   double          EstimatedSpeedup;
+  char            RuleIDData[MaxRuleIDLength] = {};
+  size_t          RuleIDLength = 0;
+
+  PredicateProgram  Where;
+  PatternAdjustment Adjustments[MaxAdjustments] = {};
+  size_t            NumAdjustments = 0;
+
+  constexpr OptimizationPattern(std::string_view PassName,
+                                std::string_view RemarkName,
+                                std::string_view Message,
+                                llvm::StringRef ShortReason,
+                                std::string_view DetailedExplanation,
+                                std::string_view RootCause,
+                                std::string_view WhatOptimizerWanted,
+                                std::initializer_list<PatternFix> Suggestions,
+                                SeverityLevel Severity, double EstimatedSpeedup,
+                                std::initializer_list<PatternAdjustment> Adjust = {},
+                                std::string_view Where = {})
+      : PassNameSubstr(PassName), RemarkNameSubstr(RemarkName),
+        MessageSubstr(Message), ShortReason(ShortReason),
+        DetailedExplanation(DetailedExplanation), RootCause(RootCause),
+        WhatOptimizerWanted(WhatOptimizerWanted), Severity(Severity),
+        EstimatedSpeedup(EstimatedSpeedup),
+        Where(PredicateProgram::compile(Where)) {
+    for (const PatternFix &F : Suggestions)
+      Fixes[NumFixes++] = F;
+    for (const PatternAdjustment &A : Adjust)
+      Adjustments[NumAdjustments++] = A;
+    appendRuleComponent(PassName, true);
+    appendRuleComponent(RemarkName, false);
+    appendRuleComponent(Message, true);
+  }
+
+  llvm::ArrayRef<PatternFix> suggestions() const { return {Fixes, NumFixes}; }
+  llvm::ArrayRef<PatternAdjustment> adjustments() const {
+    return {Adjustments, NumAdjustments};
+  }
+  llvm::StringRef ruleID() const { return {RuleIDData, RuleIDLength}; }
+
+private:
+  // appends a lowercase, dash-separated form of a matcher substring
+  constexpr void appendRuleComponent(std::string_view Part, bool Lower) {
+    if (Part.empty())
+      return;
+    if (RuleIDLength)
+      RuleIDData[RuleIDLength++] = '/';
+    bool PendingDash = false;
+    for (char C : Part) {
+      bool Upper = C >= 'A' && C <= 'Z';
+      if (!Upper && !(C >= 'a' && C <= 'z') && !(C >= '0' && C <= '9')) {
+        PendingDash = true;
+        continue;
+      }
+      if (PendingDash && RuleIDLength && RuleIDData[RuleIDLength - 1] != '/')
+        RuleIDData[RuleIDLength++] = '-';
+      PendingDash = false;
+      RuleIDData[RuleIDLength++] = Lower && Upper ? C - 'A' + 'a' : C;
+    }
+  }
 };
 
 class DiagnosticEngine {
 public:
-  DiagnosticEngine();
+  DiagnosticEngine() = default;
   ~DiagnosticEngine() = default;
 
   DiagnosticEngine(const DiagnosticEngine &)            = delete;
   DiagnosticEngine &operator=(const DiagnosticEngine &) = delete;
 
+  // remarks found in the baseline are skipped before any diagnostic is
+  // built for them; NumSuppressed receives how many were skipped
+  void setBaseline(const DiagnosticBaseline *B) { Baseline = B; }
+
+  // user patterns are scored alongside the built-in ones and win ties, so a
+  // team pattern with the same matchers replaces the built-in explanation
+  void setUserPatterns(const PatternDB *DB) { UserPatterns = DB; }
+
   std::vector<DiagnosticResult>
   analyze(const std::vector<Remark> &Remarks,
-          const ModuleDiff          &Diff) const;
+          const ModuleDiff          &Diff,
+          unsigned                  *NumSuppressed = nullptr) const;
 
   DiagnosticResult
   analyzeRemark(const Remark              &R,
                 const ModuleDiff          &Diff) const;
 
+  // describes D's rule from the user or built-in pattern with its id, or
+  // generically for fallback rules
+  RuleDescription describeRule(const DiagnosticResult &D) const;
+
 private:
-  std::vector<OptimizationPattern> GenericPatterns;
-  llvm::StringMap<std::vector<OptimizationPattern>> SpecificPatterns;
-
-  void registerPatterns();
-  void addPattern(OptimizationPattern P);
-
-  void registerInliningPatterns();
-  void registerLoopVectorizationPatterns();
-  void registerSLPVectorizationPatterns();
-  void registerSROAPatterns();
-  void registerLoopUnrollPatterns();
-  void registerTailCallPatterns();
-  void registerGVNPatterns();
-  void registerMemCpyOptPatterns();
-  void registerLoopInterchangePatterns();
-  void registerLICMPatterns();
-  void registerGenericPatterns();
+  const DiagnosticBaseline *Baseline = nullptr;
+  const PatternDB          *UserPatterns = nullptr;
 
   const OptimizationPattern *
-  findMatchingPattern(const Remark &R) const;
+  findMatchingPattern(const Remark &R, int &Score) const;
 
   DiagnosticResult
   buildFromPattern(const Remark              &R,
@@ -104,11 +273,11 @@ private:
 
   DiagnosticResult
   analyzeRemark(const Remark &R) const;
-
-  static std::string interpolateArgs(const std::string &Template,
-                                      const Remark      &R);
 };
 
+// most severe first; within a severity the larger modeled saving first
+bool ranksBefore(const DiagnosticResult &A, const DiagnosticResult &B);
+
 llvm::StringRef severityToString(SeverityLevel S);
 llvm::StringRef severityToEmoji(SeverityLevel S);
 
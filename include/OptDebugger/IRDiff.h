@@ -63,7 +63,8 @@ struct FunctionDiff {
 };
 
 struct ModuleDiff {
-  std::vector<FunctionDiff>   Functions;
+  // diagnostics of a function attach its entry here rather than a copy
+  std::vector<std::shared_ptr<FunctionDiff>> Functions;
   size_t                      AddedFunctions;
   size_t                      RemovedFunctions;
   size_t                      ModifiedFunctions;
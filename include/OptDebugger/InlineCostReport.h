@@ -0,0 +1,71 @@
+#pragma once
+
+#include "OptDebugger/Support.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace optdbg {
+
+// a missed inlining call site with its full inline cost recomputed on the input
+struct InlineSiteCost {
+  std::string          Caller;
+  std::string          Callee;
+  SourceLocation       Loc;
+  std::optional<float> Hotness;
+  // why the call site could not be analyzed; empty when it was
+  std::string          Unresolved;
+  // always/never decisions carry LLVM's reason instead of a cost
+  bool                 Always = false;
+  bool                 Never  = false;
+  std::string          Reason;
+  int                  Cost      = 0;
+  int                  Threshold = 0;
+  // the numbers the compiler put in the remark, for comparison
+  std::optional<int>   RemarkCost;
+  std::optional<int>   RemarkThreshold;
+  // nonzero bonuses and penalties of the cost, largest first
+  std::vector<std::pair<std::string, int>> Components;
+
+  bool analyzed() const { return Unresolved.empty(); }
+  bool hasCost() const { return analyzed() && !Always && !Never; }
+  // how far the cost is over the threshold; inlining needs it below zero
+  int  gap() const { return Cost - Threshold; }
+};
+
+// the missed sites of one callee
+struct InlineCalleeCost {
+  std::string Callee;
+  unsigned    Sites = 0;
+  unsigned    Never = 0;
+  // summed remark hotness, when the remarks carried any
+  double      Hotness = 0;
+  int         MinGap = 0;
+  int         MaxGap = 0;
+};
+
+struct InlineCostReport {
+  std::vector<InlineSiteCost>   Sites;
+  // callees whose shrinking unblocks the most (hottest) sites come first
+  std::vector<InlineCalleeCost> Callees;
+  unsigned                      Unresolved = 0;
+  int                           DefaultThreshold = 0;
+};
+
+// recomputes the inline cost of every missed inlining remark's call site in M
+InlineCostReport analyzeInlineCosts(llvm::Module &M,
+                                    llvm::ArrayRef<Remark> Remarks,
+                                    llvm::StringRef OptLevel);
+
+// a per-callee ranking, followed by every site's breakdown when Verbose
+void printInlineCostReport(const InlineCostReport &Report,
+                           llvm::raw_ostream &OS, bool Verbose);
+
+}
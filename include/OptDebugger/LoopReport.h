@@ -0,0 +1,92 @@
+#pragma once
+
+#include "OptDebugger/Support.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace optdbg {
+
+enum class LoopTransform : uint8_t {
+  Vectorize,
+  Unroll,
+  Interchange,
+  LICM,
+};
+
+llvm::StringRef loopTransformName(LoopTransform T);
+
+// a missed or analysis remark about one of the loop's transformations
+struct LoopBlocker {
+  LoopTransform  Transform;
+  std::string    PassName;
+  std::string    RemarkName;
+  std::string    Message;
+  SourceLocation Loc;
+};
+
+// one loop of the input module and what the optimizer did to it
+struct LoopSummary {
+  std::string    Function;
+  std::string    Header;
+  SourceLocation Loc;
+  unsigned       Depth = 1;
+  // lines the loop's instructions span, for remarks inside the body
+  unsigned       FirstLine = 0;
+  unsigned       LastLine  = 0;
+
+  // from ScalarEvolution on the input, or on the output when the input's
+  // loop is not in a form SCEV understands (-O0 IR)
+  std::optional<unsigned> TripCount;
+  std::optional<unsigned> MaxTripCount;
+  // the backedge-taken count when it is known but not constant
+  std::string             SymbolicTripCount;
+
+  unsigned InstructionsBefore = 0;
+  bool     PresentAfter       = false;
+  unsigned InstructionsAfter  = 0;
+
+  unsigned VectorizationFactor = 0;
+  unsigned InterleaveCount     = 0;
+  unsigned UnrollCount         = 0;
+  bool     FullyUnrolled       = false;
+  unsigned PeelCount           = 0;
+  bool     Interchanged        = false;
+  // instructions hoisted, sunk or promoted out of the loop
+  unsigned LICMApplied         = 0;
+
+  std::vector<LoopBlocker> Blockers;
+
+  bool vectorized() const {
+    return VectorizationFactor > 1 || InterleaveCount > 1;
+  }
+  bool unrolled() const { return FullyUnrolled || UnrollCount > 1; }
+};
+
+struct LoopReport {
+  // in module order, outer loops before the loops they contain
+  std::vector<LoopSummary> Loops;
+  // loop-pass remarks in functions or at lines with no loop of the input
+  unsigned                 UnmatchedRemarks = 0;
+  // an output module was given, so every loop is known kept or gone
+  bool                     HasOutput = false;
+};
+
+// After is the optimized module when there is one; without it only remarks
+// describe the transformations
+LoopReport buildLoopReport(llvm::Module &Before, llvm::Module *After,
+                           llvm::ArrayRef<Remark> Remarks);
+
+// one row per loop, then what blocked each transformation; Verbose prints
+// every blocking remark's message in full
+void printLoopReport(const LoopReport &Report, llvm::raw_ostream &OS,
+                     bool Verbose);
+
+}
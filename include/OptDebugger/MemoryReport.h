@@ -0,0 +1,41 @@
+#pragma once
+
+#include "OptDebugger/PassAnalyzer.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace optdbg {
+
+// Bytes one subsystem holds, split into its records (vector storage and
+// fixed-size members) and the heap blocks of the strings it owns.
+struct MemoryCategory {
+  const char *Name;
+  uint64_t    Items   = 0;
+  uint64_t    Records = 0;
+  uint64_t    Strings = 0;
+  // true where the size is derived from counts rather than walked
+  bool        Estimated = false;
+
+  uint64_t total() const { return Records + Strings; }
+};
+
+// per-subsystem memory accounting for --memory-report
+class MemoryAccounting {
+public:
+  static void enable();
+  static bool isEnabled();
+
+  // records a transient buffer; the report keeps the largest size per name
+  static void noteBuffer(llvm::StringRef Name, uint64_t Bytes);
+
+  static std::vector<MemoryCategory> measure(const AnalysisSession &Session);
+
+  // the breakdown with shares of the accounted total and of resident memory
+  static void print(const AnalysisSession &Session, llvm::raw_ostream &OS);
+};
+
+}
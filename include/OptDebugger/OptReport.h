@@ -3,8 +3,12 @@
 #include "OptDebugger/DiagnosticEngine.h"
 #include "OptDebugger/PassAnalyzer.h"
 #include "OptDebugger/Support.h"
+#include "llvm/Support/JSON.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <memory>
+#include <string>
+
 namespace optdbg {
 
 struct ReportConfig {
@@ -20,6 +24,32 @@ struct ReportConfig {
   SeverityLevel MinSeverity = SeverityLevel::Low;
 };
 
+enum class GroupKey : uint8_t {
+  None,
+  Pass,
+  Function,
+  PassAndFunction,
+};
+
+// a partition of the session's diagnostics. Indices point into
+// AnalysisSession::Diagnostics and are ordered by severity within the group.
+struct DiagnosticGroup {
+  std::string           Key;
+  std::vector<uint32_t> Indices;
+  unsigned              SeverityCounts[5] = {0, 0, 0, 0, 0};
+  // sum of each diagnostic's speedup over 1x, an additive estimate of the
+  // group's payoff
+  double                EstimatedGain = 0.0;
+
+  SeverityLevel worstSeverity() const;
+};
+
+GroupKey groupKeyFor(const ReportConfig &Cfg);
+
+std::vector<DiagnosticGroup>
+groupDiagnostics(const std::vector<DiagnosticResult> &Diagnostics,
+                 GroupKey By, SeverityLevel MinSeverity);
+
 class TerminalReporter {
 public:
   TerminalReporter(llvm::raw_ostream &OS, ReportConfig Config);
@@ -30,13 +60,17 @@ private:
   void printColoredLine(llvm::StringRef Text, llvm::raw_ostream::Colors Color);
   void printHeader(const AnalysisSession &Session);
   void printSummaryStats(const AnalysisSession &Session);
+  void printMachineStats(const AnalysisSession &Session);
   void printDiagnostic(const DiagnosticResult &D);
   void printDiagnosticHeader(const DiagnosticResult &D);
   void printExplanation(const DiagnosticResult &D);
   void printSuggestions(const DiagnosticResult &D);
   void printIRDiff(const FunctionDiff &Diff);
   void printFooter(const AnalysisSession &Session);
-  void sortAndFilter(std::vector<DiagnosticResult> &Results) const;
+  void printGroupOverview(const std::vector<DiagnosticGroup> &Groups);
+  void printGroupHeader(const DiagnosticGroup &G);
+  std::vector<uint32_t>
+  sortAndFilter(const std::vector<DiagnosticResult> &Results) const;
 
   llvm::raw_ostream &OS;
   ReportConfig Cfg;
@@ -47,22 +81,101 @@ public:
   HTMLReporter(llvm::raw_ostream &OS);
   void report(const AnalysisSession &Session, const ReportConfig &Cfg);
 
+  // writes a shell page to OS and the data chunks it fetches into DataDir
+  llvm::Error reportChunked(const AnalysisSession &Session,
+                            const ReportConfig    &Cfg,
+                            llvm::StringRef        DataDir);
+
 private:
   void emitHeader(llvm::StringRef Title);
   void emitSummary(const AnalysisSession &Session);
   void emitDiagnostic(const DiagnosticResult &D, const ReportConfig &Cfg);
+  void emitGroupHeader(const DiagnosticGroup &G);
   void emitIRDiff(const FunctionDiff &Diff);
   void emitFooter();
+  void emitChunkedShell(const AnalysisSession &Session,
+                        llvm::StringRef DataDirName);
 
+  static llvm::Error writeDataFile(llvm::StringRef DataDir,
+                                   llvm::StringRef Name,
+                                   llvm::StringRef JSON);
   static std::string escapeHTML(llvm::StringRef S);
   static std::string severityToHTMLClass(SeverityLevel S);
 
   llvm::raw_ostream &OS;
 };
 
+enum class JSONFormat : uint8_t {
+  NDJSON,
+  Document,
+};
+
+// streams records as NDJSON or one JSON document without building a json tree
+class JSONReporter {
+public:
+  JSONReporter(llvm::raw_ostream &OS, JSONFormat Format = JSONFormat::NDJSON);
+  void report(const AnalysisSession &Session, const ReportConfig &Cfg);
+
+private:
+  void emitRecord(llvm::StringRef Type,
+                  llvm::function_ref<void(llvm::json::OStream &)> Body);
+  void beginSection(llvm::StringRef Name);
+  void endSection();
+
+  static void writeLocation(llvm::json::OStream &J, llvm::StringRef Key,
+                            const SourceLocation &Loc);
+  static void writeSession(llvm::json::OStream &J,
+                           const AnalysisSession &Session);
+  static void writeRemark(llvm::json::OStream &J, const Remark &R);
+  static void writeMachineFunction(llvm::json::OStream &J,
+                                   const MachineFunctionStats &M);
+  static void writeFunctionDiff(llvm::json::OStream &J,
+                                const FunctionDiff &FD, bool Verbose);
+  static void writeDiagnostic(llvm::json::OStream &J,
+                              const DiagnosticResult &D,
+                              const ReportConfig &Cfg);
+  static void writeSummary(llvm::json::OStream &J,
+                           const AnalysisSession &Session);
+
+  llvm::raw_ostream &OS;
+  JSONFormat Format;
+  std::unique_ptr<llvm::json::OStream> Doc;
+};
+
+// emits a sarif 2.1.0 log with one rule table entry per distinct rule id
+class SARIFReporter {
+public:
+  // rules of user patterns are described from UserPatterns when given
+  SARIFReporter(llvm::raw_ostream &OS, const PatternDB *UserPatterns = nullptr);
+  void report(const AnalysisSession &Session, const ReportConfig &Cfg);
+
+private:
+  void writeRule(llvm::json::OStream &J, const DiagnosticResult &First,
+                 const RuleDescription &Rule, const ReportConfig &Cfg);
+  void writeResult(llvm::json::OStream &J, const DiagnosticResult &D,
+                   unsigned RuleIndex, const RuleDescription &Rule);
+
+  static llvm::StringRef severityToSARIFLevel(SeverityLevel S);
+  static std::string pathToURI(llvm::StringRef Path);
+
+  llvm::raw_ostream &OS;
+  DiagnosticEngine   Rules;
+};
+
+struct ReportOutputs {
+  std::string HTMLPath;
+  std::string JSONPath;
+  std::string SARIFPath;
+  JSONFormat  JSONStyle    = JSONFormat::NDJSON;
+  // describes user pattern rules in the SARIF rule table
+  const PatternDB *UserPatterns = nullptr;
+  bool        HTMLChunked  = false;
+  bool        EmitTerminal = true;
+};
+
 void generateReport(const AnalysisSession &Session,
                     const ReportConfig    &Cfg,
                     llvm::raw_ostream     &TerminalOS,
-                    llvm::StringRef        HTMLOutputPath);
+                    const ReportOutputs   &Outputs);
 
 }
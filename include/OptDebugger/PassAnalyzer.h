@@ -1,18 +1,23 @@
 #pragma once
 
+#include "OptDebugger/CodegenStage.h"
 #include "OptDebugger/DiagnosticEngine.h"
 #include "OptDebugger/IRDiff.h"
 #include "OptDebugger/RemarkCollector.h"
 #include "OptDebugger/Support.h"
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/Error.h"
 
 #include <memory>
+#include <optional>
 #include <string>
 
 namespace optdbg {
 
+class AnalysisCache;
+
 struct AnalysisConfig {
   std::string   PassPipeline;
   std::string   OptLevel;
@@ -23,6 +28,9 @@ struct AnalysisConfig {
   unsigned      InlineThreshold     = 225;
   bool          EnableVectorization = true;
   bool          EnableUnrolling     = true;
+  // remarks YAML written by the compiler for this input; merged with the
+  // remarks collected from the analysis pipeline
+  std::string   ExternalRemarksPath;
 };
 
 struct AnalysisSession {
@@ -36,6 +44,15 @@ struct AnalysisSession {
   std::vector<DiagnosticResult> Diagnostics;
   std::string                   PassPipelineUsed;
   bool                          VerificationFailed = false;
+  bool                          LoadedFromCache    = false;
+  // remarks skipped because their diagnostic is in the active baseline
+  unsigned                      BaselineSuppressed = 0;
+  // one per defined function when the codegen stage ran
+  std::vector<MachineFunctionStats> MachineFunctions;
+  // codegen was requested and failed; such sessions are not cached
+  bool                          CodegenFailed = false;
+  // provenance recorded in saved snapshots (tool version, inputs, time)
+  std::vector<std::pair<std::string, std::string>> Metadata;
 };
 
 class PassAnalyzer {
@@ -46,6 +63,27 @@ public:
   PassAnalyzer(const PassAnalyzer &)            = delete;
   PassAnalyzer &operator=(const PassAnalyzer &) = delete;
 
+  // file-based runs consult this cache before parsing and fill it afterwards;
+  // cached sessions carry no modules or printed IR
+  void setCache(const AnalysisCache *C) { Cache = C; }
+
+  // diagnostics already accepted in this baseline are left out of sessions;
+  // the baseline contents become part of every cache key
+  void setBaseline(const DiagnosticBaseline *B) {
+    Baseline = B;
+    DiagEngine.setBaseline(B);
+  }
+
+  // custom patterns used next to the built-in database; their source digest
+  // becomes part of every cache key
+  void setUserPatterns(const PatternDB *DB) {
+    UserPatterns = DB;
+    DiagEngine.setUserPatterns(DB);
+  }
+
+  // lowers every output module for this target; part of every cache key
+  void setCodegen(const CodegenOptions *O) { Codegen = O; }
+
   llvm::Expected<AnalysisSession>
   runFromFile(llvm::StringRef InputPath, const AnalysisConfig &Config);
 
@@ -62,6 +100,15 @@ public:
                  std::unique_ptr<llvm::Module> After,
                  std::vector<Remark>           ExternalRemarks);
 
+  // parses a -fsave-optimization-record YAML file
+  static llvm::Expected<std::vector<Remark>>
+  parseRemarksYAML(llvm::StringRef Path);
+
+  // streams the remarks of a YAML file one at a time, without collecting them
+  static llvm::Error
+  forEachRemarkYAML(llvm::StringRef Path,
+                    llvm::function_ref<void(Remark &&)> Callback);
+
 private:
   llvm::Expected<AnalysisSession>
   executeAnalysis(std::unique_ptr<llvm::Module> BeforeModule,
@@ -71,6 +118,8 @@ private:
                                const AnalysisConfig     &Config,
                                RemarkCollector          &Collector);
 
+  void runCodegenStage(AnalysisSession &Session) const;
+
   static std::string moduleToString(const llvm::Module &M);
 
   static llvm::Expected<std::unique_ptr<llvm::Module>>
@@ -79,13 +128,17 @@ private:
   static llvm::Expected<std::unique_ptr<llvm::Module>>
   parseIRFromString(llvm::StringRef IRText, llvm::LLVMContext &Ctx);
 
-  static llvm::Expected<std::vector<Remark>>
-  parseRemarksYAML(llvm::StringRef Path);
-
   static llvm::Error verifyModule(const llvm::Module &M);
 
+  std::optional<AnalysisSession> lookupCached(const std::string &Key) const;
+  void storeCached(const std::string &Key, const AnalysisSession &S) const;
+
   IRDiffEngine   DiffEngine;
   DiagnosticEngine DiagEngine;
+  const AnalysisCache *Cache = nullptr;
+  const DiagnosticBaseline *Baseline = nullptr;
+  const PatternDB          *UserPatterns = nullptr;
+  const CodegenOptions     *Codegen = nullptr;
 };
 
 }
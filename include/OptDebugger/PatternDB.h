@@ -0,0 +1,151 @@
+#pragma once
+
+#include "OptDebugger/DiagnosticEngine.h"
+#include "OptDebugger/Support.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace optdbg {
+
+class CacheKeyBuilder;
+
+// compiled user pattern index, mapped read-only and used in place
+constexpr char     PatternDBMagic[8]      = {'A', 'I', 'O', 'N', 'P', 'D', 'B', '\0'};
+constexpr uint32_t PatternDBFormatVersion = 2;
+
+// accumulates parsed pattern sources and writes them as one index
+class PatternDBCompiler {
+public:
+  PatternDBCompiler();
+  ~PatternDBCompiler();
+
+  // parses one pattern source; errors carry the file and line
+  llvm::Error addSourceFile(llvm::StringRef Path);
+  llvm::Error addSource(llvm::StringRef Text, llvm::StringRef Name);
+
+  llvm::Error write(llvm::StringRef Path) const;
+  void write(llvm::raw_ostream &OS) const;
+
+  size_t size() const { return Patterns.size(); }
+
+private:
+  struct Fix {
+    std::string Description;
+    std::string CodeExample;
+    bool        IsIRLevel = false;
+    FixEdit     Edit      = FixEdit::None;
+  };
+
+  struct Adjustment {
+    std::string   Condition;
+    SeverityLevel Severity = SeverityLevel::Medium;
+    double        EstimatedSpeedup = 0.0;
+    bool          HasSeverity = false;
+    bool          HasSpeedup  = false;
+  };
+
+  struct Entry {
+    std::string      Pass, RemarkName, Message;
+    std::string      ShortReason, Explanation, RootCause, Wanted;
+    std::string      RuleID;
+    std::vector<Fix> Fixes;
+    SeverityLevel    Severity = SeverityLevel::Medium;
+    double           EstimatedSpeedup = 0.0;
+    std::string             Where;
+    std::vector<Adjustment> Adjustments;
+  };
+
+  std::vector<Entry>               Patterns;
+  // hashes the format version and every source, in order
+  std::unique_ptr<CacheKeyBuilder> Key;
+};
+
+// read-only view of a compiled index
+class PatternDB {
+public:
+  // opens a compiled index file
+  static llvm::Expected<std::unique_ptr<PatternDB>> open(llvm::StringRef Path);
+
+  // loads sources through the index cache in CacheDir, or opens one index
+  static llvm::Expected<std::unique_ptr<PatternDB>>
+  load(llvm::ArrayRef<std::string> Paths, llvm::StringRef CacheDir);
+
+  // <user cache directory>/aion/patterns, or empty when there is none
+  static std::string defaultCacheDirectory();
+
+  size_t size() const { return NumPatterns; }
+
+  // hash of the sources the index was compiled from; part of analysis cache
+  // keys
+  llvm::StringRef digest() const { return Digest; }
+
+  // true when the index came from the cache rather than a fresh compile
+  bool loadedFromCache() const { return FromCache; }
+
+  // the highest scoring pattern, scored like the built-in database
+  std::optional<uint32_t> match(const Remark &R, int &Score) const;
+
+  // a pattern whose strings point into the mapped index, built when the
+  // index is opened
+  const OptimizationPattern &pattern(uint32_t Id) const { return Patterns[Id]; }
+
+  // the first pattern with this rule id
+  std::optional<uint32_t> findRule(llvm::StringRef RuleID) const;
+
+private:
+  PatternDB() = default;
+
+  static llvm::Expected<std::unique_ptr<PatternDB>>
+  fromBuffer(std::unique_ptr<llvm::MemoryBuffer> Buffer);
+
+  llvm::Error bind();
+
+  llvm::StringRef string(const char *Ref) const;
+  OptimizationPattern buildPattern(uint32_t Id) const;
+  uint32_t requiredFields(uint32_t Id) const;
+  // the stored program; one that never holds for an index out of range
+  PredicateProgram program(uint32_t Index) const;
+  // appends the needles of Field found in Text; may repeat ids
+  void scan(llvm::StringRef Text, unsigned Field,
+            llvm::SmallVectorImpl<uint32_t> &Needles) const;
+
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  bool            FromCache = false;
+  llvm::StringRef Digest;
+  uint64_t        NumPatterns = 0;
+  uint64_t        NumFixes    = 0;
+  uint64_t        NumPrograms = 0;
+  uint64_t        NumAdjustments = 0;
+  uint64_t        NumNeedles  = 0;
+  uint64_t        NumPostings = 0;
+  uint64_t        NumStates   = 0;
+  uint32_t        NumClasses  = 0;
+  uint64_t        NumOutputs  = 0;
+  llvm::StringRef Strings;
+  const char     *Records     = nullptr;
+  const char     *Fixes       = nullptr;
+  const char     *Programs    = nullptr;
+  const char     *Adjustments = nullptr;
+  const char     *NeedleFields   = nullptr;
+  const char     *NeedleOffsets  = nullptr;
+  const char     *NeedlePatterns = nullptr;
+  const uint8_t  *ClassMap    = nullptr;
+  const char     *Transitions = nullptr;
+  const char     *OutputOffsets = nullptr;
+  const char     *OutputNeedles = nullptr;
+  // one per record; templates are tokenized and programs decoded once
+  std::vector<OptimizationPattern> Patterns;
+};
+
+}
@@ -0,0 +1,341 @@
+#pragma once
+
+#include "OptDebugger/Support.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace optdbg {
+
+enum class PredicateOp : uint8_t {
+  PushNumber,   // Numbers[A]
+  PushArg,      // numeric value of argument Names[A]
+  HasArg,       // argument Names[A] is present
+  ArgContains,  // argument Names[A] contains Names[B], ignoring case
+  ArgEquals,    // argument Names[A] is exactly Names[B]
+  Add,
+  Sub,
+  Mul,
+  Div,
+  Neg,
+  Less,
+  LessEqual,
+  Greater,
+  GreaterEqual,
+  Equal,
+  NotEqual,
+  Not,
+  // peek the top of the stack: jump to A when it decides the result,
+  // otherwise pop it and fall through (short-circuit && and ||)
+  JumpIfFalse,
+  JumpIfTrue,
+};
+
+struct PredicateInstr {
+  PredicateOp Op = PredicateOp::PushNumber;
+  uint8_t     A  = 0;
+  uint8_t     B  = 0;
+};
+
+// a condition over a remark's arguments, compiled into a stack program
+struct PredicateProgram {
+  static constexpr size_t MaxInstructions = 24;
+  static constexpr size_t MaxNumbers      = 8;
+  static constexpr size_t MaxNames        = 8;
+
+  PredicateInstr   Code[MaxInstructions] = {};
+  double           Numbers[MaxNumbers]   = {};
+  std::string_view Names[MaxNames]       = {};
+  uint8_t          Length     = 0;
+  uint8_t          NumNumbers = 0;
+  uint8_t          NumNames   = 0;
+  const char      *Error       = nullptr;
+  size_t           ErrorOffset = 0;
+
+  static constexpr PredicateProgram compile(std::string_view Source);
+
+  constexpr bool empty() const { return Length == 0; }
+  constexpr bool valid() const { return Error == nullptr; }
+
+  // an empty program holds for every remark
+  bool evaluate(const Remark &R) const;
+};
+
+namespace detail {
+
+// recursive-descent parser emitting postfix code, lowest precedence first:
+// ||, &&, !, comparisons, + -, * /, unary -, atoms
+class PredicateParser {
+public:
+  constexpr PredicateParser(std::string_view Source, PredicateProgram &P)
+      : Src(Source), P(P) {}
+
+  constexpr void run() {
+    skipSpace();
+    if (Pos == Src.size())
+      return;
+    parseOr();
+    skipSpace();
+    if (!P.Error && Pos != Src.size())
+      fail("unexpected text after the condition");
+  }
+
+private:
+  std::string_view  Src;
+  PredicateProgram &P;
+  size_t            Pos = 0;
+
+  constexpr void fail(const char *Msg) {
+    if (P.Error)
+      return;
+    P.Error       = Msg;
+    P.ErrorOffset = Pos;
+  }
+
+  constexpr void skipSpace() {
+    while (Pos < Src.size() && (Src[Pos] == ' ' || Src[Pos] == '\t'))
+      ++Pos;
+  }
+
+  constexpr bool consume(std::string_view Token) {
+    skipSpace();
+    if (Src.substr(Pos, Token.size()) != Token)
+      return false;
+    Pos += Token.size();
+    return true;
+  }
+
+  constexpr uint8_t emit(PredicateOp Op, uint8_t A = 0, uint8_t B = 0) {
+    if (P.Length == PredicateProgram::MaxInstructions) {
+      fail("condition is too long");
+      return 0;
+    }
+    P.Code[P.Length] = PredicateInstr{Op, A, B};
+    return P.Length++;
+  }
+
+  constexpr uint8_t addNumber(double V) {
+    if (P.NumNumbers == PredicateProgram::MaxNumbers) {
+      fail("condition has too many constants");
+      return 0;
+    }
+    P.Numbers[P.NumNumbers] = V;
+    return P.NumNumbers++;
+  }
+
+  constexpr uint8_t addName(std::string_view Name) {
+    for (uint8_t I = 0; I < P.NumNames; ++I)
+      if (P.Names[I] == Name)
+        return I;
+    if (P.NumNames == PredicateProgram::MaxNames) {
+      fail("condition names too many arguments and strings");
+      return 0;
+    }
+    P.Names[P.NumNames] = Name;
+    return P.NumNames++;
+  }
+
+  static constexpr bool isIdentStart(char C) {
+    return (C >= 'a' && C <= 'z') || (C >= 'A' && C <= 'Z') || C == '_';
+  }
+  static constexpr bool isIdentChar(char C) {
+    return isIdentStart(C) || (C >= '0' && C <= '9') || C == '.';
+  }
+  static constexpr bool isDigit(char C) { return C >= '0' && C <= '9'; }
+
+  constexpr std::string_view parseIdent() {
+    skipSpace();
+    size_t Start = Pos;
+    if (Pos < Src.size() && isIdentStart(Src[Pos]))
+      while (Pos < Src.size() && isIdentChar(Src[Pos]))
+        ++Pos;
+    if (Start == Pos)
+      fail("expected an argument name");
+    return Src.substr(Start, Pos - Start);
+  }
+
+  constexpr std::string_view parseString() {
+    skipSpace();
+    if (Pos == Src.size() || (Src[Pos] != '\'' && Src[Pos] != '"')) {
+      fail("expected a quoted string");
+      return {};
+    }
+    char   Quote = Src[Pos++];
+    size_t Start = Pos;
+    while (Pos < Src.size() && Src[Pos] != Quote)
+      ++Pos;
+    if (Pos == Src.size()) {
+      fail("unterminated string");
+      return {};
+    }
+    return Src.substr(Start, Pos++ - Start);
+  }
+
+  constexpr double parseNumber() {
+    double V = 0;
+    while (Pos < Src.size() && isDigit(Src[Pos]))
+      V = V * 10 + (Src[Pos++] - '0');
+    if (Pos < Src.size() && Src[Pos] == '.') {
+      ++Pos;
+      double Scale = 0.1;
+      if (Pos == Src.size() || !isDigit(Src[Pos]))
+        fail("expected digits after '.'");
+      while (Pos < Src.size() && isDigit(Src[Pos])) {
+        V += (Src[Pos++] - '0') * Scale;
+        Scale /= 10;
+      }
+    }
+    return V;
+  }
+
+  // jumps are patched to the next instruction once the right operand exists
+  constexpr void parseOr() {
+    parseAnd();
+    while (!P.Error && consume("||")) {
+      uint8_t Jump = emit(PredicateOp::JumpIfTrue);
+      parseAnd();
+      P.Code[Jump].A = P.Length;
+    }
+  }
+
+  constexpr void parseAnd() {
+    parseNot();
+    while (!P.Error && consume("&&")) {
+      uint8_t Jump = emit(PredicateOp::JumpIfFalse);
+      parseNot();
+      P.Code[Jump].A = P.Length;
+    }
+  }
+
+  constexpr void parseNot() {
+    skipSpace();
+    if (Pos < Src.size() && Src[Pos] == '!' && Src.substr(Pos, 2) != "!=") {
+      ++Pos;
+      parseNot();
+      emit(PredicateOp::Not);
+      return;
+    }
+    parseComparison();
+  }
+
+  constexpr void parseComparison() {
+    parseSum();
+    struct {
+      std::string_view Token;
+      PredicateOp      Op;
+    } Ops[] = {
+        {"<=", PredicateOp::LessEqual}, {">=", PredicateOp::GreaterEqual},
+        {"==", PredicateOp::Equal},     {"!=", PredicateOp::NotEqual},
+        {"<", PredicateOp::Less},       {">", PredicateOp::Greater},
+    };
+    for (const auto &O : Ops) {
+      if (P.Error || !consume(O.Token))
+        continue;
+      parseSum();
+      emit(O.Op);
+      return;
+    }
+  }
+
+  constexpr void parseSum() {
+    parseProduct();
+    while (!P.Error) {
+      if (consume("+")) {
+        parseProduct();
+        emit(PredicateOp::Add);
+      } else if (consume("-")) {
+        parseProduct();
+        emit(PredicateOp::Sub);
+      } else {
+        return;
+      }
+    }
+  }
+
+  constexpr void parseProduct() {
+    parseUnary();
+    while (!P.Error) {
+      if (consume("*")) {
+        parseUnary();
+        emit(PredicateOp::Mul);
+      } else if (consume("/")) {
+        parseUnary();
+        emit(PredicateOp::Div);
+      } else {
+        return;
+      }
+    }
+  }
+
+  constexpr void parseUnary() {
+    if (consume("-")) {
+      parseUnary();
+      emit(PredicateOp::Neg);
+      return;
+    }
+    parseAtom();
+  }
+
+  constexpr void parseAtom() {
+    skipSpace();
+    if (P.Error)
+      return;
+    if (Pos == Src.size()) {
+      fail("unexpected end of condition");
+      return;
+    }
+    if (consume("(")) {
+      parseOr();
+      if (!P.Error && !consume(")"))
+        fail("expected ')'");
+      return;
+    }
+    if (isDigit(Src[Pos])) {
+      emit(PredicateOp::PushNumber, addNumber(parseNumber()));
+      return;
+    }
+
+    std::string_view Name = parseIdent();
+    if (P.Error)
+      return;
+    if (Name == "has" && consume("(")) {
+      std::string_view Arg = parseIdent();
+      if (!P.Error && !consume(")"))
+        fail("expected ')'");
+      emit(PredicateOp::HasArg, addName(Arg));
+      return;
+    }
+
+    // text tests bind tighter than the numeric comparisons they resemble
+    if (consume("~")) {
+      uint8_t Key = addName(Name);
+      emit(PredicateOp::ArgContains, Key, addName(parseString()));
+      return;
+    }
+    size_t Saved = Pos;
+    bool   Negate = false;
+    if (consume("==") || (Negate = consume("!="))) {
+      skipSpace();
+      if (Pos < Src.size() && (Src[Pos] == '\'' || Src[Pos] == '"')) {
+        uint8_t Key = addName(Name);
+        emit(PredicateOp::ArgEquals, Key, addName(parseString()));
+        if (Negate)
+          emit(PredicateOp::Not);
+        return;
+      }
+      Pos = Saved;
+    }
+    emit(PredicateOp::PushArg, addName(Name));
+  }
+};
+
+}
+
+constexpr PredicateProgram PredicateProgram::compile(std::string_view Source) {
+  PredicateProgram P;
+  detail::PredicateParser(Source, P).run();
+  return P;
+}
+
+}
@@ -11,12 +11,20 @@ namespace optdbg {
 
 class RemarkCollectorHandler : public llvm::DiagnosticHandler {
 public:
-  RemarkCollectorHandler(std::vector<Remark> &Remarks) : CollectedRemarks(Remarks) {}
+  RemarkCollectorHandler(std::vector<Remark> &Remarks, bool AllRemarks = false)
+      : CollectedRemarks(Remarks), AllRemarks(AllRemarks) {}
 
   bool handleDiagnostics(const llvm::DiagnosticInfo &DI) override;
 
+  // with AllRemarks every pass emits its remarks, whatever -pass-remarks says
+  bool isAnalysisRemarkEnabled(llvm::StringRef PassName) const override;
+  bool isMissedOptRemarkEnabled(llvm::StringRef PassName) const override;
+  bool isPassedOptRemarkEnabled(llvm::StringRef PassName) const override;
+  bool isAnyRemarkEnabled() const override;
+
 private:
   std::vector<Remark> &CollectedRemarks;
+  bool AllRemarks;
   std::mutex Mutex;
 
   static SourceLocation convertLocation(const llvm::DiagnosticLocation &Loc);
@@ -28,7 +36,7 @@ private:
 class RemarkCollector {
 public:
   RemarkCollector() = default;
-  void install(llvm::LLVMContext &Ctx);
+  void install(llvm::LLVMContext &Ctx, bool AllRemarks = false);
   const std::vector<Remark> &getRemarks() const { return Remarks; }
 
   std::vector<Remark> getMissedRemarks() const;
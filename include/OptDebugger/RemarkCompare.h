@@ -0,0 +1,78 @@
+#pragma once
+
+#include "OptDebugger/Support.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+namespace optdbg {
+
+enum class RemarkChange : uint8_t {
+  NewlyMissed,    // missed remark with no counterpart in the old build
+  NewlyApplied,   // applied remark with no counterpart in the old build
+  Changed,        // same key on both sides, different kind or message
+  Removed,        // missed or applied remark that no longer appears
+};
+
+struct RemarkDelta {
+  RemarkChange Change;
+  Remark       Old;   // unset for NewlyMissed and NewlyApplied
+  Remark       New;   // unset for Removed
+};
+
+struct RemarkComparison {
+  std::vector<RemarkDelta> Deltas;   // ordered by change, then location
+  size_t OldCount  = 0;
+  size_t NewCount  = 0;
+  size_t Unchanged = 0;
+
+  size_t count(RemarkChange C) const;
+  // newly missed remarks and applied ones that turned into missed ones
+  size_t regressions() const;
+  bool hasRegressions() const { return regressions() != 0; }
+};
+
+// hash-joins two remark streams on function, location, pass and remark name
+class RemarkComparator {
+public:
+  void addOld(Remark R);
+  void addNew(Remark R);
+  RemarkComparison finish();
+
+private:
+  struct OldEntry {
+    Remark R;
+    bool   Matched = false;
+  };
+
+  static std::string joinKey(const Remark &R);
+  static std::string functionKey(const Remark &R);
+  void addUnmatched(Remark R);
+
+  llvm::StringMap<llvm::SmallVector<uint32_t, 1>> Table;
+  std::vector<OldEntry> Old;
+  std::vector<Remark>   Pending;   // new remarks without an exact match
+  RemarkComparison      Result;
+};
+
+// streams every remark stored at Path, which may be a YAML remarks file, a
+// directory of .opt.yaml files, a session snapshot or a remark database
+llvm::Error forEachStoredRemark(llvm::StringRef Path,
+                                llvm::function_ref<void(Remark &&)> Callback);
+
+llvm::Expected<RemarkComparison> compareRemarkSets(llvm::StringRef OldPath,
+                                                   llvm::StringRef NewPath);
+
+void printRemarkComparison(const RemarkComparison &C, llvm::raw_ostream &OS,
+                           bool UseColor);
+void writeRemarkComparisonJSON(const RemarkComparison &C,
+                               llvm::raw_ostream &OS);
+
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "OptDebugger/Support.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace optdbg {
+
+// columnar remark store with sorted dictionaries and posting lists
+constexpr char     RemarkDBMagic[8]      = {'A', 'I', 'O', 'N', 'R', 'D', 'B', '\0'};
+constexpr uint32_t RemarkDBFormatVersion = 2;
+
+enum class RemarkColumn : uint8_t {
+  Pass,
+  Name,
+  Function,
+  File,
+  Message,
+  Origin,
+};
+constexpr unsigned NumRemarkStringColumns = 6;
+constexpr unsigned NumRemarkKinds         = 5;
+
+// accumulates remarks and writes them as one database file
+class RemarkDBWriter {
+public:
+  RemarkDBWriter();
+
+  // parses one YAML file and appends its remarks, tagged with its path
+  llvm::Error addYAMLFile(llvm::StringRef Path);
+  void add(const Remark &R, llvm::StringRef Origin);
+
+  llvm::Error write(llvm::StringRef Path);
+  size_t size() const { return Kinds.size(); }
+
+private:
+  struct Dictionary {
+    llvm::StringMap<uint32_t>    Ids;
+    std::vector<llvm::StringRef> Values;   // keys owned by Ids
+    uint32_t intern(llvm::StringRef S);
+  };
+
+  Dictionary                 Dicts[NumRemarkStringColumns];
+  std::vector<uint32_t>      Columns[NumRemarkStringColumns];
+  std::vector<uint32_t>      Lines;
+  std::vector<uint32_t>      Cols;
+  std::vector<uint8_t>       Kinds;
+  std::vector<uint32_t>      Hotness;    // float bits, NoHotness when absent
+
+  // key, value and file of every argument go through one dictionary
+  Dictionary                 ArgDict;
+  std::vector<uint32_t>      ArgOffsets{0};
+  std::vector<uint32_t>      ArgFields;  // key, value, file, line, column
+};
+
+// a filter over the database; empty fields match everything
+struct RemarkQuery {
+  std::vector<std::string> Passes;
+  std::vector<std::string> Names;
+  std::string              FunctionRegex;
+  std::string              FilePrefix;
+  uint8_t                  KindMask = 0xFF;
+  size_t                   Limit    = 0;
+};
+
+// read-only view of a database file mapped into memory
+class RemarkDB {
+public:
+  static llvm::Expected<std::unique_ptr<RemarkDB>> open(llvm::StringRef Path);
+
+  size_t size() const { return NumRows; }
+
+  // returns matching row ids in ingestion order
+  llvm::Expected<std::vector<uint32_t>> query(const RemarkQuery &Q) const;
+
+  llvm::StringRef value(RemarkColumn C, uint32_t Row) const;
+  RemarkKind kind(uint32_t Row) const;
+  SourceLocation location(uint32_t Row) const;
+  std::optional<float> hotness(uint32_t Row) const;
+  std::vector<RemarkArgument> args(uint32_t Row) const;
+  Remark materialize(uint32_t Row) const;
+
+  size_t dictionarySize(RemarkColumn C) const { return Dicts[unsigned(C)].Count; }
+
+private:
+  RemarkDB() = default;
+
+  llvm::Error bind();
+
+  struct DictionaryView {
+    const char *Data    = nullptr;
+    uint64_t    Size    = 0;
+    const char *Entries = nullptr;
+    uint32_t    Count   = 0;
+
+    llvm::StringRef get(uint32_t Id) const;
+    // first id whose value is not less than S
+    uint32_t lowerBound(llvm::StringRef S) const;
+  };
+
+  struct PostingList {
+    const char *Offsets = nullptr;
+    const char *Rows    = nullptr;
+  };
+
+  uint32_t columnId(RemarkColumn C, uint32_t Row) const;
+  void appendPostings(const PostingList &P, uint32_t Id,
+                      std::vector<uint32_t> &Out) const;
+
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  uint64_t       NumRows = 0;
+  DictionaryView Dicts[NumRemarkStringColumns];
+  const char    *Columns[NumRemarkStringColumns] = {};
+  const char    *Lines   = nullptr;
+  const char    *Cols    = nullptr;
+  const char    *Kinds   = nullptr;
+  const char    *KindBitmaps = nullptr;
+  const char    *Hotness = nullptr;
+  DictionaryView ArgDict;
+  const char    *ArgOffsets = nullptr;
+  const char    *ArgFields  = nullptr;
+  uint64_t       NumArgs    = 0;
+  PostingList    PassIndex;
+  PostingList    FileIndex;
+};
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace llvm {
+class PassInstrumentationCallbacks;
+}
+
+namespace optdbg {
+
+// profiles Aion itself through llvm's time trace profiler
+class SelfProfiler {
+public:
+  // starts recording on the calling thread. events shorter than
+  // GranularityUs are left out of the trace but still counted in the summary
+  static void start(llvm::StringRef ProcName, unsigned GranularityUs = 0);
+  static bool isActive();
+
+  // writes the Chrome trace (chrome://tracing, Perfetto) and stops the
+  // profiler; every scope must be closed by then
+  static llvm::Error finish(llvm::StringRef TracePath);
+
+  // per-phase totals, the slowest detailed scopes and the peak RSS
+  static void printSummary(llvm::raw_ostream &OS);
+
+  // worker threads hold one of these so their events join the trace; it
+  // does nothing on a thread that is already recording or when inactive
+  class ThreadScope {
+  public:
+    ThreadScope();
+    ~ThreadScope();
+    ThreadScope(const ThreadScope &) = delete;
+    ThreadScope &operator=(const ThreadScope &) = delete;
+
+  private:
+    bool Owned = false;
+  };
+};
+
+// one timed region. Phase must be a string literal; Detail names the item
+// (a function, a translation unit) and ranks it in the summary's slowest list
+class ProfileScope {
+public:
+  explicit ProfileScope(llvm::StringRef Phase)
+      : ProfileScope(Phase, llvm::StringRef(), /*HasDetail=*/false) {}
+  ProfileScope(llvm::StringRef Phase, llvm::StringRef Detail)
+      : ProfileScope(Phase, Detail, /*HasDetail=*/true) {}
+  ~ProfileScope();
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+  ProfileScope(llvm::StringRef Phase, llvm::StringRef Detail, bool HasDetail);
+
+  bool            Active = false;
+  bool            Traced = false;
+  bool            HasDetail = false;
+  llvm::StringRef Phase;
+  std::string     Detail;
+  std::chrono::steady_clock::time_point Start;
+};
+
+// adds one trace event per pass run, named after the pass with the function
+// or module as detail; a no-op unless this thread is recording
+void registerPassProfiling(llvm::PassInstrumentationCallbacks &PIC);
+
+// resident set size of this process in KB; 0 where it cannot be read
+uint64_t currentRSSKB();
+uint64_t peakRSSKB();
+
+}
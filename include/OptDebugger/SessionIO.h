@@ -0,0 +1,45 @@
+#pragma once
+
+#include "OptDebugger/PassAnalyzer.h"
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+
+namespace optdbg {
+
+// binary session layout: a header, a section table and fixed-size records,
+// all little-endian
+constexpr char     SessionMagic[8]      = {'A', 'I', 'O', 'N', 'S', 'E', 'S', 'S'};
+constexpr uint32_t SessionFormatVersion = 1;
+
+enum class SessionSection : uint32_t {
+  Strings      = 1,
+  Meta         = 2,
+  Remarks      = 3,
+  RemarkArgs   = 4,
+  Functions    = 5,
+  Blocks       = 6,
+  Instructions = 7,
+  Diagnostics  = 8,
+  Fixes        = 9,
+  Metadata     = 10,
+  // per-function results of the codegen stage
+  MachineFunctions = 11,
+};
+
+// encodes a session except its modules, contexts and printed IR
+void writeSessionBinary(const AnalysisSession &Session, llvm::raw_ostream &OS);
+
+// rebuilds a session from a buffer produced by writeSessionBinary
+llvm::Expected<AnalysisSession> readSessionBinary(llvm::MemoryBufferRef Buffer);
+
+// writes a snapshot file for --save-session
+llvm::Error saveSession(const AnalysisSession &Session, llvm::StringRef Path);
+
+// maps a snapshot file written by saveSession and decodes it
+llvm::Expected<AnalysisSession> loadSession(llvm::StringRef Path);
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Passes/OptimizationLevel.h"
 #include "llvm/Support/Error.h"
 #include <string>
 #include <vector>
@@ -8,6 +9,9 @@
 
 namespace optdbg {
 
+// tool version stamped into reports, snapshots and analysis cache keys
+constexpr const char *AionVersion = "1.0";
+
 struct SourceLocation {
   std::string File;
   unsigned Line = 0;
@@ -52,6 +56,13 @@ struct Remark {
            Kind == RemarkKind::AnalysisAliasing ||
            Kind == RemarkKind::AnalysisFPCommute;
   }
+
+  // the first argument named Key, or null
+  const RemarkArgument *findArg(llvm::StringRef Key) const;
+  // the argument as an integer; nullopt when missing or not a number
+  std::optional<int> intArg(llvm::StringRef Key) const;
+  // the argument as a count; 0 when missing or not a number
+  unsigned unsignedArg(llvm::StringRef Key) const;
 };
 
 inline llvm::Error makeStringError(const llvm::Twine &Msg) {
@@ -60,4 +71,11 @@ inline llvm::Error makeStringError(const llvm::Twine &Msg) {
 
 bool matchesPattern(llvm::StringRef Text, llvm::StringRef Pattern);
 
+// stable lowercase name of a remark kind for machine-readable output
+llvm::StringRef remarkKindName(RemarkKind K);
+
+// the level an -O option names (O0-O3, Os, Oz, with or without the dash);
+// anything else is O2
+llvm::OptimizationLevel optLevelFor(llvm::StringRef OptLevel);
+
 }
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <string>
+
+namespace optdbg {
+
+// size knobs for a generated module pair and its remarks
+struct CorpusConfig {
+  unsigned Functions            = 100;
+  unsigned BlocksPerFunction    = 4;
+  unsigned InstructionsPerBlock = 16;
+  unsigned ChangedPercent       = 20;   // functions whose body differs after
+  unsigned RemarkCount          = 1000;
+  uint64_t Seed                 = 1;
+};
+
+// small deterministic generator (splitmix64)
+class CorpusRNG {
+public:
+  explicit CorpusRNG(uint64_t Seed) : State(Seed) {}
+
+  uint64_t next() {
+    uint64_t Z = (State += 0x9e3779b97f4a7c15ULL);
+    Z = (Z ^ (Z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    Z = (Z ^ (Z >> 27)) * 0x94d049bb133111ebULL;
+    return Z ^ (Z >> 31);
+  }
+  unsigned below(unsigned N) { return N ? static_cast<unsigned>(next() % N) : 0; }
+
+private:
+  uint64_t State;
+};
+
+// writes the before module, or the after one with ChangedPercent rewritten
+void writeSyntheticModule(const CorpusConfig &C, bool After,
+                          llvm::raw_ostream &OS);
+
+// writes RemarkCount YAML remarks spread over the generated functions
+void writeSyntheticRemarks(const CorpusConfig &C, llvm::raw_ostream &OS);
+
+// name of the I-th generated function
+std::string syntheticFunctionName(unsigned I);
+
+}
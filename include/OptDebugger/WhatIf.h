@@ -0,0 +1,85 @@
+#pragma once
+
+#include "OptDebugger/DiagnosticEngine.h"
+#include "OptDebugger/IRDiff.h"
+#include "OptDebugger/Support.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace optdbg {
+
+// the IR change a fix suggestion stands for
+enum class WhatIfEdit : uint8_t {
+  RaiseInlineThreshold, // run the inliner with the suggested threshold
+  AlwaysInline,         // alwaysinline on the callee
+  RemoveNoInline,       // drop noinline from the callee
+  NoAliasArguments,     // noalias on the function's pointer arguments
+  ReadNoneCallees,      // memory(none), nounwind, willreturn on called functions
+};
+
+llvm::StringRef whatIfEditName(WhatIfEdit E);
+
+// the IR edit a suggestion's pattern tagged it with; suggestions with no IR
+// equivalent (rewrite the loop, use PGO) have none
+std::optional<WhatIfEdit> whatIfEditFor(const FixSuggestion &S);
+
+enum class WhatIfOutcome : uint8_t {
+  Flipped,       // the missed remark is gone and the pass reports success there
+  Cleared,       // the missed remark is gone without a success remark
+  StillMissed,
+  NotApplicable, // the edit has nothing to change in this module
+  Failed,        // the edited module did not verify or the pipeline failed
+};
+
+llvm::StringRef whatIfOutcomeName(WhatIfOutcome O);
+
+struct WhatIfTrial {
+  std::string   Suggestion;
+  WhatIfEdit    Edit;
+  WhatIfOutcome Outcome = WhatIfOutcome::StillMissed;
+  // what was edited, or why nothing was
+  std::string   Detail;
+  // the inliner threshold the pipeline ran with; -1 keeps the level's
+  int           InlineThreshold = -1;
+  // against the unedited run of the same pipeline
+  int64_t       FunctionInstructions = 0;
+  int64_t       FunctionCost         = 0;
+  int64_t       ModuleInstructions   = 0;
+};
+
+// one missed remark and the suggestions tried on it
+struct WhatIfExperiment {
+  Remark                   Target;
+  std::string              RuleID;
+  // the unedited pipeline emits the same missed remark; trials of a remark
+  // it does not reproduce would prove nothing and are not run
+  bool                     Reproduced = false;
+  std::vector<WhatIfTrial> Trials;
+};
+
+struct WhatIfConfig {
+  // O1-O3, Os, Oz; the default pipeline of this level is re-run per trial
+  std::string OptLevel = "O2";
+  unsigned    Threads  = 1;
+  // missed remarks tried, in remark order
+  unsigned    MaxRemarks = 16;
+};
+
+// applies each suggestion's IR equivalent to a copy of IRText and re-runs
+// the pipeline in parallel to see whether the remark turns into a success
+llvm::Expected<std::vector<WhatIfExperiment>>
+runWhatIfExperiments(llvm::StringRef IRText, llvm::ArrayRef<Remark> Remarks,
+                     const DiagnosticEngine &Engine, const ModuleDiff &Diff,
+                     const WhatIfConfig &Config);
+
+void printWhatIfReport(llvm::ArrayRef<WhatIfExperiment> Experiments,
+                       llvm::raw_ostream &OS, bool Verbose);
+
+}
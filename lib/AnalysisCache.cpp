@@ -0,0 +1,117 @@
+#include "OptDebugger/AnalysisCache.h"
+#include "OptDebugger/SessionIO.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace optdbg {
+
+CacheKeyBuilder::CacheKeyBuilder(llvm::StringRef Mode) {
+  addString(AionVersion);
+  addString(llvm::utostr(SessionFormatVersion));
+  addString(Mode);
+}
+
+// length-prefixes every component so adjacent fields cannot run together
+void CacheKeyBuilder::addString(llvm::StringRef S) {
+  char Len[8];
+  llvm::support::endian::write64le(Len, S.size());
+  Hasher.update(llvm::StringRef(Len, sizeof(Len)));
+  Hasher.update(S);
+}
+
+llvm::Error CacheKeyBuilder::addFile(llvm::StringRef Path) {
+  auto BufOrErr = llvm::MemoryBuffer::getFile(Path);
+  if (!BufOrErr)
+    return makeStringError("Cannot read '" + Path +
+                           "': " + BufOrErr.getError().message());
+  addString((*BufOrErr)->getBuffer());
+  return llvm::Error::success();
+}
+
+void CacheKeyBuilder::addConfig(const AnalysisConfig &Config) {
+  addString(Config.PassPipeline);
+  addString(Config.OptLevel);
+  char Flags[] = {
+      Config.EnableAllRemarks    ? '1' : '0',
+      Config.EnableHotnessInfo   ? '1' : '0',
+      Config.VerifyEachPass      ? '1' : '0',
+      Config.PrintPassStructure  ? '1' : '0',
+      Config.EnableVectorization ? '1' : '0',
+      Config.EnableUnrolling     ? '1' : '0',
+  };
+  addString(llvm::StringRef(Flags, sizeof(Flags)));
+  addString(llvm::utostr(Config.InlineThreshold));
+}
+
+std::string CacheKeyBuilder::finalize() {
+  return llvm::toHex(Hasher.final(), /*LowerCase=*/true);
+}
+
+AnalysisCache::AnalysisCache(std::string Directory)
+    : Directory(std::move(Directory)) {}
+
+std::string AnalysisCache::getEntryPath(llvm::StringRef Key) const {
+  llvm::SmallString<256> Path(Directory);
+  llvm::sys::path::append(Path, Key.take_front(2), Key + ".aion");
+  return std::string(Path);
+}
+
+std::optional<AnalysisSession>
+AnalysisCache::lookup(llvm::StringRef Key) const {
+  auto BufOrErr = llvm::MemoryBuffer::getFile(getEntryPath(Key),
+                                              /*IsText=*/false,
+                                              /*RequiresNullTerminator=*/false);
+  if (!BufOrErr)
+    return std::nullopt;
+
+  auto SessionOrErr = readSessionBinary((*BufOrErr)->getMemBufferRef());
+  if (!SessionOrErr) {
+    // a stale or damaged entry is just a miss; the next store replaces it
+    llvm::consumeError(SessionOrErr.takeError());
+    return std::nullopt;
+  }
+  return std::move(*SessionOrErr);
+}
+
+llvm::Error AnalysisCache::store(llvm::StringRef Key,
+                                 const AnalysisSession &Session) const {
+  std::string EntryPath = getEntryPath(Key);
+  llvm::StringRef Parent = llvm::sys::path::parent_path(EntryPath);
+  if (std::error_code EC = llvm::sys::fs::create_directories(Parent))
+    return makeStringError("Cannot create cache directory '" + Parent +
+                           "': " + EC.message());
+
+  int FD;
+  llvm::SmallString<256> TempPath;
+  if (std::error_code EC = llvm::sys::fs::createUniqueFile(
+          EntryPath + ".tmp-%%%%%%", FD, TempPath))
+    return makeStringError("Cannot create cache entry in '" + Parent +
+                           "': " + EC.message());
+
+  {
+    llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    writeSessionBinary(Session, OS);
+    OS.close();
+    if (OS.has_error()) {
+      std::error_code EC = OS.error();
+      OS.clear_error();
+      llvm::sys::fs::remove(TempPath);
+      return makeStringError("Cannot write cache entry '" + TempPath +
+                             "': " + EC.message());
+    }
+  }
+
+  if (std::error_code EC = llvm::sys::fs::rename(TempPath, EntryPath)) {
+    llvm::sys::fs::remove(TempPath);
+    return makeStringError("Cannot install cache entry '" + EntryPath +
+                           "': " + EC.message());
+  }
+  return llvm::Error::success();
+}
+
+}
@@ -0,0 +1,543 @@
+#include "OptDebugger/AnalysisServer.h"
+#include "OptDebugger/AnalysisCache.h"
+#include "OptDebugger/SelfProfile.h"
+
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace optdbg {
+
+namespace {
+
+constexpr uint32_t MaxFrameSize = 1u << 30;
+
+llvm::Error makeErrnoError(const llvm::Twine &What) {
+  return makeStringError(What + ": " + std::strerror(errno));
+}
+
+llvm::Error fillSocketAddress(llvm::StringRef Path, sockaddr_un &Addr) {
+  std::memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  if (Path.size() >= sizeof(Addr.sun_path))
+    return makeStringError("Socket path is too long: " + Path);
+  std::memcpy(Addr.sun_path, Path.data(), Path.size());
+  return llvm::Error::success();
+}
+
+llvm::Expected<int> connectTo(llvm::StringRef Path) {
+  sockaddr_un Addr;
+  if (auto Err = fillSocketAddress(Path, Addr))
+    return std::move(Err);
+  int FD = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (FD < 0)
+    return makeErrnoError("Cannot create socket");
+  if (::connect(FD, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr)) != 0) {
+    llvm::Error Err = makeErrnoError("Cannot connect to server at '" + Path + "'");
+    ::close(FD);
+    return std::move(Err);
+  }
+  return FD;
+}
+
+bool writeAll(int FD, const char *Data, size_t Size) {
+  while (Size > 0) {
+    ssize_t N = ::send(FD, Data, Size, MSG_NOSIGNAL);
+    if (N < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    Data += N;
+    Size -= static_cast<size_t>(N);
+  }
+  return true;
+}
+
+bool readAll(int FD, char *Data, size_t Size) {
+  while (Size > 0) {
+    ssize_t N = ::read(FD, Data, Size);
+    if (N < 0 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      return false;
+    Data += N;
+    Size -= static_cast<size_t>(N);
+  }
+  return true;
+}
+
+bool writeFrame(int FD, llvm::StringRef Payload) {
+  char Len[4];
+  llvm::support::endian::write32le(Len, static_cast<uint32_t>(Payload.size()));
+  return writeAll(FD, Len, sizeof(Len)) &&
+         writeAll(FD, Payload.data(), Payload.size());
+}
+
+// returns nothing when the peer closed the connection or sent a bad frame
+std::optional<std::string> readFrame(int FD) {
+  char Len[4];
+  if (!readAll(FD, Len, sizeof(Len)))
+    return std::nullopt;
+  uint32_t Size = llvm::support::endian::read32le(Len);
+  if (Size > MaxFrameSize)
+    return std::nullopt;
+  std::string Payload(Size, '\0');
+  if (!readAll(FD, Payload.data(), Size))
+    return std::nullopt;
+  return Payload;
+}
+
+std::string toPayload(const llvm::json::Value &V) {
+  std::string S;
+  llvm::raw_string_ostream OS(S);
+  OS << V;
+  OS.flush();
+  return S;
+}
+
+llvm::json::Value errorResponse(const llvm::Twine &Message) {
+  return llvm::json::Object{{"status", "error"}, {"message", Message.str()}};
+}
+
+// sends one message and waits for the matching reply
+llvm::Expected<llvm::json::Value> roundTrip(llvm::StringRef SocketPath,
+                                            const llvm::json::Value &Msg) {
+  auto FDOrErr = connectTo(SocketPath);
+  if (!FDOrErr)
+    return FDOrErr.takeError();
+  int FD = *FDOrErr;
+
+  std::optional<std::string> Reply;
+  if (writeFrame(FD, toPayload(Msg)))
+    Reply = readFrame(FD);
+  ::close(FD);
+  if (!Reply)
+    return makeStringError("Server at '" + SocketPath +
+                           "' closed the connection");
+
+  auto V = llvm::json::parse(*Reply);
+  if (!V)
+    return makeStringError("Malformed server reply: " +
+                           llvm::toString(V.takeError()));
+  const llvm::json::Object *O = V->getAsObject();
+  if (!O)
+    return makeStringError("Malformed server reply");
+  auto Status = O->getString("status");
+  if (!Status || *Status != "ok") {
+    auto Message = O->getString("message");
+    return makeStringError(Message ? *Message : "Server reported an error");
+  }
+  return std::move(*V);
+}
+
+llvm::StringRef formatName(RequestFormat F) {
+  switch (F) {
+  case RequestFormat::Terminal: return "terminal";
+  case RequestFormat::NDJSON:   return "ndjson";
+  case RequestFormat::JSON:     return "json";
+  case RequestFormat::SARIF:    return "sarif";
+  }
+  return "terminal";
+}
+
+std::optional<RequestFormat> parseFormat(llvm::StringRef S) {
+  if (S == "terminal") return RequestFormat::Terminal;
+  if (S == "ndjson")   return RequestFormat::NDJSON;
+  if (S == "json")     return RequestFormat::JSON;
+  if (S == "sarif")    return RequestFormat::SARIF;
+  return std::nullopt;
+}
+
+// absent keys keep the defaults of the target struct
+void readBool(const llvm::json::Object &O, llvm::StringRef Key, bool &Out) {
+  if (auto B = O.getBoolean(Key))
+    Out = *B;
+}
+
+void readString(const llvm::json::Object &O, llvm::StringRef Key,
+                std::string &Out) {
+  if (auto S = O.getString(Key))
+    Out = S->str();
+}
+
+void readUnsigned(const llvm::json::Object &O, llvm::StringRef Key,
+                  unsigned &Out) {
+  if (auto I = O.getInteger(Key))
+    if (*I >= 0)
+      Out = static_cast<unsigned>(*I);
+}
+
+}
+
+llvm::json::Value requestToJSON(const AnalysisRequest &Req) {
+  const AnalysisConfig &A = Req.Analysis;
+  const ReportConfig   &R = Req.Report;
+  return llvm::json::Object{
+      {"op", "analyze"},
+      {"input", Req.InputPath},
+      {"ir", Req.IRText},
+      {"before", Req.BeforePath},
+      {"after", Req.AfterPath},
+      {"remarks", Req.RemarksPath},
+      {"baseline", Req.BaselinePath},
+      {"budget", llvm::json::Array(Req.Budget.Limits)},
+      {"budget_min_hotness",
+       Req.Budget.MinHotness ? llvm::json::Value(*Req.Budget.MinHotness)
+                             : llvm::json::Value(nullptr)},
+      {"format", formatName(Req.Format)},
+      {"summary_only", Req.SummaryOnly},
+      {"config",
+       llvm::json::Object{
+           {"passes", A.PassPipeline},
+           {"opt_level", A.OptLevel},
+           {"all_remarks", A.EnableAllRemarks},
+           {"hotness", A.EnableHotnessInfo},
+           {"verify_each", A.VerifyEachPass},
+           {"print_pass_structure", A.PrintPassStructure},
+           {"inline_threshold", static_cast<int64_t>(A.InlineThreshold)},
+           {"vectorize", A.EnableVectorization},
+           {"unroll", A.EnableUnrolling},
+           {"external_remarks", A.ExternalRemarksPath},
+       }},
+      {"report",
+       llvm::json::Object{
+           {"diff", R.ShowDiff},
+           {"suggestions", R.ShowSuggestions},
+           {"ir_snippets", R.ShowIRSnippets},
+           {"color", R.UseColor},
+           {"verbose", R.Verbose},
+           {"missed_only", R.ShowOnlyMissed},
+           {"group_by_pass", R.GroupByPass},
+           {"group_by_function", R.GroupByFunction},
+           {"max_suggestions", static_cast<int64_t>(R.MaxSuggestions)},
+           {"min_severity", static_cast<int64_t>(R.MinSeverity)},
+       }},
+  };
+}
+
+llvm::Expected<AnalysisRequest> requestFromJSON(const llvm::json::Value &V) {
+  const llvm::json::Object *O = V.getAsObject();
+  if (!O)
+    return makeStringError("Request is not a JSON object");
+
+  AnalysisRequest Req;
+  readString(*O, "input", Req.InputPath);
+  readString(*O, "ir", Req.IRText);
+  readString(*O, "before", Req.BeforePath);
+  readString(*O, "after", Req.AfterPath);
+  readString(*O, "remarks", Req.RemarksPath);
+  readString(*O, "baseline", Req.BaselinePath);
+  if (const llvm::json::Array *B = O->getArray("budget")) {
+    if (B->size() != NumSeverityLevels)
+      return makeStringError("'budget' must list one limit per severity");
+    for (unsigned L = 0; L < NumSeverityLevels; ++L) {
+      auto Limit = (*B)[L].getAsInteger();
+      if (!Limit)
+        return makeStringError("'budget' limits must be integers");
+      Req.Budget.Limits[L] = *Limit;
+    }
+  }
+  if (auto Hot = O->getNumber("budget_min_hotness"))
+    Req.Budget.MinHotness = static_cast<float>(*Hot);
+  readBool(*O, "summary_only", Req.SummaryOnly);
+
+  if (auto F = O->getString("format")) {
+    auto Format = parseFormat(*F);
+    if (!Format)
+      return makeStringError("Unknown report format '" + *F + "'");
+    Req.Format = *Format;
+  }
+
+  bool HasBeforeAfter = !Req.BeforePath.empty() && !Req.AfterPath.empty();
+  unsigned Inputs = !Req.InputPath.empty() + !Req.IRText.empty() + HasBeforeAfter;
+  if (Inputs != 1)
+    return makeStringError("Request must name exactly one of 'input', 'ir' "
+                           "or 'before'/'after'");
+
+  if (const llvm::json::Object *C = O->getObject("config")) {
+    AnalysisConfig &A = Req.Analysis;
+    readString(*C, "passes", A.PassPipeline);
+    readString(*C, "opt_level", A.OptLevel);
+    readBool(*C, "all_remarks", A.EnableAllRemarks);
+    readBool(*C, "hotness", A.EnableHotnessInfo);
+    readBool(*C, "verify_each", A.VerifyEachPass);
+    readBool(*C, "print_pass_structure", A.PrintPassStructure);
+    readUnsigned(*C, "inline_threshold", A.InlineThreshold);
+    readBool(*C, "vectorize", A.EnableVectorization);
+    readBool(*C, "unroll", A.EnableUnrolling);
+    readString(*C, "external_remarks", A.ExternalRemarksPath);
+  }
+
+  if (const llvm::json::Object *R = O->getObject("report")) {
+    ReportConfig &Cfg = Req.Report;
+    readBool(*R, "diff", Cfg.ShowDiff);
+    readBool(*R, "suggestions", Cfg.ShowSuggestions);
+    readBool(*R, "ir_snippets", Cfg.ShowIRSnippets);
+    readBool(*R, "color", Cfg.UseColor);
+    readBool(*R, "verbose", Cfg.Verbose);
+    readBool(*R, "missed_only", Cfg.ShowOnlyMissed);
+    readBool(*R, "group_by_pass", Cfg.GroupByPass);
+    readBool(*R, "group_by_function", Cfg.GroupByFunction);
+    readUnsigned(*R, "max_suggestions", Cfg.MaxSuggestions);
+    unsigned Severity = static_cast<unsigned>(Cfg.MinSeverity);
+    readUnsigned(*R, "min_severity", Severity);
+    if (Severity > static_cast<unsigned>(SeverityLevel::Info))
+      return makeStringError("Invalid min_severity in request");
+    Cfg.MinSeverity = static_cast<SeverityLevel>(Severity);
+  }
+
+  return Req;
+}
+
+int renderRequestReport(const AnalysisSession &Session,
+                        const AnalysisRequest &Req, llvm::raw_ostream &OS,
+                        const PatternDB *UserPatterns) {
+  // summary_only trims every format, as --summary-only does locally
+  ReportConfig Cfg = Req.Report;
+  if (Req.SummaryOnly) {
+    Cfg.ShowDiff        = false;
+    Cfg.ShowSuggestions = false;
+    Cfg.ShowIRSnippets  = false;
+  }
+
+  switch (Req.Format) {
+  case RequestFormat::Terminal: {
+    TerminalReporter TR(OS, Cfg);
+    TR.report(Session);
+    break;
+  }
+  case RequestFormat::NDJSON:
+    JSONReporter(OS, JSONFormat::NDJSON).report(Session, Cfg);
+    break;
+  case RequestFormat::JSON:
+    JSONReporter(OS, JSONFormat::Document).report(Session, Cfg);
+    break;
+  case RequestFormat::SARIF:
+    SARIFReporter(OS, UserPatterns).report(Session, Cfg);
+    break;
+  }
+
+  return Req.Budget.firstExceeded(Session.Diagnostics) ? 2 : 0;
+}
+
+AnalysisServer::AnalysisServer(std::string SocketPath, unsigned NumWorkers,
+                               const AnalysisCache *Cache)
+    : SocketPath(std::move(SocketPath)),
+      NumWorkers(NumWorkers ? NumWorkers : 1), Cache(Cache) {}
+
+llvm::Error AnalysisServer::serve() {
+  sockaddr_un Addr;
+  if (auto Err = fillSocketAddress(SocketPath, Addr))
+    return Err;
+
+  // refuse to take over a live server, but clear a socket left by a crash
+  if (llvm::sys::fs::exists(SocketPath)) {
+    auto FDOrErr = connectTo(SocketPath);
+    if (FDOrErr) {
+      ::close(*FDOrErr);
+      return makeStringError("A server is already listening on '" +
+                             SocketPath + "'");
+    }
+    llvm::consumeError(FDOrErr.takeError());
+    // sys::fs::remove refuses to delete sockets
+    ::unlink(SocketPath.c_str());
+  }
+
+  ListenFD = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (ListenFD < 0)
+    return makeErrnoError("Cannot create socket");
+  // the socket runs analyses on paths the client names, so only its owner
+  // may connect; nothing can connect before listen()
+  if (::bind(ListenFD, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr)) != 0 ||
+      ::chmod(SocketPath.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+      ::listen(ListenFD, SOMAXCONN) != 0) {
+    llvm::Error Err = makeErrnoError("Cannot listen on '" + SocketPath + "'");
+    ::close(ListenFD);
+    return Err;
+  }
+
+  std::vector<std::thread> Workers;
+  for (unsigned I = 0; I < NumWorkers; ++I)
+    Workers.emplace_back([this] { workerLoop(); });
+
+  llvm::Error Result = llvm::Error::success();
+  while (true) {
+    int FD = ::accept(ListenFD, nullptr, nullptr);
+    if (FD < 0) {
+      if (errno == EINTR)
+        continue;
+      Result = makeErrnoError("Cannot accept connections on '" + SocketPath + "'");
+      break;
+    }
+
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    if (Stopping) {
+      ::close(FD);
+      break;
+    }
+    PendingConnections.push_back(FD);
+    QueueCV.notify_one();
+  }
+
+  {
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    Stopping = true;
+  }
+  QueueCV.notify_all();
+  for (std::thread &T : Workers)
+    T.join();
+
+  ::close(ListenFD);
+  ::unlink(SocketPath.c_str());
+  return Result;
+}
+
+// each worker builds its analyzer once and reuses it for every request
+void AnalysisServer::workerLoop() {
+  SelfProfiler::ThreadScope Profiling;
+  PassAnalyzer Analyzer;
+  Analyzer.setCache(Cache);
+  Analyzer.setUserPatterns(UserPatterns);
+
+  while (true) {
+    int FD;
+    {
+      std::unique_lock<std::mutex> Lock(QueueMutex);
+      QueueCV.wait(Lock, [&] { return Stopping || !PendingConnections.empty(); });
+      if (PendingConnections.empty())
+        return;
+      FD = PendingConnections.front();
+      PendingConnections.pop_front();
+    }
+    handleConnection(FD, Analyzer);
+    ::close(FD);
+  }
+}
+
+void AnalysisServer::handleConnection(int FD, PassAnalyzer &Analyzer) {
+  // a client that stays silent must not hold a worker forever; a timed-out
+  // read ends the connection like a closed one
+  if (IdleTimeout) {
+    timeval TV{};
+    TV.tv_sec = static_cast<time_t>(IdleTimeout);
+    ::setsockopt(FD, SOL_SOCKET, SO_RCVTIMEO, &TV, sizeof(TV));
+    ::setsockopt(FD, SOL_SOCKET, SO_SNDTIMEO, &TV, sizeof(TV));
+  }
+  while (std::optional<std::string> Payload = readFrame(FD)) {
+    ProfileScope PS("ServeRequest");
+    llvm::json::Value Reply = handleRequest(*Payload, Analyzer);
+    if (!writeFrame(FD, toPayload(Reply)))
+      return;
+  }
+}
+
+llvm::json::Value AnalysisServer::handleRequest(llvm::StringRef Payload,
+                                                PassAnalyzer &Analyzer) {
+  auto V = llvm::json::parse(Payload);
+  if (!V)
+    return errorResponse("Malformed request: " + llvm::toString(V.takeError()));
+  const llvm::json::Object *O = V->getAsObject();
+  if (!O)
+    return errorResponse("Request is not a JSON object");
+  auto Op = O->getString("op");
+  if (!Op)
+    return errorResponse("Request has no 'op'");
+
+  if (*Op == "ping")
+    return llvm::json::Object{{"status", "ok"}};
+
+  if (*Op == "shutdown") {
+    requestStop();
+    return llvm::json::Object{{"status", "ok"}};
+  }
+
+  if (*Op != "analyze")
+    return errorResponse("Unknown op '" + *Op + "'");
+
+  auto ReqOrErr = requestFromJSON(*V);
+  if (!ReqOrErr)
+    return errorResponse(llvm::toString(ReqOrErr.takeError()));
+  const AnalysisRequest &Req = *ReqOrErr;
+
+  // baselines are small text files; loading one per request keeps workers
+  // free of client state
+  std::optional<DiagnosticBaseline> Baseline;
+  if (!Req.BaselinePath.empty()) {
+    auto BaselineOrErr = DiagnosticBaseline::load(Req.BaselinePath);
+    if (!BaselineOrErr)
+      return errorResponse(llvm::toString(BaselineOrErr.takeError()));
+    Baseline = std::move(*BaselineOrErr);
+  }
+  Analyzer.setBaseline(Baseline ? &*Baseline : nullptr);
+
+  llvm::Expected<AnalysisSession> SessionOrErr =
+      !Req.BeforePath.empty()
+          ? Analyzer.runFromBeforeAfter(Req.BeforePath, Req.AfterPath,
+                                        Req.RemarksPath)
+      : !Req.IRText.empty() ? Analyzer.runFromIR(Req.IRText, Req.Analysis)
+                            : Analyzer.runFromFile(Req.InputPath, Req.Analysis);
+  Analyzer.setBaseline(nullptr);
+  if (!SessionOrErr)
+    return errorResponse(llvm::toString(SessionOrErr.takeError()));
+
+  std::string Output;
+  llvm::raw_string_ostream OS(Output);
+  int ExitCode = renderRequestReport(*SessionOrErr, Req, OS, UserPatterns);
+  OS.flush();
+
+  return llvm::json::Object{{"status", "ok"},
+                            {"exit_code", ExitCode},
+                            {"output", std::move(Output)}};
+}
+
+// wakes the accept loop with a throwaway connection once Stopping is set
+void AnalysisServer::requestStop() {
+  {
+    std::lock_guard<std::mutex> Lock(QueueMutex);
+    Stopping = true;
+  }
+  QueueCV.notify_all();
+  auto FDOrErr = connectTo(SocketPath);
+  if (FDOrErr)
+    ::close(*FDOrErr);
+  else
+    llvm::consumeError(FDOrErr.takeError());
+}
+
+llvm::Expected<int> sendAnalysisRequest(llvm::StringRef SocketPath,
+                                        const AnalysisRequest &Req,
+                                        llvm::raw_ostream &Out) {
+  auto ReplyOrErr = roundTrip(SocketPath, requestToJSON(Req));
+  if (!ReplyOrErr)
+    return ReplyOrErr.takeError();
+  const llvm::json::Object *O = ReplyOrErr->getAsObject();
+  if (auto Output = O->getString("output"))
+    Out << *Output;
+  auto ExitCode = O->getInteger("exit_code");
+  return ExitCode ? static_cast<int>(*ExitCode) : 0;
+}
+
+llvm::Error sendShutdownRequest(llvm::StringRef SocketPath) {
+  auto ReplyOrErr = roundTrip(SocketPath, llvm::json::Object{{"op", "shutdown"}});
+  if (!ReplyOrErr)
+    return ReplyOrErr.takeError();
+  return llvm::Error::success();
+}
+
+}
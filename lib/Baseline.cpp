@@ -0,0 +1,172 @@
+#include "OptDebugger/Baseline.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <algorithm>
+#include <map>
+
+namespace optdbg {
+
+namespace {
+
+constexpr llvm::StringLiteral BaselineHeader = "# Aion diagnostic baseline v1";
+
+// digit runs become '#', so "cost=35" and "cost=40" fingerprint alike
+void appendFolded(std::string &Out, llvm::StringRef S) {
+  bool InDigits = false;
+  for (char C : S) {
+    if (llvm::isDigit(C)) {
+      if (!InDigits)
+        Out += '#';
+      InDigits = true;
+      continue;
+    }
+    InDigits = false;
+    Out += C;
+  }
+}
+
+}
+
+uint64_t DiagnosticBaseline::fingerprint(const Remark &R) {
+  llvm::SmallString<128> File(R.Loc.File);
+  llvm::sys::path::remove_dots(File, /*remove_dot_dot=*/true,
+                               llvm::sys::path::Style::posix);
+
+  std::string Key;
+  Key.reserve(R.PassName.size() + R.RemarkName.size() +
+              R.FunctionName.size() + File.size() + R.Message.size() + 4);
+  Key += R.PassName;
+  Key += '\0';
+  Key += R.RemarkName;
+  Key += '\0';
+  Key += R.FunctionName;
+  Key += '\0';
+  Key += File;
+  Key += '\0';
+  appendFolded(Key, R.Message);
+
+  // the top bit is cleared so no fingerprint collides with DenseMap's
+  // reserved empty and tombstone keys
+  return llvm::xxHash64(Key) & ~(uint64_t(1) << 63);
+}
+
+llvm::Expected<DiagnosticBaseline>
+DiagnosticBaseline::load(llvm::StringRef Path) {
+  auto BufOrErr = llvm::MemoryBuffer::getFile(Path, /*IsText=*/true);
+  if (!BufOrErr)
+    return makeStringError("Cannot open baseline '" + Path +
+                           "': " + BufOrErr.getError().message());
+
+  DiagnosticBaseline B;
+  llvm::StringRef Content = (*BufOrErr)->getBuffer();
+  B.Digest = llvm::utohexstr(llvm::xxHash64(Content), /*LowerCase=*/true);
+
+  unsigned LineNo = 0;
+  while (!Content.empty()) {
+    llvm::StringRef Line;
+    std::tie(Line, Content) = Content.split('\n');
+    ++LineNo;
+    Line = Line.trim();
+    if (Line.empty() || Line.starts_with("#"))
+      continue;
+    uint64_t FP;
+    if (Line.take_until([](char C) { return C == ' ' || C == '\t'; })
+            .getAsInteger(16, FP))
+      return makeStringError("Malformed baseline entry at " + Path + ":" +
+                             llvm::Twine(LineNo));
+    ++B.Fingerprints[FP & ~(uint64_t(1) << 63)];
+  }
+  return std::move(B);
+}
+
+llvm::Error DiagnosticBaseline::write(const std::vector<Remark> &Remarks,
+                                      llvm::StringRef Path) {
+  // ordered by fingerprint so regenerating an unchanged baseline is a no-op;
+  // each occurrence gets its own line so the count is kept
+  std::multimap<uint64_t, const Remark *> Entries;
+  for (const Remark &R : Remarks)
+    if (!R.isApplied())
+      Entries.emplace(fingerprint(R), &R);
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::OF_Text);
+  if (EC)
+    return makeStringError("Cannot write baseline '" + Path +
+                           "': " + EC.message());
+
+  OS << BaselineHeader << "\n";
+  OS << "# <fingerprint> <pass>/<remark> <function> <file>\n";
+  for (const auto &E : Entries) {
+    const Remark &R = *E.second;
+    OS << llvm::format_hex_no_prefix(E.first, 16) << " " << R.PassName << "/"
+       << R.RemarkName << " " << R.FunctionName;
+    if (R.Loc.isValid())
+      OS << " " << R.Loc.File;
+    OS << "\n";
+  }
+  return llvm::Error::success();
+}
+
+llvm::Expected<SeverityBudget> SeverityBudget::parse(llvm::StringRef Spec) {
+  SeverityBudget Budget;
+  llvm::SmallVector<llvm::StringRef, 5> Parts;
+  Spec.split(Parts, ',', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+  for (llvm::StringRef Part : Parts) {
+    llvm::StringRef Name, Value;
+    std::tie(Name, Value) = Part.trim().split('=');
+
+    if (Name.equals_insensitive("hot")) {
+      double Threshold;
+      if (Value.getAsDouble(Threshold) || Threshold < 0)
+        return makeStringError("Invalid hotness '" + Value + "' in budget '" +
+                               Spec + "'");
+      Budget.MinHotness = static_cast<float>(Threshold);
+      continue;
+    }
+
+    int Level = -1;
+    for (unsigned L = 0; L < NumSeverityLevels; ++L)
+      if (Name.equals_insensitive(severityToString(static_cast<SeverityLevel>(L))))
+        Level = static_cast<int>(L);
+    if (Level < 0)
+      return makeStringError("Unknown severity '" + Name + "' in budget '" +
+                             Spec + "'");
+
+    int64_t Limit;
+    if (Value.equals_insensitive("unlimited"))
+      Limit = Unlimited;
+    else if (Value.getAsInteger(10, Limit) || Limit < 0)
+      return makeStringError("Invalid limit '" + Value + "' for " + Name +
+                             " in budget '" + Spec + "'");
+    Budget.Limits[Level] = Limit;
+  }
+  return Budget;
+}
+
+std::optional<SeverityLevel>
+SeverityBudget::firstExceeded(const std::vector<DiagnosticResult> &Diagnostics,
+                              unsigned *Count) const {
+  unsigned Counts[NumSeverityLevels] = {};
+  for (const DiagnosticResult &D : Diagnostics)
+    if (counts(D))
+      ++Counts[static_cast<unsigned>(D.Severity)];
+
+  for (unsigned L = 0; L < NumSeverityLevels; ++L) {
+    if (Limits[L] == Unlimited || Counts[L] <= Limits[L])
+      continue;
+    if (Count)
+      *Count = Counts[L];
+    return static_cast<SeverityLevel>(L);
+  }
+  return std::nullopt;
+}
+
+}
@@ -0,0 +1,413 @@
+#include "OptDebugger/BatchDriver.h"
+#include "OptDebugger/AnalysisCache.h"
+#include "OptDebugger/SelfProfile.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/StringSaver.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+
+namespace optdbg {
+
+namespace {
+
+// one deque per worker. Owners take from the front, which holds their
+// largest pending unit; thieves take from the back so the two rarely meet.
+class WorkStealingQueues {
+public:
+  explicit WorkStealingQueues(unsigned NumWorkers) {
+    for (unsigned I = 0; I < NumWorkers; ++I)
+      Queues.push_back(std::make_unique<Queue>());
+  }
+
+  void push(unsigned Worker, size_t Item) {
+    Queue &Q = *Queues[Worker];
+    std::lock_guard<std::mutex> Lock(Q.Mutex);
+    Q.Items.push_back(Item);
+  }
+
+  std::optional<size_t> pop(unsigned Worker) {
+    {
+      Queue &Own = *Queues[Worker];
+      std::lock_guard<std::mutex> Lock(Own.Mutex);
+      if (!Own.Items.empty()) {
+        size_t Item = Own.Items.front();
+        Own.Items.pop_front();
+        return Item;
+      }
+    }
+    for (size_t K = 1; K < Queues.size(); ++K) {
+      Queue &Victim = *Queues[(Worker + K) % Queues.size()];
+      std::lock_guard<std::mutex> Lock(Victim.Mutex);
+      if (!Victim.Items.empty()) {
+        size_t Item = Victim.Items.back();
+        Victim.Items.pop_back();
+        return Item;
+      }
+    }
+    return std::nullopt;
+  }
+
+private:
+  struct Queue {
+    std::mutex         Mutex;
+    std::deque<size_t> Items;
+  };
+  std::vector<std::unique_ptr<Queue>> Queues;
+};
+
+uint64_t fileSizeOrZero(llvm::StringRef Path) {
+  uint64_t Size = 0;
+  if (llvm::sys::fs::file_size(Path, Size))
+    return 0;
+  return Size;
+}
+
+// looks for <Base>.bc or <Base>.ll and the matching <Base>.opt.yaml
+std::optional<BatchUnit> unitForBase(llvm::StringRef Base) {
+  for (llvm::StringRef Ext : {".bc", ".ll"}) {
+    std::string IR = (Base + Ext).str();
+    if (!llvm::sys::fs::is_regular_file(IR))
+      continue;
+    BatchUnit U;
+    U.IRPath = IR;
+    U.Bytes  = fileSizeOrZero(IR);
+    std::string Remarks = (Base + ".opt.yaml").str();
+    if (llvm::sys::fs::is_regular_file(Remarks)) {
+      U.RemarksPath = Remarks;
+      U.Bytes      += fileSizeOrZero(Remarks);
+    }
+    return U;
+  }
+  return std::nullopt;
+}
+
+// the path of a joined -o<path> or --output=<path>; other options that
+// happen to start with -o (-objcmt-*, -ObjC) are not outputs
+std::optional<llvm::StringRef> joinedOutputPath(llvm::StringRef Arg) {
+  if (Arg.consume_front("--output="))
+    return Arg.empty() ? std::nullopt : std::optional<llvm::StringRef>(Arg);
+  if (!Arg.consume_front("-o") || Arg.empty() || Arg.starts_with("bjc"))
+    return std::nullopt;
+  if (!llvm::sys::path::has_extension(Arg) &&
+      Arg.find_first_of("/\\") == llvm::StringRef::npos)
+    return std::nullopt;
+  return Arg;
+}
+
+std::string stripExtension(llvm::StringRef Path) {
+  llvm::SmallString<256> Base(Path);
+  llvm::sys::path::replace_extension(Base, "");
+  return std::string(Base);
+}
+
+// short unique names for the units of one batch: each IR path without the
+// directory all of them share and without its extension
+std::vector<std::string> unitTags(const std::vector<BatchUnit> &Units) {
+  std::string Common;
+  if (!Units.empty())
+    Common = llvm::sys::path::parent_path(Units.front().IRPath).str();
+  for (const BatchUnit &U : Units)
+    while (!Common.empty() &&
+           !llvm::StringRef(U.IRPath).starts_with(
+               Common + llvm::sys::path::get_separator().str()))
+      Common = llvm::sys::path::parent_path(Common).str();
+
+  std::vector<std::string> Tags;
+  Tags.reserve(Units.size());
+  for (const BatchUnit &U : Units) {
+    std::string Tag = stripExtension(U.IRPath);
+    if (!Common.empty())
+      Tag.erase(0, Common.size() + 1);
+    Tags.push_back(std::move(Tag));
+  }
+  return Tags;
+}
+
+// prefixes every per-function name of a unit's session with its tag, so that
+// static or inline functions of the same name in different TUs stay apart
+// once merged. Remarks keep their names; baselines are keyed on them.
+void qualifyFunctions(AnalysisSession &S, llvm::StringRef Tag) {
+  auto Qualify = [&](std::string &Name) { Name = (Tag + ":" + Name).str(); };
+  // diagnostics attach the diff's own entries, renamed here in place; only
+  // a diff from elsewhere needs a renamed copy
+  llvm::DenseMap<const FunctionDiff *, std::shared_ptr<const FunctionDiff>>
+      Renamed;
+  for (const auto &F : S.Diff.Functions) {
+    Qualify(F->FunctionName);
+    Renamed[F.get()] = F;
+  }
+  for (DiagnosticResult &D : S.Diagnostics) {
+    Qualify(D.FunctionName);
+    if (!D.IRDiff)
+      continue;
+    std::shared_ptr<const FunctionDiff> &FD = Renamed[D.IRDiff.get()];
+    if (!FD) {
+      auto Copy = std::make_shared<FunctionDiff>(*D.IRDiff);
+      Qualify(Copy->FunctionName);
+      FD = std::move(Copy);
+    }
+    D.IRDiff = FD;
+  }
+  for (MachineFunctionStats &M : S.MachineFunctions)
+    Qualify(M.Function);
+}
+
+// frees everything the merged report does not read
+void releaseUnitState(AnalysisSession &S, bool KeepDiffs) {
+  S.BeforeModule.reset();
+  S.AfterModule.reset();
+  S.Contexts.clear();
+  std::string().swap(S.BeforeIR);
+  std::string().swap(S.AfterIR);
+  if (KeepDiffs)
+    return;
+  for (const auto &F : S.Diff.Functions)
+    std::vector<BlockDiff>().swap(F->Blocks);
+  for (DiagnosticResult &D : S.Diagnostics)
+    D.IRDiff.reset();
+}
+
+}
+
+BatchDriver::BatchDriver(AnalysisConfig Config, unsigned NumWorkers,
+                         const AnalysisCache *Cache)
+    : Config(std::move(Config)), NumWorkers(NumWorkers ? NumWorkers : 1),
+      Cache(Cache) {}
+
+llvm::Expected<std::vector<BatchUnit>>
+BatchDriver::discover(llvm::StringRef Root) {
+  if (llvm::sys::fs::is_directory(Root))
+    return discoverFromDirectory(Root);
+  if (llvm::sys::fs::is_regular_file(Root))
+    return discoverFromCompileCommands(Root);
+  return makeStringError("Batch input '" + Root +
+                         "' is neither a directory nor a compilation database");
+}
+
+// For every compile command the IR is expected next to the object file
+// (-o / "output", as with -save-temps or -emit-llvm) or next to the source
+// file; clang's -fsave-optimization-record puts the remarks beside the object.
+llvm::Expected<std::vector<BatchUnit>>
+BatchDriver::discoverFromCompileCommands(llvm::StringRef Path) {
+  auto BufOrErr = llvm::MemoryBuffer::getFile(Path);
+  if (!BufOrErr)
+    return makeStringError("Cannot open compilation database '" + Path +
+                           "': " + BufOrErr.getError().message());
+  auto V = llvm::json::parse((*BufOrErr)->getBuffer());
+  if (!V)
+    return makeStringError("Malformed compilation database '" + Path +
+                           "': " + llvm::toString(V.takeError()));
+  const llvm::json::Array *Entries = V->getAsArray();
+  if (!Entries)
+    return makeStringError("Compilation database '" + Path +
+                           "' is not a JSON array");
+
+  std::vector<BatchUnit> Units;
+  llvm::StringSet<>      Seen;
+  for (const llvm::json::Value &E : *Entries) {
+    const llvm::json::Object *O = E.getAsObject();
+    if (!O)
+      continue;
+    auto Dir  = O->getString("directory");
+    auto File = O->getString("file");
+    if (!Dir || !File)
+      continue;
+
+    llvm::BumpPtrAllocator Alloc;
+    llvm::StringSaver      Saver(Alloc);
+    llvm::SmallVector<const char *, 64> Argv;
+    if (const llvm::json::Array *Args = O->getArray("arguments")) {
+      for (const llvm::json::Value &A : *Args)
+        if (auto S = A.getAsString())
+          Argv.push_back(Saver.save(*S).data());
+    } else if (auto Command = O->getString("command")) {
+      llvm::cl::TokenizeGNUCommandLine(*Command, Saver, Argv);
+    }
+
+    std::string Output;
+    if (auto Out = O->getString("output"))
+      Output = Out->str();
+    for (size_t I = 0; I < Argv.size(); ++I) {
+      llvm::StringRef Arg = Argv[I];
+      if ((Arg == "-o" || Arg == "--output") && I + 1 < Argv.size())
+        Output = Argv[++I];
+      else if (std::optional<llvm::StringRef> Joined = joinedOutputPath(Arg))
+        Output = Joined->str();
+    }
+
+    auto Resolve = [&](llvm::StringRef P) {
+      llvm::SmallString<256> R;
+      if (llvm::sys::path::is_absolute(P)) {
+        R = P;
+      } else {
+        R = *Dir;
+        llvm::sys::path::append(R, P);
+      }
+      llvm::sys::path::remove_dots(R, /*remove_dot_dot=*/true);
+      return std::string(R);
+    };
+
+    llvm::SmallVector<std::string, 3> Bases;
+    if (!Output.empty())
+      Bases.push_back(stripExtension(Resolve(Output)));
+    Bases.push_back(stripExtension(Resolve(*File)));
+    Bases.push_back(stripExtension(Resolve(llvm::sys::path::filename(*File))));
+
+    for (const std::string &Base : Bases) {
+      if (auto U = unitForBase(Base)) {
+        if (Seen.insert(U->IRPath).second)
+          Units.push_back(std::move(*U));
+        break;
+      }
+    }
+  }
+  return Units;
+}
+
+llvm::Expected<std::vector<BatchUnit>>
+BatchDriver::discoverFromDirectory(llvm::StringRef Dir) {
+  std::vector<BatchUnit> Units;
+  llvm::StringSet<>      SeenBases;
+  std::error_code        EC;
+  for (llvm::sys::fs::recursive_directory_iterator It(Dir, EC), End;
+       It != End && !EC; It.increment(EC)) {
+    llvm::StringRef P   = It->path();
+    llvm::StringRef Ext = llvm::sys::path::extension(P);
+    if (Ext != ".ll" && Ext != ".bc")
+      continue;
+    // foo.ll and foo.bc describe the same TU; unitForBase prefers bitcode
+    std::string Base = stripExtension(P);
+    if (!SeenBases.insert(Base).second)
+      continue;
+    if (auto U = unitForBase(Base))
+      Units.push_back(std::move(*U));
+  }
+  if (EC)
+    return makeStringError("Cannot walk '" + Dir + "': " + EC.message());
+
+  // directory order is filesystem dependent; keep reports reproducible
+  std::sort(Units.begin(), Units.end(),
+            [](const BatchUnit &A, const BatchUnit &B) {
+              return A.IRPath < B.IRPath;
+            });
+  return Units;
+}
+
+AnalysisSession BatchDriver::run(std::vector<BatchUnit> Units, bool KeepDiffs,
+                                 std::vector<BatchFailure> &Failures,
+                                 bool Progress) {
+  // largest units first so the longest ones never start last
+  std::vector<size_t> Order(Units.size());
+  std::iota(Order.begin(), Order.end(), 0);
+  std::stable_sort(Order.begin(), Order.end(), [&](size_t A, size_t B) {
+    return Units[A].Bytes > Units[B].Bytes;
+  });
+
+  unsigned Workers = static_cast<unsigned>(
+      std::max<size_t>(1, std::min<size_t>(NumWorkers, Units.size())));
+  WorkStealingQueues Queues(Workers);
+  for (size_t I = 0; I < Order.size(); ++I)
+    Queues.push(I % Workers, Order[I]);
+
+  std::vector<std::optional<AnalysisSession>> Results(Units.size());
+  std::vector<std::string> Errors(Units.size());
+  std::atomic<size_t>      Finished{0};
+  std::mutex               ProgressMutex;
+
+  // each worker keeps one analyzer; every unit gets a fresh LLVMContext that
+  // is released as soon as the unit is done
+  auto Work = [&](unsigned Worker) {
+    SelfProfiler::ThreadScope Profiling;
+    PassAnalyzer Analyzer;
+    Analyzer.setCache(Cache);
+    Analyzer.setBaseline(Baseline);
+    Analyzer.setUserPatterns(UserPatterns);
+    Analyzer.setCodegen(Codegen);
+    while (std::optional<size_t> Item = Queues.pop(Worker)) {
+      const BatchUnit &U = Units[*Item];
+      AnalysisConfig UnitConfig      = Config;
+      UnitConfig.ExternalRemarksPath = U.RemarksPath;
+
+      ProfileScope PS("AnalyzeUnit", U.IRPath);
+      auto SessionOrErr = Analyzer.runFromFile(U.IRPath, UnitConfig);
+      bool OK = static_cast<bool>(SessionOrErr);
+      if (OK) {
+        releaseUnitState(*SessionOrErr, KeepDiffs);
+        Results[*Item] = std::move(*SessionOrErr);
+      } else {
+        Errors[*Item] = llvm::toString(SessionOrErr.takeError());
+      }
+
+      size_t N = ++Finished;
+      if (Progress) {
+        std::lock_guard<std::mutex> Lock(ProgressMutex);
+        llvm::errs() << "[" << N << "/" << Units.size() << "] " << U.IRPath
+                     << (OK ? "" : " (failed)") << "\n";
+      }
+    }
+  };
+
+  std::vector<std::thread> Threads;
+  for (unsigned W = 1; W < Workers; ++W)
+    Threads.emplace_back(Work, W);
+  Work(0);
+  for (std::thread &T : Threads)
+    T.join();
+
+  // merge in discovery order so the report does not depend on scheduling
+  AnalysisSession Merged;
+  Merged.Diff = ModuleDiff{};
+  std::vector<std::string> Tags = unitTags(Units);
+  for (size_t I = 0; I < Units.size(); ++I) {
+    if (!Results[I]) {
+      Failures.push_back({Units[I].IRPath, std::move(Errors[I])});
+      continue;
+    }
+    AnalysisSession &S = *Results[I];
+    qualifyFunctions(S, Tags[I]);
+    if (Merged.PassPipelineUsed.empty())
+      Merged.PassPipelineUsed = S.PassPipelineUsed;
+    Merged.VerificationFailed |= S.VerificationFailed;
+    Merged.BaselineSuppressed += S.BaselineSuppressed;
+
+    std::move(S.Remarks.begin(), S.Remarks.end(),
+              std::back_inserter(Merged.Remarks));
+    std::move(S.Diff.Functions.begin(), S.Diff.Functions.end(),
+              std::back_inserter(Merged.Diff.Functions));
+    std::move(S.Diagnostics.begin(), S.Diagnostics.end(),
+              std::back_inserter(Merged.Diagnostics));
+    std::move(S.MachineFunctions.begin(), S.MachineFunctions.end(),
+              std::back_inserter(Merged.MachineFunctions));
+
+    Merged.Diff.AddedFunctions          += S.Diff.AddedFunctions;
+    Merged.Diff.RemovedFunctions        += S.Diff.RemovedFunctions;
+    Merged.Diff.ModifiedFunctions       += S.Diff.ModifiedFunctions;
+    Merged.Diff.UnchangedFunctions      += S.Diff.UnchangedFunctions;
+    Merged.Diff.TotalBeforeInstructions += S.Diff.TotalBeforeInstructions;
+    Merged.Diff.TotalAfterInstructions  += S.Diff.TotalAfterInstructions;
+    Results[I].reset();
+  }
+
+  std::stable_sort(Merged.Diagnostics.begin(), Merged.Diagnostics.end(),
+                   ranksBefore);
+  return Merged;
+}
+
+}
@@ -0,0 +1,444 @@
+#include "OptDebugger/Bisect.h"
+#include "OptDebugger/CostModel.h"
+#include "OptDebugger/RemarkCollector.h"
+#include "OptDebugger/SelfProfile.h"
+
+#include "llvm/ADT/Any.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/LazyCallGraph.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/DiagnosticHandler.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace optdbg {
+
+namespace {
+
+constexpr unsigned PrecedingShown = 3;
+
+// the target function after a probe
+struct FunctionState {
+  bool    Present      = false;
+  int64_t Instructions = 0;
+  size_t  TextHash     = 0;
+  bool    Vectorized   = false;
+};
+
+// what the pipeline left behind with its first Limit optional passes; a
+// negative limit runs them all
+struct Probe {
+  unsigned                           Invocations = 0;
+  std::vector<PassInvocation>        Log;
+  FunctionState                      Function;
+  bool                               RemarkSeen = false;
+  unsigned                           OptNoneDropped = 0;
+  std::string                        Error;
+  std::unique_ptr<llvm::LLVMContext> Ctx;
+  std::unique_ptr<llvm::Module>      M;
+};
+
+// the textual pipeline the probes run, as opt -passes spells it
+std::string pipelineFor(const BisectConfig &Config) {
+  if (!Config.PassPipeline.empty())
+    return Config.PassPipeline;
+  llvm::StringRef L = Config.OptLevel;
+  L.consume_front("-");
+  L.consume_front("O");
+  return ("default<O" + (L.empty() ? llvm::StringRef("2") : L) + ">").str();
+}
+
+// optnone from clang -O0 would make every pass a no-op, and noinline comes
+// with it; the probes drop both and count the functions they edited
+unsigned dropOptNone(llvm::Module &M) {
+  unsigned Dropped = 0;
+  for (llvm::Function &F : M) {
+    if (!F.hasFnAttribute(llvm::Attribute::OptimizeNone))
+      continue;
+    F.removeFnAttr(llvm::Attribute::OptimizeNone);
+    F.removeFnAttr(llvm::Attribute::NoInline);
+    ++Dropped;
+  }
+  return Dropped;
+}
+
+// the IR unit a pass ran on, in the words -opt-bisect-limit prints
+std::string irUnitName(const llvm::Any &IR) {
+  if (const auto *F = llvm::any_cast<const llvm::Function *>(&IR))
+    return ("function (" + (*F)->getName() + ")").str();
+  if (const auto *L = llvm::any_cast<const llvm::Loop *>(&IR)) {
+    const llvm::BasicBlock *Header = (*L)->getHeader();
+    return ("loop %" + Header->getName() + " in function " +
+            Header->getParent()->getName())
+        .str();
+  }
+  if (const auto *C = llvm::any_cast<const llvm::LazyCallGraph::SCC *>(&IR))
+    return "scc " + (*C)->getName();
+  if (llvm::any_cast<const llvm::Module *>(&IR))
+    return "module";
+  return "";
+}
+
+FunctionState measure(const llvm::Function &F) {
+  FunctionState S;
+  S.Present = true;
+  for (const llvm::Instruction &I : llvm::instructions(F)) {
+    if (llvm::isa<llvm::DbgInfoIntrinsic>(I))
+      continue;
+    ++S.Instructions;
+    if (I.getType()->isVectorTy() ||
+        llvm::any_of(I.operands(), [](const llvm::Use &U) {
+          return U->getType()->isVectorTy();
+        }))
+      S.Vectorized = true;
+  }
+  std::string Text;
+  llvm::raw_string_ostream OS(Text);
+  F.print(OS);
+  S.TextHash = std::hash<std::string>()(OS.str());
+  return S;
+}
+
+bool remarkMatches(const BisectPredicate &P, const Remark &R) {
+  return R.PassName == P.PassName &&
+         (P.RemarkName.empty() || R.RemarkName == P.RemarkName) &&
+         (P.Function.empty() || R.FunctionName == P.Function);
+}
+
+Probe runProbe(llvm::StringRef IRText, llvm::StringRef Pipeline, int Limit,
+               const BisectPredicate &P, bool RecordLog, bool KeepModule) {
+  ProfileScope PS("BisectProbe", std::to_string(Limit));
+  Probe Run;
+  Run.Ctx = std::make_unique<llvm::LLVMContext>();
+  // remarks are only collected when the predicate asks about them; enabling
+  // them all slows every pass down
+  RemarkCollector Collector;
+  Collector.install(*Run.Ctx, P.Check == BisectCheck::Remark);
+
+  llvm::SMDiagnostic Err;
+  Run.M = llvm::parseIR(llvm::MemoryBufferRef(IRText, "<bisect>"), Err,
+                        *Run.Ctx);
+  if (!Run.M) {
+    Run.Error = "failed to parse the input IR: " + Err.getMessage().str();
+    return Run;
+  }
+  Run.OptNoneDropped = dropOptNone(*Run.M);
+
+  // the managers' cached analyses refer into the module, so they go out of
+  // scope before it is measured or released
+  {
+    std::unique_ptr<llvm::TargetMachine> TM = targetMachineFor(*Run.M);
+    llvm::PassInstrumentationCallbacks PIC;
+    registerPassProfiling(PIC);
+    // required passes (verifier, adaptors, always-inline) do not ask and are
+    // not counted, exactly as with OptBisect
+    PIC.registerShouldRunOptionalPassCallback(
+        [&](llvm::StringRef PassID, llvm::Any IR) {
+          unsigned Index = ++Run.Invocations;
+          if (RecordLog)
+            Run.Log.push_back({Index, PassID.str(), irUnitName(IR)});
+          return Limit < 0 || Index <= static_cast<unsigned>(Limit);
+        });
+    llvm::PassBuilder PB(TM.get(), llvm::PipelineTuningOptions(), {}, &PIC);
+
+    llvm::LoopAnalysisManager     LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager    CGAM;
+    llvm::ModuleAnalysisManager   MAM;
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    llvm::ModulePassManager MPM;
+    if (auto E = PB.parsePassPipeline(MPM, Pipeline)) {
+      Run.Error = "invalid pipeline '" + Pipeline.str() +
+                  "': " + llvm::toString(std::move(E));
+      return Run;
+    }
+    MPM.run(*Run.M, MAM);
+  }
+
+  if (!P.Function.empty())
+    if (const llvm::Function *F = Run.M->getFunction(P.Function))
+      if (!F->isDeclaration())
+        Run.Function = measure(*F);
+  Run.RemarkSeen = llvm::any_of(Collector.getRemarks(), [&](const Remark &R) {
+    return remarkMatches(P, R);
+  });
+
+  if (!KeepModule) {
+    Run.M.reset();
+    Run.Ctx.reset();
+  } else {
+    // the collector does not outlive this call
+    Run.Ctx->setDiagnosticHandler(std::make_unique<llvm::DiagnosticHandler>());
+  }
+  return Run;
+}
+
+// Start is the probe without optional passes; it is what Changed and Grew
+// without a threshold compare against
+bool holds(const BisectPredicate &P, const Probe &Run, const Probe &Start) {
+  const FunctionState &F = Run.Function;
+  switch (P.Check) {
+  case BisectCheck::Changed:
+    return F.Present != Start.Function.Present ||
+           F.TextHash != Start.Function.TextHash;
+  case BisectCheck::Grew:
+    return F.Present &&
+           F.Instructions > (P.Threshold ? static_cast<int64_t>(*P.Threshold)
+                                         : Start.Function.Instructions);
+  case BisectCheck::Vectorized:
+    return F.Present && F.Vectorized;
+  case BisectCheck::Remark:
+    return Run.RemarkSeen;
+  }
+  return false;
+}
+
+// probes of one round each get a thread; a round never has more of them
+// than Threads
+template <typename Fn>
+void runProbes(size_t Count, unsigned Threads, Fn Work) {
+  if (Threads <= 1) {
+    for (size_t I = 0; I < Count; ++I)
+      Work(I);
+    return;
+  }
+  std::vector<std::thread> Pool;
+  for (size_t I = 1; I < Count; ++I)
+    Pool.emplace_back([&Work, I] {
+      SelfProfiler::ThreadScope Profiling;
+      Work(I);
+    });
+  Work(0);
+  for (std::thread &T : Pool)
+    T.join();
+}
+
+}
+
+llvm::Expected<BisectPredicate> BisectPredicate::parse(llvm::StringRef Spec) {
+  BisectPredicate P;
+  auto [Kind, Arg] = Spec.trim().split(':');
+  if (Kind == "changed" || Kind == "vectorized") {
+    P.Check    = Kind == "changed" ? BisectCheck::Changed
+                                   : BisectCheck::Vectorized;
+    P.Function = Arg.str();
+  } else if (Kind == "grew") {
+    P.Check = BisectCheck::Grew;
+    auto [Function, Limit] = Arg.split(':');
+    P.Function = Function.str();
+    if (!Limit.empty()) {
+      unsigned N;
+      if (Limit.getAsInteger(10, N))
+        return makeStringError("Invalid instruction count '" + Limit +
+                               "' in bisect predicate '" + Spec + "'");
+      P.Threshold = N;
+    }
+  } else if (Kind == "remark") {
+    P.Check = BisectCheck::Remark;
+    auto [RemarkSpec, Function] = Arg.split('@');
+    auto [Pass, Name] = RemarkSpec.split('/');
+    P.PassName   = Pass.str();
+    P.RemarkName = Name.str();
+    P.Function   = Function.str();
+    if (P.PassName.empty())
+      return makeStringError("Bisect predicate '" + Spec +
+                             "' names no pass; use remark:PASS[/NAME][@FN]");
+    return P;
+  } else {
+    return makeStringError("Unknown bisect predicate '" + Spec +
+                           "'; use changed:FN, grew:FN[:N], vectorized:FN or "
+                           "remark:PASS[/NAME][@FN]");
+  }
+  if (P.Function.empty())
+    return makeStringError("Bisect predicate '" + Spec + "' names no function");
+  return P;
+}
+
+std::string BisectPredicate::describe() const {
+  switch (Check) {
+  case BisectCheck::Changed:
+    return "@" + Function + " differs from the limit-0 probe (the input after "
+           "the required passes)";
+  case BisectCheck::Grew:
+    if (Threshold)
+      return "@" + Function + " has more than " + std::to_string(*Threshold) +
+             " instructions";
+    return "@" + Function + " has more instructions than in the limit-0 probe "
+           "(the input after the required passes)";
+  case BisectCheck::Vectorized:
+    return "@" + Function + " has vector instructions";
+  case BisectCheck::Remark: {
+    std::string S = "remark " + PassName;
+    if (!RemarkName.empty())
+      S += "/" + RemarkName;
+    S += " was emitted";
+    if (!Function.empty())
+      S += " for @" + Function;
+    return S;
+  }
+  }
+  return "";
+}
+
+// assumes the predicate flips once; one that flips back and forth yields an
+// invocation that sets the final value, not necessarily the first
+llvm::Expected<BisectResult> runBisection(llvm::StringRef IRText,
+                                          const BisectPredicate &Predicate,
+                                          const BisectConfig &Config) {
+  ProfileScope PS("Bisect");
+  BisectResult Result;
+  Result.Pipeline = pipelineFor(Config);
+  unsigned Threads = std::max(1u, Config.Threads);
+
+  auto Probes = [&](llvm::ArrayRef<int> Limits, bool Keep)
+      -> llvm::Expected<std::vector<Probe>> {
+    std::vector<Probe> Runs(Limits.size());
+    runProbes(Limits.size(), Threads, [&](size_t I) {
+      // only the unlimited run lists the invocations
+      Runs[I] = runProbe(IRText, Result.Pipeline, Limits[I], Predicate,
+                         Limits[I] < 0, Keep);
+    });
+    Result.Probes += Limits.size();
+    for (const Probe &Run : Runs)
+      if (!Run.Error.empty())
+        return makeStringError(Run.Error);
+    return std::move(Runs);
+  };
+
+  // the input as the pipeline's required passes leave it, and the output
+  auto EndsOrErr = Probes({0, -1}, /*Keep=*/false);
+  if (!EndsOrErr)
+    return EndsOrErr.takeError();
+  const Probe &Start = (*EndsOrErr)[0];
+  const Probe &Full  = (*EndsOrErr)[1];
+  if (!Predicate.Function.empty() && !Start.Function.Present &&
+      Predicate.Check != BisectCheck::Remark)
+    return makeStringError("No function '" + Predicate.Function +
+                           "' is defined in the input");
+
+  Result.Invocations    = Full.Invocations;
+  Result.OptNoneDropped = Start.OptNoneDropped;
+  Result.FinalValue     = holds(Predicate, Full, Start);
+  if (holds(Predicate, Start, Start) == Result.FinalValue)
+    return Result;
+
+  // Lo never has the final value and Hi always has it; each round probes
+  // Threads limits spread evenly in between
+  unsigned Lo = 0, Hi = Full.Invocations;
+  while (Hi - Lo > 1) {
+    unsigned Ways = std::min(Threads, Hi - Lo - 1);
+    std::vector<int> Limits;
+    for (unsigned I = 1; I <= Ways; ++I)
+      Limits.push_back(static_cast<int>(
+          Lo + static_cast<uint64_t>(Hi - Lo) * I / (Ways + 1)));
+    auto RunsOrErr = Probes(Limits, /*Keep=*/false);
+    if (!RunsOrErr)
+      return RunsOrErr.takeError();
+    ++Result.Rounds;
+
+    unsigned NewLo = Lo, NewHi = Hi;
+    for (size_t I = 0; I < Limits.size(); ++I) {
+      if (holds(Predicate, (*RunsOrErr)[I], Start) == Result.FinalValue) {
+        NewHi = Limits[I];
+        break;
+      }
+      NewLo = Limits[I];
+    }
+    Lo = NewLo;
+    Hi = NewHi;
+  }
+
+  Result.Status  = BisectStatus::Found;
+  Result.Culprit = Full.Log[Hi - 1];
+  for (unsigned I = Hi - 1 - std::min(Hi - 1, PrecedingShown); I + 1 < Hi; ++I)
+    Result.Preceding.push_back(Full.Log[I]);
+
+  auto AroundOrErr =
+      Probes({static_cast<int>(Hi) - 1, static_cast<int>(Hi)}, /*Keep=*/true);
+  if (!AroundOrErr)
+    return AroundOrErr.takeError();
+  const Probe &Without = (*AroundOrErr)[0];
+  const Probe &With    = (*AroundOrErr)[1];
+  if (Without.Function.Present)
+    Result.InstructionsBefore = Without.Function.Instructions;
+  if (With.Function.Present)
+    Result.InstructionsAfter = With.Function.Instructions;
+  {
+    ProfileScope DiffScope("BisectDiff");
+    IRDiffEngine Engine;
+    Result.Delta = Engine.diff(*Without.M, *With.M);
+  }
+  return Result;
+}
+
+void printBisectReport(const BisectResult &Result,
+                       const BisectPredicate &Predicate,
+                       llvm::raw_ostream &OS, bool UseColor, bool Verbose) {
+  OS << "\n=== Pass Bisection ===\n";
+  OS << "Predicate : " << Predicate.describe() << "\n";
+  OS << "Pipeline  : " << Result.Pipeline << ", " << Result.Invocations
+     << " optional pass invocations\n";
+  OS << "Search    : " << Result.Probes << " probes in " << Result.Rounds
+     << " rounds\n";
+
+  if (Result.Status == BisectStatus::NoChange) {
+    OS << "The predicate is " << (Result.FinalValue ? "true" : "false")
+       << " both before the first pass and after the last; no single pass "
+          "changes it.\n";
+    return;
+  }
+
+  const PassInvocation &C = Result.Culprit;
+  OS << "Culprit   : #" << C.Index << " " << C.Pass;
+  if (!C.IRUnit.empty())
+    OS << " on " << C.IRUnit;
+  OS << "\n";
+  OS << "Reproduce : opt -passes='" << Result.Pipeline
+     << "' -opt-bisect-limit=" << C.Index << " (and " << C.Index - 1
+     << " without it)\n";
+  if (Result.OptNoneDropped)
+    OS << "            on the input with optnone and noinline removed from its "
+       << Result.OptNoneDropped << " optnone function"
+       << (Result.OptNoneDropped == 1 ? "" : "s") << ", as the probes do\n";
+  if (Predicate.Check != BisectCheck::Remark || !Predicate.Function.empty()) {
+    auto Count = [](int64_t N) {
+      return N < 0 ? std::string("(gone)") : std::to_string(N);
+    };
+    OS << "@" << Predicate.Function << " instructions: "
+       << Count(Result.InstructionsBefore) << " -> "
+       << Count(Result.InstructionsAfter) << "\n";
+  }
+  if (Verbose && !Result.Preceding.empty()) {
+    OS << "Preceded by:\n";
+    for (const PassInvocation &P : Result.Preceding)
+      OS << "  #" << P.Index << " " << P.Pass
+         << (P.IRUnit.empty() ? "" : " on ") << P.IRUnit << "\n";
+  }
+
+  if (!Result.Delta.hasChanges()) {
+    OS << "The pass changed no instruction; the predicate flipped on "
+          "attributes, metadata or remarks alone.\n";
+    return;
+  }
+  printModuleDiff(Result.Delta, OS, UseColor);
+}
+
+}
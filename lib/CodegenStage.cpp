@@ -0,0 +1,183 @@
+#include "OptDebugger/CodegenStage.h"
+#include "OptDebugger/CostModel.h"
+#include "OptDebugger/RemarkCollector.h"
+#include "OptDebugger/SelfProfile.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/TargetParser/Host.h"
+#include "llvm/TargetParser/Triple.h"
+
+#include <memory>
+
+namespace optdbg {
+
+namespace {
+
+// Os and Oz lower like O2
+llvm::CodeGenOptLevel codegenLevelFor(llvm::StringRef OptLevel) {
+  switch (optLevelFor(OptLevel).getSpeedupLevel()) {
+  case 0:  return llvm::CodeGenOptLevel::None;
+  case 1:  return llvm::CodeGenOptLevel::Less;
+  case 3:  return llvm::CodeGenOptLevel::Aggressive;
+  default: return llvm::CodeGenOptLevel::Default;
+  }
+}
+
+// folds a per-function bookkeeping remark into its function's stats; false
+// for remarks that belong in the report
+bool recordStat(const Remark &R, MachineFunctionStats &S) {
+  llvm::StringRef Pass = R.PassName, Name = R.RemarkName;
+  if (Pass == "asm-printer" && Name == "InstructionCount") {
+    S.Instructions = R.unsignedArg("NumInstructions");
+    return true;
+  }
+  // one per opcode and block, or per pass that changed the instruction
+  // count; the table has the totals
+  if ((Pass == "asm-printer" && Name == "InstructionMix") ||
+      Pass == "size-info")
+    return true;
+  if (Pass == "prologepilog" && Name == "StackSize") {
+    S.StackBytes = R.unsignedArg("NumStackBytes");
+    return true;
+  }
+  // the greedy allocator reports every loop (LoopSpillReloadCopies) and
+  // then the whole function; the loops stay remarks, the function's totals
+  // become the stats
+  if (Pass == "regalloc" && Name == "SpillReloadCopies") {
+    S.Spills        = R.unsignedArg("NumSpills");
+    S.Reloads       = R.unsignedArg("NumReloads");
+    S.FoldedSpills  = R.unsignedArg("NumFoldedSpills");
+    S.FoldedReloads = R.unsignedArg("NumFoldedReloads");
+    return true;
+  }
+  return false;
+}
+
+// symbol sizes of the emitted functions, keyed by IR name
+llvm::Error collectCodeSizes(llvm::StringRef Object, char GlobalPrefix,
+                             llvm::StringMap<uint64_t> &Sizes) {
+  auto ObjOrErr = llvm::object::ObjectFile::createObjectFile(
+      llvm::MemoryBufferRef(Object, "<codegen>"));
+  if (!ObjOrErr)
+    return ObjOrErr.takeError();
+  for (const auto &[Sym, Size] : llvm::object::computeSymbolSizes(**ObjOrErr)) {
+    auto TypeOrErr = Sym.getType();
+    if (!TypeOrErr) {
+      llvm::consumeError(TypeOrErr.takeError());
+      continue;
+    }
+    auto NameOrErr = Sym.getName();
+    if (!NameOrErr) {
+      llvm::consumeError(NameOrErr.takeError());
+      continue;
+    }
+    if (*TypeOrErr != llvm::object::SymbolRef::ST_Function)
+      continue;
+    llvm::StringRef Name = *NameOrErr;
+    if (GlobalPrefix)
+      Name.consume_front(llvm::StringRef(&GlobalPrefix, 1));
+    Sizes[Name] += Size;
+  }
+  return llvm::Error::success();
+}
+
+}
+
+llvm::Expected<std::vector<MachineFunctionStats>>
+runCodegen(llvm::StringRef IRText, const CodegenOptions &Options,
+           std::vector<Remark> &MachineRemarks) {
+  ProfileScope PS("Codegen");
+  initializeTargets();
+
+  // lowering rewrites the module, so it gets a copy in a context of its own
+  // whose remarks are all on
+  llvm::LLVMContext Ctx;
+  RemarkCollector Collector;
+  Collector.install(Ctx, /*AllRemarks=*/true);
+
+  llvm::SMDiagnostic Err;
+  auto M = llvm::parseIR(llvm::MemoryBufferRef(IRText, "<codegen>"), Err, Ctx);
+  if (!M) {
+    std::string Msg;
+    llvm::raw_string_ostream OS(Msg);
+    Err.print("opt-debugger", OS);
+    return makeStringError("Failed to parse IR for codegen: " + Msg);
+  }
+
+  std::string TT = Options.Triple;
+  if (TT.empty())
+    TT = M->getTargetTriple();
+  if (TT.empty())
+    TT = llvm::sys::getDefaultTargetTriple();
+  std::string CPU = Options.CPU == "native" ? llvm::sys::getHostCPUName().str()
+                                            : Options.CPU;
+
+  std::string Error;
+  const llvm::Target *T = llvm::TargetRegistry::lookupTarget(TT, Error);
+  if (!T)
+    return makeStringError("No codegen target for '" + TT + "': " + Error);
+  std::unique_ptr<llvm::TargetMachine> TM(T->createTargetMachine(
+      TT, CPU, "", llvm::TargetOptions(), llvm::Reloc::PIC_, std::nullopt,
+      codegenLevelFor(Options.OptLevel)));
+  if (!TM)
+    return makeStringError("Cannot create a target machine for '" + TT + "'");
+
+  M->setTargetTriple(TT);
+  M->setDataLayout(TM->createDataLayout());
+
+  llvm::SmallVector<char, 0> Object;
+  {
+    llvm::raw_svector_ostream OS(Object);
+    llvm::legacy::PassManager PM;
+    llvm::TargetLibraryInfoImpl TLII{llvm::Triple(TT)};
+    PM.add(new llvm::TargetLibraryInfoWrapperPass(TLII));
+    if (TM->addPassesToEmitFile(PM, OS, nullptr,
+                                llvm::CodeGenFileType::ObjectFile))
+      return makeStringError("Target '" + TT + "' cannot emit object files");
+    PM.run(*M);
+  }
+
+  std::vector<MachineFunctionStats> Stats;
+  llvm::StringMap<size_t> Index;
+  for (const llvm::Function &F : *M) {
+    if (F.isDeclaration())
+      continue;
+    Index[F.getName()] = Stats.size();
+    Stats.push_back({F.getName().str()});
+  }
+
+  for (const Remark &R : Collector.getRemarks()) {
+    if (!R.IsMachine)
+      continue;
+    auto It = Index.find(R.FunctionName);
+    if (It != Index.end() && recordStat(R, Stats[It->second]))
+      continue;
+    MachineRemarks.push_back(R);
+  }
+
+  llvm::StringMap<uint64_t> Sizes;
+  if (auto E = collectCodeSizes(llvm::StringRef(Object.data(), Object.size()),
+                                M->getDataLayout().getGlobalPrefix(), Sizes))
+    return E;
+  for (MachineFunctionStats &S : Stats)
+    S.CodeBytes = Sizes.lookup(S.Function);
+
+  return Stats;
+}
+
+}
@@ -0,0 +1,473 @@
+#include "OptDebugger/CostModel.h"
+#include "OptDebugger/SelfProfile.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/bit.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/TargetParser/Triple.h"
+
+#include <algorithm>
+#include <mutex>
+#include <optional>
+
+namespace optdbg {
+
+namespace {
+
+// loops without a constant trip count; about a typical array loop, so loop
+// bodies outweigh straight-line code as they do at run time
+constexpr double   AssumedTripCount    = 32.0;
+constexpr double   AssumedUnrollFactor = 4.0;
+constexpr unsigned MaxModeledVF        = 64;
+
+constexpr auto CostKind = llvm::TargetTransformInfo::TCK_RecipThroughput;
+
+enum class CostFamily : uint8_t {
+  None,
+  LoopVectorize,
+  SLPVectorize,
+  Unroll,
+  Inline,
+  LICM,
+  GVN,
+};
+
+CostFamily familyFor(llvm::StringRef PassName) {
+  std::string Lower = PassName.lower();
+  llvm::StringRef P(Lower);
+  if (P.contains("slp"))      return CostFamily::SLPVectorize;
+  if (P.contains("vectoriz")) return CostFamily::LoopVectorize;
+  if (P.contains("unroll"))   return CostFamily::Unroll;
+  if (P.contains("inline"))   return CostFamily::Inline;
+  if (P.contains("licm"))     return CostFamily::LICM;
+  if (P.contains("gvn"))      return CostFamily::GVN;
+  return CostFamily::None;
+}
+
+// the analyses and weighted cost of one function, built on first use
+class FunctionModel {
+public:
+  FunctionModel(llvm::Function &F, llvm::TargetMachine *TM,
+                const llvm::TargetLibraryInfoImpl &TLII)
+      : F(F),
+        TTI(TM ? TM->getTargetTransformInfo(F)
+               : llvm::TargetTransformInfo(F.getParent()->getDataLayout())),
+        TLI(TLII, &F), AC(F, &TTI), DT(F), LI(DT), SE(F, TLI, AC, DT, LI) {
+    for (llvm::BasicBlock &BB : F) {
+      double Block = 0;
+      for (llvm::Instruction &I : BB)
+        Block += cost(I);
+      Cycles += Block * frequency(BB);
+    }
+  }
+
+  // modeled cycles of one call of the function
+  double cycles() const { return Cycles; }
+
+  // cycles per call the fix saves; nullopt when nothing at the remark's
+  // location can be modeled
+  std::optional<double> saving(CostFamily Family, const SourceLocation &Loc);
+
+  // the call at the remark's location, if any
+  llvm::CallBase *callAt(const SourceLocation &Loc);
+
+  // executions per call: the trip counts of every enclosing loop
+  double frequency(const llvm::BasicBlock &BB) {
+    double Freq = 1;
+    for (llvm::Loop *L = LI.getLoopFor(&BB); L; L = L->getParentLoop())
+      Freq *= tripCount(L);
+    return Freq;
+  }
+
+private:
+  llvm::Function             &F;
+  llvm::TargetTransformInfo   TTI;
+  llvm::TargetLibraryInfo     TLI;
+  llvm::AssumptionCache       AC;
+  llvm::DominatorTree         DT;
+  llvm::LoopInfo              LI;
+  llvm::ScalarEvolution       SE;
+  double                      Cycles = 0;
+
+  double cost(const llvm::Instruction &I) {
+    if (llvm::isa<llvm::DbgInfoIntrinsic>(I))
+      return 0;
+    llvm::InstructionCost C = TTI.getInstructionCost(&I, CostKind);
+    return C.isValid() ? double(*C.getValue()) : 0;
+  }
+
+  double tripCount(llvm::Loop *L) {
+    unsigned Trip = SE.getSmallConstantTripCount(L);
+    return Trip ? double(Trip) : AssumedTripCount;
+  }
+
+  llvm::SmallVector<llvm::Instruction *, 8> anchors(const SourceLocation &Loc);
+  llvm::Loop *loopAt(const SourceLocation &Loc,
+                     llvm::ArrayRef<llvm::Instruction *> Anchors);
+
+  double vectorCost(const llvm::Instruction &I, unsigned VF);
+  double bestVectorSaving(llvm::ArrayRef<llvm::Instruction *> Body,
+                          unsigned MaxVF);
+
+  double vectorizeSaving(llvm::Loop *L);
+  double slpSaving(llvm::ArrayRef<llvm::Instruction *> Anchors);
+  double unrollSaving(llvm::Loop *L);
+  double inlineSaving(llvm::CallBase *CB);
+  double hoistSaving(llvm::ArrayRef<llvm::Instruction *> Anchors);
+  double loadSaving(llvm::ArrayRef<llvm::Instruction *> Anchors);
+};
+
+bool sameFile(llvm::StringRef A, llvm::StringRef B) {
+  return A.empty() || B.empty() ||
+         llvm::sys::path::filename(A) == llvm::sys::path::filename(B);
+}
+
+// the instructions of the function at the remark's line, narrowed to its
+// column when any instruction has it
+llvm::SmallVector<llvm::Instruction *, 8>
+FunctionModel::anchors(const SourceLocation &Loc) {
+  llvm::SmallVector<llvm::Instruction *, 8> AtLine, AtColumn;
+  for (llvm::Instruction &I : llvm::instructions(F)) {
+    const llvm::DebugLoc &DL = I.getDebugLoc();
+    if (!DL || DL.getLine() != Loc.Line || llvm::isa<llvm::DbgInfoIntrinsic>(I))
+      continue;
+    auto *Scope = llvm::dyn_cast<llvm::DIScope>(DL.getScope());
+    if (Scope && !sameFile(Scope->getFilename(), Loc.File))
+      continue;
+    AtLine.push_back(&I);
+    if (Loc.Column && DL.getCol() == Loc.Column)
+      AtColumn.push_back(&I);
+  }
+  return AtColumn.empty() ? AtLine : AtColumn;
+}
+
+// the innermost loop starting at the remark's line, otherwise the innermost
+// loop around one of its instructions
+llvm::Loop *FunctionModel::loopAt(const SourceLocation &Loc,
+                                  llvm::ArrayRef<llvm::Instruction *> Anchors) {
+  llvm::Loop *Best = nullptr;
+  for (llvm::Loop *L : LI.getLoopsInPreorder()) {
+    llvm::DebugLoc Start = L->getStartLoc();
+    if (Start && Start.getLine() == Loc.Line &&
+        (!Best || L->getLoopDepth() > Best->getLoopDepth()))
+      Best = L;
+  }
+  if (Best)
+    return Best;
+  for (llvm::Instruction *I : Anchors) {
+    llvm::Loop *L = LI.getLoopFor(I->getParent());
+    if (L && (!Best || L->getLoopDepth() > Best->getLoopDepth()))
+      Best = L;
+  }
+  return Best;
+}
+
+// one vector instruction doing VF lanes of I; control flow, phis and address
+// computations stay one per vector iteration, anything without a vector form
+// is scalarized
+double FunctionModel::vectorCost(const llvm::Instruction &I, unsigned VF) {
+  if (I.isTerminator() || llvm::isa<llvm::PHINode>(I) ||
+      llvm::isa<llvm::GetElementPtrInst>(I))
+    return cost(I);
+
+  llvm::Type *Ty = I.getType();
+  if (auto *SI = llvm::dyn_cast<llvm::StoreInst>(&I))
+    Ty = SI->getValueOperand()->getType();
+  if (!llvm::VectorType::isValidElementType(Ty))
+    return cost(I) * VF;
+
+  auto *VecTy = llvm::FixedVectorType::get(Ty, VF);
+  llvm::InstructionCost C = llvm::InstructionCost::getInvalid();
+  if (auto *BO = llvm::dyn_cast<llvm::BinaryOperator>(&I)) {
+    C = TTI.getArithmeticInstrCost(BO->getOpcode(), VecTy, CostKind);
+  } else if (auto *Load = llvm::dyn_cast<llvm::LoadInst>(&I)) {
+    C = TTI.getMemoryOpCost(llvm::Instruction::Load, VecTy, Load->getAlign(),
+                            Load->getPointerAddressSpace(), CostKind);
+  } else if (auto *Store = llvm::dyn_cast<llvm::StoreInst>(&I)) {
+    C = TTI.getMemoryOpCost(llvm::Instruction::Store, VecTy, Store->getAlign(),
+                            Store->getPointerAddressSpace(), CostKind);
+  } else if (auto *Cast = llvm::dyn_cast<llvm::CastInst>(&I)) {
+    if (llvm::VectorType::isValidElementType(Cast->getSrcTy()))
+      C = TTI.getCastInstrCost(
+          Cast->getOpcode(), VecTy,
+          llvm::FixedVectorType::get(Cast->getSrcTy(), VF),
+          llvm::TargetTransformInfo::CastContextHint::None, CostKind);
+  } else if (auto *Cmp = llvm::dyn_cast<llvm::CmpInst>(&I)) {
+    llvm::Type *OpTy = Cmp->getOperand(0)->getType();
+    if (llvm::VectorType::isValidElementType(OpTy))
+      C = TTI.getCmpSelInstrCost(Cmp->getOpcode(),
+                                 llvm::FixedVectorType::get(OpTy, VF), VecTy,
+                                 Cmp->getPredicate(), CostKind);
+  } else if (auto *Sel = llvm::dyn_cast<llvm::SelectInst>(&I)) {
+    llvm::Type *CondTy = Sel->getCondition()->getType();
+    if (!CondTy->isVectorTy())
+      C = TTI.getCmpSelInstrCost(llvm::Instruction::Select, VecTy,
+                                 llvm::FixedVectorType::get(CondTy, VF),
+                                 llvm::CmpInst::BAD_ICMP_PREDICATE, CostKind);
+  }
+  return C.isValid() ? double(*C.getValue()) : cost(I) * VF;
+}
+
+// scalar cost of VF iterations of Body against one vector iteration, at the
+// most profitable VF; zero when no VF pays off
+double FunctionModel::bestVectorSaving(llvm::ArrayRef<llvm::Instruction *> Body,
+                                       unsigned MaxVF) {
+  double Scalar = 0;
+  for (llvm::Instruction *I : Body)
+    Scalar += cost(*I);
+
+  double Best = 0;
+  for (unsigned VF = 2; VF <= MaxVF; VF *= 2) {
+    double Vector = 0;
+    for (llvm::Instruction *I : Body)
+      Vector += vectorCost(*I, VF);
+    Best = std::max(Best, Scalar - Vector / VF);
+  }
+  return Best;
+}
+
+// widest vector register over the widest element the loop touches
+unsigned maxVFFor(const llvm::TargetTransformInfo &TTI,
+                  llvm::ArrayRef<llvm::Instruction *> Body) {
+  uint64_t Widest = 8;
+  for (llvm::Instruction *I : Body) {
+    llvm::Type *Ty = I->getType();
+    if (auto *SI = llvm::dyn_cast<llvm::StoreInst>(I))
+      Ty = SI->getValueOperand()->getType();
+    if (Ty->isIntegerTy() || Ty->isFloatingPointTy())
+      Widest = std::max<uint64_t>(Widest, Ty->getPrimitiveSizeInBits()
+                                              .getFixedValue());
+  }
+  uint64_t Register = TTI.getRegisterBitWidth(
+      llvm::TargetTransformInfo::RGK_FixedWidthVector).getFixedValue();
+  uint64_t VF = std::max<uint64_t>(2, Register / Widest);
+  return unsigned(std::min<uint64_t>(VF, MaxModeledVF));
+}
+
+// per iteration of the innermost body, weighted by how often it runs
+double FunctionModel::vectorizeSaving(llvm::Loop *L) {
+  llvm::SmallVector<llvm::Instruction *, 32> Body;
+  for (llvm::BasicBlock *BB : L->blocks())
+    if (LI.getLoopFor(BB) == L)
+      for (llvm::Instruction &I : *BB)
+        Body.push_back(&I);
+  return bestVectorSaving(Body, maxVFFor(TTI, Body)) *
+         frequency(*L->getHeader());
+}
+
+// isomorphic instructions at the remark's line (same opcode and type) become
+// the lanes of one vector instruction, as many as fit a register
+double FunctionModel::slpSaving(llvm::ArrayRef<llvm::Instruction *> Anchors) {
+  llvm::SmallVector<llvm::SmallVector<llvm::Instruction *, 4>, 4> Bundles;
+  for (llvm::Instruction *I : Anchors) {
+    if (I->isTerminator() || llvm::isa<llvm::PHINode>(I) ||
+        llvm::isa<llvm::GetElementPtrInst>(I))
+      continue;
+    auto It = llvm::find_if(Bundles, [&](const auto &B) {
+      return B.front()->isSameOperationAs(I);
+    });
+    if (It == Bundles.end())
+      Bundles.push_back({I});
+    else
+      It->push_back(I);
+  }
+
+  double Saved = 0;
+  for (const auto &Bundle : Bundles) {
+    unsigned VF = std::min<unsigned>(maxVFFor(TTI, Bundle),
+                                     llvm::bit_floor(unsigned(Bundle.size())));
+    if (VF < 2)
+      continue;
+    double Scalar = 0;
+    for (unsigned Lane = 0; Lane < VF; ++Lane)
+      Scalar += cost(*Bundle[Lane]);
+    double Vector = vectorCost(*Bundle.front(), VF);
+    if (Vector < Scalar)
+      Saved += (Scalar - Vector) * frequency(*Bundle.front()->getParent());
+  }
+  return Saved;
+}
+
+// the latch branch, its compare and the induction updates run once per
+// unrolled iteration instead of once per original one
+double FunctionModel::unrollSaving(llvm::Loop *L) {
+  llvm::BasicBlock *Latch = L->getLoopLatch();
+  if (!Latch)
+    return 0;
+  llvm::Instruction *Term = Latch->getTerminator();
+  double Overhead = cost(*Term);
+  if (auto *Br = llvm::dyn_cast<llvm::BranchInst>(Term))
+    if (Br->isConditional())
+      if (auto *Cond = llvm::dyn_cast<llvm::Instruction>(Br->getCondition()))
+        if (L->contains(Cond))
+          Overhead += cost(*Cond);
+  for (llvm::PHINode &Phi : L->getHeader()->phis()) {
+    auto *Next = llvm::dyn_cast<llvm::BinaryOperator>(
+        Phi.getIncomingValueForBlock(Latch));
+    if (Next && L->contains(Next))
+      Overhead += cost(*Next);
+  }
+  return Overhead * (1 - 1 / AssumedUnrollFactor) * frequency(*L->getHeader());
+}
+
+llvm::CallBase *FunctionModel::callAt(const SourceLocation &Loc) {
+  for (llvm::Instruction *I : anchors(Loc)) {
+    auto *CB = llvm::dyn_cast<llvm::CallBase>(I);
+    if (CB && !llvm::isa<llvm::IntrinsicInst>(CB))
+      return CB;
+  }
+  return nullptr;
+}
+
+// the call itself, one move per argument and the return
+double FunctionModel::inlineSaving(llvm::CallBase *CB) {
+  return (cost(*CB) + CB->arg_size() + 1) * frequency(*CB->getParent());
+}
+
+// a hoisted instruction runs once per entry into its loop
+double FunctionModel::hoistSaving(llvm::ArrayRef<llvm::Instruction *> Anchors) {
+  double Saved = 0;
+  for (llvm::Instruction *I : Anchors) {
+    llvm::Loop *L = LI.getLoopFor(I->getParent());
+    if (!L || I->isTerminator() || llvm::isa<llvm::PHINode>(I))
+      continue;
+    Saved += cost(*I) * frequency(*I->getParent()) * (1 - 1 / tripCount(L));
+  }
+  return Saved;
+}
+
+double FunctionModel::loadSaving(llvm::ArrayRef<llvm::Instruction *> Anchors) {
+  double Saved = 0;
+  for (llvm::Instruction *I : Anchors)
+    if (llvm::isa<llvm::LoadInst>(I))
+      Saved += cost(*I) * frequency(*I->getParent());
+  return Saved;
+}
+
+std::optional<double> FunctionModel::saving(CostFamily Family,
+                                            const SourceLocation &Loc) {
+  llvm::SmallVector<llvm::Instruction *, 8> At = anchors(Loc);
+  if (At.empty())
+    return std::nullopt;
+  switch (Family) {
+  case CostFamily::LoopVectorize:
+    if (llvm::Loop *L = loopAt(Loc, At))
+      return vectorizeSaving(L);
+    return std::nullopt;
+  case CostFamily::SLPVectorize:
+    return slpSaving(At);
+  case CostFamily::Unroll:
+    if (llvm::Loop *L = loopAt(Loc, At))
+      return unrollSaving(L);
+    return std::nullopt;
+  case CostFamily::Inline:
+    if (llvm::CallBase *CB = callAt(Loc))
+      return inlineSaving(CB);
+    return std::nullopt;
+  case CostFamily::LICM:
+    return hoistSaving(At);
+  case CostFamily::GVN:
+    return loadSaving(At);
+  case CostFamily::None:
+    break;
+  }
+  return std::nullopt;
+}
+
+}
+
+void initializeTargets() {
+  static std::once_flag Initialized;
+  std::call_once(Initialized, [] {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmPrinters();
+    llvm::InitializeAllAsmParsers();
+  });
+}
+
+std::unique_ptr<llvm::TargetMachine> targetMachineFor(const llvm::Module &M) {
+  initializeTargets();
+  std::string TT = M.getTargetTriple();
+  std::string Error;
+  const llvm::Target *T =
+      TT.empty() ? nullptr : llvm::TargetRegistry::lookupTarget(TT, Error);
+  if (!T)
+    return nullptr;
+  return std::unique_ptr<llvm::TargetMachine>(
+      T->createTargetMachine(TT, "", "", llvm::TargetOptions(), {}));
+}
+
+void applyCostModel(llvm::Module &M,
+                    std::vector<DiagnosticResult> &Diagnostics) {
+  ProfileScope PS("CostModel");
+  std::unique_ptr<llvm::TargetMachine> TM;
+  std::optional<llvm::TargetLibraryInfoImpl> TLII;
+  llvm::StringMap<std::unique_ptr<FunctionModel>> Models;
+  auto ModelFor = [&](llvm::Function &F) -> FunctionModel & {
+    std::unique_ptr<FunctionModel> &Model = Models[F.getName()];
+    if (!Model)
+      Model = std::make_unique<FunctionModel>(F, TM.get(), *TLII);
+    return *Model;
+  };
+
+  for (DiagnosticResult &D : Diagnostics) {
+    CostFamily Family = familyFor(D.PassName);
+    if (Family == CostFamily::None || D.IsMachine || !D.Location.Line)
+      continue;
+    llvm::Function *F = M.getFunction(D.FunctionName);
+    if (!F || F->isDeclaration())
+      continue;
+
+    // the target and library info are only set up for modules with
+    // something to model
+    if (!TLII) {
+      TM = targetMachineFor(M);
+      TLII.emplace(llvm::Triple(M.getTargetTriple()));
+    }
+    FunctionModel &Model = ModelFor(*F);
+    std::optional<double> Saving = Model.saving(Family, D.Location);
+    if (!Saving)
+      continue;
+
+    // an inlined callee's body still runs, so the call's share of the time
+    // is the callee and the call overhead the saving removes
+    double Cycles = Model.cycles();
+    if (Family == CostFamily::Inline) {
+      llvm::CallBase *CB = Model.callAt(D.Location);
+      llvm::Function *Callee = CB->getCalledFunction();
+      if (Callee && !Callee->isDeclaration())
+        Cycles += ModelFor(*Callee).cycles() * Model.frequency(*CB->getParent());
+      Cycles += (CB->arg_size() + 1) * Model.frequency(*CB->getParent());
+    }
+    if (Cycles <= 0)
+      continue;
+
+    // a fix cannot save more than the whole function
+    double Saved = std::min(*Saving, Cycles * 0.99);
+    D.SpeedupModeled     = true;
+    D.ModeledCyclesSaved = std::max(Saved, 0.0);
+    D.EstimatedSpeedup   = D.ModeledCyclesSaved > 0
+                               ? Cycles / (Cycles - D.ModeledCyclesSaved)
+                               : 0.0;
+  }
+}
+
+}
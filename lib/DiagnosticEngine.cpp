@@ -1,58 +1,40 @@
 #include "OptDebugger/DiagnosticEngine.h"
+#include "OptDebugger/Baseline.h"
+#include "OptDebugger/PatternDB.h"
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 
 #include <algorithm>
-#include <regex>
-#include <sstream>
+#include <string_view>
 
 namespace optdbg {
 
 namespace {
 
 // constructs a generic fix suggestion payload with source-level modifications
-FixSuggestion makeFix(std::string Desc, std::string Code = "",
-                       bool SourceLevel = true, bool IRLevel = false) {
-  return FixSuggestion{std::move(Desc), std::move(Code), SourceLevel, IRLevel};
+constexpr PatternFix makeFix(llvm::StringRef Desc, llvm::StringRef Code = "",
+                             bool SourceLevel = true, bool IRLevel = false) {
+  return PatternFix{Desc, Code, SourceLevel, IRLevel};
 }
 
 // constructs an ir-specific targeted fix suggestion payload
-FixSuggestion makeIRFix(std::string Desc, std::string Code = "") {
-  return FixSuggestion{std::move(Desc), std::move(Code), false, true};
+constexpr PatternFix makeIRFix(llvm::StringRef Desc, llvm::StringRef Code = "") {
+  return PatternFix{Desc, Code, false, true};
 }
 
+// severity and speedup for remarks whose arguments satisfy Condition
+constexpr PatternAdjustment when(std::string_view Condition,
+                                 SeverityLevel Severity, double Speedup) {
+  return PatternAdjustment{PredicateProgram::compile(Condition), Severity,
+                           Speedup, true, true};
 }
 
-// initializes the engine and registers all internal diagnostic heuristics
-DiagnosticEngine::DiagnosticEngine() {
-  registerPatterns();
-}
-
-// orchestrates the registration of all independent pass-specific pattern databases
-void DiagnosticEngine::registerPatterns() {
-  registerInliningPatterns();
-  registerLoopVectorizationPatterns();
-  registerSLPVectorizationPatterns();
-  registerSROAPatterns();
-  registerLoopUnrollPatterns();
-  registerTailCallPatterns();
-  registerGVNPatterns();
-  registerMemCpyOptPatterns();
-  registerLoopInterchangePatterns();
-  registerLICMPatterns();
-  registerGenericPatterns();
-}
-
-void DiagnosticEngine::addPattern(OptimizationPattern P) {
-  if (P.PassNameSubstr.empty())
-    GenericPatterns.push_back(std::move(P));
-  else
-    SpecificPatterns[P.PassNameSubstr].push_back(std::move(P));
-}
-
-// populates failure heuristics specifically targeting the call-graph inlining phase
-void DiagnosticEngine::registerInliningPatterns() {
-  addPattern({
+// failure heuristics specifically targeting the call-graph inlining phase
+constexpr OptimizationPattern InliningPatterns[] = {
+  {
       "inline", "NotInlined", "too costly",
       "Inlining rejected: callee too large",
       "The inliner evaluated the cost of copying the callee's body into the "
@@ -68,18 +50,25 @@ void DiagnosticEngine::registerInliningPatterns() {
       {
         makeFix("Mark the function __attribute__((always_inline)) to force "
                 "inlining regardless of cost",
-                "__attribute__((always_inline)) int myFunc() { ... }"),
+                "__attribute__((always_inline)) int myFunc() { ... }")
+            .withEdit(FixEdit::AlwaysInline),
         makeFix("Split the callee into smaller helper functions so the hot "
                 "path is small enough to inline"),
         makeFix("Pass -mllvm -inline-threshold=500 (or higher) to raise the "
-                "inlining budget for this translation unit"),
+                "inlining budget for this translation unit")
+            .withEdit(FixEdit::RaiseInlineThreshold),
         makeIRFix("Add !llvm.inline.hint metadata to the call instruction",
                   "call i32 @foo() !llvm.inline.hint !{i32 1}"),
       },
-      SeverityLevel::High, 1.3
-  });
-
-  addPattern({
+      SeverityLevel::High, 1.3,
+      {
+        // a near miss is fixed by a hint; a callee many times over budget
+        // needs restructuring and rarely pays off
+        when("Cost / Threshold <= 1.1", SeverityLevel::Critical, 1.5),
+        when("Cost > 4 * Threshold", SeverityLevel::Medium, 1.05),
+      }
+  },
+  {
       "inline", "NotInlined", "recursive",
       "Inlining rejected: recursive function",
       "The inliner never inlines recursive functions because doing so could "
@@ -97,9 +86,8 @@ void DiagnosticEngine::registerInliningPatterns() {
                 "to the recursive version only for the general case"),
       },
       SeverityLevel::Medium, 0.0
-  });
-
-  addPattern({
+  },
+  {
       "inline", "NotInlined", "noinline",
       "Inlining rejected: noinline attribute present",
       "The function has the 'noinline' attribute set, which is an explicit "
@@ -112,17 +100,18 @@ void DiagnosticEngine::registerInliningPatterns() {
       {
         makeFix("Remove the __attribute__((noinline)) or [[gnu::noinline]] "
                 "annotation from the function declaration if it was added "
-                "by mistake or is no longer needed"),
+                "by mistake or is no longer needed")
+            .withEdit(FixEdit::RemoveNoInline),
         makeFix("If noinline was added for debugging, use a compilation flag "
                 "instead so you can easily toggle it"),
         makeIRFix("Remove the 'noinline' attribute from the function definition "
                   "in the IR",
-                  "define i32 @foo() { ... }  ; remove 'noinline' from attrs"),
+                  "define i32 @foo() { ... }  ; remove 'noinline' from attrs")
+            .withEdit(FixEdit::RemoveNoInline),
       },
       SeverityLevel::High, 1.25
-  });
-
-  addPattern({
+  },
+  {
       "inline", "NotInlined", "indirect call",
       "Inlining rejected: indirect call site",
       "The call is made through a function pointer or virtual dispatch, so "
@@ -145,9 +134,8 @@ void DiagnosticEngine::registerInliningPatterns() {
                   "call void %fp() !callees !{void ()* @concrete_impl}"),
       },
       SeverityLevel::High, 1.5
-  });
-
-  addPattern({
+  },
+  {
       "inline", "NotInlined", "unavailable definition",
       "Inlining rejected: callee definition not available",
       "The inliner cannot inline a function whose definition is in a "
@@ -168,12 +156,32 @@ void DiagnosticEngine::registerInliningPatterns() {
                 "the symbol is available across module boundaries"),
       },
       SeverityLevel::Medium, 1.4
-  });
-}
+  },
+  {
+      "inline", "NoDefinition", "",
+      "Inlining failed: No function definition available",
+      "The inliner cannot inline a function if its body is not available in "
+      "the current translation unit. This happens for functions defined in "
+      "other .cpp files or external libraries, unless Link Time Optimization "
+      "(LTO) is enabled.",
+      "The function body is missing in the current module.",
+      "The optimizer wanted to eliminate the call overhead by copying the "
+      "function body into the caller.",
+      {
+        makeFix("Enable Link Time Optimization (LTO) with -flto"),
+        makeFix("Move the function definition to a header or the same file"),
+      },
+      SeverityLevel::Medium, 1.3,
+      {
+        // C++ runtime and unwinder entry points are never available to LTO
+        when("Callee ~ '__cxa_' || Callee ~ '_Unwind_'", SeverityLevel::Info, 1.0),
+      }
+  },
+};
 
-// populates failure heuristics targeting single-loop autovectorization blocks
-void DiagnosticEngine::registerLoopVectorizationPatterns() {
-  addPattern({
+// failure heuristics targeting single-loop autovectorization blocks
+constexpr OptimizationPattern LoopVectorizationPatterns[] = {
+  {
       "loop-vectorize", "MissedDetails", "loop not vectorized",
       "Loop vectorization failed",
       "The Loop Vectorizer (LV) attempted to transform the scalar loop into "
@@ -189,21 +197,22 @@ void DiagnosticEngine::registerLoopVectorizationPatterns() {
       {
         makeFix("Add __restrict__ qualifiers to pointer parameters to eliminate "
                 "aliasing uncertainty",
-                "void f(float* __restrict__ a, float* __restrict__ b, int n)"),
+                "void f(float* __restrict__ a, float* __restrict__ b, int n)")
+            .withEdit(FixEdit::NoAliasArguments),
         makeFix("Annotate the loop with #pragma clang loop vectorize(enable) "
                 "to force vectorization with safety checks",
                 "#pragma clang loop vectorize(enable)\nfor(int i=0;i<n;++i)..."),
         makeFix("Ensure the loop has a simple induction variable and no early "
                 "exits (break/continue) inside the body"),
         makeFix("Remove any function calls from the loop body that have unknown "
-                "side effects; consider marking them with __attribute__((const))"),
+                "side effects; consider marking them with __attribute__((const))")
+            .withEdit(FixEdit::ReadNoneCallees),
         makeIRFix("Add !llvm.loop metadata with vectorize.enable=true",
                   "br i1 %cond, label %loop, label %exit, !llvm.loop !{!{!\"llvm.loop.vectorize.enable\", i1 true}}"),
       },
       SeverityLevel::High, 4.0
-  });
-
-  addPattern({
+  },
+  {
       "loop-vectorize", "", "cannot identify array bounds",
       "Loop vectorization blocked: unknown array bounds",
       "The vectorizer requires knowledge of the loop trip count at the point "
@@ -225,9 +234,8 @@ void DiagnosticEngine::registerLoopVectorizationPatterns() {
                 "size information"),
       },
       SeverityLevel::High, 4.0
-  });
-
-  addPattern({
+  },
+  {
       "loop-vectorize", "", "unsafe dependent memory operations",
       "Loop vectorization blocked: memory dependency / aliasing",
       "The Loop Access Analysis (LAA) detected or could not disprove a "
@@ -242,7 +250,8 @@ void DiagnosticEngine::registerLoopVectorizationPatterns() {
       {
         makeFix("If you know the arrays do not alias, add __restrict__ to all "
                 "pointer parameters",
-                "void f(int* __restrict__ out, const int* __restrict__ in, int n)"),
+                "void f(int* __restrict__ out, const int* __restrict__ in, int n)")
+            .withEdit(FixEdit::NoAliasArguments),
         makeFix("Add #pragma clang loop vectorize(assume_safety) to assert "
                 "there are no dependencies (only safe if you know this is true)",
                 "#pragma clang loop vectorize(assume_safety)"),
@@ -250,12 +259,12 @@ void DiagnosticEngine::registerLoopVectorizationPatterns() {
                 "a[i] = a[i-1] + c), consider restructuring the loop to use "
                 "a temporary buffer, or accept that the loop cannot be vectorized"),
         makeIRFix("Add !alias.scope and !noalias metadata to loads/stores "
-                  "to provide aliasing proof to the backend"),
+                  "to provide aliasing proof to the backend")
+            .withEdit(FixEdit::NoAliasArguments),
       },
       SeverityLevel::Critical, 4.0
-  });
-
-  addPattern({
+  },
+  {
       "loop-vectorize", "", "value that could not be identified as reduction",
       "Loop vectorization blocked: non-reducible accumulator",
       "The vectorizer recognizes a limited set of reduction patterns: sum, "
@@ -276,9 +285,8 @@ void DiagnosticEngine::registerLoopVectorizationPatterns() {
                 "a single reduction variable"),
       },
       SeverityLevel::Medium, 3.0
-  });
-
-  addPattern({
+  },
+  {
       "loop-vectorize", "", "call instruction cannot be vectorized",
       "Loop vectorization blocked: non-vectorizable function call",
       "A function call inside the loop body prevents vectorization. To "
@@ -298,17 +306,39 @@ void DiagnosticEngine::registerLoopVectorizationPatterns() {
                 "#pragma omp declare simd\nfloat myFunc(float x);"),
         makeFix("If the function has no side effects, mark it "
                 "__attribute__((const)) or __attribute__((pure)) to allow "
-                "LLVM to treat it as a math function"),
+                "LLVM to treat it as a math function")
+            .withEdit(FixEdit::ReadNoneCallees),
         makeFix("Manually vectorize the call site by extracting loop body "
                 "into a SIMD function using SIMD intrinsics or Eigen/xsimd"),
       },
       SeverityLevel::High, 3.5
-  });
-}
+  },
+  {
+      "loop-vectorize", "", "Cannot vectorize potentially faulting early exit loop",
+      "Loop Vectorization failed: Non-canonical early exit",
+      "The loop contains a conditional 'break', 'return', or 'goto' that "
+      "exits the loop before the induction variable reaches its end. Most "
+      "SIMD lanes cannot easily handle unpredictable exits without specialized "
+      "predication support. This forces the optimizer to fall back to scalar "
+      "execution to ensure correctness and avoid faults.",
+      "An 'early exit' branch inside the loop body blocks vectorization.",
+      "The vectorizer wanted to process multiple iterations in parallel, but "
+      "cannot guarantee safety when iterations might stop prematurely.",
+      {
+        makeFix("Restructure the loop to avoid early exits; use a boolean flag "
+                "or sentinel value and process it after the loop if possible"),
+        makeFix("If using C++20, consider using algorithms like std::find_if "
+                "which may have internal optimizations for such patterns"),
+        makeFix("Try to hoist the early-exit check if it depends on data "
+                "invariant to the loop"),
+      },
+      SeverityLevel::High, 3.5
+  },
+};
 
-// populates failure heuristics targeting straight-line instruction vectorization
-void DiagnosticEngine::registerSLPVectorizationPatterns() {
-  addPattern({
+// failure heuristics targeting straight-line instruction vectorization
+constexpr OptimizationPattern SLPVectorizationPatterns[] = {
+  {
       "slp-vectorizer", "NotVectorized", "",
       "SLP vectorization failed",
       "The Superword-Level Parallelism (SLP) vectorizer looks for independent "
@@ -332,13 +362,18 @@ void DiagnosticEngine::registerSLPVectorizationPatterns() {
         makeFix("Use #pragma clang loop unroll(full) on small loops to expose "
                 "more SLP opportunities to the vectorizer"),
       },
-      SeverityLevel::Medium, 2.0
-  });
-}
+      SeverityLevel::Medium, 2.0,
+      {
+        // the vectorizer reports its cost against the (misspelled) Treshold
+        when("Cost - Treshold <= 1", SeverityLevel::High, 2.0),
+        when("Cost - Treshold >= 10", SeverityLevel::Low, 1.1),
+      }
+  },
+};
 
-// populates failure heuristics targeting scalar-replacement-of-aggregates optimizations
-void DiagnosticEngine::registerSROAPatterns() {
-  addPattern({
+// failure heuristics targeting scalar-replacement-of-aggregates optimizations
+constexpr OptimizationPattern SROAPatterns[] = {
+  {
       "sroa", "CannotSROAElement", "",
       "SROA failed: aggregate cannot be decomposed",
       "Scalar Replacement of Aggregates (SROA) decomposes alloca'd struct or "
@@ -364,9 +399,8 @@ void DiagnosticEngine::registerSROAPatterns() {
                   "blocks SROA"),
       },
       SeverityLevel::High, 1.5
-  });
-
-  addPattern({
+  },
+  {
       "sroa", "", "address taken",
       "SROA failed: address of local variable is taken",
       "When a local variable's address is taken (e.g., '&localVar'), LLVM "
@@ -386,12 +420,12 @@ void DiagnosticEngine::registerSROAPatterns() {
                 "using std::optional<T> / std::tuple<T,U> instead of T*"),
       },
       SeverityLevel::Medium, 1.4
-  });
-}
+  },
+};
 
-// populates failure heuristics targeting loop unrolling and interleaving passes
-void DiagnosticEngine::registerLoopUnrollPatterns() {
-  addPattern({
+// failure heuristics targeting loop unrolling and interleaving passes
+constexpr OptimizationPattern LoopUnrollPatterns[] = {
+  {
       "loop-unroll", "FullUnrollAssumed", "unknown trip count",
       "Loop unrolling skipped: trip count not statically known",
       "Full loop unrolling requires the loop to execute a fixed, statically "
@@ -414,9 +448,8 @@ void DiagnosticEngine::registerLoopUnrollPatterns() {
                 "#pragma clang loop unroll_count(4)\nfor(int i=0; i<n; ++i)..."),
       },
       SeverityLevel::Low, 1.15
-  });
-
-  addPattern({
+  },
+  {
       "loop-unroll", "", "instruction count too high",
       "Loop unrolling rejected: code size would be too large",
       "LLVM's loop unroller uses a cost model to estimate the instruction "
@@ -437,12 +470,12 @@ void DiagnosticEngine::registerLoopUnrollPatterns() {
                 "unroll factor globally"),
       },
       SeverityLevel::Low, 1.1
-  });
-}
+  },
+};
 
-// populates failure heuristics targeting tail/sibling call eliminations
-void DiagnosticEngine::registerTailCallPatterns() {
-  addPattern({
+// failure heuristics targeting tail/sibling call eliminations
+constexpr OptimizationPattern TailCallPatterns[] = {
+  {
       "tailcallelim", "UnableToTransform", "",
       "Tail call elimination failed",
       "Tail call elimination (TCE) converts a recursive call in tail position "
@@ -468,12 +501,12 @@ void DiagnosticEngine::registerTailCallPatterns() {
                 "TCE cannot be applied rather than silent fallback"),
       },
       SeverityLevel::Medium, 1.3
-  });
-}
+  },
+};
 
-// populates failure heuristics targeting global value numbering redundancy elimination
-void DiagnosticEngine::registerGVNPatterns() {
-  addPattern({
+// failure heuristics targeting global value numbering redundancy elimination
+constexpr OptimizationPattern GVNPatterns[] = {
+  {
       "gvn", "LoadElim", "",
       "GVN failed to eliminate redundant load",
       "Global Value Numbering (GVN) eliminates redundant loads by proving "
@@ -490,17 +523,41 @@ void DiagnosticEngine::registerGVNPatterns() {
                 "redundancy syntactically obvious",
                 "int v = *ptr;  use(v); use(v);  // instead of use(*ptr); use(*ptr)"),
         makeFix("Mark functions that don't modify memory as __attribute__((pure)) "
-                "or __attribute__((const)) to prevent them from blocking GVN"),
+                "or __attribute__((const)) to prevent them from blocking GVN")
+            .withEdit(FixEdit::ReadNoneCallees),
         makeFix("Use __restrict__ on pointers to allow alias analysis to "
-                "prove the locations don't overlap"),
+                "prove the locations don't overlap")
+            .withEdit(FixEdit::NoAliasArguments),
       },
       SeverityLevel::Medium, 1.2
-  });
-}
+  },
+  {
+      "gvn", "LoadClobbered", "",
+      "Global Value Numbering failed: load clobbered by store",
+      "The optimizer found a load that could potentially be replaced by a "
+      "previous value (redundant load elimination), but it found a store "
+      "instruction that might modify the memory location between the source "
+      "and the load. This is often caused by pointer aliasing uncertainty.",
+      "A store instruction clobbers the memory location of a load, preventing "
+      "redundant load elimination.",
+      "The optimizer wanted to eliminate the load instruction and reuse a "
+      "value already in a register.",
+      {
+        makeFix("Use __restrict__ if you know the store does not affect the load's pointer")
+            .withEdit(FixEdit::NoAliasArguments),
+        makeFix("Hoists the load before the store if they are independent"),
+      },
+      SeverityLevel::Medium, 1.2,
+      {
+        // an opaque call clobbers everything; restrict does not help
+        when("ClobberedBy ~ 'call'", SeverityLevel::Low, 1.1),
+      }
+  },
+};
 
-// populates failure heuristics targeting implicit memcpy instantiation passes
-void DiagnosticEngine::registerMemCpyOptPatterns() {
-  addPattern({
+// failure heuristics targeting implicit memcpy instantiation passes
+constexpr OptimizationPattern MemCpyOptPatterns[] = {
+  {
       "memcpyopt", "", "",
       "MemCpyOpt failed to optimize memory copy",
       "MemCpyOpt looks for patterns like a series of scalar stores followed "
@@ -514,19 +571,57 @@ void DiagnosticEngine::registerMemCpyOptPatterns() {
       "The optimizer wanted to merge or eliminate memory copy operations "
       "to reduce unnecessary data movement.",
       {
-        makeFix("Use __restrict__ on pointers to enable aliasing proof"),
+        makeFix("Use __restrict__ on pointers to enable aliasing proof")
+            .withEdit(FixEdit::NoAliasArguments),
         makeFix("Ensure struct copies use value assignment (a = b) rather than "
                 "byte-level memcpy for better optimization opportunities"),
         makeFix("Pass destination buffers directly to the producer instead of "
                 "using an intermediate buffer"),
       },
       SeverityLevel::Low, 1.1
-  });
-}
+  },
+};
+
+// register pressure reported by the greedy allocator, one remark per loop
+// that needed stack slots; only present when the codegen stage ran
+constexpr OptimizationPattern RegAllocPatterns[] = {
+  {
+      "regalloc", "LoopSpillReloadCopies", "",
+      "Register allocation spilled values in a loop",
+      "The register allocator maps the unlimited virtual registers of the "
+      "optimized code onto the target's physical registers. When more values "
+      "are live at once than there are registers, some are stored to the "
+      "stack (spills) and loaded back before their next use (reloads). This "
+      "loop needed {NumSpills} spills and {NumReloads} reloads, plus "
+      "{NumFoldedReloads} reloads folded into other instructions, each "
+      "executed on every iteration that reaches them.",
+      "More values are live across the loop body than the target has "
+      "registers, often after unrolling, vectorization or hoisting made many "
+      "temporaries live at the same time.",
+      "The allocator wanted to keep every value of the loop in a register so "
+      "the body runs without stack traffic.",
+      {
+        makeFix("Split the loop body so each loop keeps fewer values live "
+                "(loop fission)"),
+        makeFix("Lower the unroll or interleave count of the loop to shorten "
+                "live ranges",
+                "#pragma clang loop unroll_count(2) interleave_count(1)"),
+        makeFix("Recompute cheap values inside the loop instead of keeping "
+                "them live across it"),
+        makeFix("Target a CPU with more vector registers (e.g. AVX-512 has 32) "
+                "when the loop is vectorized"),
+      },
+      SeverityLevel::Medium, 1.2,
+      {
+        when("NumSpills + NumReloads >= 8", SeverityLevel::High, 1.4),
+        when("NumSpills + NumReloads <= 1", SeverityLevel::Low, 1.05),
+      }
+  },
+};
 
-// populates failure heuristics targeting complex loop interchange matrix optimizations
-void DiagnosticEngine::registerLoopInterchangePatterns() {
-  addPattern({
+// failure heuristics targeting complex loop interchange matrix optimizations
+constexpr OptimizationPattern LoopInterchangePatterns[] = {
+  {
       "loop-interchange", "", "",
       "Loop interchange failed",
       "Loop interchange reorders nested loops to improve memory locality "
@@ -549,12 +644,52 @@ void DiagnosticEngine::registerLoopInterchangePatterns() {
                 "loop iterates over the last index"),
       },
       SeverityLevel::Medium, 2.0
-  });
-}
+  },
+};
 
-// populates generalized failure heuristics that apply across multiple common llvm passes
-void DiagnosticEngine::registerGenericPatterns() {
-  addPattern({
+// failure heuristics targeting loop invariant code motion
+constexpr OptimizationPattern LICMPatterns[] = {
+  {
+      "licm", "LoadWithLoopInvariantAddressInvalidated", "",
+      "LICM failed: Loop-invariant load invalidated",
+      "Loop Invariant Code Motion (LICM) found a load from a constant address, "
+      "but it cannot safely move it out of the loop because another store inside "
+      "the loop might modify that same memory location. This is often caused "
+      "by pointer aliasing.",
+      "A store in the loop body potentially clobbers the loop-invariant memory location.",
+      "The optimizer wanted to hoist the load out of the loop to avoid "
+      "repeated memory accesses in every iteration.",
+      {
+        makeFix("Use __restrict__ on pointers to prove the store does not alias with the load")
+            .withEdit(FixEdit::NoAliasArguments),
+        makeFix("Ensure that the loop does not contain any instructions that could modify relevant state"),
+      },
+      SeverityLevel::Medium, 1.2
+  },
+  {
+      "licm", "", "failed to sink or hoist",
+      "LICM failed: Hoisting/Sinking blocked",
+      "Loop Invariant Code Motion (LICM) failed to move an instruction "
+      "out of the loop because of potential aliasing or side effects. "
+      "If an instruction might trap or has unknown memory dependencies, "
+      "it must remain inside the loop to preserve program semantics.",
+      "Instruction has side effects or aliasing prevents safe hoisting.",
+      "The optimizer wanted to move this redundant calculation out of the "
+      "loop body to run it only once per loop entry.",
+      {
+        makeFix("Mark functions called in the loop as 'pure' or 'const'")
+            .withEdit(FixEdit::ReadNoneCallees),
+        makeFix("Use __restrict__ on pointers to prove they don't alias with "
+                "the invariant memory location")
+            .withEdit(FixEdit::NoAliasArguments),
+      },
+      SeverityLevel::Medium, 1.2
+  },
+};
+
+// failure heuristics that apply to remarks from any pass
+constexpr OptimizationPattern GenericPatterns[] = {
+  {
       "", "NeverInline", "",
       "Optimization blocked by attribute",
       "An explicit attribute on the function or call site is preventing "
@@ -569,9 +704,8 @@ void DiagnosticEngine::registerGenericPatterns() {
                 "if it was added for debugging or as a temporary workaround"),
       },
       SeverityLevel::High, 1.2
-  });
-
-  addPattern({
+  },
+  {
       "", "", "optnone",
       "Optimization skipped: optnone function",
       "The function was compiled with -O0 or has the __attribute__((optnone)) "
@@ -588,74 +722,85 @@ void DiagnosticEngine::registerGenericPatterns() {
                 "functions while still allowing optimization of the function body"),
       },
       SeverityLevel::Critical, 2.0
-  });
+  },
+};
 
-  addPattern({
-      "gvn", "LoadClobbered", "",
-      "Global Value Numbering failed: load clobbered by store",
-      "The optimizer found a load that could potentially be replaced by a "
-      "previous value (redundant load elimination), but it found a store "
-      "instruction that might modify the memory location between the source "
-      "and the load. This is often caused by pointer aliasing uncertainty.",
-      "A store instruction clobbers the memory location of a load, preventing "
-      "redundant load elimination.",
-      "The optimizer wanted to eliminate the load instruction and reuse a "
-      "value already in a register.",
-      {
-        makeFix("Use __restrict__ if you know the store does not affect the load's pointer"),
-        makeFix("Hoists the load before the store if they are independent"),
-      },
-      SeverityLevel::Medium, 1.2
-  });
+// pass-specific patterns bucketed by the pass they match, sorted by pass
+// name; a bucket keeps the order its patterns were written in, which breaks
+// ties between equally scored matches
+struct PatternBucket {
+  std::string_view                    Pass;
+  llvm::ArrayRef<OptimizationPattern> Patterns;
+};
 
-  addPattern({
-      "loop-vectorize", "", "Cannot vectorize potentially faulting early exit loop",
-      "Loop Vectorization failed: Non-canonical early exit",
-      "The loop contains a conditional 'break', 'return', or 'goto' that "
-      "exits the loop before the induction variable reaches its end. Most "
-      "SIMD lanes cannot easily handle unpredictable exits without specialized "
-      "predication support. This forces the optimizer to fall back to scalar "
-      "execution to ensure correctness and avoid faults.",
-      "An 'early exit' branch inside the loop body blocks vectorization.",
-      "The vectorizer wanted to process multiple iterations in parallel, but "
-      "cannot guarantee safety when iterations might stop prematurely.",
-      {
-        makeFix("Restructure the loop to avoid early exits; use a boolean flag "
-                "or sentinel value and process it after the loop if possible"),
-        makeFix("If using C++20, consider using algorithms like std::find_if "
-                "which may have internal optimizations for such patterns"),
-        makeFix("Try to hoist the early-exit check if it depends on data "
-                "invariant to the loop"),
-      },
-      SeverityLevel::High, 3.5
-  });
+constexpr PatternBucket PassBuckets[] = {
+    {"gvn", GVNPatterns},
+    {"inline", InliningPatterns},
+    {"licm", LICMPatterns},
+    {"loop-interchange", LoopInterchangePatterns},
+    {"loop-unroll", LoopUnrollPatterns},
+    {"loop-vectorize", LoopVectorizationPatterns},
+    {"memcpyopt", MemCpyOptPatterns},
+    {"regalloc", RegAllocPatterns},
+    {"slp-vectorizer", SLPVectorizationPatterns},
+    {"sroa", SROAPatterns},
+    {"tailcallelim", TailCallPatterns},
+};
 
-  addPattern({
-      "inline", "NoDefinition", "",
-      "Inlining failed: No function definition available",
-      "The inliner cannot inline a function if its body is not available in "
-      "the current translation unit. This happens for functions defined in "
-      "other .cpp files or external libraries, unless Link Time Optimization "
-      "(LTO) is enabled.",
-      "The function body is missing in the current module.",
-      "The optimizer wanted to eliminate the call overhead by copying the "
-      "function body into the caller.",
-      {
-        makeFix("Enable Link Time Optimization (LTO) with -flto"),
-        makeFix("Move the function definition to a header or the same file"),
-      },
-      SeverityLevel::Medium, 1.3
-  });
+constexpr bool bucketsAreSorted() {
+  for (size_t I = 1; I < std::size(PassBuckets); ++I)
+    if (!(PassBuckets[I - 1].Pass < PassBuckets[I].Pass))
+      return false;
+  return true;
 }
+static_assert(bucketsAreSorted(), "PassBuckets must be sorted by pass name");
 
-// executes an o(n) heuristic search against the registered pattern database to classify a raw remark
+template <size_t N>
+constexpr bool patternsAreValid(const OptimizationPattern (&Patterns)[N]) {
+  for (const OptimizationPattern &P : Patterns) {
+    if (!P.Where.valid() || P.DetailedExplanation.Truncated ||
+        P.RootCause.Truncated || P.WhatOptimizerWanted.Truncated)
+      return false;
+    for (size_t I = 0; I < P.NumAdjustments; ++I)
+      if (!P.Adjustments[I].Condition.valid())
+        return false;
+  }
+  return true;
+}
+static_assert(patternsAreValid(InliningPatterns) &&
+              patternsAreValid(LoopVectorizationPatterns) &&
+              patternsAreValid(SLPVectorizationPatterns) &&
+              patternsAreValid(SROAPatterns) &&
+              patternsAreValid(LoopUnrollPatterns) &&
+              patternsAreValid(TailCallPatterns) &&
+              patternsAreValid(GVNPatterns) &&
+              patternsAreValid(MemCpyOptPatterns) &&
+              patternsAreValid(RegAllocPatterns) &&
+              patternsAreValid(LoopInterchangePatterns) &&
+              patternsAreValid(LICMPatterns) &&
+              patternsAreValid(GenericPatterns),
+              "a built-in pattern has a malformed condition or too many placeholders");
+
+const PatternBucket *findBucket(llvm::StringRef PassName) {
+  std::string_view Name(PassName.data(), PassName.size());
+  const PatternBucket *It = std::lower_bound(
+      std::begin(PassBuckets), std::end(PassBuckets), Name,
+      [](const PatternBucket &B, std::string_view N) { return B.Pass < N; });
+  if (It == std::end(PassBuckets) || It->Pass != Name)
+    return nullptr;
+  return It;
+}
+
+}
+
+// scores the generic patterns and the bucket for the remark's pass to classify a raw remark
 const OptimizationPattern *
-DiagnosticEngine::findMatchingPattern(const Remark &R) const {
+DiagnosticEngine::findMatchingPattern(const Remark &R, int &BestScore) const {
   const OptimizationPattern *Best = nullptr;
-  int BestScore = -1;
+  BestScore = -1;
 
-  auto searchIn = [&](const std::vector<OptimizationPattern> &Vec) {
-    for (const auto &P : Vec) {
+  auto searchIn = [&](llvm::ArrayRef<OptimizationPattern> Patterns) {
+    for (const auto &P : Patterns) {
       int Score = 0;
 
       if (!P.PassNameSubstr.empty()) {
@@ -676,6 +821,12 @@ DiagnosticEngine::findMatchingPattern(const Remark &R) const {
         Score += 4;
       }
 
+      if (!P.Where.empty()) {
+        if (!P.Where.evaluate(R))
+          continue;
+        Score += 1;
+      }
+
       if (Score > BestScore) {
         BestScore = Score;
         Best = &P;
@@ -686,45 +837,47 @@ DiagnosticEngine::findMatchingPattern(const Remark &R) const {
   // 1. search generic patterns that apply to all passes
   searchIn(GenericPatterns);
 
-  // 2. search pass-specific patterns. 
-  // we optimize by only looking at patterns registered for this specific pass name.
-  auto It = SpecificPatterns.find(R.PassName);
-  if (It != SpecificPatterns.end()) {
-    searchIn(It->second);
+  // 2. search the bucket registered for exactly this pass name
+  if (const PatternBucket *Bucket = findBucket(R.PassName)) {
+    searchIn(Bucket->Patterns);
   } else {
-    // 3. fallback: check if any SpecificPatterns key is a substring of the remark pass name
+    // 3. fallback: check if any bucket's pass is a substring of the remark pass name
     // this handles cases where the pattern key is e.g. "inline" but the remark pass is "always-inline"
-    for (const auto &Entry : SpecificPatterns) {
-      if (matchesPattern(R.PassName, Entry.first())) {
-        searchIn(Entry.second);
-      }
+    for (const PatternBucket &B : PassBuckets) {
+      if (matchesPattern(R.PassName, llvm::StringRef(B.Pass.data(), B.Pass.size())))
+        searchIn(B.Patterns);
     }
   }
 
   return Best;
 }
 
-// interpolates dynamic arguments from the ir string directly into the heuristic template string
-std::string DiagnosticEngine::interpolateArgs(const std::string &Template,
-                                               const Remark      &R) {
-  std::string Result = Template;
-
-  for (const RemarkArgument &Arg : R.Args) {
-    std::string Placeholder = "{" + Arg.Key + "}";
-    size_t Pos = Result.find(Placeholder);
-    while (Pos != std::string::npos) {
-      Result.replace(Pos, Placeholder.size(), Arg.Value);
-      Pos = Result.find(Placeholder, Pos + Arg.Value.size());
-    }
-  }
-
-  size_t FnPos = Result.find("{FunctionName}");
-  while (FnPos != std::string::npos) {
-    Result.replace(FnPos, 14, R.FunctionName);
-    FnPos = Result.find("{FunctionName}", FnPos + R.FunctionName.size());
+// substitutes placeholders left to right; the first argument with a key
+// wins, and an argument named FunctionName shadows the function name
+void PatternTemplate::render(const Remark &R, std::string &Out) const {
+  Out.reserve(Out.size() + Text.size());
+  size_t Pos = 0;
+  for (const Placeholder &P : llvm::ArrayRef(Placeholders, NumPlaceholders)) {
+    Out.append(Text.data() + Pos, P.Offset - Pos);
+    llvm::StringRef Key = Text.substr(P.Offset + 1, P.Length - 2);
+    auto Arg = llvm::find_if(R.Args, [&](const RemarkArgument &A) {
+      return A.Key == Key;
+    });
+    if (Arg != R.Args.end())
+      Out += Arg->Value;
+    else if (Key == "FunctionName")
+      Out += R.FunctionName;
+    else
+      Out.append(Text.data() + P.Offset, P.Length);
+    Pos = P.Offset + P.Length;
   }
+  Out.append(Text.data() + Pos, Text.size() - Pos);
+}
 
-  return Result;
+std::string PatternTemplate::render(const Remark &R) const {
+  std::string Out;
+  render(R, Out);
+  return Out;
 }
 
 // constructs a structured diagnostic object by combining a raw remark with its matched pattern
@@ -732,17 +885,30 @@ DiagnosticResult
 DiagnosticEngine::buildFromPattern(const Remark              &R,
                                     const OptimizationPattern &P) const {
   DiagnosticResult DR;
+  DR.RuleID            = P.ruleID().str();
   DR.PassName          = R.PassName;
   DR.FunctionName      = R.FunctionName;
   DR.Location          = R.Loc;
-  DR.ShortReason       = P.ShortReason;
-  DR.DetailedExplanation = interpolateArgs(P.DetailedExplanation, R);
-  DR.RootCause         = interpolateArgs(P.RootCause, R);
-  DR.WhatOptimizerWanted = interpolateArgs(P.WhatOptimizerWanted, R);
-  DR.Suggestions       = P.Suggestions;
+  DR.ShortReason       = P.ShortReason.str();
+  DR.DetailedExplanation = P.DetailedExplanation.render(R);
+  DR.RootCause         = P.RootCause.render(R);
+  DR.WhatOptimizerWanted = P.WhatOptimizerWanted.render(R);
+  DR.Suggestions.reserve(P.NumFixes);
+  for (const PatternFix &F : P.suggestions())
+    DR.Suggestions.push_back({F.Description.str(), F.CodeExample.str(),
+                              F.IsSourceLevel, F.IsIRLevel, F.Edit});
   DR.Severity          = P.Severity;
   DR.EstimatedSpeedup  = P.EstimatedSpeedup;
   DR.IsMachine         = R.IsMachine;
+  for (const PatternAdjustment &A : P.adjustments()) {
+    if (!A.Condition.evaluate(R))
+      continue;
+    if (A.HasSeverity)
+      DR.Severity = A.Severity;
+    if (A.HasSpeedup)
+      DR.EstimatedSpeedup = A.EstimatedSpeedup;
+    break;
+  }
   return DR;
 }
 
@@ -750,6 +916,7 @@ DiagnosticEngine::buildFromPattern(const Remark              &R,
 DiagnosticResult
 DiagnosticEngine::buildFallback(const Remark &R) const {
   DiagnosticResult DR;
+  DR.RuleID      = "fallback/" + R.PassName + "/" + R.RemarkName;
   DR.PassName    = R.PassName;
   DR.FunctionName = R.FunctionName;
   DR.Location    = R.Loc;
@@ -769,83 +936,126 @@ DiagnosticEngine::buildFallback(const Remark &R) const {
   return DR;
 }
 
+// the built-in pattern whose rule id this is, if any
+static const OptimizationPattern *findBuiltinRule(llvm::StringRef RuleID) {
+  auto findIn = [&](llvm::ArrayRef<OptimizationPattern> Patterns)
+      -> const OptimizationPattern * {
+    for (const OptimizationPattern &P : Patterns)
+      if (P.ruleID() == RuleID)
+        return &P;
+    return nullptr;
+  };
+  if (const OptimizationPattern *P = findIn(GenericPatterns))
+    return P;
+  for (const PatternBucket &B : PassBuckets)
+    if (const OptimizationPattern *P = findIn(B.Patterns))
+      return P;
+  return nullptr;
+}
+
+RuleDescription
+DiagnosticEngine::describeRule(const DiagnosticResult &D) const {
+  auto fromPattern = [](const OptimizationPattern &P) {
+    return RuleDescription{P.ShortReason.str(), P.DetailedExplanation.Text.str(),
+                           P.WhatOptimizerWanted.Text.str(), P.Severity};
+  };
+  if (UserPatterns)
+    if (std::optional<uint32_t> Id = UserPatterns->findRule(D.RuleID))
+      return fromPattern(UserPatterns->pattern(*Id));
+  if (const OptimizationPattern *P = findBuiltinRule(D.RuleID))
+    return fromPattern(*P);
+
+  // fallback/<pass>/<remark>, or a user rule whose patterns are not loaded
+  RuleDescription Rule;
+  Rule.ShortDescription = D.ShortReason;
+  Rule.FullDescription =
+      "Pass '" + D.PassName + "' reported a missed optimization that no "
+      "loaded pattern explains. Each result carries the raw message from the "
+      "pass.";
+  Rule.WhatOptimizerWanted = "The " + D.PassName + " pass attempted a "
+                             "transformation that was blocked by a precondition.";
+  return Rule;
+}
+
 // processes a single optimization remark through the primary heuristic matching engine
 DiagnosticResult
 DiagnosticEngine::analyzeRemark(const Remark &R) const {
-  const OptimizationPattern *P = findMatchingPattern(R);
-  if (P)
-    return buildFromPattern(R, *P);
-  return buildFallback(R);
+  int Score;
+  const OptimizationPattern *P = findMatchingPattern(R, Score);
+  std::optional<DiagnosticResult> DR;
+  if (UserPatterns) {
+    int UserScore;
+    if (std::optional<uint32_t> Id = UserPatterns->match(R, UserScore))
+      if (UserScore >= Score)
+        DR = buildFromPattern(R, UserPatterns->pattern(*Id));
+  }
+  if (!DR)
+    DR = P ? buildFromPattern(R, *P) : buildFallback(R);
+  DR->Hotness = R.Hotness;
+  return std::move(*DR);
+}
+
+// a single remark's diagnostic with its function's diff attached
+DiagnosticResult
+DiagnosticEngine::analyzeRemark(const Remark     &R,
+                                const ModuleDiff &Diff) const {
+  DiagnosticResult DR = analyzeRemark(R);
+  for (const auto &FD : Diff.Functions)
+    if (FD->FunctionName == R.FunctionName) {
+      DR.IRDiff = FD;
+      break;
+    }
+  return DR;
 }
 
 // aggregates and orchestrates the analysis of all remarks, correlating them with structural ir diffs
 std::vector<DiagnosticResult>
 DiagnosticEngine::analyze(const std::vector<Remark> &Remarks,
-                           const ModuleDiff          &Diff) const {
-  llvm::StringMap<const FunctionDiff*> DiffMap;
-  for (const FunctionDiff &FD : Diff.Functions)
-    DiffMap[FD.FunctionName] = &FD;
+                           const ModuleDiff          &Diff,
+                           unsigned                  *NumSuppressed) const {
+  // diagnostics share the module diff's own entry for their function
+  llvm::StringMap<std::shared_ptr<const FunctionDiff>> DiffMap;
+  for (const auto &FD : Diff.Functions)
+    DiffMap[FD->FunctionName] = FD;
 
   std::vector<DiagnosticResult> Results;
   Results.reserve(Remarks.size());
 
+  // a fingerprint recorded N times suppresses at most N diagnostics
+  llvm::DenseMap<uint64_t, unsigned> BaselineUsed;
+  unsigned Suppressed = 0;
   for (const auto &R : Remarks) {
     if (R.Kind == RemarkKind::Applied)
       continue;
+    if (Baseline) {
+      uint64_t FP = DiagnosticBaseline::fingerprint(R);
+      unsigned &Used = BaselineUsed[FP];
+      if (Used < Baseline->count(FP)) {
+        ++Used;
+        ++Suppressed;
+        continue;
+      }
+    }
     
     DiagnosticResult DR = analyzeRemark(R);
     auto It = DiffMap.find(R.FunctionName);
     if (It != DiffMap.end())
-      DR.IRDiff = *It->second;
+      DR.IRDiff = It->second;
     
     Results.push_back(std::move(DR));
   }
+  if (NumSuppressed)
+    *NumSuppressed = Suppressed;
 
-
-  std::stable_sort(Results.begin(), Results.end(),
-                   [](const DiagnosticResult &A, const DiagnosticResult &B) {
-                     return static_cast<int>(A.Severity) <
-                            static_cast<int>(B.Severity);
-                   });
+  std::stable_sort(Results.begin(), Results.end(), ranksBefore);
 
   return Results;
 }
 
-void DiagnosticEngine::registerLICMPatterns() {
-  addPattern({
-      "licm", "LoadWithLoopInvariantAddressInvalidated", "",
-      "LICM failed: Loop-invariant load invalidated",
-      "Loop Invariant Code Motion (LICM) found a load from a constant address, "
-      "but it cannot safely move it out of the loop because another store inside "
-      "the loop might modify that same memory location. This is often caused "
-      "by pointer aliasing.",
-      "A store in the loop body potentially clobbers the loop-invariant memory location.",
-      "The optimizer wanted to hoist the load out of the loop to avoid "
-      "repeated memory accesses in every iteration.",
-      {
-        makeFix("Use __restrict__ on pointers to prove the store does not alias with the load"),
-        makeFix("Ensure that the loop does not contain any instructions that could modify relevant state"),
-      },
-      SeverityLevel::Medium, 1.2
-  });
-
-  addPattern({
-      "licm", "", "failed to sink or hoist",
-      "LICM failed: Hoisting/Sinking blocked",
-      "Loop Invariant Code Motion (LICM) failed to move an instruction "
-      "out of the loop because of potential aliasing or side effects. "
-      "If an instruction might trap or has unknown memory dependencies, "
-      "it must remain inside the loop to preserve program semantics.",
-      "Instruction has side effects or aliasing prevents safe hoisting.",
-      "The optimizer wanted to move this redundant calculation out of the "
-      "loop body to run it only once per loop entry.",
-      {
-        makeFix("Mark functions called in the loop as 'pure' or 'const'"),
-        makeFix("Use __restrict__ on pointers to prove they don't alias with "
-                "the invariant memory location"),
-      },
-      SeverityLevel::Medium, 1.2
-  });
+bool ranksBefore(const DiagnosticResult &A, const DiagnosticResult &B) {
+  if (A.Severity != B.Severity)
+    return static_cast<int>(A.Severity) < static_cast<int>(B.Severity);
+  return A.ModeledCyclesSaved > B.ModeledCyclesSaved;
 }
 
 // maps internal severity enums to human-readable strings for console output
@@ -0,0 +1,595 @@
+#include "OptDebugger/OptReport.h"
+#include "OptDebugger/MemoryReport.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Base64.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+namespace optdbg {
+
+namespace {
+
+// uncompressed bytes of function data packed into one chunk before a new one is started
+constexpr size_t ChunkTargetBytes = 256 * 1024;
+
+// compact diff row tags shared with the viewer script below
+enum DiffRowTag : int {
+  RowUnchangedRun = 0,
+  RowAdded        = 1,
+  RowRemoved      = 2,
+  RowModified     = 3,
+};
+
+// interns strings into a dictionary column so the index stores small integers per diagnostic
+class StringColumn {
+public:
+  unsigned intern(llvm::StringRef S) {
+    auto Inserted = Ids.try_emplace(S, Values.size());
+    if (Inserted.second)
+      Values.push_back(S);
+    return Inserted.first->second;
+  }
+
+  void write(llvm::json::OStream &J, llvm::StringRef Key) const {
+    J.attributeArray(Key, [&] {
+      for (llvm::StringRef V : Values)
+        J.value(V);
+    });
+  }
+
+private:
+  llvm::StringMap<unsigned> Ids;
+  std::vector<llvm::StringRef> Values;
+};
+
+// a JavaScript string literal for inline <script> code; entities are not
+// decoded there, and a "</" would close the element early
+std::string scriptStringLiteral(llvm::StringRef S) {
+  std::string JSON;
+  llvm::raw_string_ostream JS(JSON);
+  JS << llvm::json::Value(llvm::json::isUTF8(S) ? S.str()
+                                                : llvm::json::fixUTF8(S));
+  JS.flush();
+  std::string Out;
+  Out.reserve(JSON.size());
+  for (size_t I = 0; I < JSON.size(); ++I) {
+    Out += JSON[I];
+    if (JSON[I] == '<' && I + 1 < JSON.size() && JSON[I + 1] == '/')
+      Out += '\\';
+  }
+  return Out;
+}
+
+// serializes the changed blocks of one function, collapsing unchanged instruction runs to a count
+void writeChunkDiff(llvm::json::OStream &J, const FunctionDiff &FD) {
+  J.object([&] {
+    J.attribute("bb", static_cast<int64_t>(FD.BeforeBlockCount));
+    J.attribute("ab", static_cast<int64_t>(FD.AfterBlockCount));
+    J.attribute("bi", static_cast<int64_t>(FD.BeforeInstrCount));
+    J.attribute("ai", static_cast<int64_t>(FD.AfterInstrCount));
+    J.attributeArray("blocks", [&] {
+      for (const BlockDiff &BD : FD.Blocks) {
+        if (BD.Kind == DiffKind::Unchanged)
+          continue;
+        J.object([&] {
+          J.attribute("n", BD.BlockName);
+          J.attribute("k", static_cast<int64_t>(BD.Kind));
+          J.attribute("bi", static_cast<int64_t>(BD.BeforeInstrCount));
+          J.attribute("ai", static_cast<int64_t>(BD.AfterInstrCount));
+          J.attributeArray("r", [&] {
+            int64_t Run = 0;
+            auto FlushRun = [&] {
+              if (Run == 0)
+                return;
+              J.array([&] {
+                J.value(static_cast<int64_t>(RowUnchangedRun));
+                J.value(Run);
+              });
+              Run = 0;
+            };
+            for (const InstructionDiff &ID : BD.Instructions) {
+              if (ID.Kind == DiffKind::Unchanged) {
+                ++Run;
+                continue;
+              }
+              FlushRun();
+              J.array([&] {
+                switch (ID.Kind) {
+                case DiffKind::Added:
+                  J.value(static_cast<int64_t>(RowAdded));
+                  J.value(ID.After.Text);
+                  break;
+                case DiffKind::Removed:
+                  J.value(static_cast<int64_t>(RowRemoved));
+                  J.value(ID.Before.Text);
+                  break;
+                case DiffKind::Modified:
+                  J.value(static_cast<int64_t>(RowModified));
+                  J.value(ID.Before.Text);
+                  J.value(ID.After.Text);
+                  break;
+                case DiffKind::Unchanged:
+                  break;
+                }
+              });
+            }
+            FlushRun();
+          });
+        });
+      }
+    });
+  });
+}
+
+}
+
+// compresses a json payload when zlib is available and wraps it in a script that hands it to the viewer
+llvm::Error HTMLReporter::writeDataFile(llvm::StringRef DataDir,
+                                        llvm::StringRef Name,
+                                        llvm::StringRef JSON) {
+  llvm::SmallString<256> Path(DataDir);
+  llvm::sys::path::append(Path, Name + ".js");
+
+  std::error_code EC;
+  llvm::raw_fd_ostream File(Path, EC, llvm::sys::fs::OF_None);
+  if (EC)
+    return makeStringError("cannot write '" + Path + "': " + EC.message());
+
+  bool Compressed = llvm::compression::zlib::isAvailable();
+  std::string Encoded;
+  if (Compressed) {
+    llvm::SmallVector<uint8_t, 0> Buf;
+    llvm::compression::zlib::compress(
+        llvm::ArrayRef<uint8_t>(
+            reinterpret_cast<const uint8_t *>(JSON.data()), JSON.size()),
+        Buf);
+    Encoded = llvm::encodeBase64(Buf);
+  } else {
+    Encoded = llvm::encodeBase64(JSON);
+  }
+  MemoryAccounting::noteBuffer("HTML data file encoding", Encoded.capacity());
+
+  File << "AION.data(\"" << Name << "\",\"" << Encoded << "\","
+       << (Compressed ? 1 : 0) << ");\n";
+  return llvm::Error::success();
+}
+
+// emits the static page: summary numbers, an empty virtual list and the viewer script
+void HTMLReporter::emitChunkedShell(const AnalysisSession &Session,
+                                    llvm::StringRef DataDirName) {
+  emitHeader("Aion Performance Report");
+
+  OS << R"html(<style>
+  .sidebar { display: flex; flex-direction: column; padding-bottom: 0; }
+  .vcontrols { display: flex; gap: 0.5rem; margin-bottom: 0.5rem; }
+  .vcontrols input, .vcontrols select { background: var(--bg); color: var(--text); border: 1px solid var(--border); border-radius: 4px; padding: 0.3rem 0.5rem; font-size: 0.8rem; }
+  .vcontrols input { flex: 1; min-width: 0; }
+  .vcount { font-size: 0.75rem; color: var(--text-muted); margin-bottom: 0.5rem; }
+  .vlist { flex: 1; overflow-y: auto; position: relative; margin: 0 -1.5rem; }
+  .vrows { position: absolute; left: 0; right: 0; top: 0; }
+  .vrow { position: absolute; left: 0; right: 0; height: 30px; line-height: 30px; padding: 0 1.5rem; display: flex; align-items: center; gap: 0.5rem; color: var(--text-muted); font-size: 0.8rem; cursor: pointer; white-space: nowrap; overflow: hidden; text-overflow: ellipsis; }
+  .vrow:hover, .vrow.active { background: var(--surface-alt); color: var(--text-bright); }
+  .vrow .severity-indicator { flex: none; }
+  .vrow.vgroup { color: var(--text-bright); font-weight: 700; background: var(--bg); cursor: default; }
+  .diff-skip { color: var(--text-muted); font-style: italic; }
+  .placeholder { color: var(--text-muted); padding: 2rem 0; }
+</style>
+)html";
+
+  OS << "<div class=\"sidebar\">\n";
+  OS << "  <div class=\"brand\"><div class=\"brand-logo\">A</div>"
+        "<div class=\"brand-name\">AION</div></div>\n";
+  OS << "  <div class=\"vcontrols\">\n";
+  OS << "    <input id=\"vfilter\" type=\"search\" placeholder=\"Filter pass, reason, function\">\n";
+  OS << "    <select id=\"vsev\">"
+        "<option value=\"0\">Critical</option>"
+        "<option value=\"1\">High+</option>"
+        "<option value=\"2\">Medium+</option>"
+        "<option value=\"3\">Low+</option>"
+        "<option value=\"4\" selected>All</option></select>\n";
+  OS << "  </div>\n";
+  OS << "  <div class=\"vcount\"><span id=\"vcount\">Loading&hellip;</span> diagnostics</div>\n";
+  OS << "  <div class=\"vlist\" id=\"vlist\"><div id=\"vspacer\"></div>"
+        "<div class=\"vrows\" id=\"vrows\"></div></div>\n";
+  OS << "</div>\n";
+
+  OS << "<div class=\"main\">\n";
+  OS << "  <div id=\"summary\">\n";
+  OS << "    <h1>Compiler Optimization Analysis</h1>\n";
+  OS << "    <div class=\"report-meta\">Engine: Aion v1.0 // Pipeline: "
+     << escapeHTML(Session.PassPipelineUsed) << "</div>\n";
+  emitSummary(Session);
+  OS << "  </div>\n";
+  OS << "  <div id=\"detail\"><div class=\"placeholder\">Select a diagnostic "
+        "from the list to load its details.</div></div>\n";
+  OS << "</div>\n";
+
+  OS << "<script>window.AION_DATA_DIR = " << scriptStringLiteral(DataDirName)
+     << ";</script>\n";
+  OS << R"html(<script>
+(function () {
+  const ROW = 30, OVERSCAN = 8;
+  const SEV = ['CRITICAL', 'HIGH', 'MEDIUM', 'LOW', 'INFO'];
+  const DOT = ['sev-critical-dot', 'sev-high-dot', 'sev-medium-dot', 'sev-low-dot', ''];
+  const AION = window.AION = {};
+  const pending = {}, chunks = {}, diffHTML = {};
+  let index = null, view = [], active = -1;
+
+  function esc(s) {
+    return String(s).replace(/[&<>"']/g, c => ({'&': '&amp;', '<': '&lt;', '>': '&gt;', '"': '&quot;', "'": '&#39;'})[c]);
+  }
+
+  async function decode(b64, compressed) {
+    const bin = Uint8Array.from(atob(b64), ch => ch.charCodeAt(0));
+    if (!compressed) return JSON.parse(new TextDecoder().decode(bin));
+    const stream = new Blob([bin]).stream().pipeThrough(new DecompressionStream('deflate'));
+    return JSON.parse(await new Response(stream).text());
+  }
+
+  AION.data = function (name, b64, compressed) {
+    decode(b64, compressed).then(d => {
+      const resolve = pending[name];
+      delete pending[name];
+      if (resolve) resolve(d);
+    });
+  };
+
+  function load(name) {
+    return new Promise((resolve, reject) => {
+      pending[name] = resolve;
+      const s = document.createElement('script');
+      s.src = encodeURIComponent(window.AION_DATA_DIR) + '/' + name + '.js';
+      s.onerror = () => reject(new Error('cannot load ' + s.src));
+      document.head.appendChild(s);
+    });
+  }
+
+  function chunk(k) {
+    if (!(k in chunks)) chunks[k] = load('chunk-' + k);
+    return chunks[k];
+  }
+
+  const list = document.getElementById('vlist');
+  const spacer = document.getElementById('vspacer');
+  const rows = document.getElementById('vrows');
+  const filter = document.getElementById('vfilter');
+  const sev = document.getElementById('vsev');
+  const count = document.getElementById('vcount');
+  const detail = document.getElementById('detail');
+
+  function rowText(d) {
+    return index.passes[d[2]] + ': ' + index.rules[d[1]].reason + ' @' + index.functions[d[3]];
+  }
+
+  function groupText(g, shown) {
+    return g.key + ' (' + shown + (g.gain > 0 ? ', +' + Math.round(g.gain * 100) + '%' : '') + ')';
+  }
+
+  function renderRows() {
+    const top = list.scrollTop, h = list.clientHeight;
+    const first = Math.max(0, Math.floor(top / ROW) - OVERSCAN);
+    const last = Math.min(view.length, Math.ceil((top + h) / ROW) + OVERSCAN);
+    let html = '';
+    for (let v = first; v < last; ++v) {
+      const i = view[v];
+      if (typeof i === 'string') {
+        html += '<div class="vrow vgroup" style="top:' + (v * ROW) + 'px">' + esc(i) + '</div>';
+        continue;
+      }
+      const d = index.diags[i];
+      html += '<a class="vrow' + (i === active ? ' active' : '') + '" style="top:' + (v * ROW) +
+              'px" data-i="' + i + '" title="' + esc(rowText(d)) + '"><span class="severity-indicator ' +
+              DOT[d[0]] + '"></span>' + esc(rowText(d)) + '</a>';
+    }
+    rows.innerHTML = html;
+  }
+
+  function applyFilter() {
+    const q = filter.value.toLowerCase(), maxSev = +sev.value;
+    const keep = i => {
+      const d = index.diags[i];
+      return d[0] <= maxSev && (!q || rowText(d).toLowerCase().includes(q));
+    };
+    view = [];
+    let shown = 0;
+    if (index.groups) {
+      for (const g of index.groups) {
+        const members = g.idx.filter(keep);
+        if (!members.length) continue;
+        view.push(groupText(g, members.length));
+        view.push(...members);
+        shown += members.length;
+      }
+    } else {
+      for (let i = 0; i < index.diags.length; ++i)
+        if (keep(i)) view.push(i);
+      shown = view.length;
+    }
+    spacer.style.height = (view.length * ROW) + 'px';
+    count.textContent = shown;
+    renderRows();
+  }
+
+  function renderDiff(fn, diff) {
+    if (fn in diffHTML) return diffHTML[fn];
+    let html = '<div class="content-section"><div class="content-label">Structural IR Changes &mdash; blocks ' +
+               diff.bb + ' &rarr; ' + diff.ab + ', instructions ' + diff.bi + ' &rarr; ' + diff.ai +
+               '</div><div class="card"><table class="diff-table">';
+    for (const b of diff.blocks) {
+      html += '<tr class="diff-row"><td class="diff-ln">#</td><td class="diff-content diff-meta">%' + esc(b.n) + ':</td></tr>';
+      if (b.k === 1 || b.k === 2)
+        html += '<tr class="diff-row"><td class="diff-ln"></td><td class="diff-content diff-skip">  block ' +
+                (b.k === 1 ? 'added' : 'removed') + ' (' + (b.k === 1 ? b.ai : b.bi) + ' instructions)</td></tr>';
+      for (const r of b.r) {
+        if (r[0] === 0)
+          html += '<tr class="diff-row"><td class="diff-ln">=</td><td class="diff-content diff-skip">  ' + r[1] + ' unchanged</td></tr>';
+        if (r[0] === 2 || r[0] === 3)
+          html += '<tr class="diff-row diff-minus"><td class="diff-ln">-</td><td class="diff-content">  ' + esc(r[1]) + '</td></tr>';
+        if (r[0] === 1)
+          html += '<tr class="diff-row diff-plus"><td class="diff-ln">+</td><td class="diff-content">  ' + esc(r[1]) + '</td></tr>';
+        if (r[0] === 3)
+          html += '<tr class="diff-row diff-plus"><td class="diff-ln">+</td><td class="diff-content">  ' + esc(r[2]) + '</td></tr>';
+      }
+    }
+    html += '</table></div></div>';
+    diffHTML[fn] = html;
+    return html;
+  }
+
+  async function show(i) {
+    active = i;
+    renderRows();
+    const d = index.diags[i], fn = d[3], rule = index.rules[d[1]];
+    detail.innerHTML = '<div class="placeholder">Loading&hellip;</div>';
+    const data = (await chunk(index.fnChunk[fn]))[fn];
+    if (active !== i) return;
+    const det = data.diags.find(x => x.i === i) || {};
+    let html = '<div class="card"><div class="card-header"><div class="severity-indicator ' + DOT[d[0]] +
+               '"></div><div class="diag-title">' + esc(rule.reason) + '</div>';
+    if (d[4] >= 0)
+      html += '<div class="diag-loc">' + esc(index.files[d[4]] + ':' + d[5] + ':' + d[6]) + '</div>';
+    html += '</div><div class="card-body"><div class="label-group">';
+    if (det.machine) html += '<div class="label" style="background:var(--cobalt);color:white">BACKEND</div>';
+    html += '<div class="label">' + SEV[d[0]] + '</div><div class="label">' + esc(index.passes[d[2]]) +
+            '</div><div class="label">@' + esc(index.functions[fn]) + '</div>';
+    if (d[7] > 0.1)
+      html += '<div class="label" style="color:var(--green)">Estimated Speedup: ' + d[7].toFixed(1) + 'x</div>';
+    html += '</div>';
+    html += '<div class="content-section"><div class="content-label">Root Cause</div><div class="content-text">' +
+            esc(det.root || '') + '</div></div>';
+    html += '<div class="content-section"><div class="content-label">Optimizer Intent</div><div class="content-text">' +
+            esc(det.intent || '') + '</div></div>';
+    html += '<div class="content-section"><div class="content-label">Detailed Explanation</div><div class="content-text">' +
+            esc(det.expl || rule.expl) + '</div></div>';
+    if (rule.fixes.length) {
+      html += '<div class="content-label">Actionable Resolutions</div><div class="fix-container">';
+      rule.fixes.forEach((f, n) => {
+        html += '<div class="fix-item"><div class="fix-desc">' + (n + 1) + '. ' + esc(f[0]) + '</div>';
+        if (f[1]) html += '<pre>' + esc(f[1]) + '</pre>';
+        html += '</div>';
+      });
+      html += '</div>';
+    }
+    if (data.diff) html += renderDiff(fn, data.diff);
+    html += '</div></div>';
+    detail.innerHTML = html;
+  }
+
+  list.addEventListener('scroll', () => requestAnimationFrame(renderRows));
+  rows.addEventListener('click', e => {
+    const a = e.target.closest('.vrow');
+    if (a) show(+a.dataset.i);
+  });
+  let timer = 0;
+  filter.addEventListener('input', () => { clearTimeout(timer); timer = setTimeout(applyFilter, 120); });
+  sev.addEventListener('change', applyFilter);
+
+  load('index').then(data => { index = data; applyFilter(); },
+                     err => { count.textContent = err.message; });
+})();
+</script>
+)html";
+
+  emitFooter();
+}
+
+// splits the session into a dictionary-encoded index and size-bounded chunks of per-function data
+llvm::Error HTMLReporter::reportChunked(const AnalysisSession &Session,
+                                        const ReportConfig    &Cfg,
+                                        llvm::StringRef        DataDir) {
+  if (std::error_code EC = llvm::sys::fs::create_directories(DataDir))
+    return makeStringError("cannot create '" + DataDir + "': " + EC.message());
+
+  llvm::StringMap<const FunctionDiff *> DiffMap;
+  for (const auto &FD : Session.Diff.Functions)
+    DiffMap[FD->FunctionName] = FD.get();
+
+  StringColumn Passes, Files, Functions;
+  llvm::StringMap<unsigned> RuleIds;
+  std::vector<const DiagnosticResult *> RuleFirst;
+  std::vector<std::vector<unsigned>> DiagsByFunction;
+
+  std::string IndexJSON;
+  {
+    llvm::raw_string_ostream IOS(IndexJSON);
+    llvm::json::OStream J(IOS);
+    J.objectBegin();
+    J.attribute("v", 1);
+
+    std::vector<unsigned> IndexOf(Session.Diagnostics.size(), 0);
+
+    J.attributeBegin("diags");
+    J.arrayBegin();
+    unsigned Idx = 0;
+    for (const DiagnosticResult &D : Session.Diagnostics) {
+      if (static_cast<int>(D.Severity) > static_cast<int>(Cfg.MinSeverity))
+        continue;
+      IndexOf[&D - Session.Diagnostics.data()] = Idx;
+
+      auto Rule = RuleIds.try_emplace(D.RuleID, RuleFirst.size());
+      if (Rule.second)
+        RuleFirst.push_back(&D);
+
+      unsigned Fn = Functions.intern(D.FunctionName);
+      if (Fn >= DiagsByFunction.size())
+        DiagsByFunction.resize(Fn + 1);
+      DiagsByFunction[Fn].push_back(Idx);
+
+      J.array([&] {
+        J.value(static_cast<int64_t>(D.Severity));
+        J.value(Rule.first->second);
+        J.value(Passes.intern(D.PassName));
+        J.value(Fn);
+        J.value(D.Location.isValid()
+                    ? static_cast<int64_t>(Files.intern(D.Location.File))
+                    : int64_t(-1));
+        J.value(D.Location.Line);
+        J.value(D.Location.Column);
+        J.value(D.EstimatedSpeedup);
+      });
+      ++Idx;
+    }
+    J.arrayEnd();
+    J.attributeEnd();
+
+    GroupKey By = groupKeyFor(Cfg);
+    if (By != GroupKey::None) {
+      J.attributeArray("groups", [&] {
+        for (const DiagnosticGroup &G :
+             groupDiagnostics(Session.Diagnostics, By, Cfg.MinSeverity)) {
+          J.object([&] {
+            J.attribute("key", G.Key);
+            J.attribute("gain", G.EstimatedGain);
+            J.attributeArray("sev", [&] {
+              for (unsigned C : G.SeverityCounts)
+                J.value(C);
+            });
+            J.attributeArray("idx", [&] {
+              for (uint32_t I : G.Indices)
+                J.value(IndexOf[I]);
+            });
+          });
+        }
+      });
+    }
+
+    J.attributeArray("rules", [&] {
+      for (const DiagnosticResult *First : RuleFirst) {
+        J.object([&] {
+          J.attribute("id", First->RuleID);
+          J.attribute("reason", First->ShortReason);
+          J.attribute("expl", First->DetailedExplanation);
+          J.attributeArray("fixes", [&] {
+            unsigned Count = 0;
+            for (const FixSuggestion &Fix : First->Suggestions) {
+              if (Count++ >= Cfg.MaxSuggestions)
+                break;
+              J.array([&] {
+                J.value(Fix.Description);
+                J.value(Fix.CodeExample);
+              });
+            }
+          });
+        });
+      }
+    });
+
+    // the diagnostic records follow the same filtered order as the index
+    std::vector<const DiagnosticResult *> Reported;
+    Reported.reserve(Idx);
+    for (const DiagnosticResult &D : Session.Diagnostics)
+      if (static_cast<int>(D.Severity) <= static_cast<int>(Cfg.MinSeverity))
+        Reported.push_back(&D);
+
+    // pack functions into chunks in first-seen order until each reaches the size target
+    std::vector<unsigned> FnChunk(DiagsByFunction.size(), 0);
+    unsigned ChunkIdx = 0;
+    std::string ChunkJSON;
+    auto ChunkOS = std::make_unique<llvm::raw_string_ostream>(ChunkJSON);
+    auto ChunkJ = std::make_unique<llvm::json::OStream>(*ChunkOS);
+    ChunkJ->objectBegin();
+    bool ChunkEmpty = true;
+
+    auto FlushChunk = [&]() -> llvm::Error {
+      ChunkJ->objectEnd();
+      ChunkJ.reset();
+      ChunkOS->flush();
+      MemoryAccounting::noteBuffer("HTML chunk JSON", ChunkJSON.capacity());
+      if (auto Err = writeDataFile(DataDir, "chunk-" + std::to_string(ChunkIdx),
+                                   ChunkJSON))
+        return Err;
+      ChunkJSON.clear();
+      ChunkOS = std::make_unique<llvm::raw_string_ostream>(ChunkJSON);
+      ChunkJ = std::make_unique<llvm::json::OStream>(*ChunkOS);
+      ChunkJ->objectBegin();
+      ChunkEmpty = true;
+      ++ChunkIdx;
+      return llvm::Error::success();
+    };
+
+    for (unsigned Fn = 0; Fn < DiagsByFunction.size(); ++Fn) {
+      llvm::json::OStream &CJ = *ChunkJ;
+      const DiagnosticResult &FirstDiag = *Reported[DiagsByFunction[Fn][0]];
+      CJ.attributeObject(std::to_string(Fn), [&] {
+        auto It = DiffMap.find(FirstDiag.FunctionName);
+        if (Cfg.ShowDiff && It != DiffMap.end() &&
+            It->second->Kind != DiffKind::Unchanged) {
+          CJ.attributeBegin("diff");
+          writeChunkDiff(CJ, *It->second);
+          CJ.attributeEnd();
+        }
+        CJ.attributeArray("diags", [&] {
+          for (unsigned I : DiagsByFunction[Fn]) {
+            const DiagnosticResult &D = *Reported[I];
+            const DiagnosticResult &First = *RuleFirst[RuleIds.lookup(D.RuleID)];
+            CJ.object([&] {
+              CJ.attribute("i", I);
+              CJ.attribute("root", D.RootCause);
+              CJ.attribute("intent", D.WhatOptimizerWanted);
+              if (D.DetailedExplanation != First.DetailedExplanation)
+                CJ.attribute("expl", D.DetailedExplanation);
+              if (D.IsMachine)
+                CJ.attribute("machine", true);
+            });
+          }
+        });
+      });
+      FnChunk[Fn] = ChunkIdx;
+      ChunkEmpty = false;
+
+      ChunkOS->flush();
+      if (ChunkJSON.size() >= ChunkTargetBytes)
+        if (auto Err = FlushChunk())
+          return Err;
+    }
+    if (!ChunkEmpty)
+      if (auto Err = FlushChunk())
+        return Err;
+    ChunkJ->objectEnd();
+
+    J.attributeArray("fnChunk", [&] {
+      for (unsigned C : FnChunk)
+        J.value(C);
+    });
+    Passes.write(J, "passes");
+    Files.write(J, "files");
+    Functions.write(J, "functions");
+    J.objectEnd();
+  }
+
+  MemoryAccounting::noteBuffer("HTML index JSON", IndexJSON.capacity());
+  if (auto Err = writeDataFile(DataDir, "index", IndexJSON))
+    return Err;
+
+  emitChunkedShell(Session, llvm::sys::path::filename(DataDir));
+  return llvm::Error::success();
+}
+
+}
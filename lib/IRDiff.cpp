@@ -1,4 +1,5 @@
 #include "OptDebugger/IRDiff.h"
+#include "OptDebugger/SelfProfile.h"
 
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/DebugInfoMetadata.h"
@@ -369,6 +370,7 @@ FunctionDiff IRDiffEngine::diffFunctions(const llvm::Function &Before,
 // computes a comprehensive difference report comparing two llvm modules by mapping and analyzing all internal functions
 ModuleDiff IRDiffEngine::diff(const llvm::Module &Before,
                                const llvm::Module &After) {
+  ProfileScope PS("DiffModules");
   ModuleDiff MD;
   MD.AddedFunctions     = 0;
   MD.RemovedFunctions   = 0;
@@ -406,15 +408,16 @@ ModuleDiff IRDiffEngine::diff(const llvm::Module &Before,
       FD.AfterInstrCount  = 0;
       FD.AttributesChanged = false;
       FD.SignatureChanged  = false;
-      MD.Functions.push_back(std::move(FD));
+      MD.Functions.push_back(std::make_shared<FunctionDiff>(std::move(FD)));
       ++MD.RemovedFunctions;
     } else {
+      ProfileScope FPS("DiffFunction", Name);
       FunctionDiff FD = diffFunctions(*FBefore, *It->second);
       if (FD.Kind == DiffKind::Modified || FD.AttributesChanged || FD.SignatureChanged)
         ++MD.ModifiedFunctions;
       else
         ++MD.UnchangedFunctions;
-      MD.Functions.push_back(std::move(FD));
+      MD.Functions.push_back(std::make_shared<FunctionDiff>(std::move(FD)));
     }
   }
 
@@ -432,7 +435,7 @@ ModuleDiff IRDiffEngine::diff(const llvm::Module &Before,
         FD.AfterInstrCount += BB.size();
       FD.AttributesChanged = false;
       FD.SignatureChanged  = false;
-      MD.Functions.push_back(std::move(FD));
+      MD.Functions.push_back(std::make_shared<FunctionDiff>(std::move(FD)));
       ++MD.AddedFunctions;
     }
   }
@@ -483,7 +486,8 @@ void printModuleDiff(const ModuleDiff &Diff, llvm::raw_ostream &OS,
   else
     OS << " (no change)\n";
 
-  for (const FunctionDiff &FD : Diff.Functions) {
+  for (const auto &FDPtr : Diff.Functions) {
+    const FunctionDiff &FD = *FDPtr;
     if (FD.Kind == DiffKind::Unchanged)
       continue;
 
@@ -0,0 +1,291 @@
+#include "OptDebugger/InlineCostReport.h"
+#include "OptDebugger/CostModel.h"
+#include "OptDebugger/SelfProfile.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/InlineCost.h"
+#include "llvm/Analysis/InlineModelFeatureMaps.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/DebugLoc.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/TargetParser/Triple.h"
+
+#include <map>
+#include <memory>
+
+namespace optdbg {
+
+namespace {
+
+constexpr const char *CostFeatureNames[] = {
+#define POPULATE_NAMES(INDEX_NAME, NAME) NAME,
+    INLINE_COST_FEATURE_ITERATOR(POPULATE_NAMES)
+#undef POPULATE_NAMES
+};
+
+// O3 raises the threshold, Os and Oz lower it; O0 and O1 use the O2 numbers
+// like the inliner does when it runs at all
+llvm::InlineParams inlineParamsFor(llvm::StringRef OptLevel) {
+  llvm::OptimizationLevel L = optLevelFor(OptLevel);
+  llvm::InlineParams Params =
+      llvm::getInlineParams(L.getSpeedupLevel(), L.getSizeLevel());
+  // the inliner stops counting once the threshold is crossed; the gap needs
+  // the whole cost
+  Params.ComputeFullInlineCost = true;
+  return Params;
+}
+
+bool isMissedInline(const Remark &R) {
+  return R.isMissed() && !R.IsMachine &&
+         llvm::StringRef(R.PassName).contains("inline") && R.findArg("Callee");
+}
+
+// the call of Callee in Caller at the remark's location; a single call of
+// the callee needs no location
+llvm::CallBase *findCallSite(llvm::Function &Caller, llvm::StringRef Callee,
+                             const SourceLocation &Loc, std::string &Why) {
+  llvm::SmallVector<llvm::CallBase *, 4> Calls, AtLoc;
+  for (llvm::Instruction &I : llvm::instructions(Caller)) {
+    auto *CB = llvm::dyn_cast<llvm::CallBase>(&I);
+    if (!CB)
+      continue;
+    auto *Target = llvm::dyn_cast<llvm::Function>(
+        CB->getCalledOperand()->stripPointerCasts());
+    if (!Target || Target->getName() != Callee)
+      continue;
+    Calls.push_back(CB);
+    const llvm::DebugLoc &DL = CB->getDebugLoc();
+    if (Loc.Line && DL && DL.getLine() == Loc.Line &&
+        (!Loc.Column || DL.getCol() == Loc.Column))
+      AtLoc.push_back(CB);
+  }
+  if (Calls.size() == 1)
+    return Calls.front();
+  if (!AtLoc.empty())
+    return AtLoc.front();
+  Why = Calls.empty() ? "no call to the callee in the caller"
+                      : "several calls to the callee and none at the remark's "
+                        "location";
+  return nullptr;
+}
+
+}
+
+InlineCostReport analyzeInlineCosts(llvm::Module &M,
+                                    llvm::ArrayRef<Remark> Remarks,
+                                    llvm::StringRef OptLevel) {
+  ProfileScope PS("InlineCost");
+  InlineCostReport Report;
+  llvm::InlineParams Params = inlineParamsFor(OptLevel);
+  Report.DefaultThreshold = Params.DefaultThreshold;
+
+  // the target's TTI per function, as the inliner queries it; the data-layout
+  // defaults only when the module's target is not available
+  std::unique_ptr<llvm::TargetMachine> TM = targetMachineFor(M);
+  llvm::TargetLibraryInfoImpl   TLII{llvm::Triple(M.getTargetTriple())};
+  llvm::ProfileSummaryInfo      PSI(M);
+  std::map<llvm::Function *, std::unique_ptr<llvm::TargetTransformInfo>> TTIs;
+  std::map<llvm::Function *, std::unique_ptr<llvm::AssumptionCache>> ACs;
+  std::map<llvm::Function *, std::unique_ptr<llvm::TargetLibraryInfo>> TLIs;
+  auto GetTTI = [&](llvm::Function &F) -> llvm::TargetTransformInfo & {
+    auto &TTI = TTIs[&F];
+    if (!TTI)
+      TTI = std::make_unique<llvm::TargetTransformInfo>(
+          TM ? TM->getTargetTransformInfo(F)
+             : llvm::TargetTransformInfo(M.getDataLayout()));
+    return *TTI;
+  };
+  auto GetAC = [&](llvm::Function &F) -> llvm::AssumptionCache & {
+    auto &AC = ACs[&F];
+    if (!AC)
+      AC = std::make_unique<llvm::AssumptionCache>(F, &GetTTI(F));
+    return *AC;
+  };
+  auto GetTLI = [&](llvm::Function &F) -> const llvm::TargetLibraryInfo & {
+    auto &TLI = TLIs[&F];
+    if (!TLI)
+      TLI = std::make_unique<llvm::TargetLibraryInfo>(TLII, &F);
+    return *TLI;
+  };
+
+  // the compiler's remarks and the pipeline's can describe the same site
+  llvm::DenseSet<llvm::CallBase *> Seen;
+  for (const Remark &R : Remarks) {
+    if (!isMissedInline(R))
+      continue;
+
+    InlineSiteCost Site;
+    Site.Callee  = R.findArg("Callee")->Value;
+    const RemarkArgument *CallerArg = R.findArg("Caller");
+    Site.Caller  = CallerArg ? CallerArg->Value : R.FunctionName;
+    Site.Loc     = R.Loc;
+    Site.Hotness = R.Hotness;
+    Site.RemarkCost      = R.intArg("Cost");
+    Site.RemarkThreshold = R.intArg("Threshold");
+
+    llvm::Function *Caller = M.getFunction(Site.Caller);
+    llvm::CallBase *CB = nullptr;
+    if (!Caller || Caller->isDeclaration())
+      Site.Unresolved = "caller is not defined in the module";
+    else
+      CB = findCallSite(*Caller, Site.Callee, Site.Loc, Site.Unresolved);
+    if (!CB) {
+      ++Report.Unresolved;
+      Report.Sites.push_back(std::move(Site));
+      continue;
+    }
+    if (!Seen.insert(CB).second)
+      continue;
+
+    llvm::Function *Callee = llvm::cast<llvm::Function>(
+        CB->getCalledOperand()->stripPointerCasts());
+    if (Callee->isDeclaration()) {
+      Site.Never  = true;
+      Site.Reason = "no definition in this module";
+      Report.Sites.push_back(std::move(Site));
+      continue;
+    }
+
+    llvm::TargetTransformInfo &CalleeTTI = GetTTI(*Callee);
+    llvm::InlineCost IC = llvm::getInlineCost(*CB, Callee, Params, CalleeTTI,
+                                              GetAC, GetTLI, nullptr, &PSI);
+    if (IC.isAlways() || IC.isNever()) {
+      Site.Always = IC.isAlways();
+      Site.Never  = IC.isNever();
+      Site.Reason = IC.getReason() ? IC.getReason() : "";
+      Report.Sites.push_back(std::move(Site));
+      continue;
+    }
+    Site.Cost      = IC.getCost();
+    Site.Threshold = IC.getThreshold();
+
+    // the summands of the heuristic cost; counts such as the number of
+    // loops are left out
+    if (auto Features = llvm::getInliningCostFeatures(*CB, CalleeTTI, GetAC)) {
+      for (size_t I = 0; I < Features->size(); ++I) {
+        auto Index = static_cast<llvm::InlineCostFeatureIndex>(I);
+        if ((*Features)[I] && llvm::isHeuristicInlineCostFeature(Index))
+          Site.Components.emplace_back(CostFeatureNames[I], (*Features)[I]);
+      }
+      llvm::sort(Site.Components, [](const auto &A, const auto &B) {
+        return std::abs(A.second) > std::abs(B.second);
+      });
+    }
+    Report.Sites.push_back(std::move(Site));
+  }
+
+  llvm::StringMap<size_t> CalleeIndex;
+  for (const InlineSiteCost &Site : Report.Sites) {
+    if (!Site.analyzed() || Site.Always)
+      continue;
+    auto [It, Inserted] = CalleeIndex.try_emplace(Site.Callee, Report.Callees.size());
+    if (Inserted)
+      Report.Callees.push_back({Site.Callee});
+    InlineCalleeCost &C = Report.Callees[It->second];
+    bool First = C.Sites == C.Never;
+    ++C.Sites;
+    C.Hotness += Site.Hotness.value_or(0.0f);
+    if (Site.Never) {
+      ++C.Never;
+      continue;
+    }
+    C.MinGap = First ? Site.gap() : std::min(C.MinGap, Site.gap());
+    C.MaxGap = First ? Site.gap() : std::max(C.MaxGap, Site.gap());
+  }
+
+  // a callee never inlined for a structural reason cannot be fixed by
+  // shrinking it, so it ranks by its costed sites only
+  llvm::stable_sort(Report.Callees, [](const InlineCalleeCost &A,
+                                       const InlineCalleeCost &B) {
+    if (A.Hotness != B.Hotness)
+      return A.Hotness > B.Hotness;
+    unsigned CostedA = A.Sites - A.Never, CostedB = B.Sites - B.Never;
+    if (CostedA != CostedB)
+      return CostedA > CostedB;
+    if (A.MaxGap != B.MaxGap)
+      return A.MaxGap < B.MaxGap;
+    return A.Callee < B.Callee;
+  });
+  return Report;
+}
+
+void printInlineCostReport(const InlineCostReport &Report,
+                           llvm::raw_ostream &OS, bool Verbose) {
+  OS << "\n=== Inline Cost Gaps (default threshold " << Report.DefaultThreshold
+     << ") ===\n";
+  if (Report.Sites.empty()) {
+    OS << "No missed inlining remarks.\n";
+    return;
+  }
+
+  bool HasHotness = llvm::any_of(Report.Callees, [](const InlineCalleeCost &C) {
+    return C.Hotness > 0;
+  });
+  OS << llvm::left_justify("Callee", 40) << llvm::right_justify("Sites", 7)
+     << llvm::right_justify("Never", 7);
+  if (HasHotness)
+    OS << llvm::right_justify("Hotness", 10);
+  OS << llvm::right_justify("Min gap", 9) << llvm::right_justify("Max gap", 9)
+     << "\n";
+  for (const InlineCalleeCost &C : Report.Callees) {
+    bool Costed = C.Sites > C.Never;
+    OS << llvm::left_justify(C.Callee, 40)
+       << llvm::right_justify(std::to_string(C.Sites), 7)
+       << llvm::right_justify(std::to_string(C.Never), 7);
+    if (HasHotness)
+      OS << llvm::right_justify(llvm::formatv("{0:F0}", C.Hotness).str(), 10);
+    OS << llvm::right_justify(Costed ? std::to_string(C.MinGap) : "-", 9)
+       << llvm::right_justify(Costed ? std::to_string(C.MaxGap) : "-", 9)
+       << "\n";
+  }
+  OS << "Costs are recomputed on the input IR, before the passes that run "
+        "ahead of the inliner.\n";
+
+  unsigned Costed = llvm::count_if(Report.Sites, [](const InlineSiteCost &S) {
+    return S.hasCost();
+  });
+  OS << Report.Sites.size() << " missed call sites, " << Costed
+     << " with a recomputed cost";
+  if (Report.Unresolved)
+    OS << ", " << Report.Unresolved << " not found in the module";
+  OS << "\n";
+
+  if (!Verbose)
+    return;
+
+  for (const InlineSiteCost &S : Report.Sites) {
+    OS << "\n  " << S.Caller << " -> " << S.Callee;
+    if (S.Loc.isValid())
+      OS << " at " << S.Loc.format();
+    OS << "\n    ";
+    if (!S.analyzed()) {
+      OS << "not analyzed: " << S.Unresolved << "\n";
+      continue;
+    }
+    if (S.Always || S.Never) {
+      OS << (S.Always ? "always inlined: " : "never inlined: ") << S.Reason
+         << "\n";
+      continue;
+    }
+    OS << "cost " << S.Cost << ", threshold " << S.Threshold;
+    if (int Bonus = S.Threshold - Report.DefaultThreshold)
+      OS << " (" << (Bonus > 0 ? "+" : "") << Bonus << " from bonuses)";
+    OS << ", " << (S.gap() >= 0 ? "over by " : "under by ") << std::abs(S.gap());
+    if (S.RemarkCost && S.RemarkThreshold)
+      OS << "; compiler reported " << *S.RemarkCost << "/" << *S.RemarkThreshold;
+    OS << "\n";
+    for (const auto &[Name, Value] : S.Components)
+      OS << "      " << llvm::left_justify(Name, 34)
+         << llvm::right_justify(std::to_string(Value), 8) << "\n";
+  }
+}
+
+}
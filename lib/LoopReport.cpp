@@ -0,0 +1,417 @@
+#include "OptDebugger/LoopReport.h"
+#include "OptDebugger/SelfProfile.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/Path.h"
+#include "llvm/TargetParser/Triple.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+
+namespace optdbg {
+
+namespace {
+
+// the analyses of one function; loops only live as long as these do
+struct FunctionLoops {
+  llvm::DominatorTree     DT;
+  llvm::LoopInfo          LI;
+  llvm::AssumptionCache   AC;
+  llvm::TargetLibraryInfo TLI;
+  llvm::ScalarEvolution   SE;
+
+  FunctionLoops(llvm::Function &F, const llvm::TargetLibraryInfoImpl &TLII)
+      : DT(F), LI(DT), AC(F), TLI(TLII, &F), SE(F, TLI, AC, DT, LI) {}
+};
+
+// SLP works on straight-line code and has no loop to report on
+std::optional<LoopTransform> transformFor(llvm::StringRef PassName) {
+  std::string Lower = PassName.lower();
+  llvm::StringRef P(Lower);
+  if (P.contains("slp"))
+    return std::nullopt;
+  if (P.contains("vectoriz"))    return LoopTransform::Vectorize;
+  if (P.contains("unroll"))      return LoopTransform::Unroll;
+  if (P.contains("interchange")) return LoopTransform::Interchange;
+  if (P.contains("licm"))        return LoopTransform::LICM;
+  return std::nullopt;
+}
+
+bool sameFile(llvm::StringRef A, llvm::StringRef B) {
+  return A.empty() || B.empty() ||
+         llvm::sys::path::filename(A) == llvm::sys::path::filename(B);
+}
+
+SourceLocation startLocation(const llvm::Loop &L) {
+  SourceLocation Loc;
+  llvm::DebugLoc DL = L.getStartLoc();
+  if (!DL)
+    return Loc;
+  if (auto *Scope = llvm::dyn_cast<llvm::DIScope>(DL.getScope()))
+    Loc.File = Scope->getFilename().str();
+  Loc.Line   = DL.getLine();
+  Loc.Column = DL.getCol();
+  return Loc;
+}
+
+unsigned instructionCount(const llvm::Loop &L) {
+  unsigned Count = 0;
+  for (const llvm::BasicBlock *BB : L.blocks())
+    for (const llvm::Instruction &I : *BB)
+      Count += !llvm::isa<llvm::DbgInfoIntrinsic>(I);
+  return Count;
+}
+
+// the widest vector the loop computes with; 1 for scalar code
+unsigned vectorWidth(const llvm::Loop &L) {
+  unsigned Width = 1;
+  for (const llvm::BasicBlock *BB : L.blocks())
+    for (const llvm::Instruction &I : *BB) {
+      llvm::Type *Ty = I.getType();
+      if (auto *SI = llvm::dyn_cast<llvm::StoreInst>(&I))
+        Ty = SI->getValueOperand()->getType();
+      if (auto *VT = llvm::dyn_cast<llvm::FixedVectorType>(Ty))
+        Width = std::max(Width, VT->getNumElements());
+    }
+  return Width;
+}
+
+// keeps the first source of a trip count: the input, then the output
+void readTripCount(llvm::ScalarEvolution &SE, llvm::Loop &L, LoopSummary &S) {
+  if (S.TripCount || S.MaxTripCount || !S.SymbolicTripCount.empty())
+    return;
+  if (unsigned Trip = SE.getSmallConstantTripCount(&L))
+    S.TripCount = Trip;
+  // a bound at the counter's signed limit only restates its width
+  unsigned Max = SE.getSmallConstantMaxTripCount(&L);
+  if (Max && Max < unsigned(INT_MAX))
+    S.MaxTripCount = Max;
+  if (S.TripCount)
+    return;
+  const llvm::SCEV *Taken = SE.getBackedgeTakenCount(&L);
+  if (llvm::isa<llvm::SCEVCouldNotCompute>(Taken))
+    return;
+  llvm::raw_string_ostream OS(S.SymbolicTripCount);
+  Taken->print(OS);
+}
+
+// loops of the output with the summary's start line, or its header when it
+// has no location; vectorization leaves a vector and a remainder loop
+bool sameLoop(const LoopSummary &S, const llvm::Loop &L) {
+  if (!S.Loc.Line)
+    return L.getHeader()->getName() == S.Header;
+  SourceLocation Loc = startLocation(L);
+  return Loc.Line == S.Loc.Line && sameFile(Loc.File, S.Loc.File);
+}
+
+void summarizeFunction(llvm::Function &F, llvm::Function *AfterF,
+                       const llvm::TargetLibraryInfoImpl &TLII,
+                       std::vector<LoopSummary> &Loops) {
+  FunctionLoops Before(F, TLII);
+  size_t First = Loops.size();
+  for (llvm::Loop *L : Before.LI.getLoopsInPreorder()) {
+    LoopSummary S;
+    S.Function           = F.getName().str();
+    S.Header             = L->getHeader()->getName().str();
+    S.Loc                = startLocation(*L);
+    S.Depth              = L->getLoopDepth();
+    S.InstructionsBefore = instructionCount(*L);
+    for (const llvm::BasicBlock *BB : L->blocks())
+      for (const llvm::Instruction &I : *BB) {
+        const llvm::DebugLoc &DL = I.getDebugLoc();
+        if (!DL || !DL.getLine())
+          continue;
+        S.FirstLine = S.FirstLine ? std::min(S.FirstLine, DL.getLine())
+                                  : DL.getLine();
+        S.LastLine  = std::max(S.LastLine, DL.getLine());
+      }
+    readTripCount(Before.SE, *L, S);
+    Loops.push_back(std::move(S));
+  }
+
+  if (!AfterF || AfterF->isDeclaration() || First == Loops.size())
+    return;
+  FunctionLoops After(*AfterF, TLII);
+  for (llvm::Loop *L : After.LI.getLoopsInPreorder()) {
+    for (size_t I = First; I < Loops.size(); ++I) {
+      LoopSummary &S = Loops[I];
+      if (!sameLoop(S, *L))
+        continue;
+      S.PresentAfter = true;
+      S.InstructionsAfter += instructionCount(*L);
+      readTripCount(After.SE, *L, S);
+      if (llvm::getBooleanLoopAttribute(L, "llvm.loop.isvectorized"))
+        S.VectorizationFactor =
+            std::max(S.VectorizationFactor, vectorWidth(*L));
+      break;
+    }
+  }
+}
+
+// the deepest loop starting at the remark's line, otherwise the deepest loop
+// whose body spans it; a remark without a line can only name the function's
+// only loop
+LoopSummary *matchLoop(const Remark &R, std::vector<LoopSummary> &Loops,
+                       llvm::ArrayRef<size_t> Candidates) {
+  if (!R.Loc.Line)
+    return Candidates.size() == 1 ? &Loops[Candidates.front()] : nullptr;
+  LoopSummary *AtStart = nullptr, *Inside = nullptr;
+  for (size_t I : Candidates) {
+    LoopSummary &S = Loops[I];
+    if (!sameFile(S.Loc.File, R.Loc.File))
+      continue;
+    if (S.Loc.Line == R.Loc.Line && (!AtStart || S.Depth > AtStart->Depth))
+      AtStart = &S;
+    if (S.FirstLine <= R.Loc.Line && R.Loc.Line <= S.LastLine &&
+        (!Inside || S.Depth > Inside->Depth))
+      Inside = &S;
+  }
+  return AtStart ? AtStart : Inside;
+}
+
+void applyRemark(const Remark &R, LoopTransform T, LoopSummary &S) {
+  if (R.isApplied()) {
+    switch (T) {
+    case LoopTransform::Vectorize:
+      S.VectorizationFactor =
+          std::max(S.VectorizationFactor, R.unsignedArg("VectorizationFactor"));
+      S.InterleaveCount =
+          std::max(S.InterleaveCount, R.unsignedArg("InterleaveCount"));
+      break;
+    case LoopTransform::Unroll:
+      if (R.RemarkName == "Peeled") {
+        S.PeelCount = std::max(S.PeelCount, R.unsignedArg("PeelCount"));
+        break;
+      }
+      S.FullyUnrolled |= R.RemarkName == "FullyUnrolled";
+      S.UnrollCount = std::max(S.UnrollCount, R.unsignedArg("UnrollCount"));
+      break;
+    case LoopTransform::Interchange:
+      S.Interchanged = true;
+      break;
+    case LoopTransform::LICM:
+      ++S.LICMApplied;
+      break;
+    }
+    return;
+  }
+
+  // the compiler's remarks and the pipeline's can say the same thing
+  bool Duplicate = llvm::any_of(S.Blockers, [&](const LoopBlocker &B) {
+    return B.Transform == T && B.RemarkName == R.RemarkName &&
+           B.Message == R.Message;
+  });
+  if (!Duplicate)
+    S.Blockers.push_back({T, R.PassName, R.RemarkName, R.Message, R.Loc});
+}
+
+bool transformApplied(const LoopSummary &S, LoopTransform T) {
+  switch (T) {
+  case LoopTransform::Vectorize:   return S.vectorized();
+  case LoopTransform::Unroll:      return S.unrolled();
+  case LoopTransform::Interchange: return S.Interchanged;
+  // some instructions can be hoisted while others are blocked
+  case LoopTransform::LICM:        return false;
+  }
+  return false;
+}
+
+bool blocked(const LoopSummary &S, LoopTransform T) {
+  return !transformApplied(S, T) &&
+         llvm::any_of(S.Blockers,
+                      [&](const LoopBlocker &B) { return B.Transform == T; });
+}
+
+std::string loopLabel(const LoopSummary &S) {
+  std::string Label = "@" + S.Function + " ";
+  if (S.Loc.Line)
+    Label += llvm::sys::path::filename(S.Loc.File).str() + ":" +
+             std::to_string(S.Loc.Line);
+  else
+    Label += "%" + S.Header;
+  return Label;
+}
+
+std::string tripColumn(const LoopSummary &S) {
+  if (S.TripCount)
+    return std::to_string(*S.TripCount);
+  if (S.MaxTripCount)
+    return "<=" + std::to_string(*S.MaxTripCount);
+  return S.SymbolicTripCount.empty() ? "?" : "n";
+}
+
+std::string vectorizeColumn(const LoopSummary &S) {
+  if (S.vectorized()) {
+    std::string Col = "VF" + std::to_string(std::max(1u, S.VectorizationFactor));
+    if (S.InterleaveCount > 1)
+      Col += ",IC" + std::to_string(S.InterleaveCount);
+    return Col;
+  }
+  return blocked(S, LoopTransform::Vectorize) ? "blocked" : "-";
+}
+
+std::string unrollColumn(const LoopSummary &S) {
+  std::string Col;
+  if (S.FullyUnrolled)
+    Col = "full";
+  else if (S.UnrollCount > 1)
+    Col = "x" + std::to_string(S.UnrollCount);
+  if (S.PeelCount)
+    Col += (Col.empty() ? "" : ",") + ("peel " + std::to_string(S.PeelCount));
+  if (!Col.empty())
+    return Col;
+  return blocked(S, LoopTransform::Unroll) ? "blocked" : "-";
+}
+
+std::string licmColumn(const LoopSummary &S) {
+  unsigned Blocked = llvm::count_if(S.Blockers, [](const LoopBlocker &B) {
+    return B.Transform == LoopTransform::LICM;
+  });
+  std::string Col = S.LICMApplied ? std::to_string(S.LICMApplied) : "-";
+  if (Blocked)
+    Col += " (" + std::to_string(Blocked) + " blocked)";
+  return Col;
+}
+
+}
+
+llvm::StringRef loopTransformName(LoopTransform T) {
+  switch (T) {
+  case LoopTransform::Vectorize:   return "vectorize";
+  case LoopTransform::Unroll:      return "unroll";
+  case LoopTransform::Interchange: return "interchange";
+  case LoopTransform::LICM:        return "licm";
+  }
+  return "unknown";
+}
+
+LoopReport buildLoopReport(llvm::Module &Before, llvm::Module *After,
+                           llvm::ArrayRef<Remark> Remarks) {
+  ProfileScope PS("LoopReport");
+  LoopReport Report;
+  Report.HasOutput = After != nullptr;
+  llvm::TargetLibraryInfoImpl TLII{llvm::Triple(Before.getTargetTriple())};
+
+  for (llvm::Function &F : Before) {
+    if (F.isDeclaration())
+      continue;
+    llvm::Function *AfterF = After ? After->getFunction(F.getName()) : nullptr;
+    summarizeFunction(F, AfterF, TLII, Report.Loops);
+  }
+
+  llvm::StringMap<std::vector<size_t>> ByFunction;
+  for (size_t I = 0; I < Report.Loops.size(); ++I)
+    ByFunction[Report.Loops[I].Function].push_back(I);
+
+  for (const Remark &R : Remarks) {
+    if (R.IsMachine)
+      continue;
+    std::optional<LoopTransform> T = transformFor(R.PassName);
+    if (!T)
+      continue;
+    auto It = ByFunction.find(R.FunctionName);
+    LoopSummary *S = It == ByFunction.end()
+                         ? nullptr
+                         : matchLoop(R, Report.Loops, It->second);
+    if (!S) {
+      ++Report.UnmatchedRemarks;
+      continue;
+    }
+    applyRemark(R, *T, *S);
+  }
+  return Report;
+}
+
+void printLoopReport(const LoopReport &Report, llvm::raw_ostream &OS,
+                     bool Verbose) {
+  OS << "\n=== Loop Report ===\n";
+  if (Report.Loops.empty()) {
+    OS << "No loops in the input module.\n";
+    return;
+  }
+
+  OS << llvm::left_justify("Loop", 40) << llvm::right_justify("Depth", 6)
+     << llvm::right_justify("Trip", 12) << "  " << llvm::left_justify("Vector", 12)
+     << llvm::left_justify("Unroll", 12) << llvm::left_justify("Interchange", 13)
+     << llvm::left_justify("LICM", 16);
+  if (Report.HasOutput)
+    OS << "Output";
+  OS << "\n";
+
+  unsigned Vectorized = 0, Unrolled = 0, Blocked = 0;
+  for (const LoopSummary &S : Report.Loops) {
+    Vectorized += S.vectorized();
+    Unrolled   += S.unrolled();
+    Blocked    += llvm::any_of(S.Blockers, [&](const LoopBlocker &B) {
+      return blocked(S, B.Transform);
+    });
+
+    std::string Interchange = S.Interchanged ? "yes"
+                              : blocked(S, LoopTransform::Interchange)
+                                  ? "blocked"
+                                  : "-";
+    std::string Label(S.Depth - 1, ' ');
+    Label += loopLabel(S);
+    OS << llvm::left_justify(Label, 40)
+       << llvm::right_justify(std::to_string(S.Depth), 6)
+       << llvm::right_justify(tripColumn(S), 12) << "  "
+       << llvm::left_justify(vectorizeColumn(S), 12)
+       << llvm::left_justify(unrollColumn(S), 12)
+       << llvm::left_justify(Interchange, 13)
+       << llvm::left_justify(licmColumn(S), 16);
+    if (Report.HasOutput)
+      OS << (S.PresentAfter ? "kept" : "gone");
+    OS << "\n";
+  }
+  OS << Report.Loops.size() << " loops, " << Vectorized << " vectorized, "
+     << Unrolled << " unrolled, " << Blocked
+     << " with a blocked transformation";
+  if (Report.UnmatchedRemarks)
+    OS << ", " << Report.UnmatchedRemarks << " loop remarks matched no loop";
+  OS << ". Trip is the constant trip count, <=N a bound, n a symbolic count.\n";
+
+  for (const LoopSummary &S : Report.Loops) {
+    bool AnyBlocked = llvm::any_of(S.Blockers, [&](const LoopBlocker &B) {
+      return blocked(S, B.Transform);
+    });
+    if (!AnyBlocked && !Verbose)
+      continue;
+
+    OS << "\n  " << loopLabel(S) << "\n";
+    if (Verbose) {
+      OS << "    header %" << S.Header;
+      if (S.FirstLine)
+        OS << ", lines " << S.FirstLine << "-" << S.LastLine;
+      OS << ", " << S.InstructionsBefore << " instructions";
+      if (S.PresentAfter)
+        OS << " (" << S.InstructionsAfter << " after)";
+      OS << "\n";
+      if (!S.SymbolicTripCount.empty())
+        OS << "    backedge-taken count " << S.SymbolicTripCount << "\n";
+    }
+    for (const LoopBlocker &B : S.Blockers) {
+      if (!blocked(S, B.Transform))
+        continue;
+      std::string Message = B.Message;
+      if (!Verbose && Message.size() > 72)
+        Message = Message.substr(0, 69) + "...";
+      OS << "    " << llvm::left_justify(loopTransformName(B.Transform), 12)
+         << B.PassName << "/" << B.RemarkName << ": " << Message << "\n";
+    }
+  }
+}
+
+}
@@ -0,0 +1,256 @@
+#include "OptDebugger/MemoryReport.h"
+#include "OptDebugger/SelfProfile.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FormatVariadic.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace optdbg {
+
+namespace {
+
+std::atomic<bool> AccountingEnabled{false};
+
+struct BufferMarks {
+  std::mutex                Lock;
+  llvm::StringMap<uint64_t> Peak;
+};
+
+BufferMarks &bufferMarks() {
+  static BufferMarks B;
+  return B;
+}
+
+// a std::string allocates once it outgrows the inline buffer of an empty one
+uint64_t heapBytes(const std::string &S) {
+  static const size_t InlineCapacity = std::string().capacity();
+  return S.capacity() > InlineCapacity ? S.capacity() + 1 : 0;
+}
+
+template <typename T> uint64_t storageBytes(const std::vector<T> &V) {
+  return V.capacity() * sizeof(T);
+}
+
+void addLocation(const SourceLocation &L, MemoryCategory &C) {
+  C.Strings += heapBytes(L.File);
+}
+
+// opcode names always fit the inline buffer of OpcodeName
+void addRecord(const InstructionRecord &R, MemoryCategory &C) {
+  C.Strings += heapBytes(R.Text) + heapBytes(R.DebugLocStr);
+}
+
+// the function's own strings go to Functions, its blocks and instruction
+// records to the other two
+void addFunctionDiff(const FunctionDiff &FD, MemoryCategory &Functions,
+                     MemoryCategory &Blocks, MemoryCategory &Instructions) {
+  Functions.Strings += heapBytes(FD.FunctionName) +
+                       heapBytes(FD.BeforeSignature) +
+                       heapBytes(FD.AfterSignature);
+  Blocks.Records += storageBytes(FD.Blocks);
+  Blocks.Items += FD.Blocks.size();
+  for (const BlockDiff &BD : FD.Blocks) {
+    Blocks.Strings += heapBytes(BD.BlockName);
+    Instructions.Records += storageBytes(BD.Instructions);
+    Instructions.Items += BD.Instructions.size();
+    for (const InstructionDiff &ID : BD.Instructions) {
+      addRecord(ID.Before, Instructions);
+      addRecord(ID.After, Instructions);
+    }
+  }
+}
+
+uint64_t nameBytes(const llvm::Value &V) {
+  if (!V.hasName())
+    return 0;
+  return sizeof(llvm::StringMapEntry<llvm::Value *>) + V.getName().size() + 1;
+}
+
+// one Instruction plus its operand uses per instruction; subclasses with
+// extra members make this a lower bound
+void addModule(const llvm::Module &M, MemoryCategory &C) {
+  C.Records += sizeof(llvm::Module);
+  for (const llvm::GlobalVariable &G : M.globals()) {
+    C.Records += sizeof(llvm::GlobalVariable) + G.getNumOperands() * sizeof(llvm::Use);
+    C.Strings += nameBytes(G);
+  }
+  for (const llvm::Function &F : M) {
+    C.Records += sizeof(llvm::Function) + F.arg_size() * sizeof(llvm::Argument);
+    C.Strings += nameBytes(F);
+    for (const llvm::Argument &A : F.args())
+      C.Strings += nameBytes(A);
+    for (const llvm::BasicBlock &BB : F) {
+      C.Records += sizeof(llvm::BasicBlock);
+      C.Strings += nameBytes(BB);
+      for (const llvm::Instruction &I : BB) {
+        C.Records += sizeof(llvm::Instruction) +
+                     I.getNumOperands() * sizeof(llvm::Use);
+        C.Strings += nameBytes(I);
+        ++C.Items;
+      }
+    }
+  }
+}
+
+std::string formatBytes(uint64_t Bytes) {
+  if (Bytes >= (uint64_t(1) << 30))
+    return llvm::formatv("{0:F2} GB", Bytes / double(uint64_t(1) << 30)).str();
+  if (Bytes >= (uint64_t(1) << 20))
+    return llvm::formatv("{0:F1} MB", Bytes / double(uint64_t(1) << 20)).str();
+  if (Bytes >= 1024)
+    return llvm::formatv("{0:F1} KB", Bytes / 1024.0).str();
+  return std::to_string(Bytes) + " B";
+}
+
+}
+
+void MemoryAccounting::enable() { AccountingEnabled.store(true); }
+
+bool MemoryAccounting::isEnabled() {
+  return AccountingEnabled.load(std::memory_order_relaxed);
+}
+
+void MemoryAccounting::noteBuffer(llvm::StringRef Name, uint64_t Bytes) {
+  if (!isEnabled())
+    return;
+  BufferMarks &B = bufferMarks();
+  std::lock_guard<std::mutex> Lock(B.Lock);
+  uint64_t &Peak = B.Peak[Name];
+  Peak = std::max(Peak, Bytes);
+}
+
+std::vector<MemoryCategory>
+MemoryAccounting::measure(const AnalysisSession &Session) {
+  MemoryCategory Remarks{"Remarks"};
+  Remarks.Items   = Session.Remarks.size();
+  Remarks.Records = storageBytes(Session.Remarks);
+  for (const Remark &R : Session.Remarks) {
+    Remarks.Strings += heapBytes(R.PassName) + heapBytes(R.RemarkName) +
+                       heapBytes(R.FunctionName) + heapBytes(R.Message);
+    addLocation(R.Loc, Remarks);
+    Remarks.Records += storageBytes(R.Args);
+    for (const RemarkArgument &A : R.Args) {
+      Remarks.Strings += heapBytes(A.Key) + heapBytes(A.Value);
+      addLocation(A.Loc, Remarks);
+    }
+  }
+
+  MemoryCategory Functions{"IR diff: functions"};
+  MemoryCategory Blocks{"IR diff: blocks"};
+  MemoryCategory Instructions{"IR diff: instructions"};
+  Functions.Items   = Session.Diff.Functions.size();
+  Functions.Records = storageBytes(Session.Diff.Functions);
+  // diagnostics share these diffs; only ones the module diff lacks are charged
+  llvm::SmallPtrSet<const FunctionDiff *, 16> Charged;
+  for (const auto &FD : Session.Diff.Functions) {
+    Functions.Records += sizeof(FunctionDiff);
+    addFunctionDiff(*FD, Functions, Blocks, Instructions);
+    Charged.insert(FD.get());
+  }
+
+  MemoryCategory Diagnostics{"Diagnostics"};
+  Diagnostics.Items   = Session.Diagnostics.size();
+  Diagnostics.Records = storageBytes(Session.Diagnostics);
+  for (const DiagnosticResult &D : Session.Diagnostics) {
+    Diagnostics.Strings += heapBytes(D.RuleID) + heapBytes(D.PassName) +
+                           heapBytes(D.FunctionName) + heapBytes(D.ShortReason) +
+                           heapBytes(D.DetailedExplanation) +
+                           heapBytes(D.RootCause) +
+                           heapBytes(D.WhatOptimizerWanted);
+    addLocation(D.Location, Diagnostics);
+    Diagnostics.Records += storageBytes(D.Suggestions);
+    for (const FixSuggestion &S : D.Suggestions)
+      Diagnostics.Strings += heapBytes(S.Description) + heapBytes(S.CodeExample);
+    if (D.IRDiff && Charged.insert(D.IRDiff.get()).second) {
+      MemoryCategory Copy{"attached diff"};
+      addFunctionDiff(*D.IRDiff, Copy, Copy, Copy);
+      Diagnostics.Records += Copy.Records;
+      Diagnostics.Strings += Copy.Strings;
+    }
+  }
+
+  MemoryCategory IRText{"Printed IR"};
+  IRText.Items   = !Session.BeforeIR.empty() + !Session.AfterIR.empty();
+  IRText.Strings = heapBytes(Session.BeforeIR) + heapBytes(Session.AfterIR);
+
+  MemoryCategory Modules{"LLVM modules"};
+  Modules.Estimated = true;
+  if (Session.BeforeModule)
+    addModule(*Session.BeforeModule, Modules);
+  if (Session.AfterModule)
+    addModule(*Session.AfterModule, Modules);
+
+  MemoryCategory Other{"Session metadata"};
+  Other.Items   = Session.Metadata.size();
+  Other.Records = storageBytes(Session.Metadata);
+  Other.Strings = heapBytes(Session.PassPipelineUsed);
+  for (const auto &KV : Session.Metadata)
+    Other.Strings += heapBytes(KV.first) + heapBytes(KV.second);
+
+  MemoryCategory Buffers{"Report buffers"};
+  {
+    BufferMarks &B = bufferMarks();
+    std::lock_guard<std::mutex> Lock(B.Lock);
+    Buffers.Items = B.Peak.size();
+    for (const auto &P : B.Peak)
+      Buffers.Strings += P.getValue();
+  }
+
+  return {Remarks,  Functions, Blocks, Instructions, Diagnostics,
+          IRText,   Modules,   Other,  Buffers};
+}
+
+void MemoryAccounting::print(const AnalysisSession &Session,
+                             llvm::raw_ostream &OS) {
+  std::vector<MemoryCategory> Categories = measure(Session);
+  uint64_t Total = 0, TotalStrings = 0;
+  for (const MemoryCategory &C : Categories) {
+    Total += C.total();
+    TotalStrings += C.Strings;
+  }
+
+  OS << "\n=== Memory Report ===\n";
+  OS << llvm::left_justify("Subsystem", 24) << llvm::right_justify("Items", 10)
+     << llvm::right_justify("Records", 12) << llvm::right_justify("Strings", 12)
+     << llvm::right_justify("Total", 12) << llvm::right_justify("Share", 8)
+     << "\n";
+  for (const MemoryCategory &C : Categories) {
+    double Share = Total ? 100.0 * C.total() / Total : 0;
+    OS << llvm::left_justify(C.Name, 24)
+       << llvm::right_justify(std::to_string(C.Items), 10)
+       << llvm::right_justify(formatBytes(C.Records), 12)
+       << llvm::right_justify(formatBytes(C.Strings), 12)
+       << llvm::right_justify((C.Estimated ? "~" : "") + formatBytes(C.total()), 12)
+       << llvm::right_justify(llvm::formatv("{0:F1}%", Share).str(), 8) << "\n";
+  }
+
+  {
+    BufferMarks &B = bufferMarks();
+    std::lock_guard<std::mutex> Lock(B.Lock);
+    std::vector<std::pair<llvm::StringRef, uint64_t>> Marks;
+    for (const auto &P : B.Peak)
+      Marks.emplace_back(P.getKey(), P.getValue());
+    llvm::sort(Marks);
+    for (const auto &[Name, Bytes] : Marks)
+      OS << "  " << llvm::left_justify(Name, 56)
+         << llvm::right_justify(formatBytes(Bytes), 12) << " peak\n";
+  }
+
+  OS << "Accounted: " << formatBytes(Total) << " (" << formatBytes(TotalStrings)
+     << " in strings)";
+  if (uint64_t RSS = currentRSSKB())
+    OS << " of " << formatBytes(RSS * 1024) << " resident, peak "
+       << formatBytes(peakRSSKB() * 1024);
+  OS << "\n";
+}
+
+}
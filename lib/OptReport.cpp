@@ -1,6 +1,10 @@
 #include "OptDebugger/OptReport.h"
+#include "OptDebugger/SelfProfile.h"
 
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/WithColor.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Format.h"
@@ -25,6 +29,115 @@ llvm::raw_ostream::Colors colorForSeverity(SeverityLevel S) {
   return llvm::raw_ostream::WHITE;
 }
 
+// maps diff kinds to the stable lowercase names used in machine-readable output
+llvm::StringRef diffKindToString(DiffKind K) {
+  switch (K) {
+  case DiffKind::Unchanged: return "unchanged";
+  case DiffKind::Added:     return "added";
+  case DiffKind::Removed:   return "removed";
+  case DiffKind::Modified:  return "modified";
+  }
+  return "unchanged";
+}
+
+// opens a report file for writing, treating "-" as standard output
+std::unique_ptr<llvm::raw_fd_ostream>
+openReportFile(llvm::StringRef Path, llvm::StringRef What,
+               llvm::raw_ostream &StatusOS) {
+  std::error_code EC;
+  auto File = std::make_unique<llvm::raw_fd_ostream>(Path, EC,
+                                                     llvm::sys::fs::OF_Text);
+  if (EC) {
+    StatusOS << "Warning: could not write " << What << " report to '"
+             << Path << "': " << EC.message() << "\n";
+    return nullptr;
+  }
+  return File;
+}
+
+}
+
+// returns the most severe level that occurs at least once in the group
+SeverityLevel DiagnosticGroup::worstSeverity() const {
+  for (unsigned S = 0; S < 5; ++S)
+    if (SeverityCounts[S] > 0)
+      return static_cast<SeverityLevel>(S);
+  return SeverityLevel::Info;
+}
+
+// resolves the grouping requested on the command line; both flags nest function under pass
+GroupKey groupKeyFor(const ReportConfig &Cfg) {
+  if (Cfg.GroupByPass && Cfg.GroupByFunction)
+    return GroupKey::PassAndFunction;
+  if (Cfg.GroupByPass)
+    return GroupKey::Pass;
+  if (Cfg.GroupByFunction)
+    return GroupKey::Function;
+  return GroupKey::None;
+}
+
+// partitions diagnostic indices into groups with a single hashed pass, without copying results
+std::vector<DiagnosticGroup>
+groupDiagnostics(const std::vector<DiagnosticResult> &Diagnostics,
+                 GroupKey By, SeverityLevel MinSeverity) {
+  std::vector<DiagnosticGroup> Groups;
+  if (By == GroupKey::None)
+    return Groups;
+
+  llvm::StringMap<unsigned> GroupIndex;
+  std::string CompositeKey;
+  for (uint32_t I = 0, E = Diagnostics.size(); I != E; ++I) {
+    const DiagnosticResult &D = Diagnostics[I];
+    if (static_cast<int>(D.Severity) > static_cast<int>(MinSeverity))
+      continue;
+
+    llvm::StringRef Key;
+    switch (By) {
+    case GroupKey::Pass:
+      Key = D.PassName;
+      break;
+    case GroupKey::Function:
+      Key = D.FunctionName;
+      break;
+    case GroupKey::PassAndFunction:
+      CompositeKey = D.PassName + " @" + D.FunctionName;
+      Key = CompositeKey;
+      break;
+    case GroupKey::None:
+      break;
+    }
+
+    auto Inserted = GroupIndex.try_emplace(Key, Groups.size());
+    if (Inserted.second) {
+      Groups.emplace_back();
+      Groups.back().Key = By == GroupKey::Function ? "@" + Key.str()
+                                                   : Key.str();
+    }
+
+    DiagnosticGroup &G = Groups[Inserted.first->second];
+    G.Indices.push_back(I);
+    ++G.SeverityCounts[static_cast<int>(D.Severity)];
+    if (D.EstimatedSpeedup > 1.0)
+      G.EstimatedGain += D.EstimatedSpeedup - 1.0;
+  }
+
+  for (DiagnosticGroup &G : Groups)
+    std::stable_sort(G.Indices.begin(), G.Indices.end(),
+                     [&](uint32_t A, uint32_t B) {
+                       return ranksBefore(Diagnostics[A], Diagnostics[B]);
+                     });
+
+  // most severe groups first, then the ones with the largest estimated gain
+  std::stable_sort(Groups.begin(), Groups.end(),
+                   [](const DiagnosticGroup &A, const DiagnosticGroup &B) {
+                     if (A.worstSeverity() != B.worstSeverity())
+                       return static_cast<int>(A.worstSeverity()) <
+                              static_cast<int>(B.worstSeverity());
+                     if (A.EstimatedGain != B.EstimatedGain)
+                       return A.EstimatedGain > B.EstimatedGain;
+                     return A.Indices.size() > B.Indices.size();
+                   });
+  return Groups;
 }
 
 TerminalReporter::TerminalReporter(llvm::raw_ostream &OS, ReportConfig Config)
@@ -77,6 +190,8 @@ void TerminalReporter::printSummaryStats(const AnalysisSession &Session) {
   if (!D.hasChanges() && Session.Diagnostics.empty()) {
     printColoredLine("  No optimization opportunities detected.",
                      llvm::raw_ostream::GREEN);
+    if (Session.BaselineSuppressed > 0)
+      OS << "  Known (in baseline) : " << Session.BaselineSuppressed << "\n";
     OS << "\n";
     return;
   }
@@ -148,8 +263,62 @@ void TerminalReporter::printSummaryStats(const AnalysisSession &Session) {
       if (Cfg.UseColor) OS.resetColor();
       OS << "\n";
     }
+    if (Session.BaselineSuppressed > 0)
+      OS << "  Known (in baseline) : " << Session.BaselineSuppressed << "\n";
+    OS << "\n";
+  }
+}
+
+// lists the functions the codegen stage lowered, those with the most stack
+// traffic first; without --verbose only the top rows are shown
+void TerminalReporter::printMachineStats(const AnalysisSession &Session) {
+  if (Session.MachineFunctions.empty())
+    return;
+  constexpr size_t MaxRows = 15;
+
+  std::vector<const MachineFunctionStats *> Rows;
+  for (const MachineFunctionStats &M : Session.MachineFunctions)
+    Rows.push_back(&M);
+  std::stable_sort(Rows.begin(), Rows.end(),
+                   [](const MachineFunctionStats *A,
+                      const MachineFunctionStats *B) {
+                     if (A->spillsAndReloads() != B->spillsAndReloads())
+                       return A->spillsAndReloads() > B->spillsAndReloads();
+                     return A->CodeBytes > B->CodeBytes;
+                   });
+
+  printSeparator('-');
+  printColoredLine("  Machine Code", llvm::raw_ostream::CYAN);
+  printSeparator('-');
+  OS << "  " << llvm::left_justify("Function", 32)
+     << llvm::right_justify("Spills", 8) << llvm::right_justify("Reloads", 9)
+     << llvm::right_justify("Folded", 8) << llvm::right_justify("Stack", 8)
+     << llvm::right_justify("Instrs", 8) << llvm::right_justify("Bytes", 8)
+     << "\n";
+  size_t Shown = Cfg.Verbose ? Rows.size() : std::min(Rows.size(), MaxRows);
+  for (size_t I = 0; I < Shown; ++I) {
+    const MachineFunctionStats &M = *Rows[I];
+    unsigned Folded = M.FoldedSpills + M.FoldedReloads;
+    llvm::StringRef Name = M.Function;
+    if (Name.size() > 31)
+      Name = Name.take_front(31);
+    if (Cfg.UseColor && M.spillsAndReloads() > 0)
+      OS.changeColor(llvm::raw_ostream::YELLOW);
+    OS << "  " << llvm::left_justify(Name, 32)
+       << llvm::right_justify(std::to_string(M.Spills), 8)
+       << llvm::right_justify(std::to_string(M.Reloads), 9)
+       << llvm::right_justify(std::to_string(Folded), 8)
+       << llvm::right_justify(std::to_string(M.StackBytes), 8)
+       << llvm::right_justify(std::to_string(M.Instructions), 8)
+       << llvm::right_justify(std::to_string(M.CodeBytes), 8);
+    if (Cfg.UseColor && M.spillsAndReloads() > 0)
+      OS.resetColor();
     OS << "\n";
   }
+  if (Shown < Rows.size())
+    OS << "  ... " << (Rows.size() - Shown)
+       << " more functions (--verbose lists all)\n";
+  OS << "\n";
 }
 
 // formats the localized context and severity header for a single compiler diagnostic
@@ -180,6 +349,9 @@ void TerminalReporter::printDiagnosticHeader(const DiagnosticResult &D) {
     if (Cfg.UseColor) OS.changeColor(llvm::raw_ostream::GREEN);
     OS << llvm::format("%.1fx", D.EstimatedSpeedup);
     if (Cfg.UseColor) OS.resetColor();
+    if (D.SpeedupModeled)
+      OS << llvm::format(" (cost model: %.0f cycles/call saved)",
+                         D.ModeledCyclesSaved);
     OS << "\n";
   }
 }
@@ -345,14 +517,53 @@ void TerminalReporter::printDiagnostic(const DiagnosticResult &D) {
   OS << "\n";
 }
 
-// implements a stable sort to order diagnostics from highest to lowest severity
-void TerminalReporter::sortAndFilter(
-    std::vector<DiagnosticResult> &Results) const {
-  std::stable_sort(
-      Results.begin(), Results.end(),
-      [](const DiagnosticResult &A, const DiagnosticResult &B) {
-        return static_cast<int>(A.Severity) < static_cast<int>(B.Severity);
-      });
+// returns the indices of reportable diagnostics, stably ordered from highest to lowest severity
+std::vector<uint32_t> TerminalReporter::sortAndFilter(
+    const std::vector<DiagnosticResult> &Results) const {
+  std::vector<uint32_t> Order;
+  Order.reserve(Results.size());
+  for (uint32_t I = 0, E = Results.size(); I != E; ++I)
+    if (static_cast<int>(Results[I].Severity) <=
+        static_cast<int>(Cfg.MinSeverity))
+      Order.push_back(I);
+
+  std::stable_sort(Order.begin(), Order.end(), [&](uint32_t A, uint32_t B) {
+    return ranksBefore(Results[A], Results[B]);
+  });
+  return Order;
+}
+
+// prints one line per group so large sessions can be scanned before reading details
+void TerminalReporter::printGroupOverview(
+    const std::vector<DiagnosticGroup> &Groups) {
+  printSeparator('-');
+  printColoredLine("  Groups", llvm::raw_ostream::CYAN);
+  printSeparator('-');
+  OS << "  count  crit  high   med   low  info  est-gain  key\n";
+  for (const DiagnosticGroup &G : Groups) {
+    OS << llvm::format("  %5zu %5u %5u %5u %5u %5u %8.0f%%  ", G.Indices.size(),
+                       G.SeverityCounts[0], G.SeverityCounts[1],
+                       G.SeverityCounts[2], G.SeverityCounts[3],
+                       G.SeverityCounts[4], G.EstimatedGain * 100)
+       << G.Key << "\n";
+  }
+  OS << "\n";
+}
+
+// prints the banner that introduces the diagnostics of a single group
+void TerminalReporter::printGroupHeader(const DiagnosticGroup &G) {
+  printSeparator('#');
+  if (Cfg.UseColor)
+    OS.changeColor(colorForSeverity(G.worstSeverity()), true);
+  OS << "  " << G.Key;
+  if (Cfg.UseColor)
+    OS.resetColor();
+  OS << "  (" << G.Indices.size() << " diagnostic"
+     << (G.Indices.size() == 1 ? "" : "s");
+  if (G.EstimatedGain > 0.0)
+    OS << llvm::format(", estimated gain +%.0f%%", G.EstimatedGain * 100);
+  OS << ")\n";
+  printSeparator('#');
 }
 
 // renders the trailing execution summary and hints for terminal output
@@ -369,6 +580,7 @@ void TerminalReporter::printFooter(const AnalysisSession &Session) {
 void TerminalReporter::report(const AnalysisSession &Session) {
   printHeader(Session);
   printSummaryStats(Session);
+  printMachineStats(Session);
 
   if (Session.Diagnostics.empty()) {
     printColoredLine("  No missed optimizations found for the specified passes.",
@@ -377,16 +589,22 @@ void TerminalReporter::report(const AnalysisSession &Session) {
     return;
   }
 
-  auto Diagnostics = Session.Diagnostics;
-  sortAndFilter(Diagnostics);
-
-  for (const DiagnosticResult &D : Diagnostics) {
-    if (Cfg.ShowOnlyMissed && !D.PassName.empty())
-      printDiagnostic(D);
-    else
-      printDiagnostic(D);
+  GroupKey By = groupKeyFor(Cfg);
+  if (By != GroupKey::None) {
+    auto Groups = groupDiagnostics(Session.Diagnostics, By, Cfg.MinSeverity);
+    printGroupOverview(Groups);
+    for (const DiagnosticGroup &G : Groups) {
+      printGroupHeader(G);
+      for (uint32_t I : G.Indices)
+        printDiagnostic(Session.Diagnostics[I]);
+    }
+    printFooter(Session);
+    return;
   }
 
+  for (uint32_t I : sortAndFilter(Session.Diagnostics))
+    printDiagnostic(Session.Diagnostics[I]);
+
   printFooter(Session);
 }
 
@@ -669,8 +887,24 @@ void HTMLReporter::report(const AnalysisSession &Session,
   OS << "  <div class=\"nav-group-label\">Navigation</div>\n";
   OS << "  <a href=\"#summary\" class=\"nav-item\">Executive Summary</a>\n";
   
+  GroupKey By = groupKeyFor(Cfg);
+  std::vector<DiagnosticGroup> Groups =
+      groupDiagnostics(Session.Diagnostics, By, Cfg.MinSeverity);
+
   int Idx = 0;
-  if (!Session.Diagnostics.empty()) {
+  if (By != GroupKey::None) {
+    unsigned GroupIdx = 0;
+    for (const DiagnosticGroup &G : Groups) {
+      OS << "  <a href=\"#group-" << GroupIdx++ << "\" class=\"nav-group-label\""
+         << " style=\"display:block;text-decoration:none\">"
+         << escapeHTML(G.Key) << " (" << G.Indices.size() << ")</a>\n";
+      for (uint32_t I : G.Indices) {
+        const DiagnosticResult &D = Session.Diagnostics[I];
+        OS << "  <a href=\"#diag-" << I << "\" class=\"nav-item\">"
+           << escapeHTML(D.PassName) << ": " << escapeHTML(D.ShortReason) << "</a>\n";
+      }
+    }
+  } else if (!Session.Diagnostics.empty()) {
     OS << "  <div class=\"nav-group-label\">Missed Optimizations</div>\n";
     for (const DiagnosticResult &D : Session.Diagnostics) {
       std::string Target = "diag-" + std::to_string(Idx++);
@@ -688,40 +922,571 @@ void HTMLReporter::report(const AnalysisSession &Session,
   emitSummary(Session);
   OS << "  </div>\n";
 
-  Idx = 0;
-  for (const DiagnosticResult &D : Session.Diagnostics) {
-    std::string Target = "diag-" + std::to_string(Idx++);
-    OS << "<div id=\"" << Target << "\"></div>\n";
-    emitDiagnostic(D, Cfg);
+  if (By != GroupKey::None) {
+    unsigned GroupIdx = 0;
+    for (const DiagnosticGroup &G : Groups) {
+      OS << "<div id=\"group-" << GroupIdx++ << "\"></div>\n";
+      emitGroupHeader(G);
+      for (uint32_t I : G.Indices) {
+        OS << "<div id=\"diag-" << I << "\"></div>\n";
+        emitDiagnostic(Session.Diagnostics[I], Cfg);
+      }
+    }
+  } else {
+    Idx = 0;
+    for (const DiagnosticResult &D : Session.Diagnostics) {
+      std::string Target = "diag-" + std::to_string(Idx++);
+      OS << "<div id=\"" << Target << "\"></div>\n";
+      emitDiagnostic(D, Cfg);
+    }
   }
 
   OS << "</div>\n";
   emitFooter();
 }
 
-// triggers the dual-stage reporting sequence emitting both terminal text and optionally an html dashboard
+// renders a section heading with the group's size, severity histogram and estimated gain
+void HTMLReporter::emitGroupHeader(const DiagnosticGroup &G) {
+  static const char *const Labels[] = {"Critical", "High", "Medium", "Low",
+                                       "Info"};
+  OS << "<h1 style=\"margin-top:2.5rem\">" << escapeHTML(G.Key) << "</h1>\n";
+  OS << "<div class=\"label-group\">\n";
+  OS << "  <div class=\"label\">" << G.Indices.size() << " diagnostics</div>\n";
+  for (unsigned S = 0; S < 5; ++S)
+    if (G.SeverityCounts[S] > 0)
+      OS << "  <div class=\"label\">" << Labels[S] << ": "
+         << G.SeverityCounts[S] << "</div>\n";
+  if (G.EstimatedGain > 0.0) {
+    std::ostringstream SS;
+    SS << std::fixed << std::setprecision(0) << G.EstimatedGain * 100;
+    OS << "  <div class=\"label\" style=\"color:var(--green)\">Estimated Gain: +"
+       << SS.str() << "%</div>\n";
+  }
+  OS << "</div>\n";
+}
+
+JSONReporter::JSONReporter(llvm::raw_ostream &OS, JSONFormat Format)
+    : OS(OS), Format(Format) {}
+
+// writes a source location as a nested object, omitting it entirely when unknown
+void JSONReporter::writeLocation(llvm::json::OStream &J, llvm::StringRef Key,
+                                 const SourceLocation &Loc) {
+  if (!Loc.isValid())
+    return;
+  J.attributeObject(Key, [&] {
+    J.attribute("file", Loc.File);
+    J.attribute("line", Loc.Line);
+    J.attribute("column", Loc.Column);
+  });
+}
+
+// writes the pipeline metadata that identifies where the following records came from
+void JSONReporter::writeSession(llvm::json::OStream &J,
+                                const AnalysisSession &Session) {
+  J.attribute("pipeline", Session.PassPipelineUsed);
+  J.attribute("verification_failed", Session.VerificationFailed);
+  if (Session.Metadata.empty())
+    return;
+  J.attributeObject("metadata", [&] {
+    for (const auto &KV : Session.Metadata)
+      J.attribute(KV.first, KV.second);
+  });
+}
+
+// writes a single raw optimization remark including all of its structured arguments
+void JSONReporter::writeRemark(llvm::json::OStream &J, const Remark &R) {
+  J.attribute("kind", remarkKindName(R.Kind));
+  J.attribute("pass", R.PassName);
+  J.attribute("name", R.RemarkName);
+  J.attribute("function", R.FunctionName);
+  writeLocation(J, "location", R.Loc);
+  J.attribute("message", R.Message);
+  if (R.Hotness)
+    J.attribute("hotness", static_cast<double>(*R.Hotness));
+  if (R.IsMachine)
+    J.attribute("machine", true);
+  if (R.Args.empty())
+    return;
+  J.attributeArray("args", [&] {
+    for (const RemarkArgument &A : R.Args) {
+      J.object([&] {
+        J.attribute("key", A.Key);
+        J.attribute("value", A.Value);
+        writeLocation(J, "location", A.Loc);
+      });
+    }
+  });
+}
+
+// writes the changed blocks of a function diff, skipping unchanged instructions unless verbose
+void JSONReporter::writeFunctionDiff(llvm::json::OStream &J,
+                                     const FunctionDiff &FD, bool Verbose) {
+  J.attribute("function", FD.FunctionName);
+  J.attribute("kind", diffKindToString(FD.Kind));
+  J.attribute("before_blocks", static_cast<int64_t>(FD.BeforeBlockCount));
+  J.attribute("after_blocks", static_cast<int64_t>(FD.AfterBlockCount));
+  J.attribute("before_instructions", static_cast<int64_t>(FD.BeforeInstrCount));
+  J.attribute("after_instructions", static_cast<int64_t>(FD.AfterInstrCount));
+  if (FD.SignatureChanged)
+    J.attribute("signature_changed", true);
+  if (FD.AttributesChanged)
+    J.attribute("attributes_changed", true);
+
+  J.attributeArray("blocks", [&] {
+    for (const BlockDiff &BD : FD.Blocks) {
+      if (BD.Kind == DiffKind::Unchanged)
+        continue;
+      J.object([&] {
+        J.attribute("name", BD.BlockName);
+        J.attribute("kind", diffKindToString(BD.Kind));
+        J.attributeArray("instructions", [&] {
+          for (const InstructionDiff &ID : BD.Instructions) {
+            if (ID.Kind == DiffKind::Unchanged && !Verbose)
+              continue;
+            J.object([&] {
+              J.attribute("kind", diffKindToString(ID.Kind));
+              if (ID.Kind != DiffKind::Added)
+                J.attribute("before", ID.Before.Text);
+              if (ID.Kind != DiffKind::Removed &&
+                  ID.Kind != DiffKind::Unchanged)
+                J.attribute("after", ID.After.Text);
+            });
+          }
+        });
+      });
+    }
+  });
+}
+
+// writes one diagnostic; the ir diff is referenced by function name rather than repeated
+void JSONReporter::writeDiagnostic(llvm::json::OStream &J,
+                                   const DiagnosticResult &D,
+                                   const ReportConfig &Cfg) {
+  J.attribute("severity", severityToString(D.Severity));
+  J.attribute("rule", D.RuleID);
+  J.attribute("pass", D.PassName);
+  J.attribute("function", D.FunctionName);
+  writeLocation(J, "location", D.Location);
+  J.attribute("reason", D.ShortReason);
+  J.attribute("root_cause", D.RootCause);
+  J.attribute("optimizer_intent", D.WhatOptimizerWanted);
+  if (Cfg.Verbose)
+    J.attribute("explanation", D.DetailedExplanation);
+  J.attribute("estimated_speedup", D.EstimatedSpeedup);
+  if (D.SpeedupModeled)
+    J.attribute("modeled_cycles_saved", D.ModeledCyclesSaved);
+  if (D.IsMachine)
+    J.attribute("machine", true);
+  if (D.Hotness)
+    J.attribute("hotness", static_cast<double>(*D.Hotness));
+  J.attribute("has_ir_diff", D.IRDiff != nullptr);
+
+  if (!Cfg.ShowSuggestions || D.Suggestions.empty())
+    return;
+  J.attributeArray("suggestions", [&] {
+    unsigned Count = 0;
+    for (const FixSuggestion &Fix : D.Suggestions) {
+      if (Count++ >= Cfg.MaxSuggestions)
+        break;
+      J.object([&] {
+        J.attribute("description", Fix.Description);
+        if (!Fix.CodeExample.empty())
+          J.attribute("code", Fix.CodeExample);
+        J.attribute("source_level", Fix.IsSourceLevel);
+        J.attribute("ir_level", Fix.IsIRLevel);
+      });
+    }
+  });
+}
+
+// writes the trailing aggregate counters so consumers can validate a complete stream
+void JSONReporter::writeSummary(llvm::json::OStream &J,
+                                const AnalysisSession &Session) {
+  const ModuleDiff &D = Session.Diff;
+  size_t Missed = 0, Applied = 0;
+  for (const Remark &R : Session.Remarks) {
+    if (R.isMissed()) ++Missed;
+    else if (R.isApplied()) ++Applied;
+  }
+
+  int64_t BySeverity[5] = {0, 0, 0, 0, 0};
+  for (const DiagnosticResult &DR : Session.Diagnostics)
+    ++BySeverity[static_cast<int>(DR.Severity)];
+
+  J.attribute("remarks", static_cast<int64_t>(Session.Remarks.size()));
+  J.attribute("missed", static_cast<int64_t>(Missed));
+  J.attribute("applied", static_cast<int64_t>(Applied));
+  J.attribute("diagnostics", static_cast<int64_t>(Session.Diagnostics.size()));
+  J.attribute("baseline_suppressed",
+              static_cast<int64_t>(Session.BaselineSuppressed));
+  J.attributeObject("severity", [&] {
+    for (SeverityLevel S : {SeverityLevel::Critical, SeverityLevel::High,
+                            SeverityLevel::Medium, SeverityLevel::Low,
+                            SeverityLevel::Info})
+      J.attribute(severityToString(S).lower(),
+                  BySeverity[static_cast<int>(S)]);
+  });
+  J.attribute("functions_added", static_cast<int64_t>(D.AddedFunctions));
+  J.attribute("functions_removed", static_cast<int64_t>(D.RemovedFunctions));
+  J.attribute("functions_modified", static_cast<int64_t>(D.ModifiedFunctions));
+  J.attribute("functions_unchanged", static_cast<int64_t>(D.UnchangedFunctions));
+  J.attribute("instructions_before",
+              static_cast<int64_t>(D.TotalBeforeInstructions));
+  J.attribute("instructions_after",
+              static_cast<int64_t>(D.TotalAfterInstructions));
+}
+
+// writes the codegen stage's numbers for one function
+void JSONReporter::writeMachineFunction(llvm::json::OStream &J,
+                                        const MachineFunctionStats &M) {
+  J.attribute("function", M.Function);
+  J.attribute("spills", static_cast<int64_t>(M.Spills));
+  J.attribute("reloads", static_cast<int64_t>(M.Reloads));
+  J.attribute("folded_spills", static_cast<int64_t>(M.FoldedSpills));
+  J.attribute("folded_reloads", static_cast<int64_t>(M.FoldedReloads));
+  J.attribute("stack_bytes", static_cast<int64_t>(M.StackBytes));
+  J.attribute("instructions", static_cast<int64_t>(M.Instructions));
+  J.attribute("code_bytes", static_cast<int64_t>(M.CodeBytes));
+}
+
+// emits one record either as its own ndjson line or as the next element of the open array
+void JSONReporter::emitRecord(
+    llvm::StringRef Type,
+    llvm::function_ref<void(llvm::json::OStream &)> Body) {
+  if (Format == JSONFormat::Document) {
+    Doc->object([&] { Body(*Doc); });
+    return;
+  }
+
+  llvm::json::OStream J(OS);
+  J.object([&] {
+    J.attribute("type", Type);
+    Body(J);
+  });
+  OS << "\n";
+}
+
+// opens a named top-level array when producing a single json document
+void JSONReporter::beginSection(llvm::StringRef Name) {
+  if (Format != JSONFormat::Document)
+    return;
+  Doc->attributeBegin(Name);
+  Doc->arrayBegin();
+}
+
+// closes the array opened by beginsection
+void JSONReporter::endSection() {
+  if (Format != JSONFormat::Document)
+    return;
+  Doc->arrayEnd();
+  Doc->attributeEnd();
+}
+
+// streams the whole session; memory use is independent of the number of records
+void JSONReporter::report(const AnalysisSession &Session,
+                          const ReportConfig    &Cfg) {
+  if (Format == JSONFormat::Document) {
+    Doc = std::make_unique<llvm::json::OStream>(OS);
+    Doc->objectBegin();
+    Doc->attributeObject("session", [&] { writeSession(*Doc, Session); });
+  } else {
+    emitRecord("session", [&](llvm::json::OStream &J) {
+      writeSession(J, Session);
+    });
+  }
+
+  beginSection("remarks");
+  for (const Remark &R : Session.Remarks) {
+    if (Cfg.ShowOnlyMissed && R.isApplied())
+      continue;
+    emitRecord("remark", [&](llvm::json::OStream &J) { writeRemark(J, R); });
+  }
+  endSection();
+
+  beginSection("functions");
+  if (Cfg.ShowDiff) {
+    for (const auto &FD : Session.Diff.Functions) {
+      if (FD->Kind == DiffKind::Unchanged)
+        continue;
+      emitRecord("function_diff", [&](llvm::json::OStream &J) {
+        writeFunctionDiff(J, *FD, Cfg.Verbose);
+      });
+    }
+  }
+  endSection();
+
+  if (!Session.MachineFunctions.empty()) {
+    beginSection("machine_functions");
+    for (const MachineFunctionStats &M : Session.MachineFunctions)
+      emitRecord("machine_function", [&](llvm::json::OStream &J) {
+        writeMachineFunction(J, M);
+      });
+    endSection();
+  }
+
+  beginSection("diagnostics");
+  for (const DiagnosticResult &D : Session.Diagnostics) {
+    if (static_cast<int>(D.Severity) > static_cast<int>(Cfg.MinSeverity))
+      continue;
+    emitRecord("diagnostic", [&](llvm::json::OStream &J) {
+      writeDiagnostic(J, D, Cfg);
+    });
+  }
+  endSection();
+
+  if (Format == JSONFormat::Document) {
+    Doc->attributeObject("summary", [&] { writeSummary(*Doc, Session); });
+    Doc->objectEnd();
+    Doc.reset();
+    OS << "\n";
+  } else {
+    emitRecord("summary", [&](llvm::json::OStream &J) {
+      writeSummary(J, Session);
+    });
+  }
+  OS.flush();
+}
+
+SARIFReporter::SARIFReporter(llvm::raw_ostream &OS,
+                             const PatternDB *UserPatterns)
+    : OS(OS) {
+  Rules.setUserPatterns(UserPatterns);
+}
+
+// maps severities onto the three sarif result levels used by review tooling
+llvm::StringRef SARIFReporter::severityToSARIFLevel(SeverityLevel S) {
+  switch (S) {
+  case SeverityLevel::Critical:
+  case SeverityLevel::High:   return "error";
+  case SeverityLevel::Medium: return "warning";
+  case SeverityLevel::Low:
+  case SeverityLevel::Info:   return "note";
+  }
+  return "note";
+}
+
+// converts a debug-info file path into a relative uri reference as sarif requires
+std::string SARIFReporter::pathToURI(llvm::StringRef Path) {
+  std::string URI;
+  URI.reserve(Path.size());
+  for (char C : Path) {
+    if (C == '\\')
+      URI += '/';
+    else if (C == ' ' || C == '%' || C == '#' || C == '?')
+      URI += "%" + llvm::utohexstr(static_cast<unsigned char>(C), false, 2);
+    else
+      URI += C;
+  }
+  return URI;
+}
+
+// describes a rule once from its pattern; the fixes are the pattern's, so
+// they are taken from the first occurrence
+void SARIFReporter::writeRule(llvm::json::OStream &J,
+                              const DiagnosticResult &First,
+                              const RuleDescription &Rule,
+                              const ReportConfig &Cfg) {
+  J.object([&] {
+    J.attribute("id", First.RuleID);
+    J.attributeObject("shortDescription",
+                      [&] { J.attribute("text", Rule.ShortDescription); });
+    J.attributeObject("fullDescription",
+                      [&] { J.attribute("text", Rule.FullDescription); });
+
+    if (!First.Suggestions.empty()) {
+      std::string Text, Markdown;
+      unsigned Count = 0;
+      for (const FixSuggestion &Fix : First.Suggestions) {
+        if (Count++ >= Cfg.MaxSuggestions)
+          break;
+        Text += std::to_string(Count) + ". " + Fix.Description + "\n";
+        Markdown += "- " + Fix.Description + "\n";
+        if (!Fix.CodeExample.empty())
+          Markdown += "\n  ```\n  " + Fix.CodeExample + "\n  ```\n";
+      }
+      J.attributeObject("help", [&] {
+        J.attribute("text", Text);
+        J.attribute("markdown", Markdown);
+      });
+    }
+
+    J.attributeObject("defaultConfiguration", [&] {
+      J.attribute("level", severityToSARIFLevel(Rule.DefaultSeverity));
+    });
+    J.attributeObject("properties", [&] {
+      J.attribute("pass", First.PassName);
+      J.attribute("whatOptimizerWanted", Rule.WhatOptimizerWanted);
+    });
+  });
+}
+
+// writes one occurrence as a rule reference plus its physical and logical
+// location; the explanation is repeated only when placeholders changed it
+void SARIFReporter::writeResult(llvm::json::OStream &J,
+                                const DiagnosticResult &D,
+                                unsigned RuleIndex,
+                                const RuleDescription &Rule) {
+  J.object([&] {
+    J.attribute("ruleId", D.RuleID);
+    J.attribute("ruleIndex", RuleIndex);
+    J.attribute("level", severityToSARIFLevel(D.Severity));
+    J.attributeObject("message", [&] { J.attribute("text", D.RootCause); });
+
+    J.attributeArray("locations", [&] {
+      J.object([&] {
+        if (D.Location.isValid()) {
+          J.attributeObject("physicalLocation", [&] {
+            J.attributeObject("artifactLocation", [&] {
+              J.attribute("uri", pathToURI(D.Location.File));
+            });
+            if (D.Location.Line > 0) {
+              J.attributeObject("region", [&] {
+                J.attribute("startLine", D.Location.Line);
+                if (D.Location.Column > 0)
+                  J.attribute("startColumn", D.Location.Column);
+              });
+            }
+          });
+        }
+        J.attributeArray("logicalLocations", [&] {
+          J.object([&] {
+            J.attribute("name", D.FunctionName);
+            J.attribute("kind", "function");
+          });
+        });
+      });
+    });
+
+    bool Interpolated = D.DetailedExplanation != Rule.FullDescription;
+    if (D.EstimatedSpeedup > 0.0 || D.IsMachine || Interpolated) {
+      J.attributeObject("properties", [&] {
+        if (Interpolated)
+          J.attribute("explanation", D.DetailedExplanation);
+        if (D.EstimatedSpeedup > 0.0)
+          J.attribute("estimatedSpeedup", D.EstimatedSpeedup);
+        if (D.SpeedupModeled && D.ModeledCyclesSaved > 0.0)
+          J.attribute("modeledCyclesSaved", D.ModeledCyclesSaved);
+        if (D.IsMachine)
+          J.attribute("machine", true);
+      });
+    }
+  });
+}
+
+// builds the rule table in a first pass over the diagnostics, then streams rules and results
+void SARIFReporter::report(const AnalysisSession &Session,
+                           const ReportConfig    &Cfg) {
+  auto IsReported = [&](const DiagnosticResult &D) {
+    return static_cast<int>(D.Severity) <= static_cast<int>(Cfg.MinSeverity);
+  };
+
+  llvm::StringMap<unsigned> RuleIndex;
+  std::vector<const DiagnosticResult *> RuleFirst;
+  std::vector<RuleDescription> RuleText;
+  for (const DiagnosticResult &D : Session.Diagnostics) {
+    if (!IsReported(D))
+      continue;
+    auto Inserted = RuleIndex.try_emplace(D.RuleID, RuleFirst.size());
+    if (Inserted.second) {
+      RuleFirst.push_back(&D);
+      RuleText.push_back(Rules.describeRule(D));
+    }
+  }
+
+  llvm::json::OStream J(OS);
+  J.object([&] {
+    J.attribute("$schema", "https://json.schemastore.org/sarif-2.1.0.json");
+    J.attribute("version", "2.1.0");
+    J.attributeArray("runs", [&] {
+      J.object([&] {
+        J.attributeObject("tool", [&] {
+          J.attributeObject("driver", [&] {
+            J.attribute("name", "Aion");
+            J.attribute("fullName", "Aion LLVM Optimization Failure Debugger");
+            J.attribute("version", AionVersion);
+            J.attributeArray("rules", [&] {
+              for (size_t I = 0; I < RuleFirst.size(); ++I)
+                writeRule(J, *RuleFirst[I], RuleText[I], Cfg);
+            });
+          });
+        });
+
+        J.attributeArray("results", [&] {
+          for (const DiagnosticResult &D : Session.Diagnostics) {
+            if (!IsReported(D))
+              continue;
+            unsigned Index = RuleIndex.lookup(D.RuleID);
+            writeResult(J, D, Index, RuleText[Index]);
+          }
+        });
+
+        J.attributeObject("properties", [&] {
+          J.attribute("pipeline", Session.PassPipelineUsed);
+        });
+      });
+    });
+  });
+  OS << "\n";
+  OS.flush();
+}
+
+// triggers the reporting sequence emitting terminal text and any requested file-based reports
 void generateReport(const AnalysisSession &Session,
                     const ReportConfig    &Cfg,
                     llvm::raw_ostream     &TerminalOS,
-                    llvm::StringRef        HTMLOutputPath) {
-  TerminalReporter TR(TerminalOS, Cfg);
-  TR.report(Session);
+                    const ReportOutputs   &Outputs) {
+  llvm::raw_ostream &StatusOS =
+      Outputs.EmitTerminal ? TerminalOS : llvm::errs();
+
+  if (Outputs.EmitTerminal) {
+    ProfileScope PS("ReportTerminal");
+    TerminalReporter TR(TerminalOS, Cfg);
+    TR.report(Session);
+  }
 
-  if (HTMLOutputPath.empty())
-    return;
+  if (!Outputs.HTMLPath.empty()) {
+    if (auto HTMLFile = openReportFile(Outputs.HTMLPath, "HTML", StatusOS)) {
+      ProfileScope PS("ReportHTML");
+      HTMLReporter HR(*HTMLFile);
+      if (Outputs.HTMLChunked) {
+        llvm::SmallString<256> DataDir(
+            llvm::sys::path::parent_path(Outputs.HTMLPath));
+        llvm::sys::path::append(DataDir,
+                                llvm::sys::path::stem(Outputs.HTMLPath) +
+                                    "_data");
+        if (auto Err = HR.reportChunked(Session, Cfg, DataDir)) {
+          StatusOS << "Warning: could not write HTML report data: "
+                   << llvm::toString(std::move(Err)) << "\n";
+        } else {
+          StatusOS << "HTML report written to: " << Outputs.HTMLPath
+                   << " (data in " << DataDir << ")\n";
+        }
+      } else {
+        HR.report(Session, Cfg);
+        StatusOS << "HTML report written to: " << Outputs.HTMLPath << "\n";
+      }
+    }
+  }
 
-  std::error_code EC;
-  llvm::raw_fd_ostream HTMLFile(HTMLOutputPath, EC,
-                                 llvm::sys::fs::OF_Text);
-  if (EC) {
-    TerminalOS << "Warning: could not write HTML report to '"
-               << HTMLOutputPath << "': " << EC.message() << "\n";
-    return;
+  if (!Outputs.JSONPath.empty()) {
+    if (auto JSONFile = openReportFile(Outputs.JSONPath, "JSON", StatusOS)) {
+      ProfileScope PS("ReportJSON");
+      JSONReporter JR(*JSONFile, Outputs.JSONStyle);
+      JR.report(Session, Cfg);
+      if (Outputs.JSONPath != "-")
+        StatusOS << "JSON report written to: " << Outputs.JSONPath << "\n";
+    }
   }
 
-  HTMLReporter HR(HTMLFile);
-  HR.report(Session, Cfg);
-  TerminalOS << "HTML report written to: " << HTMLOutputPath << "\n";
+  if (!Outputs.SARIFPath.empty()) {
+    if (auto SARIFFile = openReportFile(Outputs.SARIFPath, "SARIF", StatusOS)) {
+      ProfileScope PS("ReportSARIF");
+      SARIFReporter SR(*SARIFFile, Outputs.UserPatterns);
+      SR.report(Session, Cfg);
+      if (Outputs.SARIFPath != "-")
+        StatusOS << "SARIF report written to: " << Outputs.SARIFPath << "\n";
+    }
+  }
 }
 
 }
@@ -1,4 +1,9 @@
 #include "OptDebugger/PassAnalyzer.h"
+#include "OptDebugger/AnalysisCache.h"
+#include "OptDebugger/Baseline.h"
+#include "OptDebugger/CostModel.h"
+#include "OptDebugger/PatternDB.h"
+#include "OptDebugger/SelfProfile.h"
 #include "OptDebugger/Support.h"
 
 #include "llvm/Analysis/CGSCCPassManager.h"
@@ -25,9 +30,12 @@
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/WithColor.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Host.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 
+#include <algorithm>
 #include <sstream>
 #include <utility>
 
@@ -37,6 +45,7 @@ PassAnalyzer::PassAnalyzer() = default;
 
 // serializes an llvm module in memory back to an ir string representation
 std::string PassAnalyzer::moduleToString(const llvm::Module &M) {
+  ProfileScope PS("PrintIR");
   std::string S;
   llvm::raw_string_ostream OS(S);
   M.print(OS, nullptr);
@@ -48,6 +57,7 @@ std::string PassAnalyzer::moduleToString(const llvm::Module &M) {
 llvm::Expected<std::unique_ptr<llvm::Module>>
 PassAnalyzer::parseIRFromFile(llvm::StringRef Path,
                                llvm::LLVMContext &Ctx) {
+  ProfileScope PS("ParseIR", Path);
   llvm::SMDiagnostic Err;
   auto M = llvm::parseIRFile(Path, Err, Ctx);
   if (!M) {
@@ -64,6 +74,7 @@ PassAnalyzer::parseIRFromFile(llvm::StringRef Path,
 llvm::Expected<std::unique_ptr<llvm::Module>>
 PassAnalyzer::parseIRFromString(llvm::StringRef IRText,
                                  llvm::LLVMContext &Ctx) {
+  ProfileScope PS("ParseIR");
   llvm::SMDiagnostic Err;
   auto Buf = llvm::MemoryBuffer::getMemBuffer(IRText, "<string>");
   auto M   = llvm::parseIR(*Buf, Err, Ctx);
@@ -79,6 +90,7 @@ PassAnalyzer::parseIRFromString(llvm::StringRef IRText,
 
 // runs the full suite of llvm structural verifications against a given module
 llvm::Error PassAnalyzer::verifyModule(const llvm::Module &M) {
+  ProfileScope PS("Verify");
   std::string ErrorStr;
   llvm::raw_string_ostream ES(ErrorStr);
   if (llvm::verifyModule(M, &ES)) {
@@ -91,6 +103,7 @@ llvm::Error PassAnalyzer::verifyModule(const llvm::Module &M) {
 llvm::Error PassAnalyzer::runPassPipeline(llvm::Module         &M,
                                            const AnalysisConfig &Config,
                                            RemarkCollector      &Collector) {
+  ProfileScope PS("RunPasses");
   // wire up our custom diagnostic handler to capture optimization remarks emitted during passes.
   Collector.install(M.getContext());
 
@@ -100,8 +113,12 @@ llvm::Error PassAnalyzer::runPassPipeline(llvm::Module         &M,
   llvm::CGSCCAnalysisManager    CGAM;
   llvm::ModuleAnalysisManager   MAM;
 
+  // per-pass trace events when self profiling is on
+  llvm::PassInstrumentationCallbacks PIC;
+  registerPassProfiling(PIC);
+
   // register all foundational function-level analyses like dominator trees and basic alias analysis.
-  FAM.registerPass([&] { return llvm::PassInstrumentationAnalysis(); });
+  FAM.registerPass([&] { return llvm::PassInstrumentationAnalysis(&PIC); });
   FAM.registerPass([&] { return llvm::DominatorTreeAnalysis(); });
   FAM.registerPass([&] { return llvm::TargetLibraryAnalysis(); });
   FAM.registerPass([&] { return llvm::TargetIRAnalysis(); });
@@ -115,12 +132,12 @@ llvm::Error PassAnalyzer::runPassPipeline(llvm::Module         &M,
   FAM.registerPass([&] { return llvm::ModuleAnalysisManagerFunctionProxy(MAM); });
 
   // register broader module-level analyses and set up the proxy linking back to function analyses.
-  MAM.registerPass([&] { return llvm::PassInstrumentationAnalysis(); });
+  MAM.registerPass([&] { return llvm::PassInstrumentationAnalysis(&PIC); });
   MAM.registerPass([&] { return llvm::ProfileSummaryAnalysis(); });
   MAM.registerPass([&] { return llvm::FunctionAnalysisManagerModuleProxy(FAM); });
 
   // register specialized loop analyses and cross-link them with the function analysis manager.
-  LAM.registerPass([&] { return llvm::PassInstrumentationAnalysis(); });
+  LAM.registerPass([&] { return llvm::PassInstrumentationAnalysis(&PIC); });
   LAM.registerPass([&] { return llvm::FunctionAnalysisManagerLoopProxy(FAM); });
 
   // build the core sequence of transformation passes based on the user's configuration string.
@@ -150,6 +167,42 @@ llvm::Error PassAnalyzer::runPassPipeline(llvm::Module         &M,
   return llvm::Error::success();
 }
 
+// replaces pattern speedups with ones modeled on the input module and ranks
+// diagnostics of the same severity by the cycles their fix saves
+static void rankByModeledCost(llvm::Module &M,
+                              std::vector<DiagnosticResult> &Diagnostics) {
+  applyCostModel(M, Diagnostics);
+  std::stable_sort(Diagnostics.begin(), Diagnostics.end(), ranksBefore);
+}
+
+// lowers the output IR and files the backend's remarks with the optimizer's,
+// before diagnosis so machine remarks get diagnostics too; a target that
+// cannot lower the module only costs the machine stats
+void PassAnalyzer::runCodegenStage(AnalysisSession &Session) const {
+  if (!Codegen)
+    return;
+  auto StatsOrErr = runCodegen(Session.AfterIR, *Codegen, Session.Remarks);
+  if (!StatsOrErr) {
+    llvm::WithColor::warning(llvm::errs(), "opt-debugger")
+        << "codegen failed, continuing without machine stats: "
+        << llvm::toString(StatsOrErr.takeError()) << "\n";
+    Session.CodegenFailed = true;
+    return;
+  }
+  Session.MachineFunctions = std::move(*StatsOrErr);
+}
+
+// the host's CPU goes into the key rather than "native", so a cache shared
+// between machines does not mix their code
+static void addCodegenKey(CacheKeyBuilder &KB, const CodegenOptions *O) {
+  if (!O)
+    return;
+  KB.addString("codegen");
+  KB.addString(O->Triple);
+  KB.addString(O->CPU == "native" ? llvm::sys::getHostCPUName() : O->CPU);
+  KB.addString(O->OptLevel);
+}
+
 // orchestrates the end-to-end analysis by copying modules, running passes, and diffing structural states
 llvm::Expected<AnalysisSession>
 PassAnalyzer::executeAnalysis(std::unique_ptr<llvm::Module> BeforeModule,
@@ -195,8 +248,24 @@ PassAnalyzer::executeAnalysis(std::unique_ptr<llvm::Module> BeforeModule,
   Session.AfterIR  = moduleToString(*AfterModule);
   Session.Remarks  = Collector.getRemarks();
 
+  if (!Config.ExternalRemarksPath.empty()) {
+    auto RemarksOrErr = parseRemarksYAML(Config.ExternalRemarksPath);
+    if (!RemarksOrErr)
+      return RemarksOrErr.takeError();
+    Session.Remarks.insert(Session.Remarks.end(),
+                           std::make_move_iterator(RemarksOrErr->begin()),
+                           std::make_move_iterator(RemarksOrErr->end()));
+  }
+
+  runCodegenStage(Session);
+
   Session.Diff        = DiffEngine.diff(*BeforeModule, *AfterModule);
-  Session.Diagnostics = DiagEngine.analyze(Session.Remarks, Session.Diff);
+  {
+    ProfileScope PS("Diagnose");
+    Session.Diagnostics = DiagEngine.analyze(Session.Remarks, Session.Diff,
+                                            &Session.BaselineSuppressed);
+  }
+  rankByModeledCost(*BeforeModule, Session.Diagnostics);
 
   Session.BeforeModule = std::move(BeforeModule);
   Session.AfterModule  = std::move(AfterModule);
@@ -204,17 +273,67 @@ PassAnalyzer::executeAnalysis(std::unique_ptr<llvm::Module> BeforeModule,
   return Session;
 }
 
+// returns a previously stored session for this key, if the cache has one
+std::optional<AnalysisSession>
+PassAnalyzer::lookupCached(const std::string &Key) const {
+  if (!Cache || Key.empty())
+    return std::nullopt;
+  ProfileScope PS("CacheLookup");
+  auto Cached = Cache->lookup(Key);
+  if (Cached)
+    Cached->LoadedFromCache = true;
+  return Cached;
+}
+
+// failing to fill the cache never fails the analysis itself
+void PassAnalyzer::storeCached(const std::string &Key,
+                               const AnalysisSession &S) const {
+  if (!Cache || Key.empty() || S.CodegenFailed)
+    return;
+  ProfileScope PS("CacheStore");
+  if (auto Err = Cache->store(Key, S))
+    llvm::WithColor::warning(llvm::errs(), "opt-debugger")
+        << llvm::toString(std::move(Err)) << "\n";
+}
+
 // wrapper to instantiate context, parse ir from a file, and execute the analysis pipeline
 llvm::Expected<AnalysisSession>
 PassAnalyzer::runFromFile(llvm::StringRef InputPath,
                            const AnalysisConfig &Config) {
+  // an unreadable input leaves the key empty so parsing reports the error
+  std::string Key;
+  if (Cache) {
+    CacheKeyBuilder KB("file");
+    if (auto Err = KB.addFile(InputPath)) {
+      llvm::consumeError(std::move(Err));
+    } else {
+      KB.addConfig(Config);
+      if (Baseline)
+        KB.addString(Baseline->digest());
+      if (UserPatterns)
+        KB.addString(UserPatterns->digest());
+      addCodegenKey(KB, Codegen);
+      llvm::Error RemarksErr = Config.ExternalRemarksPath.empty()
+                                   ? llvm::Error::success()
+                                   : KB.addFile(Config.ExternalRemarksPath);
+      if (RemarksErr)
+        llvm::consumeError(std::move(RemarksErr));
+      else
+        Key = KB.finalize();
+    }
+  }
+  if (auto Cached = lookupCached(Key))
+    return std::move(*Cached);
+
   auto Ctx = std::make_unique<llvm::LLVMContext>();
   auto ModuleOrErr = parseIRFromFile(InputPath, *Ctx);
   if (!ModuleOrErr)
     return ModuleOrErr.takeError();
   auto SessionOrErr = executeAnalysis(std::move(*ModuleOrErr), Config);
-  if (SessionOrErr)
+  if (SessionOrErr) {
     SessionOrErr->Contexts.push_back(std::move(Ctx));
+    storeCached(Key, *SessionOrErr);
+  }
   return SessionOrErr;
 }
 
@@ -237,6 +356,28 @@ llvm::Expected<AnalysisSession>
 PassAnalyzer::runFromBeforeAfter(llvm::StringRef BeforePath,
                                   llvm::StringRef AfterPath,
                                   llvm::StringRef RemarksYAMLPath) {
+  std::string Key;
+  if (Cache) {
+    CacheKeyBuilder KB("before-after");
+    llvm::Error Err = KB.addFile(BeforePath);
+    if (!Err)
+      Err = KB.addFile(AfterPath);
+    if (!Err && !RemarksYAMLPath.empty())
+      Err = KB.addFile(RemarksYAMLPath);
+    if (!Err && Baseline)
+      KB.addString(Baseline->digest());
+    if (!Err && UserPatterns)
+      KB.addString(UserPatterns->digest());
+    if (!Err)
+      addCodegenKey(KB, Codegen);
+    if (Err)
+      llvm::consumeError(std::move(Err));
+    else
+      Key = KB.finalize();
+  }
+  if (auto Cached = lookupCached(Key))
+    return std::move(*Cached);
+
   auto BeforeCtx = std::make_unique<llvm::LLVMContext>();
   auto AfterCtx  = std::make_unique<llvm::LLVMContext>();
 
@@ -261,6 +402,7 @@ PassAnalyzer::runFromBeforeAfter(llvm::StringRef BeforePath,
   if (SessionOrErr) {
     SessionOrErr->Contexts.push_back(std::move(BeforeCtx));
     SessionOrErr->Contexts.push_back(std::move(AfterCtx));
+    storeCached(Key, *SessionOrErr);
   }
   return SessionOrErr;
 }
@@ -277,8 +419,14 @@ PassAnalyzer::runFromModules(std::unique_ptr<llvm::Module> Before,
   Session.BeforeIR = moduleToString(*Before);
   Session.AfterIR  = moduleToString(*After);
   Session.Remarks  = std::move(ExternalRemarks);
+  runCodegenStage(Session);
   Session.Diff     = DiffEngine.diff(*Before, *After);
-  Session.Diagnostics = DiagEngine.analyze(Session.Remarks, Session.Diff);
+  {
+    ProfileScope PS("Diagnose");
+    Session.Diagnostics = DiagEngine.analyze(Session.Remarks, Session.Diff,
+                                            &Session.BaselineSuppressed);
+  }
+  rankByModeledCost(*Before, Session.Diagnostics);
   Session.BeforeModule = std::move(Before);
   Session.AfterModule  = std::move(After);
   return Session;
@@ -287,11 +435,21 @@ PassAnalyzer::runFromModules(std::unique_ptr<llvm::Module> Before,
 // parses an llvm compiler-generated yaml sequence into a structured internal vector of diagnostic remarks
 llvm::Expected<std::vector<Remark>>
 PassAnalyzer::parseRemarksYAML(llvm::StringRef Path) {
+  std::vector<Remark> Remarks;
+  if (auto Err = forEachRemarkYAML(
+          Path, [&](Remark &&R) { Remarks.push_back(std::move(R)); }))
+    return std::move(Err);
+  return Remarks;
+}
+
+llvm::Error
+PassAnalyzer::forEachRemarkYAML(llvm::StringRef Path,
+                                llvm::function_ref<void(Remark &&)> Callback) {
+  ProfileScope PS("ParseRemarks", Path);
   auto BufOrErr = llvm::MemoryBuffer::getFile(Path);
   if (!BufOrErr)
     return makeStringError("Cannot open remarks file: " + Path);
 
-  std::vector<Remark> Remarks;
   llvm::StringRef Content = (*BufOrErr)->getBuffer();
 
   auto parseRemarkKind = [](llvm::StringRef K) -> RemarkKind {
@@ -331,6 +489,10 @@ PassAnalyzer::parseRemarksYAML(llvm::StringRef Path) {
       llvm::StringRef LineStr = Record.slice(FPos + Field.size(), LineEnd);
       size_t QuoteStart = LineStr.find('\'');
       if (QuoteStart == llvm::StringRef::npos) {
+        // a plain scalar inside { File: a.c, Line: 1 } ends at the next key
+        size_t LineStart = Record.rfind('\n', FPos) + 1;
+        if (Record.slice(LineStart, FPos).contains('{'))
+          LineStr = LineStr.take_until([](char C) { return C == ',' || C == '}'; });
         return LineStr.trim().str();
       }
       size_t QuoteEnd = LineStr.find('\'', QuoteStart + 1);
@@ -341,6 +503,9 @@ PassAnalyzer::parseRemarksYAML(llvm::StringRef Path) {
     R.PassName    = extractField("Pass:");
     R.RemarkName  = extractField("Name:");
     R.FunctionName = extractField("Function:");
+    double Hotness;
+    if (!llvm::StringRef(extractField("Hotness:")).getAsDouble(Hotness))
+      R.Hotness = static_cast<float>(Hotness);
 
     size_t ArgsPos = Record.find("Args:");
     if (ArgsPos != llvm::StringRef::npos) {
@@ -351,8 +516,14 @@ PassAnalyzer::parseRemarksYAML(llvm::StringRef Path) {
         if (LineEnd == llvm::StringRef::npos) LineEnd = Record.size();
         llvm::StringRef Line = Record.slice(SearchStart, LineEnd);
         
-        if (!Line.trim().starts_with("-") && !Line.trim().empty() && SearchStart > ArgsPos + 6)
+        if (!Line.trim().starts_with("-") && !Line.trim().empty() && SearchStart > ArgsPos + 6) {
+          // an argument's DebugLoc is indented under it and is not text
+          if (Line.starts_with(" ")) {
+            SearchStart = LineEnd + 1;
+            continue;
+          }
           break;
+        }
 
         size_t ValPos = Line.find(": ");
         if (ValPos != llvm::StringRef::npos) {
@@ -373,6 +544,61 @@ PassAnalyzer::parseRemarksYAML(llvm::StringRef Path) {
         SearchStart = LineEnd + 1;
       }
       R.Message = FullMsg;
+
+      // structured arguments for pattern conditions; a `- Key: Value` line
+      // starts an argument and an indented DebugLoc line locates it
+      auto unquote = [](llvm::StringRef V) -> std::string {
+        if (V.size() < 2 || !V.starts_with("'") || !V.ends_with("'"))
+          return V.str();
+        std::string Out;
+        V = V.slice(1, V.size() - 1);
+        for (size_t I = 0; I < V.size(); ++I) {
+          Out += V[I];
+          if (V[I] == '\'' && I + 1 < V.size() && V[I + 1] == '\'')
+            ++I;
+        }
+        return Out;
+      };
+      auto locField = [](llvm::StringRef Loc, llvm::StringRef Field) {
+        size_t FPos = Loc.find(Field);
+        if (FPos == llvm::StringRef::npos)
+          return llvm::StringRef();
+        llvm::StringRef Val = Loc.drop_front(FPos + Field.size());
+        return Val.take_until([](char C) { return C == ',' || C == '}'; })
+            .trim()
+            .trim('\'');
+      };
+
+      llvm::StringRef Rest = Record.drop_front(ArgsPos + 5);
+      Rest = Rest.drop_until([](char C) { return C == '\n'; }).drop_front();
+      while (!Rest.empty()) {
+        llvm::StringRef Line;
+        std::tie(Line, Rest) = Rest.split('\n');
+        if (Line.trim().empty())
+          continue;
+        if (!Line.starts_with(" ") || Line.starts_with("..."))
+          break;
+
+        llvm::StringRef Item = Line.trim();
+        if (Item.consume_front("- ")) {
+          auto [K, V] = Item.split(':');
+          R.Args.push_back({K.trim().str(), unquote(V.trim()), {}});
+          continue;
+        }
+        if (R.Args.empty() || !Item.starts_with("DebugLoc:"))
+          continue;
+        // flow mappings may wrap onto following lines
+        std::string Loc = Item.str();
+        while (Loc.find('}') == std::string::npos && !Rest.empty()) {
+          std::tie(Line, Rest) = Rest.split('\n');
+          Loc += " ";
+          Loc += Line.trim().str();
+        }
+        SourceLocation &ArgLoc = R.Args.back().Loc;
+        ArgLoc.File = locField(Loc, "File:").str();
+        locField(Loc, "Line:").getAsInteger(10, ArgLoc.Line);
+        locField(Loc, "Column:").getAsInteger(10, ArgLoc.Column);
+      }
     }
 
     size_t LocPos = Record.find("DebugLoc:");
@@ -389,10 +615,10 @@ PassAnalyzer::parseRemarksYAML(llvm::StringRef Path) {
     }
 
     if (!R.PassName.empty())
-      Remarks.push_back(std::move(R));
+      Callback(std::move(R));
   }
 
-  return Remarks;
+  return llvm::Error::success();
 }
 
 }
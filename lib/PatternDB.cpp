@@ -0,0 +1,1063 @@
+#include "OptDebugger/PatternDB.h"
+#include "OptDebugger/AnalysisCache.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/ADT/bit.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <string_view>
+
+namespace optdbg {
+
+namespace {
+
+using llvm::support::endian::read32le;
+using llvm::support::endian::read64le;
+
+constexpr size_t HeaderSize       = 32;
+constexpr size_t SectionEntrySize = 24;
+
+constexpr uint32_t DigestSection         = 0x01;
+constexpr uint32_t StringsSection        = 0x02;
+constexpr uint32_t PatternsSection       = 0x03;
+constexpr uint32_t FixesSection          = 0x04;
+constexpr uint32_t ProgramsSection       = 0x05;
+constexpr uint32_t AdjustmentsSection    = 0x06;
+constexpr uint32_t NeedleFieldsSection   = 0x10;
+constexpr uint32_t NeedleOffsetsSection  = 0x11;
+constexpr uint32_t NeedlePatternsSection = 0x12;
+constexpr uint32_t ClassMapSection       = 0x20;
+constexpr uint32_t TransitionsSection    = 0x21;
+constexpr uint32_t OutputOffsetsSection  = 0x22;
+constexpr uint32_t OutputNeedlesSection  = 0x23;
+
+// a pattern record is eight (offset, length) string references followed by
+// the fix range, severity, 'where' program, speedup and adjustment range; a
+// fix record is two references and its flags
+enum PatternString : unsigned {
+  PassString,
+  RemarkString,
+  MessageString,
+  ShortString,
+  ExplanationString,
+  RootCauseString,
+  WantedString,
+  RuleIDString,
+  NumPatternStrings,
+};
+constexpr size_t PatternRecordSize = NumPatternStrings * 8 + 32;
+constexpr size_t FixRecordSize     = 24;
+
+constexpr uint32_t FixSourceLevel = 1;
+constexpr uint32_t FixIRLevel     = 2;
+
+// a program record is the code (three bytes per instruction), the counts,
+// the constants as f64 bits and the names as string references
+constexpr size_t ProgramCodeSize   = PredicateProgram::MaxInstructions * 3;
+constexpr size_t ProgramRecordSize = ProgramCodeSize + 8 +
+                                     PredicateProgram::MaxNumbers * 8 +
+                                     PredicateProgram::MaxNames * 8;
+constexpr uint32_t NoProgram = UINT32_MAX;
+
+// an adjustment record is its program, which of severity and speedup it sets,
+// the severity and the speedup
+constexpr size_t   AdjustmentRecordSize = 24;
+constexpr uint32_t AdjustsSeverity      = 1;
+constexpr uint32_t AdjustsSpeedup       = 2;
+
+// matcher fields in scoring order; needles are keyed by field
+constexpr unsigned NumMatchFields = 3;
+constexpr int FieldScores[NumMatchFields] = {2, 3, 4};
+
+void append32(std::string &Out, uint32_t V) {
+  char B[4];
+  llvm::support::endian::write32le(B, V);
+  Out.append(B, 4);
+}
+
+void append64(std::string &Out, uint64_t V) {
+  char B[8];
+  llvm::support::endian::write64le(B, V);
+  Out.append(B, 8);
+}
+
+// \n, \t and \\ are the only escapes; anything else is kept as written
+std::string unescape(llvm::StringRef S) {
+  std::string Out;
+  Out.reserve(S.size());
+  for (size_t I = 0; I < S.size(); ++I) {
+    if (S[I] != '\\' || I + 1 == S.size()) {
+      Out += S[I];
+      continue;
+    }
+    char N = S[I + 1];
+    if (N == 'n')
+      Out += '\n';
+    else if (N == 't')
+      Out += '\t';
+    else if (N == '\\')
+      Out += '\\';
+    else {
+      Out += '\\';
+      continue;
+    }
+    ++I;
+  }
+  return Out;
+}
+
+std::optional<SeverityLevel> parseSeverity(llvm::StringRef S) {
+  return llvm::StringSwitch<std::optional<SeverityLevel>>(S.lower())
+      .Case("critical", SeverityLevel::Critical)
+      .Case("high", SeverityLevel::High)
+      .Case("medium", SeverityLevel::Medium)
+      .Case("low", SeverityLevel::Low)
+      .Case("info", SeverityLevel::Info)
+      .Default(std::nullopt);
+}
+
+// the names --what-if prints for each edit
+std::optional<FixEdit> parseFixEdit(llvm::StringRef S) {
+  return llvm::StringSwitch<std::optional<FixEdit>>(S.lower())
+      .Case("inline-threshold", FixEdit::RaiseInlineThreshold)
+      .Case("alwaysinline", FixEdit::AlwaysInline)
+      .Case("remove-noinline", FixEdit::RemoveNoInline)
+      .Case("noalias", FixEdit::NoAliasArguments)
+      .Case("readnone-callees", FixEdit::ReadNoneCallees)
+      .Default(std::nullopt);
+}
+
+bool isRuleIDChar(char C) {
+  return llvm::isAlnum(C) || C == '/' || C == '-' || C == '_' || C == '.';
+}
+
+// the rule id the built-in database derives from the same matcher strings
+std::string deriveRuleID(llvm::StringRef Pass, llvm::StringRef RemarkName,
+                         llvm::StringRef Message) {
+  OptimizationPattern P({Pass.data(), Pass.size()},
+                        {RemarkName.data(), RemarkName.size()},
+                        {Message.data(), Message.size()}, "", "", "", "", {},
+                        SeverityLevel::Medium, 0.0);
+  return P.ruleID().str();
+}
+
+// the same key the compiler hashes, computed from the raw sources
+std::string sourceDigest(llvm::ArrayRef<std::unique_ptr<llvm::MemoryBuffer>> Sources) {
+  CacheKeyBuilder KB("patterns");
+  KB.addString(llvm::utostr(PatternDBFormatVersion));
+  for (const auto &Source : Sources)
+    KB.addString(Source->getBuffer());
+  return KB.finalize();
+}
+
+}
+
+PatternDBCompiler::PatternDBCompiler()
+    : Key(std::make_unique<CacheKeyBuilder>("patterns")) {
+  Key->addString(llvm::utostr(PatternDBFormatVersion));
+}
+
+PatternDBCompiler::~PatternDBCompiler() = default;
+
+llvm::Error PatternDBCompiler::addSourceFile(llvm::StringRef Path) {
+  auto BufOrErr = llvm::MemoryBuffer::getFile(Path, /*IsText=*/true);
+  if (!BufOrErr)
+    return makeStringError("Cannot read pattern file '" + Path +
+                           "': " + BufOrErr.getError().message());
+  return addSource((*BufOrErr)->getBuffer(), Path);
+}
+
+// Sources are a sequence of [pattern] blocks of "key = value" lines. An
+// indented line continues the previous value after a space; lines starting
+// with '#' are comments.
+llvm::Error PatternDBCompiler::addSource(llvm::StringRef Text,
+                                         llvm::StringRef Name) {
+  Key->addString(Text);
+
+  std::optional<Entry> Current;
+  unsigned    CurrentLine = 0;
+  std::string *LastValue  = nullptr;
+  bool HasSeverity = false, HasSpeedup = false;
+
+  auto fail = [&](unsigned Line, const llvm::Twine &Msg) {
+    return makeStringError(Name + ":" + llvm::Twine(Line) + ": " + Msg);
+  };
+
+  auto checkCondition = [&](unsigned Line, llvm::StringRef Cond) -> llvm::Error {
+    PredicateProgram P = PredicateProgram::compile({Cond.data(), Cond.size()});
+    if (P.valid())
+      return llvm::Error::success();
+    return fail(Line, "invalid condition at column " +
+                          llvm::Twine(P.ErrorOffset + 1) + ": " + P.Error);
+  };
+
+  auto parseSpeedup = [&](unsigned Line, llvm::StringRef V,
+                          double &Out) -> llvm::Error {
+    if (V.getAsDouble(Out) || Out < 0)
+      return fail(Line, "speedup must be a non-negative number");
+    return llvm::Error::success();
+  };
+
+  auto parseSeverityValue = [&](unsigned Line, llvm::StringRef V,
+                                SeverityLevel &Out) -> llvm::Error {
+    std::optional<SeverityLevel> S = parseSeverity(V);
+    if (!S)
+      return fail(Line, "unknown severity '" + V +
+                            "' (critical, high, medium, low, info)");
+    Out = *S;
+    return llvm::Error::success();
+  };
+
+  auto finish = [&]() -> llvm::Error {
+    if (!Current)
+      return llvm::Error::success();
+    Entry &E = *Current;
+    if (E.Pass.empty() && E.RemarkName.empty() && E.Message.empty())
+      return fail(CurrentLine, "pattern has no matcher; give it a pass, "
+                               "remark or message");
+    if (E.ShortReason.empty())
+      return fail(CurrentLine, "pattern is missing 'short'");
+    if (E.Explanation.empty())
+      return fail(CurrentLine, "pattern is missing 'explanation'");
+    if (E.Fixes.size() > OptimizationPattern::MaxSuggestions)
+      return fail(CurrentLine, "pattern has more than " +
+                                   llvm::Twine(OptimizationPattern::MaxSuggestions) +
+                                   " fixes");
+    for (const std::string *T : {&E.Explanation, &E.RootCause, &E.Wanted})
+      if (PatternTemplate(*T).Truncated)
+        return fail(CurrentLine, "a template has more than " +
+                                     llvm::Twine(PatternTemplate::MaxPlaceholders) +
+                                     " placeholders");
+    for (const Adjustment &A : E.Adjustments)
+      if (!A.HasSeverity && !A.HasSpeedup)
+        return fail(CurrentLine, "'when' condition '" + A.Condition +
+                                     "' sets neither 'when-severity' nor "
+                                     "'when-speedup'");
+    if (E.RuleID.empty()) {
+      // a derived id is never longer than its three matcher strings
+      if (E.Pass.size() + E.RemarkName.size() + E.Message.size() + 2 >
+          OptimizationPattern::MaxRuleIDLength)
+        return fail(CurrentLine, "matchers are too long to derive a rule id; "
+                                 "give the pattern an 'id'");
+      E.RuleID = deriveRuleID(E.Pass, E.RemarkName, E.Message);
+      if (E.RuleID.empty())
+        return fail(CurrentLine, "cannot derive a rule id; give the pattern "
+                                 "an 'id'");
+    }
+    Patterns.push_back(std::move(E));
+    Current.reset();
+    return llvm::Error::success();
+  };
+
+  unsigned LineNo = 0;
+  llvm::StringRef Rest = Text;
+  while (!Rest.empty()) {
+    llvm::StringRef Line;
+    std::tie(Line, Rest) = Rest.split('\n');
+    Line = Line.rtrim("\r");
+    ++LineNo;
+
+    llvm::StringRef Trimmed = Line.trim();
+    if (Trimmed.empty()) {
+      LastValue = nullptr;
+      continue;
+    }
+    if (Line.front() == '#')
+      continue;
+
+    if (Line.front() == ' ' || Line.front() == '\t') {
+      if (!LastValue)
+        return fail(LineNo, "continuation line without a value to continue");
+      *LastValue += ' ';
+      *LastValue += unescape(Trimmed);
+      continue;
+    }
+
+    if (Trimmed.front() == '[') {
+      if (Trimmed != "[pattern]")
+        return fail(LineNo, "unknown section '" + Trimmed + "'");
+      if (auto Err = finish())
+        return Err;
+      Current.emplace();
+      CurrentLine = LineNo;
+      LastValue   = nullptr;
+      HasSeverity = HasSpeedup = false;
+      continue;
+    }
+
+    auto [KeyPart, ValuePart] = Trimmed.split('=');
+    if (KeyPart.size() == Trimmed.size())
+      return fail(LineNo, "expected 'key = value'");
+    if (!Current)
+      return fail(LineNo, "'" + KeyPart.trim() + "' outside a [pattern] block");
+
+    Entry &E = *Current;
+    llvm::StringRef K = KeyPart.trim();
+    std::string     V = unescape(ValuePart.trim());
+    LastValue = nullptr;
+
+    if (K == "severity" || K == "speedup") {
+      bool &Seen = K == "severity" ? HasSeverity : HasSpeedup;
+      if (Seen)
+        return fail(LineNo, "duplicate '" + K + "'");
+      Seen = true;
+      if (auto Err = K == "severity"
+                         ? parseSeverityValue(LineNo, V, E.Severity)
+                         : parseSpeedup(LineNo, V, E.EstimatedSpeedup))
+        return Err;
+      continue;
+    }
+
+    // conditions are checked here so errors point at their line
+    if (K == "where" || K == "when") {
+      if (V.empty())
+        return fail(LineNo, "'" + K + "' has an empty value");
+      if (auto Err = checkCondition(LineNo, V))
+        return Err;
+      if (K == "where") {
+        if (!E.Where.empty())
+          return fail(LineNo, "duplicate 'where'");
+        E.Where = std::move(V);
+        continue;
+      }
+      if (E.Adjustments.size() == OptimizationPattern::MaxAdjustments)
+        return fail(LineNo, "pattern has more than " +
+                                llvm::Twine(OptimizationPattern::MaxAdjustments) +
+                                " 'when' conditions");
+      E.Adjustments.push_back({std::move(V)});
+      continue;
+    }
+    if (K == "when-severity" || K == "when-speedup") {
+      if (E.Adjustments.empty())
+        return fail(LineNo, "'" + K + "' must follow a 'when'");
+      Adjustment &A = E.Adjustments.back();
+      bool &Seen = K == "when-severity" ? A.HasSeverity : A.HasSpeedup;
+      if (Seen)
+        return fail(LineNo, "duplicate '" + K + "' for one 'when'");
+      Seen = true;
+      if (auto Err = K == "when-severity"
+                         ? parseSeverityValue(LineNo, V, A.Severity)
+                         : parseSpeedup(LineNo, V, A.EstimatedSpeedup))
+        return Err;
+      continue;
+    }
+
+    if (K == "fix" || K == "ir-fix") {
+      E.Fixes.push_back({V, "", K == "ir-fix"});
+      LastValue = &E.Fixes.back().Description;
+      continue;
+    }
+    if (K == "fix-edit") {
+      if (E.Fixes.empty())
+        return fail(LineNo, "'fix-edit' must follow a 'fix' or 'ir-fix'");
+      std::optional<FixEdit> Edit = parseFixEdit(V);
+      if (!Edit)
+        return fail(LineNo, "unknown fix edit '" + V +
+                                "' (inline-threshold, alwaysinline, "
+                                "remove-noinline, noalias, readnone-callees)");
+      E.Fixes.back().Edit = *Edit;
+      continue;
+    }
+    if (K == "fix-code") {
+      if (E.Fixes.empty())
+        return fail(LineNo, "'fix-code' must follow a 'fix' or 'ir-fix'");
+      if (!E.Fixes.back().CodeExample.empty())
+        return fail(LineNo, "duplicate 'fix-code' for one fix");
+      E.Fixes.back().CodeExample = std::move(V);
+      LastValue = &E.Fixes.back().CodeExample;
+      continue;
+    }
+
+    std::string *Field = llvm::StringSwitch<std::string *>(K)
+                             .Case("id", &E.RuleID)
+                             .Case("pass", &E.Pass)
+                             .Case("remark", &E.RemarkName)
+                             .Case("message", &E.Message)
+                             .Case("short", &E.ShortReason)
+                             .Case("explanation", &E.Explanation)
+                             .Case("root-cause", &E.RootCause)
+                             .Case("wanted", &E.Wanted)
+                             .Default(nullptr);
+    if (!Field)
+      return fail(LineNo, "unknown key '" + K + "'");
+    if (!Field->empty())
+      return fail(LineNo, "duplicate '" + K + "'");
+    if (V.empty())
+      return fail(LineNo, "'" + K + "' has an empty value");
+    if (K == "id") {
+      if (V.size() > OptimizationPattern::MaxRuleIDLength ||
+          !llvm::all_of(V, isRuleIDChar))
+        return fail(LineNo, "rule id must be at most " +
+                                llvm::Twine(OptimizationPattern::MaxRuleIDLength) +
+                                " characters of [A-Za-z0-9/_.-]");
+      *Field = std::move(V);
+      continue;
+    }
+    *Field    = std::move(V);
+    LastValue = Field;
+  }
+  return finish();
+}
+
+llvm::Error PatternDBCompiler::write(llvm::StringRef Path) const {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::OF_None);
+  if (EC)
+    return makeStringError("Cannot open pattern index '" + Path +
+                           "': " + EC.message());
+  write(OS);
+  OS.close();
+  if (OS.has_error()) {
+    EC = OS.error();
+    OS.clear_error();
+    return makeStringError("Cannot write pattern index '" + Path +
+                           "': " + EC.message());
+  }
+  return llvm::Error::success();
+}
+
+void PatternDBCompiler::write(llvm::raw_ostream &OS) const {
+  struct Section {
+    uint32_t    Kind;
+    uint32_t    ElemSize;
+    std::string Data;
+  };
+
+  // string pool with identical strings stored once
+  Section Strings{StringsSection, 1, {}};
+  llvm::StringMap<uint32_t> Pooled;
+  auto addString = [&](std::string &Out, llvm::StringRef S) {
+    auto Inserted = Pooled.try_emplace(S, static_cast<uint32_t>(Strings.Data.size()));
+    if (Inserted.second)
+      Strings.Data.append(S.begin(), S.end());
+    append32(Out, Inserted.first->second);
+    append32(Out, static_cast<uint32_t>(S.size()));
+  };
+
+  // programs are compiled from the entries' strings; their names are pooled
+  // like any other string
+  Section Programs{ProgramsSection, ProgramRecordSize, {}};
+  uint32_t NumPrograms = 0;
+  auto addProgram = [&](const std::string &Condition) {
+    PredicateProgram P = PredicateProgram::compile(Condition);
+    for (const PredicateInstr &I : P.Code) {
+      Programs.Data += char(I.Op);
+      Programs.Data += char(I.A);
+      Programs.Data += char(I.B);
+    }
+    Programs.Data += char(P.Length);
+    Programs.Data += char(P.NumNumbers);
+    Programs.Data += char(P.NumNames);
+    Programs.Data.append(5, '\0');
+    for (double N : P.Numbers)
+      append64(Programs.Data, llvm::bit_cast<uint64_t>(N));
+    for (std::string_view N : P.Names)
+      addString(Programs.Data, {N.data(), N.size()});
+    return NumPrograms++;
+  };
+
+  Section Records{PatternsSection, PatternRecordSize, {}};
+  Section Fixes{FixesSection, FixRecordSize, {}};
+  Section Adjustments{AdjustmentsSection, AdjustmentRecordSize, {}};
+  uint32_t NumFixes = 0, NumAdjustments = 0;
+  for (const Entry &E : Patterns) {
+    const std::string *Fields[NumPatternStrings] = {
+        &E.Pass,        &E.RemarkName, &E.Message, &E.ShortReason,
+        &E.Explanation, &E.RootCause,  &E.Wanted,  &E.RuleID};
+    for (const std::string *F : Fields)
+      addString(Records.Data, *F);
+    append32(Records.Data, NumFixes);
+    append32(Records.Data, static_cast<uint32_t>(E.Fixes.size()));
+    append32(Records.Data, static_cast<uint32_t>(E.Severity));
+    append32(Records.Data, E.Where.empty() ? NoProgram : addProgram(E.Where));
+    append64(Records.Data, llvm::bit_cast<uint64_t>(E.EstimatedSpeedup));
+    append32(Records.Data, NumAdjustments);
+    append32(Records.Data, static_cast<uint32_t>(E.Adjustments.size()));
+
+    for (const Adjustment &A : E.Adjustments) {
+      append32(Adjustments.Data, addProgram(A.Condition));
+      append32(Adjustments.Data, (A.HasSeverity ? AdjustsSeverity : 0) |
+                                     (A.HasSpeedup ? AdjustsSpeedup : 0));
+      append32(Adjustments.Data, static_cast<uint32_t>(A.Severity));
+      append32(Adjustments.Data, 0);
+      append64(Adjustments.Data, llvm::bit_cast<uint64_t>(A.EstimatedSpeedup));
+    }
+    NumAdjustments += E.Adjustments.size();
+
+    for (const Fix &F : E.Fixes) {
+      addString(Fixes.Data, F.Description);
+      addString(Fixes.Data, F.CodeExample);
+      append32(Fixes.Data, F.IsIRLevel ? FixIRLevel : FixSourceLevel);
+      append32(Fixes.Data, static_cast<uint32_t>(F.Edit));
+    }
+    NumFixes += E.Fixes.size();
+  }
+
+  // one needle per distinct (field, lowercased substring), with the patterns
+  // that use it
+  std::vector<std::pair<unsigned, std::string>> Needles;
+  std::vector<std::vector<uint32_t>>            Users;
+  llvm::StringMap<uint32_t>                     NeedleIds;
+  for (uint32_t Id = 0; Id < Patterns.size(); ++Id) {
+    const Entry &E = Patterns[Id];
+    const std::string *Matchers[NumMatchFields] = {&E.Pass, &E.RemarkName,
+                                                   &E.Message};
+    for (unsigned F = 0; F < NumMatchFields; ++F) {
+      if (Matchers[F]->empty())
+        continue;
+      std::string Lower = llvm::StringRef(*Matchers[F]).lower();
+      auto Inserted = NeedleIds.try_emplace(char('0' + F) + Lower,
+                                            static_cast<uint32_t>(Needles.size()));
+      if (Inserted.second) {
+        Needles.emplace_back(F, std::move(Lower));
+        Users.emplace_back();
+      }
+      Users[Inserted.first->second].push_back(Id);
+    }
+  }
+
+  // bytes that occur in no needle share class 0; letters fold to one class
+  uint8_t  ClassOf[256] = {};
+  uint32_t NumClasses   = 1;
+  for (const auto &N : Needles)
+    for (unsigned char C : N.second)
+      if (!ClassOf[C])
+        ClassOf[C] = static_cast<uint8_t>(NumClasses++);
+  for (unsigned C = 'a'; C <= 'z'; ++C)
+    ClassOf[C - 'a' + 'A'] = ClassOf[C];
+
+  // trie over the needles, then breadth-first failure links that complete
+  // it into a DFA and merge each state's outputs with its failure state's
+  std::vector<int32_t>               Next(NumClasses, -1);
+  std::vector<std::vector<uint32_t>> Outputs(1);
+  for (uint32_t Id = 0; Id < Needles.size(); ++Id) {
+    uint32_t S = 0;
+    for (unsigned char C : Needles[Id].second) {
+      int32_t &T = Next[S * NumClasses + ClassOf[C]];
+      if (T < 0) {
+        T = static_cast<int32_t>(Outputs.size());
+        Outputs.emplace_back();
+        Next.resize(Next.size() + NumClasses, -1);
+      }
+      S = Next[S * NumClasses + ClassOf[C]];
+    }
+    Outputs[S].push_back(Id);
+  }
+
+  std::vector<uint32_t> Fail(Outputs.size(), 0);
+  std::deque<uint32_t>  Queue;
+  for (uint32_t C = 0; C < NumClasses; ++C) {
+    int32_t &T = Next[C];
+    if (T < 0)
+      T = 0;
+    else
+      Queue.push_back(T);
+  }
+  while (!Queue.empty()) {
+    uint32_t S = Queue.front();
+    Queue.pop_front();
+    for (uint32_t C = 0; C < NumClasses; ++C) {
+      int32_t &T = Next[S * NumClasses + C];
+      int32_t  Via = Next[Fail[S] * NumClasses + C];
+      if (T < 0) {
+        T = Via;
+        continue;
+      }
+      Fail[T] = Via;
+      llvm::append_range(Outputs[T], Outputs[Via]);
+      Queue.push_back(T);
+    }
+  }
+
+  Section Digest{DigestSection, 1, CacheKeyBuilder(*Key).finalize()};
+
+  Section NeedleFields{NeedleFieldsSection, 1, {}};
+  Section NeedleOffsets{NeedleOffsetsSection, 4, {}};
+  Section NeedlePatterns{NeedlePatternsSection, 4, {}};
+  uint32_t Cursor = 0;
+  for (uint32_t Id = 0; Id < Needles.size(); ++Id) {
+    NeedleFields.Data += char(Needles[Id].first);
+    append32(NeedleOffsets.Data, Cursor);
+    for (uint32_t P : Users[Id])
+      append32(NeedlePatterns.Data, P);
+    Cursor += Users[Id].size();
+  }
+  append32(NeedleOffsets.Data, Cursor);
+
+  Section ClassMap{ClassMapSection, 1,
+                   std::string(reinterpret_cast<const char *>(ClassOf), 256)};
+  Section Transitions{TransitionsSection, 4, {}};
+  for (int32_t T : Next)
+    append32(Transitions.Data, static_cast<uint32_t>(T));
+
+  Section OutputOffsets{OutputOffsetsSection, 4, {}};
+  Section OutputNeedles{OutputNeedlesSection, 4, {}};
+  Cursor = 0;
+  for (std::vector<uint32_t> &Out : Outputs) {
+    llvm::sort(Out);
+    Out.erase(std::unique(Out.begin(), Out.end()), Out.end());
+    append32(OutputOffsets.Data, Cursor);
+    for (uint32_t N : Out)
+      append32(OutputNeedles.Data, N);
+    Cursor += Out.size();
+  }
+  append32(OutputOffsets.Data, Cursor);
+
+  std::vector<Section> Sections;
+  Sections.push_back(std::move(Digest));
+  Sections.push_back(std::move(Strings));
+  Sections.push_back(std::move(Records));
+  Sections.push_back(std::move(Fixes));
+  Sections.push_back(std::move(Programs));
+  Sections.push_back(std::move(Adjustments));
+  Sections.push_back(std::move(NeedleFields));
+  Sections.push_back(std::move(NeedleOffsets));
+  Sections.push_back(std::move(NeedlePatterns));
+  Sections.push_back(std::move(ClassMap));
+  Sections.push_back(std::move(Transitions));
+  Sections.push_back(std::move(OutputOffsets));
+  Sections.push_back(std::move(OutputNeedles));
+
+  auto AlignUp = [](uint64_t V) { return (V + 7) & ~uint64_t(7); };
+  std::vector<uint64_t> Offsets;
+  uint64_t End = HeaderSize + Sections.size() * SectionEntrySize;
+  for (const Section &S : Sections) {
+    End = AlignUp(End);
+    Offsets.push_back(End);
+    End += S.Data.size();
+  }
+
+  std::string Header(PatternDBMagic, sizeof(PatternDBMagic));
+  append32(Header, PatternDBFormatVersion);
+  append32(Header, static_cast<uint32_t>(Sections.size()));
+  append64(Header, End);
+  append64(Header, Patterns.size());
+  for (size_t I = 0; I < Sections.size(); ++I) {
+    append32(Header, Sections[I].Kind);
+    append32(Header, Sections[I].ElemSize);
+    append64(Header, Offsets[I]);
+    append64(Header, Sections[I].Data.size() / Sections[I].ElemSize);
+  }
+  OS << Header;
+
+  uint64_t Written = Header.size();
+  for (size_t I = 0; I < Sections.size(); ++I) {
+    OS.write_zeros(Offsets[I] - Written);
+    OS << Sections[I].Data;
+    Written = Offsets[I] + Sections[I].Data.size();
+  }
+}
+
+llvm::Expected<std::unique_ptr<PatternDB>>
+PatternDB::fromBuffer(std::unique_ptr<llvm::MemoryBuffer> Buffer) {
+  std::unique_ptr<PatternDB> DB(new PatternDB());
+  DB->Buffer = std::move(Buffer);
+  if (auto Err = DB->bind())
+    return std::move(Err);
+  DB->Patterns.reserve(DB->NumPatterns);
+  for (uint32_t Id = 0; Id < DB->NumPatterns; ++Id)
+    DB->Patterns.push_back(DB->buildPattern(Id));
+  return std::move(DB);
+}
+
+llvm::Expected<std::unique_ptr<PatternDB>> PatternDB::open(llvm::StringRef Path) {
+  auto BufOrErr = llvm::MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                              /*RequiresNullTerminator=*/false);
+  if (!BufOrErr)
+    return makeStringError("Cannot open pattern index '" + Path +
+                           "': " + BufOrErr.getError().message());
+  auto DBOrErr = fromBuffer(std::move(*BufOrErr));
+  if (!DBOrErr)
+    return makeStringError("Cannot load pattern index '" + Path +
+                           "': " + llvm::toString(DBOrErr.takeError()));
+  return DBOrErr;
+}
+
+std::string PatternDB::defaultCacheDirectory() {
+  llvm::SmallString<256> Dir;
+  if (!llvm::sys::path::cache_directory(Dir))
+    return "";
+  llvm::sys::path::append(Dir, "aion", "patterns");
+  return std::string(Dir);
+}
+
+// the sources are read and hashed on every run, which is cheap next to
+// parsing them; only a cache miss compiles
+llvm::Expected<std::unique_ptr<PatternDB>>
+PatternDB::load(llvm::ArrayRef<std::string> Paths, llvm::StringRef CacheDir) {
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> Sources;
+  for (const std::string &Path : Paths) {
+    auto BufOrErr = llvm::MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                                /*RequiresNullTerminator=*/false);
+    if (!BufOrErr)
+      return makeStringError("Cannot read pattern file '" + Path +
+                             "': " + BufOrErr.getError().message());
+    Sources.push_back(std::move(*BufOrErr));
+  }
+
+  auto IsIndex = [](const llvm::MemoryBuffer &B) {
+    return B.getBufferSize() >= sizeof(PatternDBMagic) &&
+           std::memcmp(B.getBufferStart(), PatternDBMagic,
+                       sizeof(PatternDBMagic)) == 0;
+  };
+  if (llvm::any_of(Sources, [&](const auto &B) { return IsIndex(*B); })) {
+    if (Sources.size() != 1)
+      return makeStringError("A compiled pattern index cannot be combined "
+                             "with other pattern files");
+    auto DBOrErr = fromBuffer(std::move(Sources.front()));
+    if (!DBOrErr)
+      return makeStringError("Cannot load pattern index '" + Paths.front() +
+                             "': " + llvm::toString(DBOrErr.takeError()));
+    return DBOrErr;
+  }
+
+  std::string Digest = sourceDigest(Sources);
+  llvm::SmallString<256> IndexPath(CacheDir);
+  llvm::sys::path::append(IndexPath, Digest + ".aionpdb");
+
+  if (!CacheDir.empty()) {
+    auto BufOrErr = llvm::MemoryBuffer::getFile(IndexPath, /*IsText=*/false,
+                                                /*RequiresNullTerminator=*/false);
+    if (BufOrErr) {
+      auto DBOrErr = fromBuffer(std::move(*BufOrErr));
+      if (DBOrErr && (*DBOrErr)->digest() == Digest) {
+        (*DBOrErr)->FromCache = true;
+        return DBOrErr;
+      }
+      // a stale or damaged index is just a miss; it is replaced below
+      if (!DBOrErr)
+        llvm::consumeError(DBOrErr.takeError());
+    }
+  }
+
+  PatternDBCompiler Compiler;
+  for (size_t I = 0; I < Sources.size(); ++I)
+    if (auto Err = Compiler.addSource(Sources[I]->getBuffer(), Paths[I]))
+      return std::move(Err);
+
+  std::string Index;
+  {
+    llvm::raw_string_ostream OS(Index);
+    Compiler.write(OS);
+  }
+
+  // storing is best effort: an unwritable cache only costs the next run a
+  // compile. The temporary file is renamed into place so concurrent runs
+  // never map a partial index
+  if (!CacheDir.empty() && !llvm::sys::fs::create_directories(CacheDir)) {
+    int FD;
+    llvm::SmallString<256> TempPath;
+    if (!llvm::sys::fs::createUniqueFile(IndexPath + ".tmp-%%%%%%", FD, TempPath)) {
+      llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      OS << Index;
+      OS.close();
+      bool Failed = OS.has_error();
+      OS.clear_error();
+      if (Failed || llvm::sys::fs::rename(TempPath, IndexPath))
+        llvm::sys::fs::remove(TempPath);
+    }
+  }
+
+  return fromBuffer(llvm::MemoryBuffer::getMemBufferCopy(Index, "<patterns>"));
+}
+
+// validates the header and section table and points every view into the
+// buffer; records are checked as they are read
+llvm::Error PatternDB::bind() {
+  llvm::StringRef B = Buffer->getBuffer();
+  if (B.size() < HeaderSize ||
+      std::memcmp(B.data(), PatternDBMagic, sizeof(PatternDBMagic)) != 0)
+    return makeStringError("not an Aion pattern index");
+
+  const char *H = B.data() + sizeof(PatternDBMagic);
+  uint32_t Version     = read32le(H);
+  uint32_t NumSections = read32le(H + 4);
+  uint64_t TotalSize   = read64le(H + 8);
+  NumPatterns          = read64le(H + 16);
+  if (Version != PatternDBFormatVersion)
+    return makeStringError("unsupported pattern index version " +
+                           llvm::Twine(Version));
+  if (TotalSize != B.size())
+    return makeStringError("pattern index is truncated");
+  if (NumSections > (B.size() - HeaderSize) / SectionEntrySize ||
+      NumPatterns > UINT32_MAX)
+    return makeStringError("pattern index header is corrupt");
+
+  auto Find = [&](uint32_t Kind, uint32_t ElemSize,
+                  uint64_t &Count) -> const char * {
+    const char *T = B.data() + HeaderSize;
+    for (uint32_t I = 0; I < NumSections; ++I, T += SectionEntrySize) {
+      if (read32le(T) != Kind || read32le(T + 4) != ElemSize)
+        continue;
+      uint64_t Offset = read64le(T + 8);
+      Count           = read64le(T + 16);
+      if (Offset > B.size() || Count > (B.size() - Offset) / ElemSize)
+        return nullptr;
+      return B.data() + Offset;
+    }
+    return nullptr;
+  };
+
+  auto Require = [&](uint32_t Kind, uint32_t ElemSize, uint64_t &Count,
+                     const char *&Out) -> llvm::Error {
+    Out = Find(Kind, ElemSize, Count);
+    if (!Out || Count > UINT32_MAX)
+      return makeStringError("pattern index section " + llvm::Twine(Kind) +
+                             " is missing");
+    return llvm::Error::success();
+  };
+
+  uint64_t Count = 0;
+  const char *Data = nullptr;
+  if (auto Err = Require(DigestSection, 1, Count, Data))
+    return Err;
+  Digest = llvm::StringRef(Data, Count);
+  if (auto Err = Require(StringsSection, 1, Count, Data))
+    return Err;
+  Strings = llvm::StringRef(Data, Count);
+
+  if (auto Err = Require(PatternsSection, PatternRecordSize, Count, Records))
+    return Err;
+  if (Count != NumPatterns)
+    return makeStringError("pattern index has the wrong number of records");
+  if (auto Err = Require(FixesSection, FixRecordSize, NumFixes, Fixes))
+    return Err;
+  if (auto Err = Require(ProgramsSection, ProgramRecordSize, NumPrograms, Programs))
+    return Err;
+  if (auto Err = Require(AdjustmentsSection, AdjustmentRecordSize,
+                         NumAdjustments, Adjustments))
+    return Err;
+
+  if (auto Err = Require(NeedleFieldsSection, 1, NumNeedles, NeedleFields))
+    return Err;
+  if (auto Err = Require(NeedleOffsetsSection, 4, Count, NeedleOffsets))
+    return Err;
+  if (Count != NumNeedles + 1)
+    return makeStringError("pattern index needle table is corrupt");
+  if (auto Err = Require(NeedlePatternsSection, 4, NumPostings, NeedlePatterns))
+    return Err;
+  if (read32le(NeedleOffsets + NumNeedles * 4) != NumPostings)
+    return makeStringError("pattern index needle table is corrupt");
+
+  const char *Map = nullptr;
+  if (auto Err = Require(ClassMapSection, 1, Count, Map))
+    return Err;
+  if (Count != 256)
+    return makeStringError("pattern index class map is corrupt");
+  ClassMap   = reinterpret_cast<const uint8_t *>(Map);
+  NumClasses = *std::max_element(ClassMap, ClassMap + 256) + 1u;
+
+  if (auto Err = Require(OutputOffsetsSection, 4, Count, OutputOffsets))
+    return Err;
+  if (Count == 0)
+    return makeStringError("pattern index automaton is empty");
+  NumStates = Count - 1;
+  if (auto Err = Require(OutputNeedlesSection, 4, NumOutputs, OutputNeedles))
+    return Err;
+  if (read32le(OutputOffsets + NumStates * 4) != NumOutputs)
+    return makeStringError("pattern index automaton is corrupt");
+  if (auto Err = Require(TransitionsSection, 4, Count, Transitions))
+    return Err;
+  if (Count != NumStates * NumClasses)
+    return makeStringError("pattern index automaton is corrupt");
+  return llvm::Error::success();
+}
+
+llvm::StringRef PatternDB::string(const char *Ref) const {
+  uint32_t Offset = read32le(Ref), Length = read32le(Ref + 4);
+  if (Offset > Strings.size() || Length > Strings.size() - Offset)
+    return {};
+  return Strings.substr(Offset, Length);
+}
+
+uint32_t PatternDB::requiredFields(uint32_t Id) const {
+  const char *R = Records + uint64_t(Id) * PatternRecordSize;
+  uint32_t Mask = 0;
+  for (unsigned F = 0; F < NumMatchFields; ++F)
+    if (!string(R + F * 8).empty())
+      Mask |= 1u << F;
+  return Mask;
+}
+
+// the counts are clamped and evaluate() checks every operand, so a damaged
+// record or index can only make its condition false
+PredicateProgram PatternDB::program(uint32_t Index) const {
+  if (Index >= NumPrograms)
+    return PredicateProgram::compile("0");
+  PredicateProgram P;
+  const char *R = Programs + uint64_t(Index) * ProgramRecordSize;
+  for (size_t I = 0; I < PredicateProgram::MaxInstructions; ++I)
+    P.Code[I] = PredicateInstr{PredicateOp(R[I * 3]), uint8_t(R[I * 3 + 1]),
+                               uint8_t(R[I * 3 + 2])};
+  const char *Counts = R + ProgramCodeSize;
+  P.Length     = std::min<uint8_t>(Counts[0], PredicateProgram::MaxInstructions);
+  P.NumNumbers = std::min<uint8_t>(Counts[1], PredicateProgram::MaxNumbers);
+  P.NumNames   = std::min<uint8_t>(Counts[2], PredicateProgram::MaxNames);
+  const char *Numbers = Counts + 8;
+  for (size_t I = 0; I < PredicateProgram::MaxNumbers; ++I)
+    P.Numbers[I] = llvm::bit_cast<double>(read64le(Numbers + I * 8));
+  const char *Names = Numbers + PredicateProgram::MaxNumbers * 8;
+  for (size_t I = 0; I < PredicateProgram::MaxNames; ++I) {
+    llvm::StringRef N = string(Names + I * 8);
+    P.Names[I] = std::string_view(N.data(), N.size());
+  }
+  return P;
+}
+
+// one table lookup per byte; a transition outside the automaton stops the
+// scan rather than reading past it
+void PatternDB::scan(llvm::StringRef Text, unsigned Field,
+                     llvm::SmallVectorImpl<uint32_t> &Needles) const {
+  uint32_t S = 0;
+  for (unsigned char C : Text) {
+    S = read32le(Transitions + (uint64_t(S) * NumClasses + ClassMap[C]) * 4);
+    if (S >= NumStates)
+      return;
+    uint32_t Begin = read32le(OutputOffsets + uint64_t(S) * 4);
+    uint32_t End   = read32le(OutputOffsets + uint64_t(S + 1) * 4);
+    for (uint32_t I = Begin; I < End && I < NumOutputs; ++I) {
+      uint32_t N = read32le(OutputNeedles + uint64_t(I) * 4);
+      if (N < NumNeedles && uint8_t(NeedleFields[N]) == Field)
+        Needles.push_back(N);
+    }
+  }
+}
+
+std::optional<uint32_t> PatternDB::match(const Remark &R, int &Score) const {
+  Score = -1;
+  if (!NumPatterns)
+    return std::nullopt;
+
+  llvm::SmallVector<uint32_t, 16> Needles;
+  scan(R.PassName, 0, Needles);
+  scan(R.RemarkName, 1, Needles);
+  scan(R.Message, 2, Needles);
+  if (Needles.empty())
+    return std::nullopt;
+  llvm::sort(Needles);
+  Needles.erase(std::unique(Needles.begin(), Needles.end()), Needles.end());
+
+  // (pattern << 2 | field) for every pattern a found needle belongs to
+  llvm::SmallVector<uint64_t, 32> Hits;
+  for (uint32_t N : Needles) {
+    uint32_t Begin = read32le(NeedleOffsets + uint64_t(N) * 4);
+    uint32_t End   = read32le(NeedleOffsets + uint64_t(N + 1) * 4);
+    for (uint32_t I = Begin; I < End && I < NumPostings; ++I) {
+      uint32_t P = read32le(NeedlePatterns + uint64_t(I) * 4);
+      if (P < NumPatterns)
+        Hits.push_back(uint64_t(P) << 2 | uint8_t(NeedleFields[N]));
+    }
+  }
+  llvm::sort(Hits);
+
+  std::optional<uint32_t> Best;
+  for (size_t I = 0; I < Hits.size();) {
+    uint32_t P = static_cast<uint32_t>(Hits[I] >> 2);
+    uint32_t Found = 0;
+    for (; I < Hits.size() && (Hits[I] >> 2) == P; ++I)
+      Found |= 1u << (Hits[I] & 3);
+    if (Found != requiredFields(P))
+      continue;
+    int S = 0;
+    for (unsigned F = 0; F < NumMatchFields; ++F)
+      if (Found & (1u << F))
+        S += FieldScores[F];
+    uint32_t Where = read32le(Records + uint64_t(P) * PatternRecordSize +
+                              NumPatternStrings * 8 + 12);
+    if (Where != NoProgram) {
+      if (!Patterns[P].Where.evaluate(R))
+        continue;
+      S += 1;
+    }
+    if (S > Score) {
+      Score = S;
+      Best  = P;
+    }
+  }
+  return Best;
+}
+
+std::optional<uint32_t> PatternDB::findRule(llvm::StringRef RuleID) const {
+  for (uint64_t Id = 0; Id < NumPatterns; ++Id) {
+    const char *R = Records + Id * PatternRecordSize;
+    if (string(R + RuleIDString * 8)
+            .take_front(OptimizationPattern::MaxRuleIDLength) == RuleID)
+      return static_cast<uint32_t>(Id);
+  }
+  return std::nullopt;
+}
+
+OptimizationPattern PatternDB::buildPattern(uint32_t Id) const {
+  const char *R = Records + uint64_t(Id) * PatternRecordSize;
+  const char *Tail = R + NumPatternStrings * 8;
+
+  uint32_t Severity = read32le(Tail + 8);
+  OptimizationPattern P(
+      "", "", "", string(R + ShortString * 8), string(R + ExplanationString * 8),
+      string(R + RootCauseString * 8), string(R + WantedString * 8), {},
+      Severity <= uint32_t(SeverityLevel::Info) ? SeverityLevel(Severity)
+                                                : SeverityLevel::Medium,
+      llvm::bit_cast<double>(read64le(Tail + 16)));
+  P.PassNameSubstr   = string(R + PassString * 8);
+  P.RemarkNameSubstr = string(R + RemarkString * 8);
+  P.MessageSubstr    = string(R + MessageString * 8);
+
+  llvm::StringRef RuleID =
+      string(R + RuleIDString * 8).take_front(OptimizationPattern::MaxRuleIDLength);
+  if (!RuleID.empty())
+    std::memcpy(P.RuleIDData, RuleID.data(), RuleID.size());
+  P.RuleIDLength = RuleID.size();
+
+  uint64_t FixBegin = read32le(Tail);
+  uint64_t FixCount = read32le(Tail + 4);
+  if (FixBegin > NumFixes)
+    FixBegin = NumFixes;
+  FixCount = std::min<uint64_t>({FixCount, NumFixes - FixBegin,
+                                 OptimizationPattern::MaxSuggestions});
+  for (uint64_t I = 0; I < FixCount; ++I) {
+    const char *F = Fixes + (FixBegin + I) * FixRecordSize;
+    uint32_t Flags = read32le(F + 16);
+    uint32_t Edit  = read32le(F + 20);
+    P.Fixes[I] = PatternFix{string(F), string(F + 8),
+                            (Flags & FixSourceLevel) != 0,
+                            (Flags & FixIRLevel) != 0};
+    if (Edit <= static_cast<uint32_t>(FixEdit::ReadNoneCallees))
+      P.Fixes[I].Edit = static_cast<FixEdit>(Edit);
+  }
+  P.NumFixes = FixCount;
+
+  uint32_t Where = read32le(Tail + 12);
+  if (Where != NoProgram)
+    P.Where = program(Where);
+
+  uint64_t AdjBegin = read32le(Tail + 24);
+  uint64_t AdjCount = read32le(Tail + 28);
+  if (AdjBegin > NumAdjustments)
+    AdjBegin = NumAdjustments;
+  AdjCount = std::min<uint64_t>({AdjCount, NumAdjustments - AdjBegin,
+                                 OptimizationPattern::MaxAdjustments});
+  for (uint64_t I = 0; I < AdjCount; ++I) {
+    const char *A = Adjustments + (AdjBegin + I) * AdjustmentRecordSize;
+    uint32_t Flags    = read32le(A + 4);
+    uint32_t Severity = read32le(A + 8);
+    PatternAdjustment &Adj = P.Adjustments[I];
+    Adj.Condition   = program(read32le(A));
+    Adj.HasSeverity = (Flags & AdjustsSeverity) && Severity <= uint32_t(SeverityLevel::Info);
+    Adj.HasSpeedup  = (Flags & AdjustsSpeedup) != 0;
+    Adj.Severity    = Adj.HasSeverity ? SeverityLevel(Severity) : SeverityLevel::Medium;
+    Adj.EstimatedSpeedup = llvm::bit_cast<double>(read64le(A + 16));
+  }
+  P.NumAdjustments = AdjCount;
+  return P;
+}
+
+}
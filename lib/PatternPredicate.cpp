@@ -0,0 +1,102 @@
+#include "OptDebugger/PatternPredicate.h"
+
+#include "llvm/ADT/StringRef.h"
+
+namespace optdbg {
+
+// programs from a pattern index are not trusted: operands, stack depth and
+// jump targets are checked, and only forward jumps are taken
+bool PredicateProgram::evaluate(const Remark &R) const {
+  double Stack[MaxInstructions];
+  size_t Top = 0;
+
+  auto name = [&](uint8_t I) -> std::string_view {
+    return I < NumNames ? Names[I] : std::string_view();
+  };
+
+  for (size_t PC = 0; PC < Length && PC < MaxInstructions;) {
+    const PredicateInstr &I = Code[PC++];
+
+    switch (I.Op) {
+    case PredicateOp::PushNumber:
+    case PredicateOp::PushArg:
+    case PredicateOp::HasArg:
+    case PredicateOp::ArgContains:
+    case PredicateOp::ArgEquals: {
+      if (Top == MaxInstructions)
+        return false;
+      double V = 0;
+      if (I.Op == PredicateOp::PushNumber) {
+        if (I.A >= NumNumbers)
+          return false;
+        V = Numbers[I.A];
+      } else {
+        const RemarkArgument *Arg = R.findArg(name(I.A));
+        if (I.Op == PredicateOp::PushArg) {
+          if (!Arg || llvm::StringRef(Arg->Value).trim().getAsDouble(V))
+            return false;
+        } else if (I.Op == PredicateOp::HasArg) {
+          V = Arg != nullptr;
+        } else if (Arg) {
+          std::string_view Text = name(I.B);
+          llvm::StringRef Needle(Text.data(), Text.size());
+          V = I.Op == PredicateOp::ArgContains
+                  ? llvm::StringRef(Arg->Value).contains_insensitive(Needle)
+                  : llvm::StringRef(Arg->Value) == Needle;
+        }
+      }
+      Stack[Top++] = V;
+      break;
+    }
+
+    case PredicateOp::Neg:
+    case PredicateOp::Not:
+      if (Top == 0)
+        return false;
+      Stack[Top - 1] = I.Op == PredicateOp::Neg ? -Stack[Top - 1]
+                                                : double(Stack[Top - 1] == 0);
+      break;
+
+    case PredicateOp::JumpIfFalse:
+    case PredicateOp::JumpIfTrue: {
+      if (Top == 0 || I.A < PC)
+        return false;
+      bool Truth = Stack[Top - 1] != 0;
+      if (Truth == (I.Op == PredicateOp::JumpIfTrue))
+        PC = I.A;
+      else
+        --Top;
+      break;
+    }
+
+    default: {
+      if (Top < 2)
+        return false;
+      double Rhs = Stack[--Top];
+      double &Lhs = Stack[Top - 1];
+      switch (I.Op) {
+      case PredicateOp::Add:          Lhs = Lhs + Rhs; break;
+      case PredicateOp::Sub:          Lhs = Lhs - Rhs; break;
+      case PredicateOp::Mul:          Lhs = Lhs * Rhs; break;
+      case PredicateOp::Div:
+        if (Rhs == 0)
+          return false;
+        Lhs = Lhs / Rhs;
+        break;
+      case PredicateOp::Less:         Lhs = Lhs < Rhs;  break;
+      case PredicateOp::LessEqual:    Lhs = Lhs <= Rhs; break;
+      case PredicateOp::Greater:      Lhs = Lhs > Rhs;  break;
+      case PredicateOp::GreaterEqual: Lhs = Lhs >= Rhs; break;
+      case PredicateOp::Equal:        Lhs = Lhs == Rhs; break;
+      case PredicateOp::NotEqual:     Lhs = Lhs != Rhs; break;
+      default:
+        return false;
+      }
+      break;
+    }
+    }
+  }
+  return Length == 0 || (Top > 0 && Stack[Top - 1] != 0);
+}
+
+}
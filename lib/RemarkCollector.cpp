@@ -153,10 +153,29 @@ bool RemarkCollectorHandler::handleDiagnostics(
   return true;
 }
 
+bool RemarkCollectorHandler::isAnalysisRemarkEnabled(
+    llvm::StringRef PassName) const {
+  return AllRemarks || DiagnosticHandler::isAnalysisRemarkEnabled(PassName);
+}
+
+bool RemarkCollectorHandler::isMissedOptRemarkEnabled(
+    llvm::StringRef PassName) const {
+  return AllRemarks || DiagnosticHandler::isMissedOptRemarkEnabled(PassName);
+}
+
+bool RemarkCollectorHandler::isPassedOptRemarkEnabled(
+    llvm::StringRef PassName) const {
+  return AllRemarks || DiagnosticHandler::isPassedOptRemarkEnabled(PassName);
+}
+
+bool RemarkCollectorHandler::isAnyRemarkEnabled() const {
+  return AllRemarks || DiagnosticHandler::isAnyRemarkEnabled();
+}
+
 // installs the custom diagnostic handler into the llvm context
-void RemarkCollector::install(llvm::LLVMContext &Ctx) {
+void RemarkCollector::install(llvm::LLVMContext &Ctx, bool AllRemarks) {
   Ctx.setDiagnosticHandler(
-      std::make_unique<RemarkCollectorHandler>(Remarks));
+      std::make_unique<RemarkCollectorHandler>(Remarks, AllRemarks));
   Ctx.setDiagnosticsHotnessRequested(false);
 }
 
@@ -0,0 +1,309 @@
+#include "OptDebugger/RemarkCompare.h"
+#include "OptDebugger/PassAnalyzer.h"
+#include "OptDebugger/RemarkDB.h"
+#include "OptDebugger/SessionIO.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+namespace optdbg {
+
+namespace {
+
+llvm::StringRef changeName(RemarkChange C) {
+  switch (C) {
+  case RemarkChange::NewlyMissed:  return "newly-missed";
+  case RemarkChange::NewlyApplied: return "newly-applied";
+  case RemarkChange::Changed:      return "changed";
+  case RemarkChange::Removed:      return "removed";
+  }
+  return "changed";
+}
+
+// the same file reached through "./a/../b.c" or "b.c" joins as one key
+std::string normalizeFile(llvm::StringRef File) {
+  llvm::SmallString<128> P(File);
+  llvm::sys::path::remove_dots(P, /*remove_dot_dot=*/true,
+                               llvm::sys::path::Style::posix);
+  return std::string(P);
+}
+
+// true when the file starts with the given magic bytes
+bool hasMagic(llvm::StringRef Path, const char (&Magic)[8]) {
+  auto BufOrErr = llvm::MemoryBuffer::getFileSlice(Path, sizeof(Magic), 0);
+  return BufOrErr && (*BufOrErr)->getBufferSize() == sizeof(Magic) &&
+         std::memcmp((*BufOrErr)->getBufferStart(), Magic, sizeof(Magic)) == 0;
+}
+
+const Remark &deltaRemark(const RemarkDelta &D) {
+  return D.Change == RemarkChange::Removed ? D.Old : D.New;
+}
+
+}
+
+size_t RemarkComparison::count(RemarkChange C) const {
+  return std::count_if(Deltas.begin(), Deltas.end(),
+                       [C](const RemarkDelta &D) { return D.Change == C; });
+}
+
+size_t RemarkComparison::regressions() const {
+  return std::count_if(Deltas.begin(), Deltas.end(), [](const RemarkDelta &D) {
+    return D.Change == RemarkChange::NewlyMissed ||
+           (D.Change == RemarkChange::Changed && D.Old.isApplied() &&
+            D.New.isMissed());
+  });
+}
+
+std::string RemarkComparator::joinKey(const Remark &R) {
+  std::string Key;
+  llvm::raw_string_ostream OS(Key);
+  OS << R.FunctionName << '\0' << normalizeFile(R.Loc.File) << '\0'
+     << R.Loc.Line << '\0' << R.Loc.Column << '\0' << R.PassName << '\0'
+     << R.RemarkName;
+  return OS.str();
+}
+
+std::string RemarkComparator::functionKey(const Remark &R) {
+  std::string Key;
+  llvm::raw_string_ostream OS(Key);
+  OS << R.FunctionName << '\0' << R.PassName << '\0' << R.RemarkName << '\0'
+     << R.Message;
+  return OS.str();
+}
+
+void RemarkComparator::addOld(Remark R) {
+  ++Result.OldCount;
+  Table[joinKey(R)].push_back(static_cast<uint32_t>(Old.size()));
+  Old.push_back({std::move(R), false});
+}
+
+// a key may repeat (e.g. one remark per call site on a line); an unmatched
+// old entry with the same kind and message is preferred over any other
+void RemarkComparator::addNew(Remark R) {
+  ++Result.NewCount;
+
+  auto It = Table.find(joinKey(R));
+  if (It != Table.end()) {
+    OldEntry *Fallback = nullptr;
+    for (uint32_t Idx : It->second) {
+      OldEntry &E = Old[Idx];
+      if (E.Matched)
+        continue;
+      if (E.R.Kind == R.Kind && E.R.Message == R.Message) {
+        E.Matched = true;
+        ++Result.Unchanged;
+        return;
+      }
+      if (!Fallback)
+        Fallback = &E;
+    }
+    if (Fallback) {
+      Fallback->Matched = true;
+      Result.Deltas.push_back({RemarkChange::Changed, Fallback->R, std::move(R)});
+      return;
+    }
+  }
+
+  if (!R.isAnalysis())
+    Pending.push_back(std::move(R));
+}
+
+void RemarkComparator::addUnmatched(Remark R) {
+  if (R.isMissed())
+    Result.Deltas.push_back({RemarkChange::NewlyMissed, Remark(), std::move(R)});
+  else if (R.isApplied())
+    Result.Deltas.push_back({RemarkChange::NewlyApplied, Remark(), std::move(R)});
+}
+
+RemarkComparison RemarkComparator::finish() {
+  // second pass once every exact match is taken: a remark whose location
+  // moved still matches an unmatched old one in the same function
+  if (!Pending.empty()) {
+    llvm::StringMap<llvm::SmallVector<uint32_t, 1>> ByFunction;
+    for (uint32_t I = 0; I < Old.size(); ++I)
+      if (!Old[I].Matched && !Old[I].R.isAnalysis())
+        ByFunction[functionKey(Old[I].R)].push_back(I);
+
+    for (Remark &R : Pending) {
+      auto It = ByFunction.find(functionKey(R));
+      OldEntry *Match = nullptr;
+      if (It != ByFunction.end())
+        for (uint32_t Idx : It->second)
+          if (!Old[Idx].Matched) {
+            Match = &Old[Idx];
+            break;
+          }
+      if (!Match) {
+        addUnmatched(std::move(R));
+        continue;
+      }
+      Match->Matched = true;
+      if (Match->R.Kind == R.Kind)
+        ++Result.Unchanged;
+      else
+        Result.Deltas.push_back({RemarkChange::Changed, Match->R, std::move(R)});
+    }
+    Pending.clear();
+  }
+
+  for (OldEntry &E : Old)
+    if (!E.Matched && !E.R.isAnalysis())
+      Result.Deltas.push_back({RemarkChange::Removed, std::move(E.R), Remark()});
+  Old.clear();
+  Table.clear();
+
+  std::stable_sort(Result.Deltas.begin(), Result.Deltas.end(),
+                   [](const RemarkDelta &A, const RemarkDelta &B) {
+                     const Remark &RA = deltaRemark(A), &RB = deltaRemark(B);
+                     return std::make_tuple(A.Change, llvm::StringRef(RA.Loc.File),
+                                            RA.Loc.Line, RA.Loc.Column) <
+                            std::make_tuple(B.Change, llvm::StringRef(RB.Loc.File),
+                                            RB.Loc.Line, RB.Loc.Column);
+                   });
+  return std::move(Result);
+}
+
+llvm::Error forEachStoredRemark(llvm::StringRef Path,
+                                llvm::function_ref<void(Remark &&)> Callback) {
+  if (llvm::sys::fs::is_directory(Path)) {
+    std::vector<std::string> Files;
+    std::error_code EC;
+    for (llvm::sys::fs::recursive_directory_iterator It(Path, EC), End;
+         It != End && !EC; It.increment(EC))
+      if (llvm::StringRef(It->path()).ends_with(".opt.yaml"))
+        Files.push_back(It->path());
+    if (EC)
+      return makeStringError("Cannot walk '" + Path + "': " + EC.message());
+    std::sort(Files.begin(), Files.end());
+    for (const std::string &F : Files)
+      if (auto Err = PassAnalyzer::forEachRemarkYAML(F, Callback))
+        return Err;
+    return llvm::Error::success();
+  }
+
+  if (hasMagic(Path, SessionMagic)) {
+    auto SessionOrErr = loadSession(Path);
+    if (!SessionOrErr)
+      return SessionOrErr.takeError();
+    for (Remark &R : SessionOrErr->Remarks)
+      Callback(std::move(R));
+    return llvm::Error::success();
+  }
+
+  if (hasMagic(Path, RemarkDBMagic)) {
+    auto DBOrErr = RemarkDB::open(Path);
+    if (!DBOrErr)
+      return DBOrErr.takeError();
+    for (uint32_t Row = 0; Row < (*DBOrErr)->size(); ++Row)
+      Callback((*DBOrErr)->materialize(Row));
+    return llvm::Error::success();
+  }
+
+  return PassAnalyzer::forEachRemarkYAML(Path, Callback);
+}
+
+llvm::Expected<RemarkComparison> compareRemarkSets(llvm::StringRef OldPath,
+                                                   llvm::StringRef NewPath) {
+  RemarkComparator Cmp;
+  if (auto Err = forEachStoredRemark(
+          OldPath, [&](Remark &&R) { Cmp.addOld(std::move(R)); }))
+    return std::move(Err);
+  if (auto Err = forEachStoredRemark(
+          NewPath, [&](Remark &&R) { Cmp.addNew(std::move(R)); }))
+    return std::move(Err);
+  return Cmp.finish();
+}
+
+void printRemarkComparison(const RemarkComparison &C, llvm::raw_ostream &OS,
+                           bool UseColor) {
+  auto ColorFor = [](RemarkChange Ch) {
+    switch (Ch) {
+    case RemarkChange::NewlyMissed:  return llvm::raw_ostream::RED;
+    case RemarkChange::NewlyApplied: return llvm::raw_ostream::GREEN;
+    case RemarkChange::Changed:      return llvm::raw_ostream::YELLOW;
+    case RemarkChange::Removed:      return llvm::raw_ostream::CYAN;
+    }
+    return llvm::raw_ostream::WHITE;
+  };
+
+  for (const RemarkDelta &D : C.Deltas) {
+    const Remark &R = deltaRemark(D);
+    if (UseColor)
+      OS.changeColor(ColorFor(D.Change), true);
+    OS << changeName(D.Change);
+    if (UseColor)
+      OS.resetColor();
+    OS << ": " << R.Loc.format() << ": " << R.PassName << "/" << R.RemarkName
+       << " in " << R.FunctionName << "\n";
+    if (D.Change == RemarkChange::Changed) {
+      OS << "    was: [" << remarkKindName(D.Old.Kind) << "] " << D.Old.Message << "\n";
+      OS << "    now: [" << remarkKindName(D.New.Kind) << "] " << D.New.Message << "\n";
+    } else if (!R.Message.empty()) {
+      OS << "    " << R.Message << "\n";
+    }
+  }
+
+  if (!C.Deltas.empty())
+    OS << "\n";
+  OS << "Compared " << C.OldCount << " old and " << C.NewCount
+     << " new remarks: " << C.count(RemarkChange::NewlyMissed)
+     << " newly missed, " << C.count(RemarkChange::NewlyApplied)
+     << " newly applied, " << C.count(RemarkChange::Changed) << " changed, "
+     << C.count(RemarkChange::Removed) << " removed, " << C.Unchanged
+     << " unchanged\n";
+}
+
+void writeRemarkComparisonJSON(const RemarkComparison &C,
+                               llvm::raw_ostream &OS) {
+  auto WriteRemark = [](llvm::json::OStream &J, llvm::StringRef Key,
+                        const Remark &R) {
+    J.attributeObject(Key, [&] {
+      J.attribute("kind", remarkKindName(R.Kind));
+      J.attribute("pass", R.PassName);
+      J.attribute("name", R.RemarkName);
+      J.attribute("function", R.FunctionName);
+      J.attribute("file", R.Loc.File);
+      J.attribute("line", R.Loc.Line);
+      J.attribute("column", R.Loc.Column);
+      J.attribute("message", R.Message);
+    });
+  };
+
+  llvm::json::OStream J(OS, 2);
+  J.object([&] {
+    J.attributeObject("summary", [&] {
+      J.attribute("old_remarks", static_cast<int64_t>(C.OldCount));
+      J.attribute("new_remarks", static_cast<int64_t>(C.NewCount));
+      J.attribute("unchanged", static_cast<int64_t>(C.Unchanged));
+      J.attribute("newly_missed",
+                  static_cast<int64_t>(C.count(RemarkChange::NewlyMissed)));
+      J.attribute("newly_applied",
+                  static_cast<int64_t>(C.count(RemarkChange::NewlyApplied)));
+      J.attribute("changed", static_cast<int64_t>(C.count(RemarkChange::Changed)));
+      J.attribute("removed", static_cast<int64_t>(C.count(RemarkChange::Removed)));
+      J.attribute("regressions", static_cast<int64_t>(C.regressions()));
+    });
+    J.attributeArray("changes", [&] {
+      for (const RemarkDelta &D : C.Deltas) {
+        J.object([&] {
+          J.attribute("change", changeName(D.Change));
+          if (D.Change != RemarkChange::NewlyMissed &&
+              D.Change != RemarkChange::NewlyApplied)
+            WriteRemark(J, "old", D.Old);
+          if (D.Change != RemarkChange::Removed)
+            WriteRemark(J, "new", D.New);
+        });
+      }
+    });
+  });
+  OS << "\n";
+}
+
+}
@@ -0,0 +1,652 @@
+#include "OptDebugger/RemarkDB.h"
+#include "OptDebugger/PassAnalyzer.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/bit.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <optional>
+
+namespace optdbg {
+
+namespace {
+
+using llvm::support::endian::read32le;
+using llvm::support::endian::read64le;
+
+constexpr size_t HeaderSize       = 32;
+constexpr size_t SectionEntrySize = 24;
+
+// section kinds; string columns occupy one slot per RemarkColumn
+constexpr uint32_t DictDataBase     = 0x10;
+constexpr uint32_t DictEntriesBase  = 0x20;
+constexpr uint32_t ColumnBase       = 0x30;
+constexpr uint32_t LinesSection     = 0x40;
+constexpr uint32_t ColsSection      = 0x41;
+constexpr uint32_t KindsSection     = 0x42;
+constexpr uint32_t KindBitmapsSection = 0x43;
+constexpr uint32_t PassOffsetsSection = 0x50;
+constexpr uint32_t PassRowsSection    = 0x51;
+constexpr uint32_t FileOffsetsSection = 0x52;
+constexpr uint32_t FileRowsSection    = 0x53;
+constexpr uint32_t HotnessSection     = 0x60;
+constexpr uint32_t ArgDictDataSection    = 0x61;
+constexpr uint32_t ArgDictEntriesSection = 0x62;
+constexpr uint32_t ArgOffsetsSection     = 0x63;
+constexpr uint32_t ArgFieldsSection      = 0x64;
+
+// a quiet NaN no remark hotness (a count) can take
+constexpr uint32_t NoHotness      = 0xFFFFFFFF;
+constexpr unsigned ArgFieldCount  = 5;
+
+uint64_t bitmapWords(uint64_t Rows) { return (Rows + 63) / 64; }
+
+void append32(std::string &Out, uint32_t V) {
+  char B[4];
+  llvm::support::endian::write32le(B, V);
+  Out.append(B, 4);
+}
+
+void append64(std::string &Out, uint64_t V) {
+  char B[8];
+  llvm::support::endian::write64le(B, V);
+  Out.append(B, 8);
+}
+
+// sorts a dictionary so prefix queries map to a contiguous id range and
+// returns the new id of every old one
+std::vector<uint32_t> sortDictionary(const std::vector<llvm::StringRef> &Values) {
+  std::vector<uint32_t> Order(Values.size());
+  std::iota(Order.begin(), Order.end(), 0);
+  std::sort(Order.begin(), Order.end(), [&](uint32_t A, uint32_t B) {
+    return Values[A] < Values[B];
+  });
+  std::vector<uint32_t> NewId(Order.size());
+  for (uint32_t I = 0; I < Order.size(); ++I)
+    NewId[Order[I]] = I;
+  return NewId;
+}
+
+// row ids grouped by dictionary id, as CSR offsets plus a row array
+void buildPostings(const std::vector<uint32_t> &Column, uint32_t DictSize,
+                   std::string &Offsets, std::string &Rows) {
+  std::vector<uint32_t> Start(DictSize + 1, 0);
+  for (uint32_t Id : Column)
+    ++Start[Id + 1];
+  std::partial_sum(Start.begin(), Start.end(), Start.begin());
+
+  std::vector<uint32_t> Sorted(Column.size());
+  std::vector<uint32_t> Next(Start.begin(), Start.end() - 1);
+  for (uint32_t Row = 0; Row < Column.size(); ++Row)
+    Sorted[Next[Column[Row]]++] = Row;
+
+  for (uint32_t S : Start)
+    append32(Offsets, S);
+  for (uint32_t R : Sorted)
+    append32(Rows, R);
+}
+
+}
+
+uint32_t RemarkDBWriter::Dictionary::intern(llvm::StringRef S) {
+  auto Inserted = Ids.try_emplace(S, static_cast<uint32_t>(Values.size()));
+  if (Inserted.second)
+    Values.push_back(Inserted.first->getKey());
+  return Inserted.first->second;
+}
+
+RemarkDBWriter::RemarkDBWriter() = default;
+
+void RemarkDBWriter::add(const Remark &R, llvm::StringRef Origin) {
+  const llvm::StringRef Values[NumRemarkStringColumns] = {
+      R.PassName, R.RemarkName, R.FunctionName, R.Loc.File, R.Message, Origin};
+  for (unsigned C = 0; C < NumRemarkStringColumns; ++C)
+    Columns[C].push_back(Dicts[C].intern(Values[C]));
+  Lines.push_back(R.Loc.Line);
+  Cols.push_back(R.Loc.Column);
+  Kinds.push_back(static_cast<uint8_t>(R.Kind));
+  Hotness.push_back(R.Hotness ? llvm::bit_cast<uint32_t>(*R.Hotness)
+                              : NoHotness);
+  for (const RemarkArgument &A : R.Args) {
+    ArgFields.push_back(ArgDict.intern(A.Key));
+    ArgFields.push_back(ArgDict.intern(A.Value));
+    ArgFields.push_back(ArgDict.intern(A.Loc.File));
+    ArgFields.push_back(A.Loc.Line);
+    ArgFields.push_back(A.Loc.Column);
+  }
+  ArgOffsets.push_back(static_cast<uint32_t>(ArgFields.size() / ArgFieldCount));
+}
+
+// remarks are appended as each file is parsed, so only one file's remarks
+// are materialized at a time
+llvm::Error RemarkDBWriter::addYAMLFile(llvm::StringRef Path) {
+  auto RemarksOrErr = PassAnalyzer::parseRemarksYAML(Path);
+  if (!RemarksOrErr)
+    return RemarksOrErr.takeError();
+  for (const Remark &R : *RemarksOrErr)
+    add(R, Path);
+  return llvm::Error::success();
+}
+
+llvm::Error RemarkDBWriter::write(llvm::StringRef Path) {
+  uint64_t NumRows = Kinds.size();
+  if (NumRows > UINT32_MAX || ArgFields.size() / ArgFieldCount > UINT32_MAX)
+    return makeStringError("Too many remarks for one database");
+
+  struct Section {
+    uint32_t    Kind;
+    uint32_t    ElemSize;
+    std::string Data;
+  };
+  std::vector<Section> Sections;
+
+  // writes a dictionary in sorted order; returns the new id of every old one
+  auto WriteDictionary = [&](const Dictionary &D, uint32_t DataKind,
+                             uint32_t EntriesKind) {
+    std::vector<uint32_t> NewId = sortDictionary(D.Values);
+    std::vector<llvm::StringRef> Sorted(D.Values.size());
+    for (uint32_t Old = 0; Old < NewId.size(); ++Old)
+      Sorted[NewId[Old]] = D.Values[Old];
+
+    Section Data{DataKind, 1, {}};
+    Section Entries{EntriesKind, 8, {}};
+    for (llvm::StringRef V : Sorted) {
+      append32(Entries.Data, static_cast<uint32_t>(Data.Data.size()));
+      append32(Entries.Data, static_cast<uint32_t>(V.size()));
+      Data.Data.append(V.begin(), V.end());
+    }
+    Sections.push_back(std::move(Data));
+    Sections.push_back(std::move(Entries));
+    return NewId;
+  };
+
+  for (unsigned C = 0; C < NumRemarkStringColumns; ++C) {
+    std::vector<uint32_t> NewId =
+        WriteDictionary(Dicts[C], DictDataBase + C, DictEntriesBase + C);
+    for (uint32_t &Id : Columns[C])
+      Id = NewId[Id];
+
+    Section Col{ColumnBase + C, 4, {}};
+    for (uint32_t Id : Columns[C])
+      append32(Col.Data, Id);
+    Sections.push_back(std::move(Col));
+  }
+
+  Section LineSec{LinesSection, 4, {}}, ColSec{ColsSection, 4, {}};
+  for (uint32_t L : Lines)
+    append32(LineSec.Data, L);
+  for (uint32_t C : Cols)
+    append32(ColSec.Data, C);
+  Sections.push_back(std::move(LineSec));
+  Sections.push_back(std::move(ColSec));
+
+  Section KindSec{KindsSection, 1,
+                  std::string(Kinds.begin(), Kinds.end())};
+  Sections.push_back(std::move(KindSec));
+
+  Section HotSec{HotnessSection, 4, {}};
+  for (uint32_t H : Hotness)
+    append32(HotSec.Data, H);
+  Sections.push_back(std::move(HotSec));
+
+  std::vector<uint32_t> ArgId =
+      WriteDictionary(ArgDict, ArgDictDataSection, ArgDictEntriesSection);
+  Section ArgOffsetSec{ArgOffsetsSection, 4, {}};
+  for (uint32_t O : ArgOffsets)
+    append32(ArgOffsetSec.Data, O);
+  Section ArgFieldSec{ArgFieldsSection, 4 * ArgFieldCount, {}};
+  for (size_t I = 0; I < ArgFields.size(); I += ArgFieldCount) {
+    append32(ArgFieldSec.Data, ArgId[ArgFields[I]]);
+    append32(ArgFieldSec.Data, ArgId[ArgFields[I + 1]]);
+    append32(ArgFieldSec.Data, ArgId[ArgFields[I + 2]]);
+    append32(ArgFieldSec.Data, ArgFields[I + 3]);
+    append32(ArgFieldSec.Data, ArgFields[I + 4]);
+  }
+  Sections.push_back(std::move(ArgOffsetSec));
+  Sections.push_back(std::move(ArgFieldSec));
+
+  uint64_t Words = bitmapWords(NumRows);
+  std::vector<uint64_t> Bitmaps(NumRemarkKinds * Words, 0);
+  for (uint64_t Row = 0; Row < NumRows; ++Row)
+    Bitmaps[Kinds[Row] * Words + Row / 64] |= uint64_t(1) << (Row % 64);
+  Section BitmapSec{KindBitmapsSection, 8, {}};
+  for (uint64_t W : Bitmaps)
+    append64(BitmapSec.Data, W);
+  Sections.push_back(std::move(BitmapSec));
+
+  Section PassOffsets{PassOffsetsSection, 4, {}}, PassRows{PassRowsSection, 4, {}};
+  buildPostings(Columns[unsigned(RemarkColumn::Pass)],
+                Dicts[unsigned(RemarkColumn::Pass)].Values.size(),
+                PassOffsets.Data, PassRows.Data);
+  Section FileOffsets{FileOffsetsSection, 4, {}}, FileRows{FileRowsSection, 4, {}};
+  buildPostings(Columns[unsigned(RemarkColumn::File)],
+                Dicts[unsigned(RemarkColumn::File)].Values.size(),
+                FileOffsets.Data, FileRows.Data);
+  Sections.push_back(std::move(PassOffsets));
+  Sections.push_back(std::move(PassRows));
+  Sections.push_back(std::move(FileOffsets));
+  Sections.push_back(std::move(FileRows));
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::OF_None);
+  if (EC)
+    return makeStringError("Cannot open remark database '" + Path +
+                           "': " + EC.message());
+
+  auto AlignUp = [](uint64_t V) { return (V + 7) & ~uint64_t(7); };
+  std::vector<uint64_t> Offsets;
+  uint64_t Cursor = HeaderSize + Sections.size() * SectionEntrySize;
+  for (const Section &S : Sections) {
+    Cursor = AlignUp(Cursor);
+    Offsets.push_back(Cursor);
+    Cursor += S.Data.size();
+  }
+
+  std::string Header(RemarkDBMagic, sizeof(RemarkDBMagic));
+  append32(Header, RemarkDBFormatVersion);
+  append32(Header, static_cast<uint32_t>(Sections.size()));
+  append64(Header, Cursor);
+  append64(Header, NumRows);
+  for (size_t I = 0; I < Sections.size(); ++I) {
+    append32(Header, Sections[I].Kind);
+    append32(Header, Sections[I].ElemSize);
+    append64(Header, Offsets[I]);
+    append64(Header, Sections[I].Data.size() / Sections[I].ElemSize);
+  }
+  OS << Header;
+
+  uint64_t Written = Header.size();
+  for (size_t I = 0; I < Sections.size(); ++I) {
+    OS.write_zeros(Offsets[I] - Written);
+    OS << Sections[I].Data;
+    Written = Offsets[I] + Sections[I].Data.size();
+  }
+
+  OS.close();
+  if (OS.has_error()) {
+    EC = OS.error();
+    OS.clear_error();
+    return makeStringError("Cannot write remark database '" + Path +
+                           "': " + EC.message());
+  }
+  return llvm::Error::success();
+}
+
+llvm::StringRef RemarkDB::DictionaryView::get(uint32_t Id) const {
+  if (Id >= Count)
+    return {};
+  const char *E = Entries + uint64_t(Id) * 8;
+  return llvm::StringRef(Data + read32le(E), read32le(E + 4));
+}
+
+uint32_t RemarkDB::DictionaryView::lowerBound(llvm::StringRef S) const {
+  uint32_t Lo = 0, Hi = Count;
+  while (Lo < Hi) {
+    uint32_t Mid = Lo + (Hi - Lo) / 2;
+    if (get(Mid) < S)
+      Lo = Mid + 1;
+    else
+      Hi = Mid;
+  }
+  return Lo;
+}
+
+llvm::Expected<std::unique_ptr<RemarkDB>> RemarkDB::open(llvm::StringRef Path) {
+  auto BufOrErr = llvm::MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                              /*RequiresNullTerminator=*/false);
+  if (!BufOrErr)
+    return makeStringError("Cannot open remark database '" + Path +
+                           "': " + BufOrErr.getError().message());
+
+  std::unique_ptr<RemarkDB> DB(new RemarkDB());
+  DB->Buffer = std::move(*BufOrErr);
+  if (auto Err = DB->bind())
+    return makeStringError("Cannot load remark database '" + Path +
+                           "': " + llvm::toString(std::move(Err)));
+  return std::move(DB);
+}
+
+// validates the header and section table and points every view into the
+// mapped file; nothing is copied
+llvm::Error RemarkDB::bind() {
+  llvm::StringRef B = Buffer->getBuffer();
+  if (B.size() < HeaderSize ||
+      std::memcmp(B.data(), RemarkDBMagic, sizeof(RemarkDBMagic)) != 0)
+    return makeStringError("not an Aion remark database");
+
+  const char *H = B.data() + sizeof(RemarkDBMagic);
+  uint32_t Version     = read32le(H);
+  uint32_t NumSections = read32le(H + 4);
+  uint64_t TotalSize   = read64le(H + 8);
+  NumRows              = read64le(H + 16);
+  if (Version != RemarkDBFormatVersion)
+    return makeStringError("unsupported database version " + llvm::Twine(Version));
+  if (TotalSize != B.size())
+    return makeStringError("database file is truncated");
+  if (NumSections > (B.size() - HeaderSize) / SectionEntrySize ||
+      NumRows > UINT32_MAX)
+    return makeStringError("database header is corrupt");
+
+  auto Find = [&](uint32_t Kind, uint32_t ElemSize,
+                  uint64_t &Count) -> const char * {
+    const char *T = B.data() + HeaderSize;
+    for (uint32_t I = 0; I < NumSections; ++I, T += SectionEntrySize) {
+      if (read32le(T) != Kind || read32le(T + 4) != ElemSize)
+        continue;
+      uint64_t Offset = read64le(T + 8);
+      Count           = read64le(T + 16);
+      if (Offset > B.size() || Count > (B.size() - Offset) / ElemSize)
+        return nullptr;
+      return B.data() + Offset;
+    }
+    return nullptr;
+  };
+
+  auto Require = [&](uint32_t Kind, uint32_t ElemSize, uint64_t Expected,
+                     const char *&Out) -> llvm::Error {
+    uint64_t Count = 0;
+    Out = Find(Kind, ElemSize, Count);
+    if (!Out || Count != Expected)
+      return makeStringError("database section " + llvm::Twine(Kind) +
+                             " is missing or has the wrong size");
+    return llvm::Error::success();
+  };
+
+  auto BindDictionary = [&](uint32_t DataKind, uint32_t EntriesKind,
+                            DictionaryView &D) -> llvm::Error {
+    uint64_t EntryCount = 0;
+    D.Data    = Find(DataKind, 1, D.Size);
+    D.Entries = Find(EntriesKind, 8, EntryCount);
+    if (!D.Data || !D.Entries || EntryCount > UINT32_MAX)
+      return makeStringError("database dictionary " + llvm::Twine(DataKind) +
+                             " is missing");
+    D.Count = static_cast<uint32_t>(EntryCount);
+    for (uint32_t I = 0; I < D.Count; ++I) {
+      const char *E = D.Entries + uint64_t(I) * 8;
+      if (uint64_t(read32le(E)) + read32le(E + 4) > D.Size)
+        return makeStringError("database dictionary " + llvm::Twine(DataKind) +
+                               " is corrupt");
+    }
+    return llvm::Error::success();
+  };
+
+  for (unsigned C = 0; C < NumRemarkStringColumns; ++C) {
+    if (auto Err = BindDictionary(DictDataBase + C, DictEntriesBase + C,
+                                  Dicts[C]))
+      return Err;
+    if (auto Err = Require(ColumnBase + C, 4, NumRows, Columns[C]))
+      return Err;
+  }
+
+  if (auto Err = Require(LinesSection, 4, NumRows, Lines))
+    return Err;
+  if (auto Err = Require(ColsSection, 4, NumRows, Cols))
+    return Err;
+  if (auto Err = Require(KindsSection, 1, NumRows, Kinds))
+    return Err;
+  if (auto Err = Require(KindBitmapsSection, 8,
+                         NumRemarkKinds * bitmapWords(NumRows), KindBitmaps))
+    return Err;
+  if (auto Err = Require(HotnessSection, 4, NumRows, Hotness))
+    return Err;
+
+  // every column id must resolve in its dictionary and every kind byte must
+  // name a remark kind; queries use both as indexes without checking
+  for (unsigned C = 0; C < NumRemarkStringColumns; ++C)
+    for (uint64_t Row = 0; Row < NumRows; ++Row)
+      if (read32le(Columns[C] + Row * 4) >= Dicts[C].Count)
+        return makeStringError("database column " + llvm::Twine(C) +
+                               " is corrupt");
+  for (uint64_t Row = 0; Row < NumRows; ++Row)
+    if (static_cast<uint8_t>(Kinds[Row]) >= NumRemarkKinds)
+      return makeStringError("database remark kinds are corrupt");
+
+  // argument offsets must be monotonic and end at the argument count, and
+  // every string id must resolve in the argument dictionary
+  if (auto Err = BindDictionary(ArgDictDataSection, ArgDictEntriesSection,
+                                ArgDict))
+    return Err;
+  if (auto Err = Require(ArgOffsetsSection, 4, NumRows + 1, ArgOffsets))
+    return Err;
+  ArgFields = Find(ArgFieldsSection, 4 * ArgFieldCount, NumArgs);
+  if (!ArgFields || read32le(ArgOffsets + NumRows * 4) != NumArgs)
+    return makeStringError("database arguments are missing or corrupt");
+  for (uint64_t Row = 0, Prev = 0; Row <= NumRows; ++Row) {
+    uint32_t Off = read32le(ArgOffsets + Row * 4);
+    if (Off < Prev)
+      return makeStringError("database arguments are corrupt");
+    Prev = Off;
+  }
+  for (uint64_t A = 0; A < NumArgs; ++A)
+    for (unsigned F = 0; F < 3; ++F)
+      if (read32le(ArgFields + (A * ArgFieldCount + F) * 4) >= ArgDict.Count)
+        return makeStringError("database arguments are corrupt");
+
+  struct {
+    PostingList *Index;
+    RemarkColumn Column;
+    uint32_t     OffsetsKind;
+    uint32_t     RowsKind;
+  } Indexes[] = {
+      {&PassIndex, RemarkColumn::Pass, PassOffsetsSection, PassRowsSection},
+      {&FileIndex, RemarkColumn::File, FileOffsetsSection, FileRowsSection},
+  };
+  for (auto &I : Indexes) {
+    uint32_t DictSize = Dicts[unsigned(I.Column)].Count;
+    if (auto Err = Require(I.OffsetsKind, 4, uint64_t(DictSize) + 1,
+                           I.Index->Offsets))
+      return Err;
+    if (auto Err = Require(I.RowsKind, 4, NumRows, I.Index->Rows))
+      return Err;
+    uint32_t Prev = 0;
+    for (uint32_t Id = 0; Id <= DictSize; ++Id) {
+      uint32_t Off = read32le(I.Index->Offsets + uint64_t(Id) * 4);
+      if (Off < Prev || Off > NumRows)
+        return makeStringError("database index is corrupt");
+      Prev = Off;
+    }
+  }
+  return llvm::Error::success();
+}
+
+uint32_t RemarkDB::columnId(RemarkColumn C, uint32_t Row) const {
+  return read32le(Columns[unsigned(C)] + uint64_t(Row) * 4);
+}
+
+llvm::StringRef RemarkDB::value(RemarkColumn C, uint32_t Row) const {
+  return Dicts[unsigned(C)].get(columnId(C, Row));
+}
+
+RemarkKind RemarkDB::kind(uint32_t Row) const {
+  return static_cast<RemarkKind>(static_cast<uint8_t>(Kinds[Row]));
+}
+
+SourceLocation RemarkDB::location(uint32_t Row) const {
+  SourceLocation Loc;
+  Loc.File   = value(RemarkColumn::File, Row).str();
+  Loc.Line   = read32le(Lines + uint64_t(Row) * 4);
+  Loc.Column = read32le(Cols + uint64_t(Row) * 4);
+  return Loc;
+}
+
+std::optional<float> RemarkDB::hotness(uint32_t Row) const {
+  uint32_t Bits = read32le(Hotness + uint64_t(Row) * 4);
+  if (Bits == NoHotness)
+    return std::nullopt;
+  return llvm::bit_cast<float>(Bits);
+}
+
+std::vector<RemarkArgument> RemarkDB::args(uint32_t Row) const {
+  uint32_t Begin = read32le(ArgOffsets + uint64_t(Row) * 4);
+  uint32_t End   = read32le(ArgOffsets + uint64_t(Row + 1) * 4);
+  std::vector<RemarkArgument> Args;
+  Args.reserve(End - Begin);
+  for (uint32_t A = Begin; A < End; ++A) {
+    const char *F = ArgFields + uint64_t(A) * ArgFieldCount * 4;
+    RemarkArgument Arg;
+    Arg.Key        = ArgDict.get(read32le(F)).str();
+    Arg.Value      = ArgDict.get(read32le(F + 4)).str();
+    Arg.Loc.File   = ArgDict.get(read32le(F + 8)).str();
+    Arg.Loc.Line   = read32le(F + 12);
+    Arg.Loc.Column = read32le(F + 16);
+    Args.push_back(std::move(Arg));
+  }
+  return Args;
+}
+
+Remark RemarkDB::materialize(uint32_t Row) const {
+  Remark R;
+  R.Kind         = kind(Row);
+  R.PassName     = value(RemarkColumn::Pass, Row).str();
+  R.RemarkName   = value(RemarkColumn::Name, Row).str();
+  R.FunctionName = value(RemarkColumn::Function, Row).str();
+  R.Loc          = location(Row);
+  R.Message      = value(RemarkColumn::Message, Row).str();
+  R.Args         = args(Row);
+  R.Hotness      = hotness(Row);
+  return R;
+}
+
+void RemarkDB::appendPostings(const PostingList &P, uint32_t Id,
+                              std::vector<uint32_t> &Out) const {
+  uint32_t Begin = read32le(P.Offsets + uint64_t(Id) * 4);
+  uint32_t End   = read32le(P.Offsets + uint64_t(Id + 1) * 4);
+  for (uint32_t I = Begin; I < End; ++I) {
+    uint32_t Row = read32le(P.Rows + uint64_t(I) * 4);
+    if (Row < NumRows)
+      Out.push_back(Row);
+  }
+}
+
+// Filters are first resolved against the (small) dictionaries, the most
+// selective of the pass and file indexes then supplies candidate rows, and
+// the remaining predicates are integer and bitmap tests per row.
+llvm::Expected<std::vector<uint32_t>>
+RemarkDB::query(const RemarkQuery &Q) const {
+  auto ExactIds = [&](RemarkColumn C, const std::vector<std::string> &Values) {
+    const DictionaryView &D = Dicts[unsigned(C)];
+    llvm::BitVector Ids(D.Count);
+    for (const std::string &V : Values) {
+      uint32_t Id = D.lowerBound(V);
+      if (Id < D.Count && D.get(Id) == V)
+        Ids.set(Id);
+    }
+    return Ids;
+  };
+
+  std::optional<llvm::BitVector> PassIds, NameIds, FunctionIds;
+  if (!Q.Passes.empty())
+    PassIds = ExactIds(RemarkColumn::Pass, Q.Passes);
+  if (!Q.Names.empty())
+    NameIds = ExactIds(RemarkColumn::Name, Q.Names);
+
+  if (!Q.FunctionRegex.empty()) {
+    llvm::Regex Re(Q.FunctionRegex);
+    std::string Err;
+    if (!Re.isValid(Err))
+      return makeStringError("Invalid function regex '" + Q.FunctionRegex +
+                             "': " + Err);
+    const DictionaryView &D = Dicts[unsigned(RemarkColumn::Function)];
+    FunctionIds.emplace(D.Count);
+    for (uint32_t Id = 0; Id < D.Count; ++Id)
+      if (Re.match(D.get(Id)))
+        FunctionIds->set(Id);
+  }
+
+  // sorted dictionary: every file under the prefix is one contiguous id range
+  const DictionaryView &Files = Dicts[unsigned(RemarkColumn::File)];
+  uint32_t FileLo = 0, FileHi = Files.Count;
+  bool HasFileFilter = !Q.FilePrefix.empty();
+  if (HasFileFilter) {
+    FileLo = Files.lowerBound(Q.FilePrefix);
+    FileHi = FileLo;
+    while (FileHi < Files.Count &&
+           Files.get(FileHi).starts_with(Q.FilePrefix))
+      ++FileHi;
+  }
+
+  auto PostingCount = [](const PostingList &P, uint32_t Id) {
+    return read32le(P.Offsets + uint64_t(Id + 1) * 4) -
+           read32le(P.Offsets + uint64_t(Id) * 4);
+  };
+
+  bool UseIndex = false;
+  std::vector<uint32_t> Candidates;
+  if (PassIds || HasFileFilter) {
+    uint64_t PassRows = UINT64_MAX, FileRows = UINT64_MAX;
+    if (PassIds) {
+      PassRows = 0;
+      for (unsigned Id : PassIds->set_bits())
+        PassRows += PostingCount(PassIndex, Id);
+    }
+    if (HasFileFilter) {
+      FileRows = read32le(FileIndex.Offsets + uint64_t(FileHi) * 4) -
+                 read32le(FileIndex.Offsets + uint64_t(FileLo) * 4);
+    }
+
+    UseIndex = true;
+    if (PassRows <= FileRows) {
+      Candidates.reserve(PassRows);
+      for (unsigned Id : PassIds->set_bits())
+        appendPostings(PassIndex, Id, Candidates);
+    } else {
+      Candidates.reserve(FileRows);
+      for (uint32_t Id = FileLo; Id < FileHi; ++Id)
+        appendPostings(FileIndex, Id, Candidates);
+    }
+    std::sort(Candidates.begin(), Candidates.end());
+  }
+
+  uint64_t Words = bitmapWords(NumRows);
+  auto KindWord = [&](uint64_t W) {
+    uint64_t Bits = 0;
+    for (unsigned K = 0; K < NumRemarkKinds; ++K)
+      if (Q.KindMask & (1u << K))
+        Bits |= read64le(KindBitmaps + (K * Words + W) * 8);
+    return Bits;
+  };
+
+  std::vector<uint32_t> Result;
+  auto Accept = [&](uint32_t Row) {
+    if (PassIds && !PassIds->test(columnId(RemarkColumn::Pass, Row)))
+      return true;
+    if (NameIds && !NameIds->test(columnId(RemarkColumn::Name, Row)))
+      return true;
+    if (FunctionIds && !FunctionIds->test(columnId(RemarkColumn::Function, Row)))
+      return true;
+    if (HasFileFilter) {
+      uint32_t F = columnId(RemarkColumn::File, Row);
+      if (F < FileLo || F >= FileHi)
+        return true;
+    }
+    Result.push_back(Row);
+    return Q.Limit == 0 || Result.size() < Q.Limit;
+  };
+
+  if (UseIndex) {
+    for (uint32_t Row : Candidates) {
+      uint64_t Bit = KindWord(Row / 64) >> (Row % 64);
+      if ((Bit & 1) && !Accept(Row))
+        break;
+    }
+    return Result;
+  }
+
+  // full scan: walk the set bits of the selected kinds' bitmaps
+  for (uint64_t W = 0; W < Words; ++W) {
+    for (uint64_t Bits = KindWord(W); Bits; Bits &= Bits - 1) {
+      uint32_t Row = static_cast<uint32_t>(W * 64 + llvm::countr_zero(Bits));
+      if (!Accept(Row))
+        return Result;
+    }
+  }
+  return Result;
+}
+
+}
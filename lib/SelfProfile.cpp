@@ -0,0 +1,346 @@
+#include "OptDebugger/SelfProfile.h"
+#include "OptDebugger/Support.h"
+
+#include "llvm/ADT/Any.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TimeProfiler.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace optdbg {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// slowest detailed scopes kept per phase
+constexpr size_t SlowestPerPhase = 10;
+
+// memory is sampled at most this often so short phases stay cheap
+constexpr auto MemorySampleInterval = std::chrono::milliseconds(1);
+
+struct PhaseStats {
+  uint64_t Count   = 0;
+  uint64_t TotalNs = 0;
+  uint64_t MaxNs   = 0;
+};
+
+struct DetailCost {
+  std::string Detail;
+  uint64_t    Ns = 0;
+};
+
+struct MemorySample {
+  uint64_t TimeUs;
+  uint64_t RSSKB;
+  uint64_t PeakKB;
+};
+
+struct ProfileState {
+  std::mutex                                Lock;
+  llvm::StringMap<PhaseStats>               Phases;
+  // min-heaps on Ns, so the cheapest of the kept scopes is at the front
+  llvm::StringMap<std::vector<DetailCost>>  Slowest;
+  std::vector<MemorySample>                 Memory;
+  Clock::time_point                         Start;
+  Clock::time_point                         LastSample;
+  uint64_t                                  WallNs = 0;
+  unsigned                                  Granularity = 0;
+  std::string                               ProcName;
+};
+
+std::atomic<bool> ProfilerActive{false};
+
+ProfileState &state() {
+  static ProfileState S;
+  return S;
+}
+
+bool costlier(const DetailCost &A, const DetailCost &B) { return A.Ns > B.Ns; }
+
+// caller holds the lock
+void sampleMemoryLocked(ProfileState &S, Clock::time_point Now, bool Force) {
+  if (!Force && Now - S.LastSample < MemorySampleInterval)
+    return;
+  S.LastSample = Now;
+  auto Us = std::chrono::duration_cast<std::chrono::microseconds>(Now - S.Start);
+  S.Memory.push_back({static_cast<uint64_t>(Us.count()), currentRSSKB(),
+                      peakRSSKB()});
+}
+
+void record(llvm::StringRef Phase, const std::string *Detail, uint64_t Ns) {
+  ProfileState &S = state();
+  Clock::time_point Now = Clock::now();
+  std::lock_guard<std::mutex> Lock(S.Lock);
+
+  PhaseStats &P = S.Phases[Phase];
+  ++P.Count;
+  P.TotalNs += Ns;
+  P.MaxNs = std::max(P.MaxNs, Ns);
+
+  if (!Detail) {
+    sampleMemoryLocked(S, Now, /*Force=*/false);
+    return;
+  }
+  std::vector<DetailCost> &Heap = S.Slowest[Phase];
+  if (Heap.size() < SlowestPerPhase) {
+    Heap.push_back({*Detail, Ns});
+    std::push_heap(Heap.begin(), Heap.end(), costlier);
+  } else if (Ns > Heap.front().Ns) {
+    std::pop_heap(Heap.begin(), Heap.end(), costlier);
+    Heap.back() = {*Detail, Ns};
+    std::push_heap(Heap.begin(), Heap.end(), costlier);
+  }
+}
+
+// appends the memory samples as a counter track and the peak as trace
+// metadata; a trace that does not parse is written unchanged
+std::string decorateTrace(llvm::StringRef Trace, const ProfileState &S) {
+  llvm::Expected<llvm::json::Value> Parsed = llvm::json::parse(Trace);
+  if (!Parsed) {
+    llvm::consumeError(Parsed.takeError());
+    return Trace.str();
+  }
+  llvm::json::Object *Root = Parsed->getAsObject();
+  llvm::json::Array *Events = Root ? Root->getArray("traceEvents") : nullptr;
+  if (!Events)
+    return Trace.str();
+
+  int64_t Pid = 0;
+  if (!Events->empty())
+    if (const llvm::json::Object *First = Events->front().getAsObject())
+      if (auto FirstPid = First->getInteger("pid"))
+        Pid = *FirstPid;
+
+  uint64_t Peak = 0;
+  for (const MemorySample &M : S.Memory) {
+    Events->push_back(llvm::json::Object{
+        {"ph", "C"},
+        {"name", "Memory"},
+        {"pid", Pid},
+        {"tid", 0},
+        {"ts", static_cast<int64_t>(M.TimeUs)},
+        {"args", llvm::json::Object{{"rss_kb", static_cast<int64_t>(M.RSSKB)},
+                                    {"peak_rss_kb",
+                                     static_cast<int64_t>(M.PeakKB)}}}});
+    Peak = std::max(Peak, M.PeakKB);
+  }
+  (*Root)["otherData"] = llvm::json::Object{
+      {"tool", std::string("Aion ") + AionVersion},
+      {"wall_ms", static_cast<double>(S.WallNs) / 1e6},
+      {"peak_rss_kb", static_cast<int64_t>(Peak)}};
+
+  std::string Out;
+  llvm::raw_string_ostream OS(Out);
+  OS << llvm::json::Value(std::move(*Parsed));
+  OS.flush();
+  return Out;
+}
+
+std::string formatMs(uint64_t Ns) {
+  return llvm::formatv("{0:F2}", static_cast<double>(Ns) / 1e6).str();
+}
+
+}
+
+uint64_t currentRSSKB() {
+  // statm reports pages: total program size, then resident
+  std::ifstream Statm("/proc/self/statm");
+  uint64_t Size = 0, Resident = 0;
+  if (Statm >> Size >> Resident)
+    return Resident * llvm::sys::Process::getPageSizeEstimate() / 1024;
+  return 0;
+}
+
+uint64_t peakRSSKB() {
+  std::ifstream Status("/proc/self/status");
+  std::string Line;
+  while (std::getline(Status, Line)) {
+    llvm::StringRef L(Line);
+    if (!L.consume_front("VmHWM:"))
+      continue;
+    uint64_t KB = 0;
+    if (!L.trim().split(' ').first.getAsInteger(10, KB))
+      return KB;
+  }
+  // ru_maxrss is in KB on Linux and the BSDs
+  struct rusage RU;
+  if (::getrusage(RUSAGE_SELF, &RU) == 0)
+    return static_cast<uint64_t>(RU.ru_maxrss);
+  return 0;
+}
+
+void SelfProfiler::start(llvm::StringRef ProcName, unsigned GranularityUs) {
+  if (ProfilerActive.load())
+    return;
+  ProfileState &S = state();
+  {
+    std::lock_guard<std::mutex> Lock(S.Lock);
+    S.Granularity = GranularityUs;
+    S.ProcName    = ProcName.str();
+    S.Start = S.LastSample = Clock::now();
+  }
+  llvm::timeTraceProfilerInitialize(GranularityUs, ProcName);
+  ProfilerActive.store(true);
+}
+
+bool SelfProfiler::isActive() {
+  return ProfilerActive.load(std::memory_order_relaxed);
+}
+
+llvm::Error SelfProfiler::finish(llvm::StringRef TracePath) {
+  if (!ProfilerActive.exchange(false))
+    return makeStringError("The self profiler was not started");
+
+  ProfileState &S = state();
+  llvm::SmallString<0> Trace;
+  {
+    std::lock_guard<std::mutex> Lock(S.Lock);
+    Clock::time_point Now = Clock::now();
+    S.WallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   Now - S.Start).count();
+    sampleMemoryLocked(S, Now, /*Force=*/true);
+  }
+
+  llvm::raw_svector_ostream TraceOS(Trace);
+  llvm::timeTraceProfilerWrite(TraceOS);
+  llvm::timeTraceProfilerCleanup();
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(TracePath, EC, llvm::sys::fs::OF_Text);
+  if (EC)
+    return makeStringError("Cannot write profile '" + TracePath +
+                           "': " + EC.message());
+  std::lock_guard<std::mutex> Lock(S.Lock);
+  OS << decorateTrace(Trace, S);
+  return llvm::Error::success();
+}
+
+void SelfProfiler::printSummary(llvm::raw_ostream &OS) {
+  ProfileState &S = state();
+  std::lock_guard<std::mutex> Lock(S.Lock);
+
+  std::vector<std::pair<llvm::StringRef, const PhaseStats *>> Phases;
+  for (const auto &P : S.Phases)
+    Phases.emplace_back(P.getKey(), &P.getValue());
+  llvm::sort(Phases, [](const auto &A, const auto &B) {
+    if (A.second->TotalNs != B.second->TotalNs)
+      return A.second->TotalNs > B.second->TotalNs;
+    return A.first < B.first;
+  });
+
+  OS << "\n=== Self Profile ===\n";
+  OS << llvm::left_justify("Phase", 24) << llvm::right_justify("Calls", 9)
+     << llvm::right_justify("Total ms", 12) << llvm::right_justify("Max ms", 12)
+     << llvm::right_justify("Wall %", 9) << "\n";
+  for (const auto &[Name, P] : Phases) {
+    double Share = S.WallNs ? 100.0 * P->TotalNs / S.WallNs : 0;
+    OS << llvm::left_justify(Name, 24)
+       << llvm::right_justify(std::to_string(P->Count), 9)
+       << llvm::right_justify(formatMs(P->TotalNs), 12)
+       << llvm::right_justify(formatMs(P->MaxNs), 12)
+       << llvm::right_justify(llvm::formatv("{0:F1}", Share).str(), 9) << "\n";
+  }
+  OS << llvm::left_justify("(wall)", 24) << llvm::right_justify("", 9)
+     << llvm::right_justify(formatMs(S.WallNs), 12) << "\n";
+
+  for (const auto &[Name, P] : Phases) {
+    auto It = S.Slowest.find(Name);
+    if (It == S.Slowest.end())
+      continue;
+    std::vector<DetailCost> Costs = It->getValue();
+    llvm::sort(Costs, costlier);
+    OS << "\nSlowest " << Name << ":\n";
+    for (const DetailCost &C : Costs)
+      OS << llvm::right_justify(formatMs(C.Ns), 12) << " ms  " << C.Detail
+         << "\n";
+  }
+
+  uint64_t Peak = 0;
+  for (const MemorySample &M : S.Memory)
+    Peak = std::max(Peak, M.PeakKB);
+  OS << "\nPeak RSS: " << Peak << " KB\n";
+}
+
+SelfProfiler::ThreadScope::ThreadScope() {
+  if (!SelfProfiler::isActive() || llvm::timeTraceProfilerEnabled())
+    return;
+  ProfileState &S = state();
+  unsigned Granularity;
+  std::string ProcName;
+  {
+    std::lock_guard<std::mutex> Lock(S.Lock);
+    Granularity = S.Granularity;
+    ProcName    = S.ProcName;
+  }
+  llvm::timeTraceProfilerInitialize(Granularity, ProcName);
+  Owned = true;
+}
+
+SelfProfiler::ThreadScope::~ThreadScope() {
+  if (Owned)
+    llvm::timeTraceProfilerFinishThread();
+}
+
+ProfileScope::ProfileScope(llvm::StringRef Phase, llvm::StringRef Detail,
+                           bool HasDetail) {
+  if (!SelfProfiler::isActive())
+    return;
+  Active          = true;
+  this->HasDetail = HasDetail;
+  this->Phase     = Phase;
+  this->Detail    = Detail.str();
+  if (llvm::timeTraceProfilerEnabled()) {
+    llvm::timeTraceProfilerBegin(Phase, Detail);
+    Traced = true;
+  }
+  Start = Clock::now();
+}
+
+ProfileScope::~ProfileScope() {
+  if (!Active)
+    return;
+  uint64_t Ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - Start).count();
+  if (Traced)
+    llvm::timeTraceProfilerEnd();
+  record(Phase, HasDetail ? &Detail : nullptr, Ns);
+}
+
+void registerPassProfiling(llvm::PassInstrumentationCallbacks &PIC) {
+  if (!llvm::timeTraceProfilerEnabled())
+    return;
+  PIC.registerBeforeNonSkippedPassCallback(
+      [](llvm::StringRef PassID, llvm::Any IR) {
+        llvm::StringRef Unit;
+        if (const auto *F = llvm::any_cast<const llvm::Function *>(&IR))
+          Unit = (*F)->getName();
+        else if (const auto *M = llvm::any_cast<const llvm::Module *>(&IR))
+          Unit = (*M)->getName();
+        llvm::timeTraceProfilerBegin(PassID, Unit);
+      });
+  PIC.registerAfterPassCallback(
+      [](llvm::StringRef, llvm::Any, const llvm::PreservedAnalyses &) {
+        llvm::timeTraceProfilerEnd();
+      });
+  PIC.registerAfterPassInvalidatedCallback(
+      [](llvm::StringRef, const llvm::PreservedAnalyses &) {
+        llvm::timeTraceProfilerEnd();
+      });
+}
+
+}
@@ -0,0 +1,742 @@
+#include "OptDebugger/SessionIO.h"
+#include "OptDebugger/SelfProfile.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/bit.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <cassert>
+#include <cstring>
+#include <iterator>
+
+namespace optdbg {
+
+namespace {
+
+constexpr size_t HeaderSize       = 32;
+constexpr size_t SectionEntrySize = 24;
+
+// record sizes of format version 1; readers accept larger records so that
+// fields can be appended without breaking older snapshots
+constexpr uint32_t MetaRecordSize        = 64;
+constexpr uint32_t RemarkRecordSize      = 64;
+constexpr uint32_t ArgRecordSize         = 32;
+constexpr uint32_t FunctionRecordSize    = 72;
+constexpr uint32_t BlockRecordSize       = 40;
+constexpr uint32_t InstructionRecordSize = 64;
+constexpr uint32_t DiagnosticRecordSize  = 96;
+// diagnostics written since the cost model carry its saving at the end;
+// shorter records read as unmodeled. Hotness follows it.
+constexpr uint32_t ModeledDiagnosticRecordSize = 104;
+constexpr uint32_t HotDiagnosticRecordSize     = 112;
+constexpr uint32_t FixRecordSize         = 24;
+constexpr uint32_t MetadataRecordSize    = 16;
+constexpr uint32_t MachineRecordSize     = 48;
+
+constexpr uint32_t NoDiffIndex = UINT32_MAX;
+
+// interns every string written by the session so repeated pass names,
+// explanations and instruction texts are stored once
+class StringPool {
+public:
+  std::pair<uint32_t, uint32_t> add(llvm::StringRef S) {
+    auto Inserted = Offsets.try_emplace(S, static_cast<uint32_t>(Data.size()));
+    if (Inserted.second)
+      Data.append(S.begin(), S.end());
+    return {Inserted.first->second, static_cast<uint32_t>(S.size())};
+  }
+
+  const std::string &data() const { return Data; }
+
+private:
+  llvm::StringMap<uint32_t> Offsets;
+  std::string               Data;
+};
+
+// accumulates the fixed-size records of one section
+class RecordBuffer {
+public:
+  RecordBuffer(StringPool &Strings, uint32_t RecordSize)
+      : Strings(Strings), RecordSize(RecordSize) {}
+
+  void u8(uint8_t V) { Data.push_back(static_cast<char>(V)); }
+  void u32(uint32_t V) {
+    char B[4];
+    llvm::support::endian::write32le(B, V);
+    Data.append(B, 4);
+  }
+  void u64(uint64_t V) {
+    char B[8];
+    llvm::support::endian::write64le(B, V);
+    Data.append(B, 8);
+  }
+  void pad(size_t N) { Data.append(N, '\0'); }
+  void str(llvm::StringRef S) {
+    auto Ref = Strings.add(S);
+    u32(Ref.first);
+    u32(Ref.second);
+  }
+
+  void endRecord() {
+    ++Count;
+    assert(Data.size() == Count * RecordSize && "record layout mismatch");
+  }
+
+  StringPool  &Strings;
+  uint32_t     RecordSize;
+  uint32_t     Count = 0;
+  std::string  Data;
+};
+
+class RecordReader {
+public:
+  explicit RecordReader(const char *P) : P(P) {}
+
+  uint8_t u8() { return static_cast<uint8_t>(*P++); }
+  uint32_t u32() {
+    uint32_t V = llvm::support::endian::read32le(P);
+    P += 4;
+    return V;
+  }
+  uint64_t u64() {
+    uint64_t V = llvm::support::endian::read64le(P);
+    P += 8;
+    return V;
+  }
+  void skip(size_t N) { P += N; }
+
+private:
+  const char *P;
+};
+
+struct SectionView {
+  const char *Data       = nullptr;
+  uint64_t    Count      = 0;
+  uint32_t    RecordSize = 0;
+
+  RecordReader record(uint64_t I) const {
+    return RecordReader(Data + I * RecordSize);
+  }
+};
+
+// validates the section table and rebuilds session structures from it
+class SessionDecoder {
+public:
+  llvm::Error parse(llvm::StringRef Buffer);
+  llvm::Expected<AnalysisSession> decode();
+
+private:
+  llvm::Error bindSection(SessionSection Kind, uint32_t MinRecordSize,
+                          SectionView &View, bool Required);
+
+  std::string str(RecordReader &R) {
+    uint32_t Off  = R.u32();
+    uint32_t Size = R.u32();
+    if (static_cast<uint64_t>(Off) + Size > Strings.size()) {
+      Corrupt = true;
+      return {};
+    }
+    return Strings.substr(Off, Size).str();
+  }
+
+  bool inRange(uint32_t Begin, uint32_t Count, const SectionView &V) {
+    if (static_cast<uint64_t>(Begin) + Count > V.Count) {
+      Corrupt = true;
+      return false;
+    }
+    return true;
+  }
+
+  // an enum byte past the enum's last value marks the file corrupt
+  template <typename EnumT> EnumT enumValue(uint8_t V, EnumT Last) {
+    if (V > static_cast<uint8_t>(Last)) {
+      Corrupt = true;
+      return EnumT{};
+    }
+    return static_cast<EnumT>(V);
+  }
+
+  void decodeRemarks(AnalysisSession &S);
+  FunctionDiff decodeFunction(uint64_t Index);
+  void decodeDiff(AnalysisSession &S);
+  void decodeDiagnostics(AnalysisSession &S);
+  void decodeMetadata(AnalysisSession &S);
+  void decodeMachine(AnalysisSession &S);
+
+  struct SectionEntry {
+    uint32_t Kind;
+    uint32_t RecordSize;
+    uint64_t Offset;
+    uint64_t Count;
+  };
+
+  llvm::StringRef           Buffer;
+  llvm::StringRef           Strings;
+  std::vector<SectionEntry> Entries;
+  SectionView Meta, Remarks, Args, Functions, Blocks, Instructions,
+      Diagnostics, Fixes, Metadata, Machine;
+  bool Corrupt = false;
+};
+
+llvm::Error SessionDecoder::parse(llvm::StringRef Buf) {
+  Buffer = Buf;
+  if (Buffer.size() < HeaderSize ||
+      std::memcmp(Buffer.data(), SessionMagic, sizeof(SessionMagic)) != 0)
+    return makeStringError("not an Aion session file");
+
+  RecordReader H(Buffer.data() + sizeof(SessionMagic));
+  uint32_t Version     = H.u32();
+  uint32_t NumSections = H.u32();
+  uint64_t TotalSize   = H.u64();
+
+  if (Version != SessionFormatVersion)
+    return makeStringError("unsupported session format version " +
+                           llvm::Twine(Version) + " (expected " +
+                           llvm::Twine(SessionFormatVersion) + ")");
+  if (TotalSize != Buffer.size())
+    return makeStringError("session file is truncated");
+  if (NumSections > (Buffer.size() - HeaderSize) / SectionEntrySize)
+    return makeStringError("session section table is corrupt");
+
+  RecordReader T(Buffer.data() + HeaderSize);
+  for (uint32_t I = 0; I < NumSections; ++I) {
+    SectionEntry E;
+    E.Kind       = T.u32();
+    E.RecordSize = T.u32();
+    E.Offset     = T.u64();
+    E.Count      = T.u64();
+    if (E.RecordSize == 0 || E.Offset > Buffer.size() ||
+        E.Count > (Buffer.size() - E.Offset) / E.RecordSize)
+      return makeStringError("session section " + llvm::Twine(E.Kind) +
+                             " lies outside the file");
+    Entries.push_back(E);
+  }
+
+  SectionView StringView;
+  if (auto Err = bindSection(SessionSection::Strings, 1, StringView, true))
+    return Err;
+  Strings = llvm::StringRef(StringView.Data, StringView.Count);
+
+  if (auto Err = bindSection(SessionSection::Meta, MetaRecordSize, Meta, true))
+    return Err;
+  if (Meta.Count != 1)
+    return makeStringError("session metadata record is missing");
+
+  struct {
+    SessionSection Kind;
+    uint32_t       Size;
+    SectionView   *View;
+  } Optional[] = {
+      {SessionSection::Remarks, RemarkRecordSize, &Remarks},
+      {SessionSection::RemarkArgs, ArgRecordSize, &Args},
+      {SessionSection::Functions, FunctionRecordSize, &Functions},
+      {SessionSection::Blocks, BlockRecordSize, &Blocks},
+      {SessionSection::Instructions, InstructionRecordSize, &Instructions},
+      {SessionSection::Diagnostics, DiagnosticRecordSize, &Diagnostics},
+      {SessionSection::Fixes, FixRecordSize, &Fixes},
+      {SessionSection::Metadata, MetadataRecordSize, &Metadata},
+      {SessionSection::MachineFunctions, MachineRecordSize, &Machine},
+  };
+  for (auto &O : Optional)
+    if (auto Err = bindSection(O.Kind, O.Size, *O.View, false))
+      return Err;
+
+  return llvm::Error::success();
+}
+
+llvm::Error SessionDecoder::bindSection(SessionSection Kind,
+                                        uint32_t MinRecordSize,
+                                        SectionView &View, bool Required) {
+  for (const SectionEntry &E : Entries) {
+    if (E.Kind != static_cast<uint32_t>(Kind))
+      continue;
+    if (E.RecordSize < MinRecordSize)
+      return makeStringError("session section " + llvm::Twine(E.Kind) +
+                             " has undersized records");
+    View.Data       = Buffer.data() + E.Offset;
+    View.Count      = E.Count;
+    View.RecordSize = E.RecordSize;
+    return llvm::Error::success();
+  }
+  if (Required)
+    return makeStringError("session section " +
+                           llvm::Twine(static_cast<uint32_t>(Kind)) +
+                           " is missing");
+  return llvm::Error::success();
+}
+
+void SessionDecoder::decodeRemarks(AnalysisSession &S) {
+  S.Remarks.reserve(Remarks.Count);
+  for (uint64_t I = 0; I < Remarks.Count; ++I) {
+    RecordReader R = Remarks.record(I);
+    Remark Rem;
+    Rem.Kind           = enumValue(R.u8(), RemarkKind::AnalysisFPCommute);
+    Rem.IsMachine      = R.u8() != 0;
+    bool HasHotness    = R.u8() != 0;
+    R.skip(1);
+    uint32_t HotBits   = R.u32();
+    if (HasHotness)
+      Rem.Hotness = llvm::bit_cast<float>(HotBits);
+    Rem.PassName       = str(R);
+    Rem.RemarkName     = str(R);
+    Rem.FunctionName   = str(R);
+    Rem.Loc.File       = str(R);
+    Rem.Loc.Line       = R.u32();
+    Rem.Loc.Column     = R.u32();
+    Rem.Message        = str(R);
+    uint32_t ArgBegin  = R.u32();
+    uint32_t ArgCount  = R.u32();
+
+    if (inRange(ArgBegin, ArgCount, Args)) {
+      Rem.Args.reserve(ArgCount);
+      for (uint32_t A = ArgBegin; A < ArgBegin + ArgCount; ++A) {
+        RecordReader AR = Args.record(A);
+        RemarkArgument Arg;
+        Arg.Key        = str(AR);
+        Arg.Value      = str(AR);
+        Arg.Loc.File   = str(AR);
+        Arg.Loc.Line   = AR.u32();
+        Arg.Loc.Column = AR.u32();
+        Rem.Args.push_back(std::move(Arg));
+      }
+    }
+    S.Remarks.push_back(std::move(Rem));
+  }
+}
+
+FunctionDiff SessionDecoder::decodeFunction(uint64_t Index) {
+  RecordReader R = Functions.record(Index);
+  FunctionDiff F;
+  F.Kind              = enumValue(R.u8(), DiffKind::Modified);
+  F.AttributesChanged = R.u8() != 0;
+  F.SignatureChanged  = R.u8() != 0;
+  R.skip(1);
+  uint32_t BlockBegin = R.u32();
+  uint32_t BlockCount = R.u32();
+  R.skip(4);
+  F.FunctionName      = str(R);
+  F.BeforeSignature   = str(R);
+  F.AfterSignature    = str(R);
+  F.BeforeBlockCount  = R.u64();
+  F.AfterBlockCount   = R.u64();
+  F.BeforeInstrCount  = R.u64();
+  F.AfterInstrCount   = R.u64();
+
+  if (inRange(BlockBegin, BlockCount, Blocks)) {
+    F.Blocks.reserve(BlockCount);
+    for (uint32_t B = BlockBegin; B < BlockBegin + BlockCount; ++B) {
+      RecordReader BR = Blocks.record(B);
+      BlockDiff BD;
+      BD.Kind               = enumValue(BR.u8(), DiffKind::Modified);
+      BR.skip(3);
+      uint32_t InstrBegin   = BR.u32();
+      uint32_t InstrCount   = BR.u32();
+      BR.skip(4);
+      BD.BlockName          = str(BR);
+      BD.BeforeInstrCount   = BR.u64();
+      BD.AfterInstrCount    = BR.u64();
+
+      if (inRange(InstrBegin, InstrCount, Instructions)) {
+        BD.Instructions.reserve(InstrCount);
+        for (uint32_t N = InstrBegin; N < InstrBegin + InstrCount; ++N) {
+          RecordReader IR = Instructions.record(N);
+          InstructionDiff ID;
+          ID.Kind              = enumValue(IR.u8(), DiffKind::Modified);
+          IR.skip(3);
+          ID.Before.Line       = IR.u32();
+          ID.After.Line        = IR.u32();
+          IR.skip(4);
+          ID.Before.Text       = str(IR);
+          ID.Before.OpcodeName = str(IR);
+          ID.Before.DebugLocStr = str(IR);
+          ID.After.Text        = str(IR);
+          ID.After.OpcodeName  = str(IR);
+          ID.After.DebugLocStr = str(IR);
+          BD.Instructions.push_back(std::move(ID));
+        }
+      }
+      F.Blocks.push_back(std::move(BD));
+    }
+  }
+  return F;
+}
+
+void SessionDecoder::decodeDiff(AnalysisSession &S) {
+  RecordReader M = Meta.record(0);
+  S.PassPipelineUsed   = str(M);
+  S.VerificationFailed = (M.u32() & 1) != 0;
+  S.BaselineSuppressed = M.u32();
+  S.Diff.AddedFunctions          = M.u64();
+  S.Diff.RemovedFunctions        = M.u64();
+  S.Diff.ModifiedFunctions       = M.u64();
+  S.Diff.UnchangedFunctions      = M.u64();
+  S.Diff.TotalBeforeInstructions = M.u64();
+  S.Diff.TotalAfterInstructions  = M.u64();
+
+  S.Diff.Functions.reserve(Functions.Count);
+  for (uint64_t I = 0; I < Functions.Count; ++I)
+    S.Diff.Functions.push_back(
+        std::make_shared<FunctionDiff>(decodeFunction(I)));
+}
+
+void SessionDecoder::decodeDiagnostics(AnalysisSession &S) {
+  // diagnostics of one function share the module diff's entry for it
+  const auto &Linked = S.Diff.Functions;
+  S.Diagnostics.reserve(Diagnostics.Count);
+  for (uint64_t I = 0; I < Diagnostics.Count; ++I) {
+    RecordReader R = Diagnostics.record(I);
+    DiagnosticResult D;
+    D.Severity             = enumValue(R.u8(), SeverityLevel::Info);
+    D.IsMachine            = R.u8() != 0;
+    D.SpeedupModeled       = R.u8() != 0;
+    bool HasHotness        = R.u8() != 0;
+    uint32_t DiffIndex     = R.u32();
+    uint32_t FixBegin      = R.u32();
+    uint32_t FixCount      = R.u32();
+    D.EstimatedSpeedup     = llvm::bit_cast<double>(R.u64());
+    D.RuleID               = str(R);
+    D.PassName             = str(R);
+    D.FunctionName         = str(R);
+    D.Location.File        = str(R);
+    D.Location.Line        = R.u32();
+    D.Location.Column      = R.u32();
+    D.ShortReason          = str(R);
+    D.DetailedExplanation  = str(R);
+    D.RootCause            = str(R);
+    D.WhatOptimizerWanted  = str(R);
+    if (Diagnostics.RecordSize >= ModeledDiagnosticRecordSize)
+      D.ModeledCyclesSaved = llvm::bit_cast<double>(R.u64());
+    if (Diagnostics.RecordSize >= HotDiagnosticRecordSize && HasHotness)
+      D.Hotness = llvm::bit_cast<float>(R.u32());
+
+    if (DiffIndex != NoDiffIndex) {
+      if (DiffIndex < Linked.size())
+        D.IRDiff = Linked[DiffIndex];
+      else
+        Corrupt = true;
+    }
+
+    if (inRange(FixBegin, FixCount, Fixes)) {
+      D.Suggestions.reserve(FixCount);
+      for (uint32_t F = FixBegin; F < FixBegin + FixCount; ++F) {
+        RecordReader FR = Fixes.record(F);
+        FixSuggestion Fix;
+        Fix.Description   = str(FR);
+        Fix.CodeExample   = str(FR);
+        Fix.IsSourceLevel = FR.u8() != 0;
+        Fix.IsIRLevel     = FR.u8() != 0;
+        Fix.Edit          = enumValue(FR.u8(), FixEdit::ReadNoneCallees);
+        D.Suggestions.push_back(std::move(Fix));
+      }
+    }
+    S.Diagnostics.push_back(std::move(D));
+  }
+}
+
+void SessionDecoder::decodeMetadata(AnalysisSession &S) {
+  S.Metadata.reserve(Metadata.Count);
+  for (uint64_t I = 0; I < Metadata.Count; ++I) {
+    RecordReader R = Metadata.record(I);
+    std::string Key = str(R);
+    S.Metadata.emplace_back(std::move(Key), str(R));
+  }
+}
+
+void SessionDecoder::decodeMachine(AnalysisSession &S) {
+  S.MachineFunctions.reserve(Machine.Count);
+  for (uint64_t I = 0; I < Machine.Count; ++I) {
+    RecordReader R = Machine.record(I);
+    MachineFunctionStats M;
+    M.Function      = str(R);
+    M.Spills        = R.u32();
+    M.Reloads       = R.u32();
+    M.FoldedSpills  = R.u32();
+    M.FoldedReloads = R.u32();
+    M.Instructions  = R.u32();
+    R.skip(4);
+    M.StackBytes    = R.u64();
+    M.CodeBytes     = R.u64();
+    S.MachineFunctions.push_back(std::move(M));
+  }
+}
+
+llvm::Expected<AnalysisSession> SessionDecoder::decode() {
+  AnalysisSession S;
+  decodeRemarks(S);
+  decodeDiff(S);
+  decodeDiagnostics(S);
+  decodeMetadata(S);
+  decodeMachine(S);
+  if (Corrupt)
+    return makeStringError("session file contains out-of-range references");
+  return S;
+}
+
+}
+
+// lays out every section into record buffers, then writes header, section
+// table and 8-byte aligned section payloads in one pass
+void writeSessionBinary(const AnalysisSession &Session, llvm::raw_ostream &OS) {
+  StringPool Strings;
+  RecordBuffer Meta(Strings, MetaRecordSize);
+  RecordBuffer Remarks(Strings, RemarkRecordSize);
+  RecordBuffer Args(Strings, ArgRecordSize);
+  RecordBuffer Functions(Strings, FunctionRecordSize);
+  RecordBuffer Blocks(Strings, BlockRecordSize);
+  RecordBuffer Instructions(Strings, InstructionRecordSize);
+  RecordBuffer Diagnostics(Strings, HotDiagnosticRecordSize);
+  RecordBuffer Fixes(Strings, FixRecordSize);
+  RecordBuffer Metadata(Strings, MetadataRecordSize);
+  RecordBuffer Machine(Strings, MachineRecordSize);
+
+  const ModuleDiff &Diff = Session.Diff;
+  Meta.str(Session.PassPipelineUsed);
+  Meta.u32(Session.VerificationFailed ? 1 : 0);
+  Meta.u32(Session.BaselineSuppressed);
+  Meta.u64(Diff.AddedFunctions);
+  Meta.u64(Diff.RemovedFunctions);
+  Meta.u64(Diff.ModifiedFunctions);
+  Meta.u64(Diff.UnchangedFunctions);
+  Meta.u64(Diff.TotalBeforeInstructions);
+  Meta.u64(Diff.TotalAfterInstructions);
+  Meta.endRecord();
+
+  for (const Remark &R : Session.Remarks) {
+    Remarks.u8(static_cast<uint8_t>(R.Kind));
+    Remarks.u8(R.IsMachine);
+    Remarks.u8(R.Hotness.has_value());
+    Remarks.pad(1);
+    Remarks.u32(llvm::bit_cast<uint32_t>(R.Hotness.value_or(0.0f)));
+    Remarks.str(R.PassName);
+    Remarks.str(R.RemarkName);
+    Remarks.str(R.FunctionName);
+    Remarks.str(R.Loc.File);
+    Remarks.u32(R.Loc.Line);
+    Remarks.u32(R.Loc.Column);
+    Remarks.str(R.Message);
+    Remarks.u32(Args.Count);
+    Remarks.u32(R.Args.size());
+    Remarks.endRecord();
+
+    for (const RemarkArgument &A : R.Args) {
+      Args.str(A.Key);
+      Args.str(A.Value);
+      Args.str(A.Loc.File);
+      Args.u32(A.Loc.Line);
+      Args.u32(A.Loc.Column);
+      Args.endRecord();
+    }
+  }
+
+  llvm::StringMap<uint32_t> FunctionIndex;
+  for (const auto &FD : Diff.Functions) {
+    const FunctionDiff &F = *FD;
+    FunctionIndex.try_emplace(F.FunctionName, Functions.Count);
+    Functions.u8(static_cast<uint8_t>(F.Kind));
+    Functions.u8(F.AttributesChanged);
+    Functions.u8(F.SignatureChanged);
+    Functions.pad(1);
+    Functions.u32(Blocks.Count);
+    Functions.u32(F.Blocks.size());
+    Functions.pad(4);
+    Functions.str(F.FunctionName);
+    Functions.str(F.BeforeSignature);
+    Functions.str(F.AfterSignature);
+    Functions.u64(F.BeforeBlockCount);
+    Functions.u64(F.AfterBlockCount);
+    Functions.u64(F.BeforeInstrCount);
+    Functions.u64(F.AfterInstrCount);
+    Functions.endRecord();
+
+    for (const BlockDiff &B : F.Blocks) {
+      Blocks.u8(static_cast<uint8_t>(B.Kind));
+      Blocks.pad(3);
+      Blocks.u32(Instructions.Count);
+      Blocks.u32(B.Instructions.size());
+      Blocks.pad(4);
+      Blocks.str(B.BlockName);
+      Blocks.u64(B.BeforeInstrCount);
+      Blocks.u64(B.AfterInstrCount);
+      Blocks.endRecord();
+
+      for (const InstructionDiff &I : B.Instructions) {
+        Instructions.u8(static_cast<uint8_t>(I.Kind));
+        Instructions.pad(3);
+        Instructions.u32(I.Before.Line);
+        Instructions.u32(I.After.Line);
+        Instructions.pad(4);
+        Instructions.str(I.Before.Text);
+        Instructions.str(I.Before.OpcodeName);
+        Instructions.str(I.Before.DebugLocStr);
+        Instructions.str(I.After.Text);
+        Instructions.str(I.After.OpcodeName);
+        Instructions.str(I.After.DebugLocStr);
+        Instructions.endRecord();
+      }
+    }
+  }
+
+  for (const DiagnosticResult &D : Session.Diagnostics) {
+    // a diagnostic's diff is one entry of the module diff, so it is stored
+    // as an index and re-linked on load
+    uint32_t DiffIndex = NoDiffIndex;
+    if (D.IRDiff) {
+      auto It = FunctionIndex.find(D.IRDiff->FunctionName);
+      if (It != FunctionIndex.end())
+        DiffIndex = It->second;
+    }
+
+    Diagnostics.u8(static_cast<uint8_t>(D.Severity));
+    Diagnostics.u8(D.IsMachine);
+    Diagnostics.u8(D.SpeedupModeled);
+    Diagnostics.u8(D.Hotness.has_value());
+    Diagnostics.u32(DiffIndex);
+    Diagnostics.u32(Fixes.Count);
+    Diagnostics.u32(D.Suggestions.size());
+    Diagnostics.u64(llvm::bit_cast<uint64_t>(D.EstimatedSpeedup));
+    Diagnostics.str(D.RuleID);
+    Diagnostics.str(D.PassName);
+    Diagnostics.str(D.FunctionName);
+    Diagnostics.str(D.Location.File);
+    Diagnostics.u32(D.Location.Line);
+    Diagnostics.u32(D.Location.Column);
+    Diagnostics.str(D.ShortReason);
+    Diagnostics.str(D.DetailedExplanation);
+    Diagnostics.str(D.RootCause);
+    Diagnostics.str(D.WhatOptimizerWanted);
+    Diagnostics.u64(llvm::bit_cast<uint64_t>(D.ModeledCyclesSaved));
+    Diagnostics.u32(llvm::bit_cast<uint32_t>(D.Hotness.value_or(0.0f)));
+    Diagnostics.pad(4);
+    Diagnostics.endRecord();
+
+    for (const FixSuggestion &Fix : D.Suggestions) {
+      Fixes.str(Fix.Description);
+      Fixes.str(Fix.CodeExample);
+      Fixes.u8(Fix.IsSourceLevel);
+      Fixes.u8(Fix.IsIRLevel);
+      Fixes.u8(static_cast<uint8_t>(Fix.Edit));
+      Fixes.pad(5);
+      Fixes.endRecord();
+    }
+  }
+
+  for (const auto &KV : Session.Metadata) {
+    Metadata.str(KV.first);
+    Metadata.str(KV.second);
+    Metadata.endRecord();
+  }
+
+  for (const MachineFunctionStats &M : Session.MachineFunctions) {
+    Machine.str(M.Function);
+    Machine.u32(M.Spills);
+    Machine.u32(M.Reloads);
+    Machine.u32(M.FoldedSpills);
+    Machine.u32(M.FoldedReloads);
+    Machine.u32(M.Instructions);
+    Machine.pad(4);
+    Machine.u64(M.StackBytes);
+    Machine.u64(M.CodeBytes);
+    Machine.endRecord();
+  }
+
+  struct Section {
+    SessionSection     Kind;
+    uint32_t           RecordSize;
+    uint64_t           Count;
+    const std::string *Data;
+  };
+  const Section Sections[] = {
+      {SessionSection::Strings, 1, Strings.data().size(), &Strings.data()},
+      {SessionSection::Meta, MetaRecordSize, Meta.Count, &Meta.Data},
+      {SessionSection::Remarks, RemarkRecordSize, Remarks.Count, &Remarks.Data},
+      {SessionSection::RemarkArgs, ArgRecordSize, Args.Count, &Args.Data},
+      {SessionSection::Functions, FunctionRecordSize, Functions.Count,
+       &Functions.Data},
+      {SessionSection::Blocks, BlockRecordSize, Blocks.Count, &Blocks.Data},
+      {SessionSection::Instructions, InstructionRecordSize, Instructions.Count,
+       &Instructions.Data},
+      {SessionSection::Diagnostics, HotDiagnosticRecordSize,
+       Diagnostics.Count, &Diagnostics.Data},
+      {SessionSection::Fixes, FixRecordSize, Fixes.Count, &Fixes.Data},
+      {SessionSection::Metadata, MetadataRecordSize, Metadata.Count,
+       &Metadata.Data},
+      {SessionSection::MachineFunctions, MachineRecordSize, Machine.Count,
+       &Machine.Data},
+  };
+  constexpr uint32_t NumSections = std::size(Sections);
+
+  auto AlignUp = [](uint64_t V) { return (V + 7) & ~uint64_t(7); };
+
+  uint64_t Offsets[NumSections];
+  uint64_t Cursor = HeaderSize + NumSections * SectionEntrySize;
+  for (uint32_t I = 0; I < NumSections; ++I) {
+    Cursor     = AlignUp(Cursor);
+    Offsets[I] = Cursor;
+    Cursor    += Sections[I].Data->size();
+  }
+  uint64_t TotalSize = Cursor;
+
+  RecordBuffer Header(Strings, 1);
+  for (char C : SessionMagic)
+    Header.u8(static_cast<uint8_t>(C));
+  Header.u32(SessionFormatVersion);
+  Header.u32(NumSections);
+  Header.u64(TotalSize);
+  Header.u64(0);
+  for (uint32_t I = 0; I < NumSections; ++I) {
+    Header.u32(static_cast<uint32_t>(Sections[I].Kind));
+    Header.u32(Sections[I].RecordSize);
+    Header.u64(Offsets[I]);
+    Header.u64(Sections[I].Count);
+  }
+  OS << Header.Data;
+
+  uint64_t Written = Header.Data.size();
+  for (uint32_t I = 0; I < NumSections; ++I) {
+    OS.write_zeros(Offsets[I] - Written);
+    OS << *Sections[I].Data;
+    Written = Offsets[I] + Sections[I].Data->size();
+  }
+}
+
+llvm::Expected<AnalysisSession> readSessionBinary(llvm::MemoryBufferRef Buffer) {
+  SessionDecoder Decoder;
+  if (auto Err = Decoder.parse(Buffer.getBuffer()))
+    return std::move(Err);
+  return Decoder.decode();
+}
+
+llvm::Error saveSession(const AnalysisSession &Session, llvm::StringRef Path) {
+  ProfileScope PS("SaveSession", Path);
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::OF_None);
+  if (EC)
+    return makeStringError("Cannot open session file '" + Path +
+                           "': " + EC.message());
+  writeSessionBinary(Session, OS);
+  OS.close();
+  if (OS.has_error()) {
+    EC = OS.error();
+    OS.clear_error();
+    return makeStringError("Cannot write session file '" + Path +
+                           "': " + EC.message());
+  }
+  return llvm::Error::success();
+}
+
+llvm::Expected<AnalysisSession> loadSession(llvm::StringRef Path) {
+  ProfileScope PS("LoadSession", Path);
+  auto BufOrErr = llvm::MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                              /*RequiresNullTerminator=*/false);
+  if (!BufOrErr)
+    return makeStringError("Cannot open session file '" + Path +
+                           "': " + BufOrErr.getError().message());
+  auto SessionOrErr = readSessionBinary((*BufOrErr)->getMemBufferRef());
+  if (!SessionOrErr)
+    return makeStringError("Cannot load session file '" + Path + "': " +
+                           llvm::toString(SessionOrErr.takeError()));
+  return SessionOrErr;
+}
+
+}
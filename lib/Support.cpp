@@ -3,10 +3,56 @@
 
 namespace optdbg {
 
+const RemarkArgument *Remark::findArg(llvm::StringRef Key) const {
+  for (const RemarkArgument &A : Args)
+    if (A.Key == Key)
+      return &A;
+  return nullptr;
+}
+
+std::optional<int> Remark::intArg(llvm::StringRef Key) const {
+  int V;
+  const RemarkArgument *A = findArg(Key);
+  if (!A || llvm::StringRef(A->Value).trim().getAsInteger(10, V))
+    return std::nullopt;
+  return V;
+}
+
+unsigned Remark::unsignedArg(llvm::StringRef Key) const {
+  unsigned V;
+  const RemarkArgument *A = findArg(Key);
+  if (!A || llvm::StringRef(A->Value).trim().getAsInteger(10, V))
+    return 0;
+  return V;
+}
+
 // executes a case-insensitive substring search to match raw remarks against patterns
 bool matchesPattern(llvm::StringRef Text, llvm::StringRef Pattern) {
   if (Pattern.empty()) return true;
   return Text.contains_insensitive(Pattern);
 }
 
+llvm::StringRef remarkKindName(RemarkKind K) {
+  switch (K) {
+  case RemarkKind::Applied:           return "applied";
+  case RemarkKind::Missed:            return "missed";
+  case RemarkKind::Analysis:          return "analysis";
+  case RemarkKind::AnalysisAliasing:  return "analysis-aliasing";
+  case RemarkKind::AnalysisFPCommute: return "analysis-fp-commute";
+  }
+  return "analysis";
+}
+
+llvm::OptimizationLevel optLevelFor(llvm::StringRef OptLevel) {
+  llvm::StringRef L = OptLevel;
+  L.consume_front("-");
+  L.consume_front("O");
+  if (L == "0") return llvm::OptimizationLevel::O0;
+  if (L == "1") return llvm::OptimizationLevel::O1;
+  if (L == "3") return llvm::OptimizationLevel::O3;
+  if (L == "s") return llvm::OptimizationLevel::Os;
+  if (L == "z") return llvm::OptimizationLevel::Oz;
+  return llvm::OptimizationLevel::O2;
+}
+
 }
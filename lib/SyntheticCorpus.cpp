@@ -0,0 +1,156 @@
+#include "OptDebugger/SyntheticCorpus.h"
+
+#include <iterator>
+#include <vector>
+
+namespace optdbg {
+
+namespace {
+
+const char *const BinaryOps[] = {"add", "sub", "mul", "xor", "and", "or", "shl"};
+
+// a remark shape as the compiler would emit it. Arg values "%c", "%f" and
+// "%n" are replaced by a callee, the caller and a number respectively.
+struct RemarkShape {
+  const char *Kind;
+  const char *Pass;
+  const char *Name;
+  std::vector<std::pair<const char *, const char *>> Args;
+};
+
+const std::vector<RemarkShape> &remarkShapes() {
+  static const std::vector<RemarkShape> Shapes = {
+      {"Missed", "inline", "NotInlined",
+       {{"Callee", "%c"}, {"String", "' not inlined into '"}, {"Caller", "%f"},
+        {"String", "' because too costly to inline (cost='"}, {"Cost", "%n"},
+        {"String", "', threshold=225)'"}}},
+      {"Missed", "inline", "NoDefinition",
+       {{"Callee", "%c"}, {"String", "' will not be inlined into '"},
+        {"Caller", "%f"},
+        {"String", "' because its definition is unavailable'"}}},
+      {"Passed", "inline", "Inlined",
+       {{"Callee", "%c"}, {"String", "' inlined into '"}, {"Caller", "%f"},
+        {"String", "' with (cost='"}, {"Cost", "%n"},
+        {"String", "', threshold=225)'"}}},
+      {"Missed", "loop-vectorize", "MissedDetails",
+       {{"String", "'loop not vectorized'"}}},
+      {"Analysis", "loop-vectorize", "CantIdentifyArrayBounds",
+       {{"String", "'loop not vectorized: cannot identify array bounds'"}}},
+      {"Analysis", "loop-vectorize", "UnsafeDep",
+       {{"String", "'loop not vectorized: unsafe dependent memory operations in loop'"}}},
+      {"Passed", "loop-vectorize", "Vectorized",
+       {{"String", "'vectorized loop (vectorization width: '"},
+        {"VectorizationFactor", "%n"}, {"String", "', interleaved count: 2)'"}}},
+      {"Missed", "slp-vectorizer", "NotVectorized",
+       {{"String", "'List vectorization was possible but not beneficial with cost '"},
+        {"Cost", "%n"}, {"String", "' >= 0'"}}},
+      {"Missed", "gvn", "LoadClobbered",
+       {{"String", "'load of type i32 not eliminated because it is clobbered by call'"}}},
+      {"Missed", "licm", "LoadWithLoopInvariantAddressInvalidated",
+       {{"String", "'failed to move load with loop-invariant address because the loop may invalidate its value'"}}},
+      {"Missed", "loop-unroll", "FullUnrollAssumed",
+       {{"String", "'unable to fully unroll loop: unknown trip count'"}}},
+      {"Missed", "sroa", "CannotSROAElement",
+       {{"String", "'cannot split alloca: address taken'"}}},
+      {"Missed", "tailcallelim", "UnableToTransform",
+       {{"String", "'unable to eliminate tail call'"}}},
+      // no pattern matches these; they exercise the fallback path
+      {"Missed", "synthetic-pass", "UnknownReason",
+       {{"String", "'transformation skipped for reason '"}, {"Reason", "%n"}}},
+  };
+  return Shapes;
+}
+
+void writeFunction(const CorpusConfig &C, unsigned Index, bool Mutate,
+                   llvm::raw_ostream &OS) {
+  // the body depends only on the seed and index, so before and after agree
+  // everywhere the mutation does not touch
+  CorpusRNG Body(C.Seed * 0x100000001b3ULL + Index);
+  CorpusRNG Edit(C.Seed ^ (0xa5a5a5a5ULL + Index));
+
+  OS << "define i32 @" << syntheticFunctionName(Index)
+     << "(i32 %a, i32 %b) {\n";
+
+  std::vector<std::string> Values = {"%a", "%b"};
+  unsigned Next = 0;
+  unsigned Blocks = C.BlocksPerFunction ? C.BlocksPerFunction : 1;
+  for (unsigned B = 0; B < Blocks; ++B) {
+    OS << "bb" << B << ":\n";
+    for (unsigned I = 0; I < C.InstructionsPerBlock; ++I) {
+      constexpr unsigned NumOps = std::size(BinaryOps);
+      unsigned Op = Body.below(NumOps);
+      const std::string &L = Values[Body.below(Values.size())];
+      const std::string &R = Values[Body.below(Values.size())];
+      bool Rewrite = Mutate && Edit.below(4) == 0;
+      bool Insert  = Mutate && Edit.below(8) == 0;
+      if (Rewrite)
+        Op = (Op + 1 + Edit.below(NumOps - 1)) % NumOps;
+
+      std::string Name = "%v" + std::to_string(Next++);
+      OS << "  " << Name << " = " << BinaryOps[Op] << " i32 " << L << ", " << R
+         << "\n";
+      if (Insert)
+        OS << "  " << Name << ".extra = add i32 " << Name << ", "
+           << Edit.below(64) << "\n";
+      Values.push_back(std::move(Name));
+    }
+    if (B + 1 < Blocks)
+      OS << "  br label %bb" << B + 1 << "\n";
+  }
+  OS << "  ret i32 " << Values.back() << "\n}\n\n";
+}
+
+}
+
+std::string syntheticFunctionName(unsigned I) {
+  return "synth_fn_" + std::to_string(I);
+}
+
+void writeSyntheticModule(const CorpusConfig &C, bool After,
+                          llvm::raw_ostream &OS) {
+  OS << "; synthetic corpus: " << C.Functions << " functions x "
+     << C.BlocksPerFunction << " blocks x " << C.InstructionsPerBlock
+     << " instructions, seed " << C.Seed << "\n\n";
+  CorpusRNG Pick(C.Seed);
+  for (unsigned F = 0; F < C.Functions; ++F) {
+    bool Mutate = Pick.below(100) < C.ChangedPercent;
+    writeFunction(C, F, After && Mutate, OS);
+  }
+}
+
+void writeSyntheticRemarks(const CorpusConfig &C, llvm::raw_ostream &OS) {
+  const std::vector<RemarkShape> &Shapes = remarkShapes();
+  CorpusRNG RNG(C.Seed + 0x5eed);
+  unsigned NumFunctions = C.Functions ? C.Functions : 1;
+
+  for (unsigned I = 0; I < C.RemarkCount; ++I) {
+    const RemarkShape &S = Shapes[RNG.below(Shapes.size())];
+    unsigned Fn     = RNG.below(NumFunctions);
+    unsigned Callee = RNG.below(NumFunctions);
+    std::string Function = syntheticFunctionName(Fn);
+
+    OS << "--- !" << S.Kind << "\n";
+    OS << "Pass:            " << S.Pass << "\n";
+    OS << "Name:            " << S.Name << "\n";
+    OS << "DebugLoc:        { File: 'src/unit" << Fn % 64 << ".c', Line: "
+       << 1 + RNG.below(2000) << ", Column: " << 1 + RNG.below(80) << " }\n";
+    OS << "Function:        " << Function << "\n";
+    OS << "Args:\n";
+    for (const auto &A : S.Args) {
+      llvm::StringRef V = A.second;
+      OS << "  - " << A.first << ": ";
+      if (V == "%c")
+        OS << syntheticFunctionName(Callee);
+      else if (V == "%f")
+        OS << Function;
+      else if (V == "%n")
+        OS << "'" << RNG.below(1000) << "'";
+      else
+        OS << V;
+      OS << "\n";
+    }
+    OS << "...\n";
+  }
+}
+
+}
@@ -0,0 +1,506 @@
+#include "OptDebugger/WhatIf.h"
+#include "OptDebugger/CostModel.h"
+#include "OptDebugger/RemarkCollector.h"
+#include "OptDebugger/SelfProfile.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace optdbg {
+
+namespace {
+
+constexpr int DefaultSuggestedThreshold = 500;
+
+struct FunctionSize {
+  int64_t Instructions = 0;
+  int64_t Cost         = 0;
+};
+
+// what one pipeline run left behind
+struct PipelineRun {
+  std::vector<Remark>      Remarks;
+  llvm::StringMap<FunctionSize> Functions;
+  int64_t                  ModuleInstructions = 0;
+  std::string              Error;
+};
+
+struct EditResult {
+  bool        Applied = true;
+  std::string Detail;
+};
+
+using ModuleEdit = std::function<EditResult(llvm::Module &)>;
+
+// an O0 pipeline would change nothing to observe, so it runs at O2
+llvm::OptimizationLevel levelFor(llvm::StringRef OptLevel) {
+  llvm::OptimizationLevel L = optLevelFor(OptLevel);
+  return L == llvm::OptimizationLevel::O0 ? llvm::OptimizationLevel::O2 : L;
+}
+
+// clang -O0 output marks every function optnone and noinline, which would
+// keep the pipeline from doing anything; both go so it runs as at -O2
+void makeOptimizable(llvm::Module &M) {
+  for (llvm::Function &F : M) {
+    if (!F.hasFnAttribute(llvm::Attribute::OptimizeNone))
+      continue;
+    F.removeFnAttr(llvm::Attribute::OptimizeNone);
+    F.removeFnAttr(llvm::Attribute::NoInline);
+  }
+}
+
+PipelineRun runPipeline(llvm::StringRef IRText, llvm::OptimizationLevel Level,
+                        int InlineThreshold, const ModuleEdit &Edit,
+                        EditResult &Applied) {
+  PipelineRun Run;
+  llvm::LLVMContext Ctx;
+  RemarkCollector   Collector;
+  Collector.install(Ctx, /*AllRemarks=*/true);
+
+  llvm::SMDiagnostic Err;
+  auto M = llvm::parseIR(llvm::MemoryBufferRef(IRText, "<what-if>"), Err, Ctx);
+  if (!M) {
+    Run.Error = "failed to parse the input IR: " + Err.getMessage().str();
+    return Run;
+  }
+  makeOptimizable(*M);
+  if (Edit) {
+    Applied = Edit(*M);
+    if (!Applied.Applied)
+      return Run;
+  }
+  std::string VerifyErrors;
+  llvm::raw_string_ostream VS(VerifyErrors);
+  if (llvm::verifyModule(*M, &VS)) {
+    Run.Error = "edited module does not verify: " + VS.str();
+    return Run;
+  }
+
+  std::unique_ptr<llvm::TargetMachine> TM = targetMachineFor(*M);
+  llvm::PipelineTuningOptions PTO;
+  if (InlineThreshold >= 0)
+    PTO.InlinerThreshold = InlineThreshold;
+  llvm::PassInstrumentationCallbacks PIC;
+  registerPassProfiling(PIC);
+  llvm::PassBuilder PB(TM.get(), PTO, {}, &PIC);
+
+  llvm::LoopAnalysisManager     LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager    CGAM;
+  llvm::ModuleAnalysisManager   MAM;
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  llvm::ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(Level);
+  MPM.run(*M, MAM);
+
+  for (llvm::Function &F : *M) {
+    if (F.isDeclaration())
+      continue;
+    llvm::TargetTransformInfo TTI = TM ? TM->getTargetTransformInfo(F)
+                                       : llvm::TargetTransformInfo(M->getDataLayout());
+    FunctionSize &Size = Run.Functions[F.getName()];
+    for (llvm::Instruction &I : llvm::instructions(F)) {
+      if (llvm::isa<llvm::DbgInfoIntrinsic>(I))
+        continue;
+      ++Size.Instructions;
+      llvm::InstructionCost C = TTI.getInstructionCost(
+          &I, llvm::TargetTransformInfo::TCK_RecipThroughput);
+      if (C.isValid())
+        Size.Cost += *C.getValue();
+    }
+    Run.ModuleInstructions += Size.Instructions;
+  }
+  Run.Remarks = Collector.getRemarks();
+  return Run;
+}
+
+// the remark is about the same function, callee and source line
+bool sameSite(const Remark &Target, const Remark &R) {
+  if (R.PassName != Target.PassName || R.FunctionName != Target.FunctionName)
+    return false;
+  if (const RemarkArgument *Callee = Target.findArg("Callee")) {
+    const RemarkArgument *Other = R.findArg("Callee");
+    if (!Other || Other->Value != Callee->Value)
+      return false;
+  }
+  return !Target.Loc.Line || !R.Loc.Line || Target.Loc.Line == R.Loc.Line;
+}
+
+// remark names differ between LLVM versions, so any missed remark of the
+// pass at the site counts
+bool stillMissed(const Remark &Target, llvm::ArrayRef<Remark> Remarks) {
+  return llvm::any_of(Remarks, [&](const Remark &R) {
+    return R.isMissed() && sameSite(Target, R);
+  });
+}
+
+bool succeeded(const Remark &Target, llvm::ArrayRef<Remark> Remarks) {
+  return llvm::any_of(Remarks, [&](const Remark &R) {
+    return R.isApplied() && sameSite(Target, R);
+  });
+}
+
+int suggestedThreshold(llvm::StringRef Text) {
+  size_t Pos = Text.find("inline-threshold=");
+  int    Threshold;
+  if (Pos == llvm::StringRef::npos)
+    return DefaultSuggestedThreshold;
+  llvm::StringRef Digits = Text.drop_front(Pos + strlen("inline-threshold="));
+  Digits = Digits.take_while([](char C) { return C >= '0' && C <= '9'; });
+  if (Digits.getAsInteger(10, Threshold))
+    return DefaultSuggestedThreshold;
+  return Threshold;
+}
+
+EditResult notApplicable(std::string Why) { return {false, std::move(Why)}; }
+
+llvm::Function *definedCallee(llvm::Module &M, const Remark &Target,
+                              EditResult &Why) {
+  const RemarkArgument *Name = Target.findArg("Callee");
+  llvm::Function *F = Name ? M.getFunction(Name->Value) : nullptr;
+  if (!Name)
+    Why = notApplicable("the remark names no callee");
+  else if (!F || F->isDeclaration())
+    Why = notApplicable("callee has no definition in the module");
+  else if (F->hasFnAttribute(llvm::Attribute::OptimizeNone))
+    Why = notApplicable("callee is optnone");
+  else
+    return F;
+  return nullptr;
+}
+
+ModuleEdit editFor(WhatIfEdit E, const Remark &Target) {
+  switch (E) {
+  case WhatIfEdit::RaiseInlineThreshold:
+    return nullptr;
+
+  case WhatIfEdit::AlwaysInline:
+    return [Target](llvm::Module &M) {
+      EditResult R;
+      llvm::Function *Callee = definedCallee(M, Target, R);
+      if (!Callee)
+        return R;
+      if (Callee->hasFnAttribute(llvm::Attribute::AlwaysInline))
+        return notApplicable("callee is already alwaysinline");
+      Callee->removeFnAttr(llvm::Attribute::NoInline);
+      Callee->addFnAttr(llvm::Attribute::AlwaysInline);
+      R.Detail = "alwaysinline on @" + Callee->getName().str();
+      return R;
+    };
+
+  case WhatIfEdit::RemoveNoInline:
+    return [Target](llvm::Module &M) {
+      EditResult R;
+      llvm::Function *Callee = definedCallee(M, Target, R);
+      if (!Callee)
+        return R;
+      bool Changed = Callee->hasFnAttribute(llvm::Attribute::NoInline);
+      Callee->removeFnAttr(llvm::Attribute::NoInline);
+      for (llvm::User *U : Callee->users()) {
+        auto *CB = llvm::dyn_cast<llvm::CallBase>(U);
+        if (CB && CB->hasFnAttr(llvm::Attribute::NoInline)) {
+          CB->removeFnAttr(llvm::Attribute::NoInline);
+          Changed = true;
+        }
+      }
+      if (!Changed)
+        return notApplicable("neither the callee nor its calls are noinline");
+      R.Detail = "no noinline on @" + Callee->getName().str();
+      return R;
+    };
+
+  case WhatIfEdit::NoAliasArguments:
+    return [Target](llvm::Module &M) {
+      llvm::Function *F = M.getFunction(Target.FunctionName);
+      if (!F || F->isDeclaration())
+        return notApplicable("function has no definition in the module");
+      unsigned Added = 0;
+      for (llvm::Argument &A : F->args()) {
+        if (!A.getType()->isPointerTy() || A.hasNoAliasAttr())
+          continue;
+        A.addAttr(llvm::Attribute::NoAlias);
+        ++Added;
+      }
+      if (!Added)
+        return notApplicable("no pointer arguments without noalias");
+      return EditResult{true, "noalias on " + std::to_string(Added) +
+                                  " argument" + (Added == 1 ? "" : "s")};
+    };
+
+  case WhatIfEdit::ReadNoneCallees:
+    return [Target](llvm::Module &M) {
+      llvm::Function *F = M.getFunction(Target.FunctionName);
+      if (!F || F->isDeclaration())
+        return notApplicable("function has no definition in the module");
+      llvm::SmallPtrSet<llvm::Function *, 8> Callees;
+      for (llvm::Instruction &I : llvm::instructions(*F)) {
+        auto *CB = llvm::dyn_cast<llvm::CallBase>(&I);
+        llvm::Function *Callee = CB ? CB->getCalledFunction() : nullptr;
+        if (!Callee || Callee->isIntrinsic() || Callee->doesNotAccessMemory())
+          continue;
+        Callees.insert(Callee);
+      }
+      if (Callees.empty())
+        return notApplicable("no calls that may access memory");
+      std::string Names;
+      for (llvm::Function *Callee : Callees) {
+        Callee->setDoesNotAccessMemory();
+        Callee->setDoesNotThrow();
+        Callee->setWillReturn();
+        Names += (Names.empty() ? "@" : ", @") + Callee->getName().str();
+      }
+      return EditResult{true, "memory(none) on " + Names};
+    };
+  }
+  return nullptr;
+}
+
+// one trial of one experiment
+struct Job {
+  size_t Experiment;
+  size_t Trial;
+};
+
+template <typename Fn>
+void runParallel(size_t Count, unsigned Threads, Fn Work) {
+  std::atomic<size_t> Next{0};
+  auto Worker = [&] {
+    SelfProfiler::ThreadScope Profiling;
+    for (size_t I = Next++; I < Count; I = Next++)
+      Work(I);
+  };
+  unsigned Workers = std::max(1u, std::min<unsigned>(Threads, Count));
+  std::vector<std::thread> Pool;
+  for (unsigned W = 1; W < Workers; ++W)
+    Pool.emplace_back(Worker);
+  Worker();
+  for (std::thread &T : Pool)
+    T.join();
+}
+
+std::string signedString(int64_t V) {
+  return (V > 0 ? "+" : "") + std::to_string(V);
+}
+
+}
+
+llvm::StringRef whatIfEditName(WhatIfEdit E) {
+  switch (E) {
+  case WhatIfEdit::RaiseInlineThreshold: return "inline-threshold";
+  case WhatIfEdit::AlwaysInline:         return "alwaysinline";
+  case WhatIfEdit::RemoveNoInline:       return "remove-noinline";
+  case WhatIfEdit::NoAliasArguments:     return "noalias";
+  case WhatIfEdit::ReadNoneCallees:      return "readnone-callees";
+  }
+  return "unknown";
+}
+
+llvm::StringRef whatIfOutcomeName(WhatIfOutcome O) {
+  switch (O) {
+  case WhatIfOutcome::Flipped:       return "flipped";
+  case WhatIfOutcome::Cleared:       return "cleared";
+  case WhatIfOutcome::StillMissed:   return "still missed";
+  case WhatIfOutcome::NotApplicable: return "not applicable";
+  case WhatIfOutcome::Failed:        return "failed";
+  }
+  return "unknown";
+}
+
+std::optional<WhatIfEdit> whatIfEditFor(const FixSuggestion &S) {
+  switch (S.Edit) {
+  case FixEdit::None:                 return std::nullopt;
+  case FixEdit::RaiseInlineThreshold: return WhatIfEdit::RaiseInlineThreshold;
+  case FixEdit::AlwaysInline:         return WhatIfEdit::AlwaysInline;
+  case FixEdit::RemoveNoInline:       return WhatIfEdit::RemoveNoInline;
+  case FixEdit::NoAliasArguments:     return WhatIfEdit::NoAliasArguments;
+  case FixEdit::ReadNoneCallees:      return WhatIfEdit::ReadNoneCallees;
+  }
+  return std::nullopt;
+}
+
+llvm::Expected<std::vector<WhatIfExperiment>>
+runWhatIfExperiments(llvm::StringRef IRText, llvm::ArrayRef<Remark> Remarks,
+                     const DiagnosticEngine &Engine, const ModuleDiff &Diff,
+                     const WhatIfConfig &Config) {
+  ProfileScope PS("WhatIf");
+  if (IRText.empty())
+    return makeStringError("what-if experiments need the input IR");
+
+  // one experiment per missed site, with one trial per distinct edit
+  std::vector<WhatIfExperiment> Experiments;
+  for (const Remark &R : Remarks) {
+    if (Experiments.size() == Config.MaxRemarks)
+      break;
+    if (!R.isMissed() || R.IsMachine)
+      continue;
+    if (llvm::any_of(Experiments, [&](const WhatIfExperiment &E) {
+          return E.Target.RemarkName == R.RemarkName && sameSite(E.Target, R) &&
+                 E.Target.Loc.Column == R.Loc.Column;
+        }))
+      continue;
+
+    DiagnosticResult DR = Engine.analyzeRemark(R, Diff);
+    WhatIfExperiment E;
+    for (const FixSuggestion &S : DR.Suggestions) {
+      std::optional<WhatIfEdit> Edit = whatIfEditFor(S);
+      if (!Edit || llvm::any_of(E.Trials, [&](const WhatIfTrial &T) {
+            return T.Edit == *Edit;
+          }))
+        continue;
+      WhatIfTrial T;
+      T.Suggestion = S.Description;
+      T.Edit       = *Edit;
+      if (*Edit == WhatIfEdit::RaiseInlineThreshold) {
+        T.InlineThreshold = suggestedThreshold(S.Description);
+        T.Detail = "inline threshold " + std::to_string(T.InlineThreshold);
+      }
+      E.Trials.push_back(std::move(T));
+    }
+    if (E.Trials.empty())
+      continue;
+    E.Target = R;
+    E.RuleID = DR.RuleID;
+    Experiments.push_back(std::move(E));
+  }
+  if (Experiments.empty())
+    return Experiments;
+
+  llvm::OptimizationLevel Level = levelFor(Config.OptLevel);
+
+  // the unedited run is shared by every experiment
+  EditResult  Unused;
+  PipelineRun Control = runPipeline(IRText, Level, -1, nullptr, Unused);
+  if (!Control.Error.empty())
+    return makeStringError(Control.Error);
+
+  std::vector<Job> Jobs;
+  for (size_t I = 0; I < Experiments.size(); ++I) {
+    WhatIfExperiment &E = Experiments[I];
+    E.Reproduced = stillMissed(E.Target, Control.Remarks);
+    if (!E.Reproduced)
+      continue;
+    for (size_t T = 0; T < E.Trials.size(); ++T)
+      Jobs.push_back({I, T});
+  }
+
+  runParallel(Jobs.size(), Config.Threads, [&](size_t I) {
+    WhatIfExperiment &E = Experiments[Jobs[I].Experiment];
+    WhatIfTrial      &T = E.Trials[Jobs[I].Trial];
+    ProfileScope TrialScope("WhatIfTrial", whatIfEditName(T.Edit));
+
+    EditResult  Applied;
+    PipelineRun Run = runPipeline(IRText, Level, T.InlineThreshold,
+                                  editFor(T.Edit, E.Target), Applied);
+    if (!Applied.Detail.empty())
+      T.Detail = Applied.Detail;
+    if (!Applied.Applied) {
+      T.Outcome = WhatIfOutcome::NotApplicable;
+      return;
+    }
+    if (!Run.Error.empty()) {
+      T.Outcome = WhatIfOutcome::Failed;
+      T.Detail  = Run.Error;
+      return;
+    }
+
+    if (stillMissed(E.Target, Run.Remarks))
+      T.Outcome = WhatIfOutcome::StillMissed;
+    else if (succeeded(E.Target, Run.Remarks))
+      T.Outcome = WhatIfOutcome::Flipped;
+    else
+      T.Outcome = WhatIfOutcome::Cleared;
+
+    // a function inlined away or deleted counts as empty
+    FunctionSize Before = Control.Functions.lookup(E.Target.FunctionName);
+    FunctionSize After  = Run.Functions.lookup(E.Target.FunctionName);
+    T.FunctionInstructions = After.Instructions - Before.Instructions;
+    T.FunctionCost         = After.Cost - Before.Cost;
+    T.ModuleInstructions   = Run.ModuleInstructions - Control.ModuleInstructions;
+  });
+  return Experiments;
+}
+
+void printWhatIfReport(llvm::ArrayRef<WhatIfExperiment> Experiments,
+                       llvm::raw_ostream &OS, bool Verbose) {
+  OS << "\n=== What-If Experiments ===\n";
+  if (Experiments.empty()) {
+    OS << "No missed remarks with a suggestion that has an IR equivalent.\n";
+    return;
+  }
+
+  unsigned Flipped = 0, NotReproduced = 0;
+  for (const WhatIfExperiment &E : Experiments) {
+    const Remark &R = E.Target;
+    OS << "\n" << R.PassName << "/" << R.RemarkName << " in " << R.FunctionName;
+    if (const RemarkArgument *Callee = R.findArg("Callee"))
+      OS << " (callee " << Callee->Value << ")";
+    if (R.Loc.isValid())
+      OS << " at " << R.Loc.format();
+    OS << "\n";
+    if (!E.Reproduced) {
+      ++NotReproduced;
+      OS << "  not reproduced by the unedited pipeline; no trials run\n";
+      continue;
+    }
+
+    Flipped += llvm::any_of(E.Trials, [](const WhatIfTrial &T) {
+      return T.Outcome == WhatIfOutcome::Flipped;
+    });
+    OS << "  " << llvm::left_justify("Outcome", 16)
+       << llvm::left_justify("Edit", 44) << llvm::right_justify("Insts", 7)
+       << llvm::right_justify("Cost", 7) << llvm::right_justify("Module", 8)
+       << "\n";
+    for (const WhatIfTrial &T : E.Trials) {
+      bool Ran = T.Outcome != WhatIfOutcome::NotApplicable &&
+                 T.Outcome != WhatIfOutcome::Failed;
+      std::string Detail = T.Detail;
+      if (!Verbose && Detail.size() > 42)
+        Detail = Detail.substr(0, 39) + "...";
+      OS << "  " << llvm::left_justify(whatIfOutcomeName(T.Outcome), 16)
+         << llvm::left_justify(Detail, 44);
+      if (Ran)
+        OS << llvm::right_justify(signedString(T.FunctionInstructions), 7)
+           << llvm::right_justify(signedString(T.FunctionCost), 7)
+           << llvm::right_justify(signedString(T.ModuleInstructions), 8);
+      OS << "\n";
+      if (Verbose)
+        OS << "    suggestion: " << T.Suggestion << "\n";
+    }
+  }
+
+  OS << "\n" << Flipped << " of " << Experiments.size()
+     << " missed remarks flip to passed with at least one suggestion";
+  if (NotReproduced)
+    OS << ", " << NotReproduced << " not reproduced";
+  OS << ". Insts and Cost are the function's change, Module the module's "
+        "instruction change.\n";
+}
+
+}
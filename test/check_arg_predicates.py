@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+import os
+import sys
+import tempfile
+
+from testlib import check, fixture, load_json, passed, run, usage
+
+# callee, Cost (None when missing), Threshold
+CALLS = [
+    ("hash_mix", 230, 225),
+    ("hash_mix", 5000, 225),
+    ("hash_mix", 300, 225),
+    ("hash_mix", None, 225),
+    ("copy_buf", 230, 225),
+]
+
+PATTERN = """\
+[pattern]
+pass = inline
+remark = NotInlined
+message = too costly
+where = Callee ~ 'HASH_' && has(Threshold)
+severity = medium
+speedup = 1.1
+short = Hash helper not inlined
+explanation = A hashing helper was rejected by the inline cost model.
+when = Cost / Threshold <= 1.2
+when-severity = critical
+when-speedup = 1.6
+when = Cost > 4 * Threshold
+when-severity = low
+"""
+
+
+def write_remarks(path):
+    with open(path, "w") as f:
+        for i, (callee, cost, threshold) in enumerate(CALLS):
+            f.write(f"--- !Missed\nPass: inline\nName: NotInlined\n"
+                    f"DebugLoc: {{ File: k.c, Line: {i + 1}, Column: 1 }}\n"
+                    f"Function: f{i}\nArgs:\n  - Callee: {callee}\n"
+                    f"  - String: ' not inlined because too costly to "
+                    f"inline '\n")
+            if cost is not None:
+                f.write(f"  - Cost: '{cost}'\n")
+            f.write(f"  - Threshold: '{threshold}'\n...\n")
+
+
+def diagnose(opt_debugger, remarks, *extra, expect=2):
+    # the near misses are critical, which exceeds the default budget
+    out = run([opt_debugger, "--before=" + fixture("kernels.ll"),
+               "--after=" + fixture("kernels.O2.ll"), "--remarks=" + remarks,
+               "--no-color", "--json=-", "--json-format=json", *extra],
+              expect=expect).stdout
+    doc = load_json(out, "--json-format=json output")
+    return {d["function"]: (d["reason"], d["severity"], d["estimated_speedup"])
+            for d in doc["diagnostics"]}, out
+
+
+def check_builtin(opt_debugger, remarks):
+    got, out = diagnose(opt_debugger, remarks)
+    expected = {"f0": ("CRITICAL", 1.5), "f1": ("MEDIUM", 1.05),
+                "f2": ("HIGH", 1.3), "f3": ("HIGH", 1.3),
+                "f4": ("CRITICAL", 1.5)}
+    for fn, want in expected.items():
+        check(got[fn][1:] == want, f"{fn} was not ranked by Cost/Threshold",
+              out)
+    passed("built-in inline severity follows Cost / Threshold")
+
+
+def check_custom(opt_debugger, remarks, tmp):
+    patterns = os.path.join(tmp, "hash.aionpat")
+    with open(patterns, "w") as f:
+        f.write(PATTERN)
+    got, out = diagnose(opt_debugger, remarks, "--patterns=" + patterns)
+    custom = "Hash helper not inlined"
+    expected = {"f0": (custom, "CRITICAL", 1.6), "f1": (custom, "LOW", 1.1),
+                "f2": (custom, "MEDIUM", 1.1), "f3": (custom, "MEDIUM", 1.1)}
+    for fn, want in expected.items():
+        check(got[fn] == want, f"{fn} did not get the custom ranking", out)
+    check(got["f4"][0] != custom, "where matched a callee without 'hash_'",
+          out)
+    passed("where selects remarks by argument and when adjusts the ranking")
+
+
+def check_bad_condition(opt_debugger, remarks, tmp):
+    patterns = os.path.join(tmp, "bad.aionpat")
+    with open(patterns, "w") as f:
+        f.write("[pattern]\npass = inline\nwhere = Cost >\n")
+    result = run([opt_debugger, "--before=" + fixture("kernels.ll"),
+                  "--after=" + fixture("kernels.O2.ll"),
+                  "--remarks=" + remarks, "--patterns=" + patterns],
+                 expect=1)
+    check("bad.aionpat:3" in result.stderr,
+          "a malformed condition was not reported at its line", result.stderr)
+    passed("a malformed condition is rejected")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        remarks = os.path.join(tmp, "inline.opt.yaml")
+        write_remarks(remarks)
+        check_builtin(opt_debugger, remarks)
+        check_custom(opt_debugger, remarks, tmp)
+        check_bad_condition(opt_debugger, remarks, tmp)
+    sys.exit(0)
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+import os
+import sys
+import tempfile
+
+from testlib import KERNELS, check, fixture, load_json, passed, run, usage
+
+REPORT = ["--json=-", "--json-format=json"]
+
+
+def with_remarks(path):
+    return [a if not a.startswith("--remarks=") else "--remarks=" + path
+            for a in KERNELS]
+
+
+def duplicate_libcall_remark(path):
+    with open(fixture("kernels.opt.yaml")) as f:
+        text = f.read()
+    first = text.split("...\n", 1)[0] + "...\n"
+    check("CantVectorizeLibcall" in first,
+          "the fixture no longer starts with the libcall remark")
+    with open(path, "w") as f:
+        f.write(first + text)
+
+
+def check_counts(opt_debugger, tmp):
+    baseline = os.path.join(tmp, "aion.baseline")
+    run([opt_debugger, *KERNELS, "--write-baseline=" + baseline])
+    doc = load_json(run([opt_debugger, *KERNELS, *REPORT,
+                         "--baseline=" + baseline]).stdout, "baseline run")
+    check(not doc["diagnostics"], "the baseline left diagnostics")
+
+    twice = os.path.join(tmp, "twice.opt.yaml")
+    duplicate_libcall_remark(twice)
+    doc = load_json(run([opt_debugger, *with_remarks(twice), *REPORT,
+                         "--baseline=" + baseline]).stdout, "baseline run")
+    left = [(d["pass"], d["function"]) for d in doc["diagnostics"]]
+    check(left == [("loop-vectorize", "calls_in_loop")],
+          "a second occurrence was suppressed by a single baseline entry",
+          str(left))
+    passed("a baseline entry suppresses one occurrence")
+
+
+def check_hotness(opt_debugger):
+    doc = load_json(run([opt_debugger, *KERNELS, *REPORT]).stdout, "report")
+    hot = {d["function"]: d.get("hotness") for d in doc["diagnostics"]}
+    check(hot.get("use_scale") == 120, "Hotness was not read from YAML",
+          str(hot))
+    passed("remark hotness reaches the diagnostics")
+
+
+def check_hot_budget(opt_debugger):
+    run([opt_debugger, *KERNELS, "--budget=high=2"], expect=2)
+    run([opt_debugger, *KERNELS, "--budget=high=0,hot=200"], expect=0)
+    run([opt_debugger, *KERNELS, "--budget=high=0,hot=100"], expect=2)
+    passed("hot=N leaves colder diagnostics out of the budget")
+    # only use_scale carries hotness; the two calls_in_loop diagnostics
+    # would exceed high=1 if diagnostics without hotness counted
+    run([opt_debugger, *KERNELS, "--budget=high=1,hot=100"], expect=0)
+    passed("hot=N leaves diagnostics without hotness out of the budget")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_counts(opt_debugger, tmp)
+        check_hotness(opt_debugger)
+        check_hot_budget(opt_debugger)
+    sys.exit(0)
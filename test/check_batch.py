@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+import json
+import os
+import shutil
+import sys
+import tempfile
+
+from testlib import check, fixture, load_json, passed, run, usage
+
+REPORT = ["--no-color", "--json=-", "--json-format=json"]
+
+
+def add_unit(base):
+    os.makedirs(os.path.dirname(base), exist_ok=True)
+    shutil.copy(fixture("kernels.ll"), base + ".ll")
+    shutil.copy(fixture("kernels.opt.yaml"), base + ".opt.yaml")
+
+
+def check_qualified_functions(opt_debugger, tmp):
+    root = os.path.join(tmp, "tree")
+    add_unit(os.path.join(root, "a", "kernels"))
+    add_unit(os.path.join(root, "b", "kernels"))
+    out = run([opt_debugger, "--batch=" + root, *REPORT]).stdout
+    doc = load_json(out, "--batch output")
+    names = {d["function"] for d in doc["diagnostics"]}
+    for tu in ("a/kernels", "b/kernels"):
+        check(tu + ":use_scale" in names,
+              f"no diagnostic for {tu}:use_scale", str(sorted(names)))
+    check(not any(":" not in n for n in names),
+          "a merged diagnostic kept an unqualified name", str(sorted(names)))
+    passed("merged functions are qualified with their TU")
+
+
+def check_output_flag(opt_debugger, tmp):
+    root = os.path.join(tmp, "project")
+    add_unit(os.path.join(root, "out", "x"))
+    os.makedirs(os.path.join(root, "src"))
+    commands = [{
+        "directory": root,
+        "file": "src/x.c",
+        "arguments": ["clang", "-c", "src/x.c", "-o", "out/x.o",
+                      "-objcmt-migrate-literals", "-ObjC"],
+    }]
+    db = os.path.join(root, "compile_commands.json")
+    with open(db, "w") as f:
+        json.dump(commands, f)
+    out = run([opt_debugger, "--batch=" + db, *REPORT]).stdout
+    doc = load_json(out, "--batch output")
+    check(doc["diagnostics"], "the TU next to -o was not found", out)
+    passed("-o is matched with its path, not as a prefix of other flags")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_qualified_functions(opt_debugger, tmp)
+        check_output_flag(opt_debugger, tmp)
+    sys.exit(0)
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+import sys
+
+from testlib import check, load_json, passed, run, usage
+
+SMALL = ["--functions=10", "--blocks=2", "--instructions=4", "--remarks=200",
+         "--repeat=1"]
+STAGES = {"yaml-parse", "ir-parse", "ir-diff", "pattern-match",
+          "report-terminal", "report-json", "report-sarif", "report-html",
+          "end-to-end"}
+
+
+def bench(aion_bench, *extra):
+    out = run([aion_bench, *SMALL, *extra, "--json=-"]).stdout
+    return load_json(out, "aion-bench --json=- output")
+
+
+def check_results(aion_bench):
+    doc = bench(aion_bench)
+    check(doc["config"]["remarks"] == 200 and doc["config"]["functions"] == 10,
+          "the config does not echo the size options", str(doc["config"]))
+    names = {r["name"] for r in doc["results"]}
+    check(names == STAGES, "unexpected benchmark set", str(sorted(names)))
+    for r in doc["results"]:
+        check(r["items"] > 0 and r["median_ms"] > 0 and r["peak_rss_kb"] > 0,
+              f"{r['name']} measured nothing", str(r))
+        check(r["min_ms"] <= r["median_ms"],
+              f"{r['name']} min is above the median", str(r))
+        expected = r["items"] / (r["median_ms"] / 1000)
+        check(abs(r["items_per_second"] - expected) <= expected * 1e-6,
+              f"{r['name']} throughput does not match items and time", str(r))
+    yaml = [r for r in doc["results"] if r["name"] == "yaml-parse"][0]
+    check(yaml["items"] == 200, "yaml-parse did not see every remark",
+          str(yaml))
+    passed("every stage reports consistent throughput")
+    return doc
+
+
+def check_reproducible(aion_bench, first):
+    items = {r["name"]: r["items"] for r in first["results"]}
+    again = {r["name"]: r["items"] for r in bench(aion_bench)["results"]}
+    check(items == again, "the same options generated different work",
+          f"{items}\n{again}")
+    passed("the same options measure the same work")
+
+
+def check_filter(aion_bench):
+    doc = bench(aion_bench, "--filter=yaml,match")
+    names = sorted(r["name"] for r in doc["results"])
+    check(names == ["pattern-match", "yaml-parse"],
+          "--filter ran the wrong benchmarks", str(names))
+    passed("--filter selects benchmarks by name")
+
+
+if __name__ == "__main__":
+    (aion_bench,) = usage(["aion-bench"])
+    first = check_results(aion_bench)
+    check_reproducible(aion_bench, first)
+    check_filter(aion_bench)
+    sys.exit(0)
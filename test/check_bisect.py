@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+import os
+import re
+import sys
+import tempfile
+
+from testlib import check, passed, run, usage
+
+# clang -O0 style: every function optnone and noinline
+OPTNONE = """\
+define i32 @f(i32 %x) #0 {
+entry:
+  %a = add i32 %x, 0
+  %b = mul i32 %a, 1
+  ret i32 %b
+}
+
+define i32 @g(i32 %x) #0 {
+entry:
+  %r = call i32 @f(i32 %x)
+  ret i32 %r
+}
+
+attributes #0 = { noinline nounwind optnone }
+"""
+
+# inlining the callee makes the caller larger
+INLINED = """\
+define internal i32 @body(i32 %x) {
+entry:
+  %a = mul i32 %x, 3
+  %b = add i32 %a, 7
+  %c = xor i32 %b, 5
+  ret i32 %c
+}
+
+define i32 @caller(i32 %x) {
+entry:
+  %r = call i32 @body(i32 %x)
+  ret i32 %r
+}
+"""
+
+
+def bisect(opt_debugger, path, spec, *extra, expect=0):
+    result = run([opt_debugger, path, "--bisect=" + spec, "--no-color",
+                  *extra], expect=expect)
+    if expect != 0:
+        return result.stderr
+    out = result.stdout
+    check("=== Pass Bisection ===" in out, "no bisection report", out)
+    return out[out.index("=== Pass Bisection ==="):]
+
+
+def culprit(out):
+    match = re.search(r"^Culprit   : #(\d+) (\S+)", out, re.M)
+    check(match, "no culprit", out)
+    return int(match.group(1)), match.group(2)
+
+
+def check_optnone_input(opt_debugger, path):
+    out = bisect(opt_debugger, path, "changed:f")
+    check("differs from the limit-0 probe (the input after the required "
+          "passes)" in out, "the predicate does not name what it compares to",
+          out)
+    index, _ = culprit(out)
+    check(f"-opt-bisect-limit={index} (and {index - 1} without it)" in out,
+          "the repro line does not match the culprit", out)
+    check("optnone and noinline removed from its 2 optnone functions" in out,
+          "the repro does not mention the dropped optnone", out)
+    check("@f instructions: 3 -> 1" in out, "wrong instruction counts", out)
+    check("+ ret i32 %x" in out, "the culprit's IR diff is missing", out)
+    passed("changed:FN on optnone input names the edit opt needs")
+
+
+def check_grew(opt_debugger, path):
+    out = bisect(opt_debugger, path, "grew:caller")
+    check("more instructions than in the limit-0 probe" in out,
+          "the predicate does not name what it compares to", out)
+    index, name = culprit(out)
+    check("Inliner" in name, f"{name} is not the inliner", out)
+    check("optnone" not in out, "input without optnone got an optnone note",
+          out)
+    parallel = bisect(opt_debugger, path, "grew:caller", "--jobs=4")
+    check(culprit(parallel) == (index, name),
+          "--jobs=4 found a different culprit", parallel)
+
+    out = bisect(opt_debugger, path, "grew:caller:100")
+    check("false both before the first pass and after the last" in out,
+          "a threshold above the final size still found a culprit", out)
+    passed("grew:FN finds the inliner, in parallel too")
+
+
+def check_remark(opt_debugger, path):
+    out = bisect(opt_debugger, path, "remark:inline/Inlined@caller")
+    _, name = culprit(out)
+    check("Inliner" in name, f"{name} did not emit the remark", out)
+    passed("remark:PASS/NAME@FN finds the pass that emitted it")
+
+
+def check_errors(opt_debugger, path):
+    err = bisect(opt_debugger, path, "shrank:f", expect=1)
+    check("Unknown bisect predicate 'shrank:f'" in err,
+          "an unknown predicate was accepted", err)
+    err = bisect(opt_debugger, path, "changed:missing", expect=1)
+    check("No function 'missing' is defined in the input" in err,
+          "a missing function was accepted", err)
+    passed("bad predicates and functions are rejected")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        paths = {}
+        for name, text in (("optnone.ll", OPTNONE), ("inlined.ll", INLINED)):
+            paths[name] = os.path.join(tmp, name)
+            with open(paths[name], "w") as f:
+                f.write(text)
+        check_optnone_input(opt_debugger, paths["optnone.ll"])
+        check_grew(opt_debugger, paths["inlined.ll"])
+        check_remark(opt_debugger, paths["inlined.ll"])
+        check_errors(opt_debugger, paths["optnone.ll"])
+    sys.exit(0)
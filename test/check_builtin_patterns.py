@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+import os
+import sys
+import tempfile
+
+from testlib import check, fixture, load_json, passed, run, usage
+
+# pass, remark name, message -> the built-in pattern's short reason; one
+# remark per pass bucket, plus generic patterns and the fallback
+CASES = [
+    ("gvn", "LoadElim", "load of type i32 not eliminated",
+     "GVN failed to eliminate redundant load"),
+    ("licm", "LICMFail", "failed to sink or hoist instruction",
+     "LICM failed: Hoisting/Sinking blocked"),
+    ("loop-interchange", "Dependence", "cannot interchange",
+     "Loop interchange failed"),
+    ("loop-unroll", "FullUnrollAssumed", "unknown trip count",
+     "Loop unrolling skipped: trip count not statically known"),
+    ("memcpyopt", "Copy", "memcpy kept",
+     "MemCpyOpt failed to optimize memory copy"),
+    ("regalloc", "LoopSpillReloadCopies", "3 spills",
+     "Register allocation spilled values in a loop"),
+    ("slp-vectorizer", "NotVectorized", "not vectorized",
+     "SLP vectorization failed"),
+    ("sroa", "CannotSROAElement", "element escapes",
+     "SROA failed: aggregate cannot be decomposed"),
+    ("tailcallelim", "UnableToTransform", "cannot eliminate tail call",
+     "Tail call elimination failed"),
+    ("loop-vectorize", "NeverInline", "blocked",
+     "Optimization blocked by attribute"),
+    ("instcombine", "Custom", "function has optnone",
+     "Optimization skipped: optnone function"),
+    ("instcombine", "Other", "nothing known", "Optimization missed: Other"),
+]
+
+
+def write_remarks(path):
+    with open(path, "w") as f:
+        for i, (pass_, name, message, _) in enumerate(CASES):
+            f.write(f"--- !Missed\nPass: {pass_}\nName: {name}\n"
+                    f"DebugLoc: {{ File: k.c, Line: {i + 1}, Column: 1 }}\n"
+                    f"Function: f{i}\nArgs:\n  - String: '{message}'\n...\n")
+
+
+def check_buckets(opt_debugger, tmp):
+    remarks = os.path.join(tmp, "remarks.opt.yaml")
+    write_remarks(remarks)
+    # the optnone remark is critical, which exceeds the default budget
+    out = run([opt_debugger, "--before=" + fixture("kernels.ll"),
+               "--after=" + fixture("kernels.O2.ll"), "--remarks=" + remarks,
+               "--no-color", "--json=-", "--json-format=json"],
+              expect=2).stdout
+    doc = load_json(out, "--json-format=json output")
+    reasons = {d["function"]: d["reason"] for d in doc["diagnostics"]}
+    for i, (pass_, name, _, reason) in enumerate(CASES):
+        check(reasons.get(f"f{i}") == reason,
+              f"{pass_}/{name} matched the wrong pattern", out)
+    passed("every pass bucket, the generic patterns and the fallback match")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_buckets(opt_debugger, tmp)
+    sys.exit(0)
@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+import os
+import shutil
+import sys
+import tempfile
+
+from testlib import KERNELS, check, fixture, load_json, passed, run, usage
+
+REUSED = "reusing cached analysis"
+
+
+def analyze(opt_debugger, cache, inputs=KERNELS):
+    result = run([opt_debugger, *inputs, "--cache-dir=" + cache, "--verbose",
+                  "--json=-", "--json-format=json"])
+    return load_json(result.stdout, "--json=- output"), result.stderr
+
+
+def check_hit(opt_debugger, cache):
+    first, err = analyze(opt_debugger, cache)
+    check(REUSED not in err, "an empty cache served a result", err)
+    check(os.listdir(cache), "nothing was stored in the cache")
+    second, err = analyze(opt_debugger, cache)
+    check(REUSED in err, "identical inputs were analyzed again", err)
+    for key in ("diagnostics", "functions", "summary"):
+        check(first[key] == second[key],
+              f"the cached {key} differ from the fresh ones")
+    passed("a repeat run is served from the cache with the same report")
+
+
+def check_miss_on_changed_input(opt_debugger, cache, tmp):
+    before = os.path.join(tmp, "kernels.ll")
+    shutil.copy(fixture("kernels.ll"), before)
+    with open(before, "a") as f:
+        f.write("\n; edited\n")
+    inputs = ["--before=" + before] + KERNELS[1:]
+    _, err = analyze(opt_debugger, cache, inputs)
+    check(REUSED not in err, "an edited input was served from the cache", err)
+    passed("an edited input misses the cache")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        cache = os.path.join(tmp, "cache")
+        check_hit(opt_debugger, cache)
+        check_miss_on_changed_input(opt_debugger, cache, tmp)
+    sys.exit(0)
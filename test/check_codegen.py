@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+import sys
+import tempfile
+
+from testlib import KERNELS, check, load_json, passed, run, usage
+
+FUNCTIONS = {"calls_in_loop", "saxpy", "scale", "use_scale"}
+
+
+def analyze(opt_debugger, *extra):
+    result = run([opt_debugger, *KERNELS, "--json=-", "--json-format=json",
+                  *extra])
+    return load_json(result.stdout, "--json=- output"), result.stderr
+
+
+def check_machine_stats(opt_debugger):
+    doc, err = analyze(opt_debugger, "--codegen-triple=x86_64-unknown-linux-gnu")
+    stats = doc.get("machine_functions")
+    check(stats, "no machine_functions with --codegen-triple", err)
+    check({s["function"] for s in stats} == FUNCTIONS,
+          "machine_functions does not list every defined function", str(stats))
+    check(all(s["instructions"] > 0 and s["code_bytes"] > 0 for s in stats),
+          "a function has no instructions or code bytes", str(stats))
+    passed("--codegen lists per-function machine stats")
+
+
+def check_failure_is_a_warning(opt_debugger):
+    plain, _ = analyze(opt_debugger)
+    doc, err = analyze(opt_debugger, "--codegen-triple=bogus-unknown-none")
+    check("warning: codegen failed, continuing without machine stats" in err,
+          "a codegen failure was not reported as a warning", err)
+    check("machine_functions" not in doc,
+          "a failed codegen stage still reported machine stats")
+    check(doc["diagnostics"] == plain["diagnostics"],
+          "a failed codegen stage changed the diagnostics")
+    passed("a codegen failure warns and keeps the analysis")
+
+
+def check_failure_is_not_cached(opt_debugger, cache):
+    for _ in range(2):
+        _, err = analyze(opt_debugger, "--codegen-triple=bogus-unknown-none",
+                         "--cache-dir=" + cache, "--verbose")
+        check("reusing cached analysis" not in err,
+              "a session without its machine stats was cached", err)
+        check("codegen failed" in err, "the repeat run did not warn", err)
+    passed("a session whose codegen failed is not cached")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as cache:
+        check_machine_stats(opt_debugger)
+        check_failure_is_a_warning(opt_debugger)
+        check_failure_is_not_cached(opt_debugger, cache)
+    sys.exit(0)
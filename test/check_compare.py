@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+import os
+import sys
+import tempfile
+
+from testlib import check, fixture, load_json, passed, run, usage
+
+
+def write_new_build(path):
+    with open(fixture("kernels.opt.yaml")) as f:
+        text = f.read()
+    # the missed loop moved down two lines
+    moved = text.replace("Name:            MissedDetails\n"
+                         "DebugLoc:        { File: kernels.c, Line: 4,",
+                         "Name:            MissedDetails\n"
+                         "DebugLoc:        { File: kernels.c, Line: 6,")
+    check(moved != text, "the fixture no longer has the MissedDetails remark")
+    # the vectorized loop is no longer vectorized
+    lost = moved.replace("--- !Passed\nPass:            loop-vectorize\n"
+                         "Name:            Vectorized",
+                         "--- !Missed\nPass:            loop-vectorize\n"
+                         "Name:            Vectorized")
+    check(lost != moved, "the fixture no longer has the Vectorized remark")
+    with open(path, "w") as f:
+        f.write(lost)
+
+
+def check_compare(opt_debugger, tmp):
+    new = os.path.join(tmp, "new.opt.yaml")
+    write_new_build(new)
+    result = run([opt_debugger, "--compare", fixture("kernels.opt.yaml"), new,
+                  "--json=-"], expect=1)
+    doc = load_json(result.stdout, "--compare JSON")
+    summary = doc["summary"]
+    check(summary["newly_missed"] == 0 and summary["removed"] == 0,
+          "a remark that only moved was reported as new and removed",
+          result.stdout)
+    check(summary["changed"] == 1 and summary["regressions"] == 1,
+          "applied -> missed is not a regression", result.stdout)
+    (change,) = doc["changes"]
+    check(change["old"]["kind"] == "applied" and
+          change["new"]["kind"] == "missed",
+          "the change has the wrong kinds", result.stdout)
+    passed("moved remarks match and applied -> missed fails the run")
+
+
+def check_identical(opt_debugger):
+    result = run([opt_debugger, "--compare", fixture("kernels.opt.yaml"),
+                  fixture("kernels.opt.yaml"), "--json=-"])
+    summary = load_json(result.stdout, "--compare JSON")["summary"]
+    check(summary["unchanged"] == summary["old_remarks"] == 6,
+          "identical builds differ", result.stdout)
+    passed("identical builds compare clean")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_compare(opt_debugger, tmp)
+        check_identical(opt_debugger)
+    sys.exit(0)
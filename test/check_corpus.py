@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+import filecmp
+import os
+import sys
+import tempfile
+
+from testlib import check, passed, run, usage
+
+
+def corpus(generate_tests, out, *extra, expect=0):
+    return run([generate_tests, "--corpus", out, *extra], expect=expect)
+
+
+def check_layout(generate_tests, tmp):
+    out = os.path.join(tmp, "corpus")
+    corpus(generate_tests, out, "--units", "2", "--functions", "5",
+           "--remarks", "30", "--changed", "40")
+    for unit in ("unit0", "unit1"):
+        before = os.path.join(out, "before", unit + ".ll")
+        after = os.path.join(out, "after", unit + ".ll")
+        with open(before) as f:
+            text = f.read()
+        check(text.count("\ndefine ") == 5, f"{unit} does not have 5 functions",
+              text)
+        check(not filecmp.cmp(before, after, shallow=False),
+              f"{unit} did not change with --changed 40")
+        with open(os.path.join(out, "before", unit + ".opt.yaml")) as f:
+            yaml = f.read()
+        check(yaml.count("--- !") == 30, f"{unit} does not have 30 remarks")
+    check(not filecmp.cmp(os.path.join(out, "before", "unit0.ll"),
+                          os.path.join(out, "before", "unit1.ll"),
+                          shallow=False), "units share one seed")
+    passed("the corpus has the requested shape")
+
+    again = os.path.join(tmp, "again")
+    corpus(generate_tests, again, "--units", "2", "--functions", "5",
+           "--remarks", "30", "--changed", "40")
+    for sub in ("before/unit1.ll", "after/unit1.ll", "before/unit1.opt.yaml"):
+        check(filecmp.cmp(os.path.join(out, sub), os.path.join(again, sub),
+                          shallow=False), f"{sub} is not reproducible")
+    passed("the same command line writes the same bytes")
+
+
+def check_rejected(generate_tests, tmp):
+    out = os.path.join(tmp, "bad")
+    for option, value in [("--functions", "-1"), ("--units", " 5"),
+                          ("--remarks", "4294967296"), ("--changed", "101"),
+                          ("--seed", "18446744073709551616"),
+                          ("--blocks", "4x")]:
+        result = corpus(generate_tests, out, option, value, expect=1)
+        check(option in result.stderr, f"{option} {value!r} was not rejected",
+              result.stderr)
+    check(not os.path.exists(out), "a rejected command line wrote files")
+    passed("negative, out-of-range and malformed counts are rejected")
+
+
+if __name__ == "__main__":
+    (generate_tests,) = usage(["generate-tests"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_layout(generate_tests, tmp)
+        check_rejected(generate_tests, tmp)
+    sys.exit(0)
@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+import os
+import sys
+import tempfile
+
+from testlib import KERNELS, check, fixture, load_json, passed, run, usage
+
+
+def inline_diagnostic(opt_debugger, *args):
+    out = run([opt_debugger, *args, "--json=-", "--json-format=json"]).stdout
+    doc = load_json(out, "--json-format=json output")
+    found = [d for d in doc["diagnostics"] if d["pass"] == "inline"]
+    check(len(found) == 1, "expected one inline diagnostic", out)
+    return found[0], out
+
+
+def check_inline_speedup(opt_debugger):
+    d, out = inline_diagnostic(opt_debugger, *KERNELS)
+    check("modeled_cycles_saved" in d, "the inline fix was not modeled", out)
+    # the callee's body still runs after inlining, so removing the call
+    # overhead cannot make the caller ~100x faster
+    check(1.0 < d["estimated_speedup"] < 10.0,
+          f"implausible inline speedup {d['estimated_speedup']}", out)
+    passed("an inline speedup counts the callee's body")
+
+
+def check_unmodeled_keeps_prior(opt_debugger, tmp):
+    with open(fixture("kernels.opt.yaml")) as f:
+        text = f.read()
+    moved = text.replace("{ File: kernels.c, Line: 18, Column: 10 }",
+                         "{ File: kernels.c, Line: 999, Column: 10 }")
+    check(moved != text, "the fixture no longer has the use_scale remark")
+    remarks = os.path.join(tmp, "moved.opt.yaml")
+    with open(remarks, "w") as f:
+        f.write(moved)
+    args = [a if not a.startswith("--remarks=") else "--remarks=" + remarks
+            for a in KERNELS]
+    d, out = inline_diagnostic(opt_debugger, *args)
+    check("modeled_cycles_saved" not in d,
+          "a remark with no code at its line was modeled", out)
+    check(d["estimated_speedup"] > 1.0,
+          "the pattern's prior speedup was dropped", out)
+    passed("a remark with nothing to cost keeps the pattern's prior")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_inline_speedup(opt_debugger)
+        check_unmodeled_keeps_prior(opt_debugger, tmp)
+    sys.exit(0)
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+import os
+import re
+import sys
+import tempfile
+
+from testlib import KERNELS, check, load_json, passed, run, usage
+
+ROW = re.compile(r"^\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)%\s+(\S+)$")
+
+
+def group_rows(out):
+    table = out.split("  Groups\n", 1)
+    check(len(table) == 2, "no group table in the terminal report", out)
+    rows = []
+    for line in table[1].splitlines()[2:]:
+        m = ROW.match(line)
+        if not m:
+            break
+        counts = [int(x) for x in m.groups()[:6]]
+        rows.append((counts[0], counts[1:], int(m.group(7)), m.group(8)))
+    check(rows, "the group table has no rows", out)
+    return rows
+
+
+def total_diagnostics(out):
+    return sum(int(n) for n in
+               re.findall(r"\[..\] (?:CRITICAL|HIGH|MEDIUM|LOW)\s+: (\d+)", out))
+
+
+def check_terminal(opt_debugger, flag, keys):
+    out = run([opt_debugger, *KERNELS, flag]).stdout
+    rows = group_rows(out)
+    for count, histogram, _, key in rows:
+        check(sum(histogram) == count,
+              f"the severity histogram of {key} does not add up", out)
+    check(sum(r[0] for r in rows) == total_diagnostics(out),
+          "the groups do not partition the diagnostics", out)
+    check({r[3] for r in rows} == keys, f"unexpected {flag} keys", out)
+    # most severe first, then by estimated gain
+    order = [(next(i for i, n in enumerate(r[1]) if n), -r[2]) for r in rows]
+    check(order == sorted(order),
+          "groups are not ordered by severity and estimated gain", out)
+    passed(f"{flag} partitions the diagnostics")
+
+
+def check_gain(opt_debugger):
+    out = run([opt_debugger, *KERNELS, "--json=-", "--json-format=json"]).stdout
+    gains = {}
+    for d in load_json(out, "--json=- output")["diagnostics"]:
+        gains[d["pass"]] = (gains.get(d["pass"], 0) +
+                            max(d["estimated_speedup"] - 1, 0) * 100)
+    out = run([opt_debugger, *KERNELS, "--group-by-pass"]).stdout
+    for _, _, gain, key in group_rows(out):
+        check(abs(gain - gains[key]) <= 1,
+              f"{key}'s gain is not the sum of its speedups over 1x", out)
+    check("combined speedup" not in out, "speedups are still multiplied", out)
+    passed("a group's gain adds each speedup over 1x")
+
+
+def check_html(opt_debugger, tmp):
+    html = os.path.join(tmp, "grouped.html")
+    run([opt_debugger, *KERNELS, "--group-by-pass", "--html=" + html])
+    with open(html) as f:
+        page = f.read()
+    for key in ("inline", "loop-vectorize", "custom-pass"):
+        check(f"<h1 style=\"margin-top:2.5rem\">{key}</h1>" in page,
+              f"the HTML report has no {key} group")
+    passed("the HTML report groups by pass")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    check_terminal(opt_debugger, "--group-by-pass",
+                   {"inline", "loop-vectorize", "custom-pass"})
+    check_terminal(opt_debugger, "--group-by-function",
+                   {"@use_scale", "@calls_in_loop", "@saxpy"})
+    check_gain(opt_debugger)
+    with tempfile.TemporaryDirectory() as tmp:
+        check_html(opt_debugger, tmp)
+    sys.exit(0)
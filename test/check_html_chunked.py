@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+import json
+import os
+import re
+import sys
+import tempfile
+
+from testlib import KERNELS, check, fail, passed, run, usage
+
+# quotes, a backslash and markup must survive the inline <script>
+STEM = 're"po\\rt<b>'
+
+
+def check_data_dir_literal(opt_debugger, tmp):
+    html = os.path.join(tmp, STEM + ".html")
+    run([opt_debugger, *KERNELS, "--html=" + html, "--html-chunked"])
+    with open(html) as f:
+        page = f.read()
+    match = re.search(r"window\.AION_DATA_DIR = (.*?);</script>", page)
+    check(match, "no AION_DATA_DIR assignment in the page")
+    literal = match.group(1)
+    check("</" not in literal, "the data dir literal can close the script",
+          literal)
+    try:
+        name = json.loads(literal.replace("<\\/", "</"))
+    except json.JSONDecodeError as e:
+        fail(f"the data dir literal is not a JS string: {e}", literal)
+    check(name == STEM + "_data", f"the page points at {name!r}", literal)
+    data_dir = os.path.join(tmp, name)
+    check(os.path.isdir(data_dir), "the data directory was not written")
+    check(os.path.exists(os.path.join(data_dir, "index.js")),
+          "the data directory has no index", str(os.listdir(data_dir)))
+    passed("the chunked page names its data directory as a JS string")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_data_dir_literal(opt_debugger, tmp)
+    sys.exit(0)
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+import os
+import re
+import sys
+import tempfile
+
+from testlib import KERNELS, check, load_json, passed, run, usage
+
+BODY = "\n".join(f"  %v{i + 1} = mul i32 %v{i}, {i + 3}" for i in range(300))
+
+MODULE = f"""\
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-i128:128-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @big(i32 %v0) {{
+entry:
+{BODY}
+  ret i32 %v300
+}}
+
+define i32 @small(i32 %x) {{
+entry:
+  %r = add i32 %x, 1
+  ret i32 %r
+}}
+
+define i32 @caller(i32 %x) {{
+entry:
+  %a = call i32 @big(i32 %x)
+  %b = call i32 @small(i32 %a)
+  ret i32 %b
+}}
+"""
+
+REMARK = """\
+--- !Missed
+Pass: inline
+Name: NotInlined
+Function: caller
+Args:
+  - Callee: {callee}
+  - String: ' not inlined into '
+  - Caller: caller
+  - String: ' because too costly to inline (cost='
+  - Cost: '{cost}'
+  - String: ', threshold='
+  - Threshold: '225'
+  - String: ')'
+...
+"""
+
+
+def inline_cost(opt_debugger, tmp, *extra):
+    ir = os.path.join(tmp, "calls.ll")
+    remarks = os.path.join(tmp, "calls.opt.yaml")
+    with open(ir, "w") as f:
+        f.write(MODULE)
+    with open(remarks, "w") as f:
+        for callee, cost in [("big", 1500), ("small", 5), ("missing", 1)]:
+            f.write(REMARK.format(callee=callee, cost=cost))
+    # the near-miss remarks are critical, which exceeds the default budget
+    out = run([opt_debugger, "--before=" + ir, "--after=" + ir,
+               "--remarks=" + remarks, "--no-color", "--inline-cost",
+               *extra], expect=2).stdout
+    return out[out.index("=== Inline Cost Gaps"):]
+
+
+def gaps(report):
+    return {m.group(1): (int(m.group(2)), int(m.group(3))) for m in
+            re.finditer(r"^(\w+)\s+\d+\s+\d+\s+(-?\d+)\s+(-?\d+)$", report,
+                        re.M)}
+
+
+def check_gaps(opt_debugger, tmp):
+    report = inline_cost(opt_debugger, tmp, "--verbose")
+    table = gaps(report)
+    check(table["big"][0] > 0 and table["small"][1] < 0,
+          "the costly callee should be over and the cheap one under", report)
+    check(list(table) == ["small", "big"], "callees are not ranked", report)
+    check("3 missed call sites, 2 with a recomputed cost, 1 not found in the "
+          "module" in report, "the site summary is wrong", report)
+    check("compiler reported 1500/225" in report and
+          "not analyzed: no call to the callee in the caller" in report,
+          "--verbose does not show each site", report)
+    check("exact" not in report and "before the passes" in report,
+          "the report overstates the precision of the gap", report)
+    passed("missed call sites are recomputed and ranked by gap")
+
+
+def check_levels(opt_debugger, tmp):
+    for level, threshold in [("O2", 225), ("O3", 250), ("Os", 50)]:
+        report = inline_cost(opt_debugger, tmp, "-O=" + level)
+        check(f"(default threshold {threshold})" in report,
+              f"-O={level} used the wrong threshold", report)
+    passed("the threshold follows the optimization level")
+
+
+def check_never(opt_debugger):
+    out = run([opt_debugger, *KERNELS, "--inline-cost", "--verbose"]).stdout
+    check(re.search(r"use_scale -> scale at .*\n\s+never inlined: ", out),
+          "a noinline callee was not reported as never inlined", out)
+    passed("a noinline callee is never inlined")
+
+
+def check_streams(opt_debugger):
+    result = run([opt_debugger, *KERNELS, "--inline-cost", "--json=-",
+                  "--json-format=json"])
+    load_json(result.stdout, "--json=- output")
+    check("=== Inline Cost Gaps" in result.stderr,
+          "with --json=- the report did not move to stderr", result.stderr)
+    passed("--json=- keeps the report off stdout")
+
+
+def check_single_input(opt_debugger, tmp):
+    session = os.path.join(tmp, "missing.aion")
+    for flag in ["--inline-cost", "--loop-report", "--what-if",
+                 "--bisect=pass:inline"]:
+        stderr = run([opt_debugger, "--load-session=" + session, flag],
+                     expect=1).stderr
+        name = flag.split("=")[0]
+        check(f"{name} needs the IR of one input" in stderr,
+              f"{name} was accepted with --load-session", stderr)
+    passed("single-input views reject other modes")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_gaps(opt_debugger, tmp)
+        check_levels(opt_debugger, tmp)
+        check_never(opt_debugger)
+        check_streams(opt_debugger)
+        check_single_input(opt_debugger, tmp)
+    sys.exit(0)
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+import os
+import sys
+import tempfile
+
+from testlib import KERNELS, check, load_json, passed, run, usage
+
+
+def check_ndjson(opt_debugger):
+    out = run([opt_debugger, *KERNELS, "--json=-"]).stdout
+    records = [load_json(line, "NDJSON line") for line in out.splitlines()]
+    check(records and records[0]["type"] == "session",
+          "the first NDJSON record is not the session", out)
+    check(records[-1]["type"] == "summary",
+          "the last NDJSON record is not the summary", out)
+    diagnostics = [r for r in records if r["type"] == "diagnostic"]
+    check(len(diagnostics) == records[-1]["diagnostics"] > 0,
+          "diagnostic records do not match the summary count", out)
+    check(any(r["type"] == "function_diff" for r in records),
+          "no function diff records", out)
+    passed("every NDJSON line is a JSON record")
+
+
+def check_document(opt_debugger):
+    out = run([opt_debugger, *KERNELS, "--json=-", "--json-format=json"]).stdout
+    doc = load_json(out, "--json-format=json output")
+    check(len(doc["diagnostics"]) == doc["summary"]["diagnostics"],
+          "document diagnostics do not match the summary count", out)
+    check(doc["functions"], "the document has no function diffs", out)
+    passed("--json-format=json writes one JSON document")
+    return doc
+
+
+def check_rule_ids(opt_debugger, doc):
+    rules = [d.get("rule") for d in doc["diagnostics"]]
+    check(all(rules), "a JSON diagnostic has no rule id", str(rules))
+    sarif = load_json(run([opt_debugger, *KERNELS, "--sarif=-"]).stdout,
+                      "--sarif=- output")
+    results = sarif["runs"][0]["results"]
+    check(sorted(rules) == sorted(r["ruleId"] for r in results),
+          "JSON rule ids do not match the SARIF results", str(rules))
+    check("fallback/custom-pass/Unhandled" in rules,
+          "the fallback rule id is missing", str(rules))
+    passed("JSON diagnostics carry the rule id SARIF uses")
+
+
+def check_summary_only(opt_debugger, tmp):
+    path = os.path.join(tmp, "summary.json")
+    run([opt_debugger, *KERNELS, "--summary-only", "--json-format=json",
+         "--json=" + path])
+    check(os.path.exists(path), "--summary-only ignored --json")
+    with open(path) as f:
+        doc = load_json(f.read(), "--summary-only JSON")
+    check(doc["diagnostics"], "--summary-only JSON has no diagnostics")
+    check(not doc["functions"], "--summary-only JSON still has IR diffs")
+    check(all(not d.get("suggestions") for d in doc["diagnostics"]),
+          "--summary-only JSON still has suggestions")
+    passed("--summary-only writes a trimmed --json report")
+
+
+def check_single_stdout_document(opt_debugger):
+    result = run([opt_debugger, *KERNELS, "--json=-", "--sarif=-"], expect=1)
+    check(not result.stdout, "--json=- --sarif=- wrote to stdout",
+          result.stdout)
+    passed("--json=- with --sarif=- is rejected")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_ndjson(opt_debugger)
+        doc = check_document(opt_debugger)
+        check_rule_ids(opt_debugger, doc)
+        check_summary_only(opt_debugger, tmp)
+        check_single_stdout_document(opt_debugger)
+    sys.exit(0)
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+import os
+import re
+import sys
+import tempfile
+
+from testlib import KERNELS, check, fixture, passed, run, usage
+
+DEBUG_INFO = """
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!2, !3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, emissionKind: FullDebug)
+!1 = !DIFile(filename: "fill.c", directory: "/tmp")
+!2 = !{i32 2, !"Debug Info Version", i32 3}
+!3 = !{i32 7, !"Dwarf Version", i32 5}
+!4 = distinct !DISubprogram(name: "fill", scope: !1, file: !1, line: 1, type: !5, scopeLine: 1, spFlags: DISPFlagDefinition | DISPFlagOptimized, unit: !0)
+!5 = !DISubroutineType(types: !6)
+!6 = !{null}
+!8 = !DILocation(line: 2, column: 3, scope: !4)
+!9 = !DILocation(line: 3, column: 5, scope: !4)
+!10 = !DILocation(line: 4, column: 1, scope: !4)
+"""
+
+# a four-iteration loop and the output with it fully unrolled
+BEFORE = """\
+define void @fill(ptr %p) !dbg !4 {
+entry:
+  br label %loop, !dbg !8
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %next, %loop ], !dbg !8
+  %addr = getelementptr i32, ptr %p, i64 %i, !dbg !9
+  store i32 7, ptr %addr, align 4, !dbg !9
+  %next = add i64 %i, 1, !dbg !8
+  %done = icmp eq i64 %next, 4, !dbg !8
+  br i1 %done, label %exit, label %loop, !dbg !8
+
+exit:
+  ret void, !dbg !10
+}
+""" + DEBUG_INFO
+
+AFTER = """\
+define void @fill(ptr %p) !dbg !4 {
+entry:
+  store i32 7, ptr %p, align 4, !dbg !9
+  %a1 = getelementptr i32, ptr %p, i64 1, !dbg !9
+  store i32 7, ptr %a1, align 4, !dbg !9
+  %a2 = getelementptr i32, ptr %p, i64 2, !dbg !9
+  store i32 7, ptr %a2, align 4, !dbg !9
+  %a3 = getelementptr i32, ptr %p, i64 3, !dbg !9
+  store i32 7, ptr %a3, align 4, !dbg !9
+  ret void, !dbg !10
+}
+""" + DEBUG_INFO
+
+UNROLLED = """\
+--- !Passed
+Pass:            loop-unroll
+Name:            FullyUnrolled
+DebugLoc:        { File: fill.c, Line: 2, Column: 3 }
+Function:        fill
+Args:
+  - String:          'completely unrolled loop with '
+  - UnrollCount:     '4'
+  - String:          ' iterations'
+...
+"""
+
+
+def loop_table(out):
+    check("=== Loop Report ===" in out, "no loop report", out)
+    lines = out[out.index("=== Loop Report ==="):].splitlines()
+    header = re.split(r"\s{2,}", lines[1].strip())
+    rows = {}
+    for line in lines[2:]:
+        if not line.startswith("@"):
+            break
+        cells = re.split(r"\s{2,}", line.strip())
+        rows[cells[0]] = dict(zip(header[1:], cells[1:]))
+    return header, rows
+
+
+def check_kernels(opt_debugger):
+    out = run([opt_debugger, *KERNELS, "--loop-report"]).stdout
+    header, rows = loop_table(out)
+    check(header[-1] == "Output", "no Output column with --after", out)
+    check(set(rows) == {"@calls_in_loop kernels.c:4", "@saxpy kernels.c:9"},
+          "wrong loops", out)
+    saxpy = rows["@saxpy kernels.c:9"]
+    check(saxpy["Vector"] == "VF4,IC2", "saxpy's vectorization is missing", out)
+    check(saxpy["Trip"] == "n" and saxpy["Output"] == "kept",
+          "saxpy's trip count or output is wrong", out)
+    calls = rows["@calls_in_loop kernels.c:4"]
+    check(calls["Vector"] == "blocked", "calls_in_loop is not blocked", out)
+    check("2 loops, 1 vectorized, 0 unrolled, 1 with a blocked" in out,
+          "wrong totals", out)
+    check("loop-vectorize/CantVectorizeLibcall" in out,
+          "the blocking remark is not listed", out)
+    check("@saxpy kernels.c:9\n    header" not in out,
+          "a loop with nothing blocked has details without --verbose", out)
+
+    out = run([opt_debugger, *KERNELS, "--loop-report", "--verbose"]).stdout
+    check("header %loop, lines 9-10, 12 instructions" in out,
+          "--verbose does not describe saxpy's loop", out)
+    check("backedge-taken count (-1 + %n)" in out,
+          "--verbose has no symbolic trip count", out)
+    passed("the kernels' loops are vectorized, blocked and kept")
+
+
+def check_full_unroll(opt_debugger, tmp):
+    paths = {}
+    for name, text in (("before.ll", BEFORE), ("after.ll", AFTER),
+                       ("fill.opt.yaml", UNROLLED)):
+        paths[name] = os.path.join(tmp, name)
+        with open(paths[name], "w") as f:
+            f.write(text)
+    out = run([opt_debugger, "--before=" + paths["before.ll"],
+               "--after=" + paths["after.ll"],
+               "--remarks=" + paths["fill.opt.yaml"], "--no-color",
+               "--loop-report"]).stdout
+    header, rows = loop_table(out)
+    check(header[-1] == "Output",
+          "the Output column is missing when no loop is left", out)
+    fill = rows.get("@fill fill.c:2")
+    check(fill is not None, "the loop is missing", out)
+    check(fill["Trip"] == "4", "the constant trip count is wrong", out)
+    check(fill["Unroll"] == "full" and fill["Output"] == "gone",
+          "the full unroll is not reported", out)
+    passed("a fully unrolled loop has a trip count and is gone")
+
+
+def check_single_input(opt_debugger):
+    result = run([opt_debugger, *KERNELS, "--loop-report", "--batch=" +
+                  fixture("kernels.ll")], expect=1)
+    check("--loop-report needs the IR of one input" in result.stderr,
+          "--loop-report with --batch is not rejected", result.stderr)
+    passed("--loop-report needs a single input")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_kernels(opt_debugger)
+        check_full_unroll(opt_debugger, tmp)
+        check_single_input(opt_debugger)
+    sys.exit(0)
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+import base64
+import os
+import re
+import sys
+import tempfile
+import zlib
+
+from testlib import KERNELS, check, passed, run, usage
+
+UNITS = {"B": 1, "KB": 1024, "MB": 1024 ** 2, "GB": 1024 ** 3}
+
+
+def to_bytes(text):
+    number, unit = text.lstrip("~").split()
+    return float(number) * UNITS[unit]
+
+
+def memory_report(opt_debugger, *extra):
+    stderr = run([opt_debugger, *KERNELS, "--memory-report", *extra]).stderr
+    check("=== Memory Report ===" in stderr, "no memory report", stderr)
+    rows = {}
+    for m in re.finditer(r"^(\S.*?)\s+(\d+)\s+(~?[\d.]+ [KMG]?B)\s+"
+                         r"(~?[\d.]+ [KMG]?B)\s+(~?[\d.]+ [KMG]?B)\s+[\d.]+%$",
+                         stderr, re.M):
+        rows[m.group(1)] = (int(m.group(2)), to_bytes(m.group(5)))
+    marks = {m.group(1): to_bytes(m.group(2)) for m in
+             re.finditer(r"^  (\S.*?)\s+([\d.]+ [KMG]?B) peak$", stderr, re.M)}
+    return stderr, rows, marks
+
+
+def check_subsystems(opt_debugger):
+    stderr, rows, marks = memory_report(opt_debugger)
+    for name, items in [("Remarks", 6), ("IR diff: functions", 5),
+                        ("Diagnostics", 5), ("Printed IR", 2)]:
+        check(rows.get(name, (0, 0))[0] == items and rows[name][1] > 0,
+              f"{name} should hold {items} items", stderr)
+    check(rows["Report buffers"] == (0, 0) and not marks,
+          "streamed reports were counted as buffers", stderr)
+    passed("each subsystem is measured and streamed reports hold no buffer")
+
+
+def check_chunked_buffers(opt_debugger, tmp):
+    html = os.path.join(tmp, "report.html")
+    stderr, rows, marks = memory_report(opt_debugger, "--html=" + html,
+                                        "--html-chunked")
+    check(set(marks) == {"HTML index JSON", "HTML chunk JSON",
+                         "HTML data file encoding"},
+          "the chunked report buffers are not listed", stderr)
+    check(rows["Report buffers"][0] == 3, "wrong buffer count", stderr)
+    data = os.path.join(tmp, "report_data")
+    largest = {}
+    for name in os.listdir(data):
+        with open(os.path.join(data, name)) as f:
+            _, kind, _, encoded, flag = f.read().split('"')
+        decoded = base64.b64decode(encoded)
+        if flag.startswith(",1"):
+            decoded = zlib.decompress(decoded)
+        kind = "index" if kind == "index" else "chunk"
+        largest[kind] = max(largest.get(kind, 0), len(decoded))
+        largest["encoded"] = max(largest.get("encoded", 0), len(encoded))
+    # sizes are printed with one decimal, so allow for rounding
+    for mark, kind in [("HTML index JSON", "index"),
+                       ("HTML chunk JSON", "chunk"),
+                       ("HTML data file encoding", "encoded")]:
+        check(marks[mark] >= largest[kind] * 0.95,
+              f"{mark} is smaller than what was written", stderr)
+    passed("the chunked HTML report's JSON and encoding buffers are counted")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_subsystems(opt_debugger)
+        check_chunked_buffers(opt_debugger, tmp)
+    sys.exit(0)
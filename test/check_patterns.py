@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+import os
+import sys
+import tempfile
+
+from testlib import KERNELS, check, load_json, passed, run, usage
+
+PATTERN = """\
+[pattern]
+id = team/vec/libcall
+pass = loop-vectorize
+message = call instruction cannot
+severity = low
+speedup = 1.01
+short = Libcall in a vector loop
+explanation = The loop calls
+  a library function.
+root-cause = {FunctionName} calls a libcall.
+wanted = Vectorize.
+fix = Use a vector math library.
+"""
+
+
+def custom_diagnostics(opt_debugger, patterns, *extra):
+    result = run([opt_debugger, *KERNELS, "--patterns=" + patterns,
+                  "--json=-", "--json-format=json", *extra])
+    doc = load_json(result.stdout, "--json-format=json output")
+    return ([d for d in doc["diagnostics"]
+             if d["reason"] == "Libcall in a vector loop"], result.stderr)
+
+
+def check_source(opt_debugger, source, cache):
+    custom, _ = custom_diagnostics(opt_debugger, source, "--cache-dir=" + cache)
+    check(len(custom) == 1, "the custom pattern did not win the tie with "
+          "the built-in libcall pattern", str(custom))
+    check(custom[0]["severity"] == "LOW" and
+          custom[0]["root_cause"] == "calls_in_loop calls a libcall.",
+          "the custom pattern's fields were not applied", str(custom))
+    passed("a pattern source overrides the built-in match")
+
+
+def check_cache(opt_debugger, source, cache):
+    index_dir = os.path.join(cache, "patterns")
+    cached = os.listdir(index_dir)
+    check(len(cached) == 1 and cached[0].endswith(".aionpdb"),
+          "the compiled index was not cached", str(cached))
+    _, stderr = custom_diagnostics(opt_debugger, source, "--verbose",
+                                   "--cache-dir=" + cache)
+    check("from the index cache" in stderr, "the cached index was not reused",
+          stderr)
+    with open(os.path.join(index_dir, cached[0]), "w") as f:
+        f.write("garbage")
+    custom, stderr = custom_diagnostics(opt_debugger, source, "--verbose",
+                                        "--cache-dir=" + cache)
+    check(len(custom) == 1 and "from the index cache" not in stderr,
+          "a corrupt cached index was used", stderr)
+    passed("the compiled index is cached by content and rebuilt when corrupt")
+
+
+def check_index(opt_debugger, aion_patterns, source, tmp):
+    index = os.path.join(tmp, "team.aionpdb")
+    run([aion_patterns, "compile", source, "-o", index])
+    listed = run([aion_patterns, "list", index]).stdout
+    check("team/vec/libcall [LOW]" in listed, "list does not show the pattern",
+          listed)
+    custom, _ = custom_diagnostics(opt_debugger, index)
+    check(len(custom) == 1, "the precompiled index did not match", str(custom))
+    passed("aion-patterns compiles an index opt-debugger loads")
+
+
+def check_errors(opt_debugger, aion_patterns, tmp):
+    bad = os.path.join(tmp, "bad.aionpat")
+    with open(bad, "w") as f:
+        f.write("[pattern]\nseverity = bogus\n")
+    for cmd in ([aion_patterns, "compile", bad, "-o", bad + ".pdb"],
+                [opt_debugger, *KERNELS, "--patterns=" + bad]):
+        stderr = run(cmd, expect=1).stderr
+        check("bad.aionpat:2: unknown severity 'bogus'" in stderr,
+              "the error does not name the file and line", stderr)
+    passed("malformed pattern files are rejected with their location")
+
+
+if __name__ == "__main__":
+    opt_debugger, aion_patterns = usage(["opt-debugger", "aion-patterns"])
+    with tempfile.TemporaryDirectory() as tmp:
+        source = os.path.join(tmp, "team.aionpat")
+        with open(source, "w") as f:
+            f.write(PATTERN)
+        cache = os.path.join(tmp, "cache")
+        check_source(opt_debugger, source, cache)
+        check_cache(opt_debugger, source, cache)
+        check_index(opt_debugger, aion_patterns, source, tmp)
+        check_errors(opt_debugger, aion_patterns, tmp)
+    sys.exit(0)
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+import json
+import os
+import struct
+import sys
+import tempfile
+
+from testlib import check, fixture, passed, run, usage
+
+
+def query(remarkdb, db, *args):
+    out = run([remarkdb, "query", db, "--json", *args]).stdout
+    return [json.loads(line) for line in out.splitlines()]
+
+
+def check_round_trip(remarkdb, tmp):
+    db = os.path.join(tmp, "remarks.db")
+    run([remarkdb, "ingest", "-o", db, fixture("kernels.opt.yaml")])
+    rows = query(remarkdb, db)
+    check(len(rows) == 6, f"expected 6 remarks, got {len(rows)}")
+
+    (vectorized,) = query(remarkdb, db, "--name=Vectorized")
+    args = {a["key"]: a["value"] for a in vectorized["args"]}
+    check(args.get("VectorizationFactor") == "4" and
+          args.get("InterleaveCount") == "2",
+          "structured arguments were not stored", json.dumps(vectorized))
+
+    (inline,) = query(remarkdb, db, "--pass=inline")
+    callee = [a for a in inline["args"] if a["key"] == "Callee"]
+    check(callee and callee[0]["value"] == "scale" and
+          callee[0].get("loc") == "kernels.c:13:0",
+          "an argument lost its value or location", json.dumps(inline))
+    check(inline.get("hotness") == 120, "hotness was not stored",
+          json.dumps(inline))
+    passed("remark arguments and hotness survive ingest and query")
+
+
+def check_filters(remarkdb, tmp):
+    db = os.path.join(tmp, "remarks.db")
+    out = run([remarkdb, "query", db, "--pass=loop-vectorize", "--kind=missed",
+               "--count"]).stdout
+    check(out.strip() == "1", "pass and kind filters disagree", out)
+    out = run([remarkdb, "query", db, "--function=^calls_", "--count"]).stdout
+    check(out.strip() == "3", "the function regex filter is wrong", out)
+    passed("queries filter by pass, kind and function")
+
+
+def corrupt(tmp, name, section, value, width):
+    with open(os.path.join(tmp, "remarks.db"), "rb") as f:
+        data = bytearray(f.read())
+    (num_sections,) = struct.unpack_from("<I", data, 12)
+    for i in range(num_sections):
+        kind, _, offset, _ = struct.unpack_from("<IIQQ", data, 32 + 24 * i)
+        if kind == section:
+            data[offset:offset + width] = value.to_bytes(width, "little")
+            break
+    else:
+        check(False, f"the database has no section {section:#x}")
+    path = os.path.join(tmp, name)
+    with open(path, "wb") as f:
+        f.write(data)
+    return path
+
+
+def check_rejects_corrupt(remarkdb, tmp):
+    # the first row's kind byte and its pass column id
+    for name, section, value, width in [("kind.db", 0x42, 0xff, 1),
+                                        ("pass.db", 0x30, 0xffff, 4)]:
+        db = corrupt(tmp, name, section, value, width)
+        result = run([remarkdb, "query", db, "--count"], expect=1)
+        check("corrupt" in result.stderr,
+              f"no error for an out-of-range value in {name}", result.stderr)
+    passed("out-of-range kinds and column ids are rejected")
+
+
+if __name__ == "__main__":
+    (remarkdb,) = usage(["aion-remarkdb"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_round_trip(remarkdb, tmp)
+        check_filters(remarkdb, tmp)
+        check_rejects_corrupt(remarkdb, tmp)
+    sys.exit(0)
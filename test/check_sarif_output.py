@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+import sys
+
+from testlib import KERNELS, check, load_json, passed, run, usage
+
+LEVELS = {"error", "warning", "note"}
+
+
+def check_log(opt_debugger):
+    out = run([opt_debugger, *KERNELS, "--sarif=-"]).stdout
+    log = load_json(out, "--sarif=- output")
+    check(log["version"] == "2.1.0", "not a SARIF 2.1.0 log", out)
+    check(len(log["runs"]) == 1, "expected exactly one run", out)
+    run_ = log["runs"][0]
+    rules = run_["tool"]["driver"]["rules"]
+    ids = [r["id"] for r in rules]
+    check(len(ids) == len(set(ids)), "the rule table repeats a rule id", out)
+    check(run_["results"], "the log has no results", out)
+    for result in run_["results"]:
+        index = result["ruleIndex"]
+        check(0 <= index < len(rules) and rules[index]["id"] == result["ruleId"],
+              f"result for {result['ruleId']} points at the wrong rule", out)
+        check(result["level"] in LEVELS, "invalid result level", out)
+        check(result["message"]["text"], "result without a message", out)
+    for rule in rules:
+        check(rule["defaultConfiguration"]["level"] in LEVELS,
+              f"invalid default level for {rule['id']}", out)
+    passed("the SARIF log is well formed")
+    return rules, run_["results"]
+
+
+def check_rule_text_is_shared(rules, results):
+    fallback = [r for r in rules if r["id"] == "fallback/custom-pass/Unhandled"]
+    check(len(fallback) == 1, "the fallback rule is missing")
+    rule = fallback[0]
+    described = (rule["shortDescription"]["text"] +
+                 rule["fullDescription"]["text"] +
+                 rule["properties"]["whatOptimizerWanted"])
+    check("raw message about" not in described,
+          "the rule quotes one occurrence's raw message", described)
+    check(rule["defaultConfiguration"]["level"] == "warning",
+          "the fallback rule has the wrong default level")
+    messages = sorted(r["message"]["text"] for r in results
+                      if r["ruleId"] == rule["id"])
+    check(len(messages) == 2 and "first raw message" in messages[0] and
+          "second raw message" in messages[1],
+          "each result should carry its own raw message", str(messages))
+    passed("rules hold pattern text and results hold per-occurrence text")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    rules, results = check_log(opt_debugger)
+    check_rule_text_is_shared(rules, results)
+    sys.exit(0)
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+import os
+import re
+import sys
+import tempfile
+
+from testlib import KERNELS, check, load_json, passed, run, usage
+
+PHASES = {"ParseIR", "ParseRemarks", "DiffModules", "DiffFunction", "Diagnose",
+          "ReportTerminal"}
+FUNCTIONS = {"calls_in_loop", "saxpy", "scale", "use_scale", "log_value"}
+
+
+def check_trace(opt_debugger, tmp):
+    path = os.path.join(tmp, "trace.json")
+    result = run([opt_debugger, *KERNELS, "--self-profile=" + path])
+    with open(path) as f:
+        text = f.read()
+    trace = load_json(text, "--self-profile trace")
+    events = trace["traceEvents"]
+    scopes = [e for e in events if e["ph"] == "X" and e["tid"] == e["pid"]]
+    names = {e["name"] for e in scopes}
+    check(PHASES <= names, "the trace misses a phase",
+          str(sorted(PHASES - names)))
+    for e in scopes:
+        check(e["dur"] >= 0 and e["ts"] >= 0, "malformed complete event",
+              str(e))
+    diffed = {e["args"]["detail"] for e in scopes
+              if e["name"] == "DiffFunction"}
+    check(diffed == FUNCTIONS, "per-function diff events do not name each "
+          "function", str(sorted(diffed)))
+    memory = [e for e in events if e["name"] == "Memory"]
+    check(memory and all(e["ph"] == "C" for e in memory),
+          "no peak RSS counter", text)
+    peak = trace["otherData"]["peak_rss_kb"]
+    check(peak > 0 and all(e["args"]["peak_rss_kb"] <= peak for e in memory),
+          "otherData does not hold the final peak RSS", text)
+    passed("the trace holds every phase, each diffed function and peak RSS")
+    return result.stderr
+
+
+def check_summary(stderr):
+    check("=== Self Profile ===" in stderr, "no summary table", stderr)
+    rows = dict(re.findall(r"^(\w+)\s+(\d+)\s+[\d.]+\s+[\d.]+\s+[\d.]+$",
+                           stderr, re.M))
+    check(PHASES <= set(rows), "the summary misses a phase", stderr)
+    check(rows["DiffFunction"] == str(len(FUNCTIONS)),
+          "DiffFunction was not counted once per function", stderr)
+    check(re.search(r"^Peak RSS: \d+ KB$", stderr, re.M),
+          "the summary has no peak RSS", stderr)
+    passed("the summary table counts each phase")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_summary(check_trace(opt_debugger, tmp))
+    sys.exit(0)
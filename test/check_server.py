@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+import os
+import socket
+import stat
+import subprocess
+import sys
+import tempfile
+import time
+
+from testlib import KERNELS, check, fail, load_json, passed, run, usage
+
+
+def start_server(opt_debugger, sock):
+    server = subprocess.Popen([opt_debugger, "--serve=" + sock,
+                               "--serve-idle-timeout=1", "--jobs=1"])
+    for _ in range(100):
+        probe = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            probe.connect(sock)
+            return server
+        except OSError:
+            time.sleep(0.05)
+        finally:
+            probe.close()
+    server.kill()
+    fail("the server never created its socket")
+
+
+def check_socket_mode(sock):
+    mode = stat.S_IMODE(os.stat(sock).st_mode)
+    check(mode == 0o600, f"the socket is {oct(mode)}, expected 0o600")
+    passed("only the owner can connect to the socket")
+
+
+def check_idle_connection_closed(sock):
+    client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    client.settimeout(10)
+    client.connect(sock)
+    start = time.monotonic()
+    try:
+        data = client.recv(1)
+    except socket.timeout:
+        fail("the server kept an idle connection open")
+    finally:
+        client.close()
+    check(data == b"", "the server replied to an empty request")
+    check(time.monotonic() - start < 5, "the idle timeout was not applied")
+    passed("an idle connection is closed")
+
+
+def check_summary_only(opt_debugger, sock):
+    out = run([opt_debugger, "--connect=" + sock, *KERNELS, "--summary-only",
+               "--json=-", "--json-format=json"]).stdout
+    doc = load_json(out, "--connect --summary-only output")
+    check(doc["diagnostics"], "the summary has no diagnostics", out)
+    check(not doc["functions"], "summary_only kept the IR diffs", out)
+    check(all(not d.get("suggestions") for d in doc["diagnostics"]),
+          "summary_only kept the suggestions", out)
+    passed("summary_only trims the JSON report")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        sock = os.path.join(tmp, "aion.sock")
+        server = start_server(opt_debugger, sock)
+        try:
+            check_socket_mode(sock)
+            check_idle_connection_closed(sock)
+            check_summary_only(opt_debugger, sock)
+            run([opt_debugger, "--connect=" + sock, "--stop-server"])
+            server.wait(timeout=30)
+        finally:
+            if server.poll() is None:
+                server.kill()
+    sys.exit(0)
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+import os
+import struct
+import sys
+import tempfile
+
+from testlib import KERNELS, check, load_json, passed, run, usage
+
+REPORT = ["--no-color", "--json=-", "--json-format=json"]
+
+
+def check_round_trip(opt_debugger, tmp):
+    snapshot = os.path.join(tmp, "kernels.aion")
+    fresh = run([opt_debugger, *KERNELS, *REPORT[1:],
+                 "--save-session=" + snapshot]).stdout
+    check(os.path.exists(snapshot), "--save-session wrote no snapshot")
+    loaded = run([opt_debugger, "--load-session=" + snapshot, *REPORT]).stdout
+    fresh = load_json(fresh, "fresh report")
+    loaded = load_json(loaded, "report from the snapshot")
+    for key in ("diagnostics", "functions", "summary"):
+        check(fresh[key] == loaded[key],
+              f"the snapshot's {key} differ from the fresh run")
+    check(any(d["has_ir_diff"] for d in loaded["diagnostics"]),
+          "no loaded diagnostic kept its IR diff")
+    passed("a loaded snapshot renders the same report")
+    return snapshot
+
+
+def check_shared_diffs(opt_debugger, snapshot):
+    out = run([opt_debugger, "--load-session=" + snapshot,
+               "--no-color"]).stdout
+    check(out.count("IR DIFF for @calls_in_loop") == 3,
+          "every @calls_in_loop diagnostic should show the shared diff", out)
+    passed("diagnostics of one function share a diff after loading")
+
+
+def check_rejects_garbage(opt_debugger, tmp):
+    bogus = os.path.join(tmp, "bogus.aion")
+    with open(bogus, "wb") as f:
+        f.write(b"AIONSESS" + b"\xff" * 40)
+    result = run([opt_debugger, "--load-session=" + bogus, "--no-color"],
+                 expect=1)
+    check("session" in result.stderr, "no error for a corrupt snapshot",
+          result.stderr)
+    passed("a corrupt snapshot is rejected")
+
+
+def check_rejects_bad_severity(opt_debugger, snapshot, tmp):
+    with open(snapshot, "rb") as f:
+        data = bytearray(f.read())
+    (num_sections,) = struct.unpack_from("<I", data, 12)
+    for i in range(num_sections):
+        kind, _, offset, count = struct.unpack_from("<IIQQ", data, 32 + 24 * i)
+        if kind == 8:
+            check(count > 0, "the snapshot has no diagnostics")
+            # the first byte of a diagnostic record is its severity
+            data[offset] = 0xff
+            break
+    else:
+        check(False, "the snapshot has no diagnostics section")
+    flipped = os.path.join(tmp, "flipped.aion")
+    with open(flipped, "wb") as f:
+        f.write(data)
+    result = run([opt_debugger, "--load-session=" + flipped, "--no-color"],
+                 expect=1)
+    check("out-of-range" in result.stderr,
+          "no error for an out-of-range severity", result.stderr)
+    passed("an out-of-range severity byte is rejected")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        snapshot = check_round_trip(opt_debugger, tmp)
+        check_shared_diffs(opt_debugger, snapshot)
+        check_rejects_garbage(opt_debugger, tmp)
+        check_rejects_bad_severity(opt_debugger, snapshot, tmp)
+    sys.exit(0)
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+import os
+import sys
+import tempfile
+
+from testlib import KERNELS, check, load_json, passed, run, usage
+
+PATTERN = """\
+[pattern]
+pass = inline
+remark = NeverInline
+severity = medium
+short = Template check
+explanation = unused
+root-cause = {Callee} into {Caller} in {FunctionName}: {Reason}.
+wanted = {Nope} {} {Callee
+"""
+
+# one placeholder more than a template can hold
+CAPPED = " ".join(["{Callee}"] * 9)
+
+
+def write_pattern(tmp, wanted):
+    path = os.path.join(tmp, "templates.aionpat")
+    with open(path, "w") as f:
+        f.write(PATTERN if wanted is None else
+                PATTERN.replace("wanted = {Nope} {} {Callee",
+                                "wanted = " + wanted))
+    return path
+
+
+def intents(opt_debugger, tmp):
+    path = write_pattern(tmp, None)
+    out = run([opt_debugger, *KERNELS, "--patterns=" + path, "--json=-",
+               "--json-format=json"]).stdout
+    doc = load_json(out, "--json-format=json output")
+    hits = [d for d in doc["diagnostics"] if d["reason"] == "Template check"]
+    check(len(hits) == 1, "the template pattern did not match", out)
+    return hits[0], out
+
+
+def check_placeholders(opt_debugger, tmp):
+    diag, out = intents(opt_debugger, tmp)
+    check(diag["root_cause"] ==
+          "scale into use_scale in use_scale: noinline function attribute.",
+          "argument and FunctionName placeholders were not filled in", out)
+    check(diag["optimizer_intent"] == "{Nope} {} {Callee",
+          "unknown, empty or unterminated placeholders were not kept", out)
+    passed("placeholders are filled in and anything else is kept as written")
+
+
+def check_cap(opt_debugger, tmp):
+    path = write_pattern(tmp, CAPPED)
+    stderr = run([opt_debugger, *KERNELS, "--patterns=" + path],
+                 expect=1).stderr
+    check("more than 8 placeholders" in stderr,
+          "a template over the placeholder cap was accepted", stderr)
+    passed("a custom template with more than eight placeholders is rejected")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        check_placeholders(opt_debugger, tmp)
+        check_cap(opt_debugger, tmp)
+    sys.exit(0)
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+import os
+import sys
+import tempfile
+
+from testlib import check, passed, run, usage
+
+# no loops, so the pipeline run per trial stays small
+IR = """\
+define internal i32 @scale(i32 %v) noinline {
+entry:
+  %m = mul i32 %v, 3
+  ret i32 %m
+}
+
+define i32 @use_scale(i32 %v) {
+entry:
+  %r = call i32 @scale(i32 %v)
+  ret i32 %r
+}
+"""
+
+REMARK = """\
+--- !Missed
+Pass:            inline
+Name:            {name}
+Function:        use_scale
+Args:
+  - String:          ''''
+  - Callee:          scale
+  - String:          ''' not inlined into '''
+  - Caller:          use_scale
+  - String:          ''': '
+  - Reason:          noinline function attribute
+...
+"""
+
+PATTERN = """\
+[pattern]
+id = team/inline/noinline
+pass = inline
+remark = NeverInline
+short = Callee is noinline
+explanation = The callee of {FunctionName} is marked noinline.
+fix = Consider alwaysinline on the callee.
+"""
+
+
+def write(tmp, name, text):
+    path = os.path.join(tmp, name)
+    with open(path, "w") as f:
+        f.write(text)
+    return path
+
+
+def what_if(opt_debugger, ir, remarks, *extra):
+    out = run([opt_debugger, ir, "--remarks=" + remarks, "--what-if",
+               "--no-color", *extra]).stdout
+    check("=== What-If Experiments ===" in out, "no what-if section", out)
+    return out[out.index("=== What-If Experiments ==="):]
+
+
+def check_builtin_edit(opt_debugger, ir, tmp):
+    remarks = write(tmp, "builtin.opt.yaml", REMARK.format(name="NotInlined"))
+    out = what_if(opt_debugger, ir, remarks)
+    check("no noinline on @scale" in out and "flipped" in out,
+          "the built-in noinline fix did not run its edit", out)
+    check("1 of 1 missed remarks flip" in out, "the remark did not flip", out)
+    passed("a built-in fix runs the edit it is tagged with")
+
+
+def check_custom_edit(opt_debugger, ir, tmp):
+    remarks = write(tmp, "custom.opt.yaml", REMARK.format(name="NeverInline"))
+    untagged = write(tmp, "untagged.aionpat", PATTERN)
+    out = what_if(opt_debugger, ir, remarks, "--patterns=" + untagged)
+    check("No missed remarks with a suggestion that has an IR equivalent" in out,
+          "a fix without fix-edit was tried because of its wording", out)
+    tagged = write(tmp, "tagged.aionpat", PATTERN + "fix-edit = alwaysinline\n")
+    out = what_if(opt_debugger, ir, remarks, "--patterns=" + tagged)
+    check("alwaysinline on @scale" in out and "flipped" in out,
+          "the custom fix-edit was not tried", out)
+    check("no noinline" not in out, "an untagged edit was tried", out)
+    passed("fix-edit picks the edit of a custom fix")
+
+
+def check_errors(opt_debugger, ir, tmp):
+    remarks = write(tmp, "errors.opt.yaml", REMARK.format(name="NeverInline"))
+    cases = {
+        "orphan.aionpat": ("[pattern]\npass = inline\nshort = x\n"
+                           "fix-edit = noalias\n", "must follow a 'fix'"),
+        "unknown.aionpat": ("[pattern]\npass = inline\nshort = x\nfix = y\n"
+                            "fix-edit = magic\n", "unknown fix edit 'magic'"),
+    }
+    for name, (text, message) in cases.items():
+        path = write(tmp, name, text)
+        result = run([opt_debugger, ir, "--remarks=" + remarks,
+                      "--patterns=" + path], expect=1)
+        check(message in result.stderr, f"{name} was not rejected", result.stderr)
+    passed("a fix-edit without a fix or with an unknown name is rejected")
+
+
+if __name__ == "__main__":
+    (opt_debugger,) = usage(["opt-debugger"])
+    with tempfile.TemporaryDirectory() as tmp:
+        ir = write(tmp, "scale.ll", IR)
+        check_builtin_edit(opt_debugger, ir, tmp)
+        check_custom_edit(opt_debugger, ir, tmp)
+        check_errors(opt_debugger, ir, tmp)
+    sys.exit(0)
@@ -0,0 +1,117 @@
+; ModuleID = 'kernels.c'
+source_filename = "kernels.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare void @log_value(i32)
+
+; for (i = 0; i < n; ++i) log_value(a[i]);
+define void @calls_in_loop(ptr %a, i32 %n) !dbg !8 {
+entry:
+  %cmp = icmp sgt i32 %n, 0, !dbg !11
+  br i1 %cmp, label %loop, label %exit, !dbg !11
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %idx = sext i32 %i to i64, !dbg !12
+  %p = getelementptr inbounds i32, ptr %a, i64 %idx, !dbg !12
+  %v = load i32, ptr %p, align 4, !dbg !12
+  call void @log_value(i32 %v), !dbg !12
+  %i.next = add nsw i32 %i, 1, !dbg !13
+  %c = icmp slt i32 %i.next, %n, !dbg !13
+  br i1 %c, label %loop, label %exit, !dbg !13, !llvm.loop !14
+
+exit:
+  ret void, !dbg !16
+}
+
+; for (i = 0; i < n; ++i) y[i] += k * x[i]; four lanes at a time, then a
+; scalar remainder
+define void @saxpy(ptr %y, ptr %x, float %k, i32 %n) !dbg !17 {
+entry:
+  %cmp = icmp sgt i32 %n, 0, !dbg !18
+  br i1 %cmp, label %vector.ph, label %exit, !dbg !18
+
+vector.ph:
+  %wide.n = zext i32 %n to i64, !dbg !18
+  %n.vec = and i64 %wide.n, 4294967292, !dbg !18
+  %k.ins = insertelement <4 x float> poison, float %k, i64 0, !dbg !19
+  %k.splat = shufflevector <4 x float> %k.ins, <4 x float> poison, <4 x i32> zeroinitializer, !dbg !19
+  %has.vec = icmp ne i64 %n.vec, 0, !dbg !18
+  br i1 %has.vec, label %vector.body, label %remainder, !dbg !18
+
+vector.body:
+  %vi = phi i64 [ 0, %vector.ph ], [ %vi.next, %vector.body ]
+  %vpx = getelementptr inbounds float, ptr %x, i64 %vi, !dbg !19
+  %vvx = load <4 x float>, ptr %vpx, align 4, !dbg !19
+  %vm = fmul fast <4 x float> %vvx, %k.splat, !dbg !19
+  %vpy = getelementptr inbounds float, ptr %y, i64 %vi, !dbg !19
+  %vvy = load <4 x float>, ptr %vpy, align 4, !dbg !19
+  %vs = fadd fast <4 x float> %vvy, %vm, !dbg !19
+  store <4 x float> %vs, ptr %vpy, align 4, !dbg !19
+  %vi.next = add nuw i64 %vi, 4, !dbg !20
+  %vc = icmp ult i64 %vi.next, %n.vec, !dbg !20
+  br i1 %vc, label %vector.body, label %remainder, !dbg !20, !llvm.loop !21
+
+remainder:
+  %done = icmp eq i64 %n.vec, %wide.n, !dbg !18
+  br i1 %done, label %exit, label %loop, !dbg !18
+
+loop:
+  %i = phi i64 [ %i.next, %loop ], [ %n.vec, %remainder ]
+  %px = getelementptr inbounds float, ptr %x, i64 %i, !dbg !19
+  %vx = load float, ptr %px, align 4, !dbg !19
+  %m = fmul fast float %vx, %k, !dbg !19
+  %py = getelementptr inbounds float, ptr %y, i64 %i, !dbg !19
+  %vy = load float, ptr %py, align 4, !dbg !19
+  %s = fadd fast float %vy, %m, !dbg !19
+  store float %s, ptr %py, align 4, !dbg !19
+  %i.next = add nuw nsw i64 %i, 1, !dbg !20
+  %c = icmp ult i64 %i.next, %wide.n, !dbg !20
+  br i1 %c, label %loop, label %exit, !dbg !20, !llvm.loop !27
+
+exit:
+  ret void, !dbg !22
+}
+
+; a callee marked noinline; its call site is a missed inlining
+define internal i32 @scale(i32 %v) noinline !dbg !23 {
+entry:
+  %m = mul nsw i32 %v, 7, !dbg !24
+  %r = add nsw i32 %m, 3, !dbg !24
+  ret i32 %r, !dbg !24
+}
+
+define i32 @use_scale(i32 %v) !dbg !25 {
+entry:
+  %r = call i32 @scale(i32 %v), !dbg !26
+  ret i32 %r, !dbg !26
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3, !4}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: true, runtimeVersion: 0, emissionKind: LineTablesOnly)
+!1 = !DIFile(filename: "kernels.c", directory: "/src")
+!2 = !{}
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!4 = !{i32 7, !"Dwarf Version", i32 5}
+!5 = !DISubroutineType(types: !2)
+!8 = distinct !DISubprogram(name: "calls_in_loop", scope: !1, file: !1, line: 3, type: !5, scopeLine: 3, spFlags: DISPFlagDefinition | DISPFlagOptimized, unit: !0)
+!11 = !DILocation(line: 4, column: 3, scope: !8)
+!12 = !DILocation(line: 5, column: 5, scope: !8)
+!13 = !DILocation(line: 4, column: 27, scope: !8)
+!14 = distinct !{!14, !11, !15}
+!15 = !DILocation(line: 5, column: 22, scope: !8)
+!16 = !DILocation(line: 6, column: 1, scope: !8)
+!17 = distinct !DISubprogram(name: "saxpy", scope: !1, file: !1, line: 8, type: !5, scopeLine: 8, spFlags: DISPFlagDefinition | DISPFlagOptimized, unit: !0)
+!18 = !DILocation(line: 9, column: 3, scope: !17)
+!19 = !DILocation(line: 10, column: 10, scope: !17)
+!20 = !DILocation(line: 9, column: 27, scope: !17)
+!21 = distinct !{!21, !18, !19}
+!22 = !DILocation(line: 11, column: 1, scope: !17)
+!23 = distinct !DISubprogram(name: "scale", scope: !1, file: !1, line: 13, type: !5, scopeLine: 13, spFlags: DISPFlagDefinition | DISPFlagOptimized | DISPFlagLocalToUnit, unit: !0)
+!24 = !DILocation(line: 14, column: 3, scope: !23)
+!25 = distinct !DISubprogram(name: "use_scale", scope: !1, file: !1, line: 17, type: !5, scopeLine: 17, spFlags: DISPFlagDefinition | DISPFlagOptimized, unit: !0)
+!26 = !DILocation(line: 18, column: 10, scope: !25)
+!27 = distinct !{!27, !18, !19}
@@ -0,0 +1,19 @@
+void log_value(int);
+
+void calls_in_loop(int *a, int n) {
+  for (int i = 0; i < n; ++i)
+    log_value(a[i]);
+}
+
+void saxpy(float *y, const float *x, float k, int n) {
+  for (int i = 0; i < n; ++i)
+    y[i] += k * x[i];
+}
+
+static __attribute__((noinline)) int scale(int v) {
+  return v * 7 + 3;
+}
+
+int use_scale(int v) {
+  return scale(v);
+}
@@ -0,0 +1,67 @@
+"""Helpers shared by the check_*.py scripts."""
+import json
+import os
+import subprocess
+import sys
+
+TEST_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def fixture(*parts):
+    return os.path.join(TEST_DIR, "fixtures", *parts)
+
+
+# the before/after/remarks triple most checks analyze
+KERNELS = [
+    "--before=" + fixture("kernels.ll"),
+    "--after=" + fixture("kernels.O2.ll"),
+    "--remarks=" + fixture("kernels.opt.yaml"),
+    "--no-color",
+]
+
+
+def fail(message, output=None):
+    print(f"[!] FAIL: {message}")
+    if output:
+        print("--- OUTPUT START ---")
+        print(output)
+        print("--- OUTPUT END ---")
+    sys.exit(1)
+
+
+def check(condition, message, output=None):
+    if not condition:
+        fail(message, output)
+
+
+def run(cmd, expect=0, stdin=None, timeout=120):
+    """Runs cmd and fails the check unless it exits with expect."""
+    print("[*] " + " ".join(cmd))
+    try:
+        result = subprocess.run(cmd, capture_output=True, text=True,
+                                input=stdin, timeout=timeout)
+    except subprocess.TimeoutExpired:
+        fail(f"timed out after {timeout}s")
+    if expect is not None and result.returncode != expect:
+        fail(f"exit code {result.returncode}, expected {expect}",
+             result.stdout + result.stderr)
+    return result
+
+
+def load_json(text, what):
+    try:
+        return json.loads(text)
+    except json.JSONDecodeError as e:
+        fail(f"{what} is not valid JSON: {e}", text)
+
+
+def usage(args):
+    if len(sys.argv) < 1 + len(args):
+        print(f"Usage: {os.path.basename(sys.argv[0])} " +
+              " ".join(f"<{a}>" for a in args))
+        sys.exit(1)
+    return sys.argv[1:1 + len(args)]
+
+
+def passed(message):
+    print(f"[+] PASS: {message}")
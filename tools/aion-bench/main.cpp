@@ -0,0 +1,377 @@
+#include "OptDebugger/DiagnosticEngine.h"
+#include "OptDebugger/IRDiff.h"
+#include "OptDebugger/OptReport.h"
+#include "OptDebugger/PassAnalyzer.h"
+#include "OptDebugger/Support.h"
+#include "OptDebugger/SyntheticCorpus.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+using namespace llvm;
+using namespace optdbg;
+
+static cl::OptionCategory BenchCategory("aion-bench options");
+
+static cl::opt<unsigned> NumFunctions(
+    "functions", cl::init(200),
+    cl::desc("Functions per generated module"),
+    cl::cat(BenchCategory));
+
+static cl::opt<unsigned> NumBlocks(
+    "blocks", cl::init(8),
+    cl::desc("Basic blocks per generated function"),
+    cl::cat(BenchCategory));
+
+static cl::opt<unsigned> NumInstructions(
+    "instructions", cl::init(32),
+    cl::desc("Instructions per generated basic block"),
+    cl::cat(BenchCategory));
+
+static cl::opt<unsigned> ChangedPercent(
+    "changed-percent", cl::init(20),
+    cl::desc("Percentage of functions that differ between before and after"),
+    cl::cat(BenchCategory));
+
+static cl::opt<unsigned> NumRemarks(
+    "remarks", cl::init(20000),
+    cl::desc("Remark records in the generated YAML"),
+    cl::cat(BenchCategory));
+
+static cl::opt<uint64_t> Seed(
+    "seed", cl::init(1),
+    cl::desc("Seed for the input generator"),
+    cl::cat(BenchCategory));
+
+static cl::opt<unsigned> Repetitions(
+    "repeat", cl::init(5),
+    cl::desc("Timed runs per benchmark after one warm-up run"),
+    cl::cat(BenchCategory));
+
+static cl::list<std::string> Filter(
+    "filter", cl::CommaSeparated,
+    cl::desc("Only run benchmarks whose name contains one of these strings"),
+    cl::cat(BenchCategory));
+
+static cl::opt<std::string> JSONOutput(
+    "json",
+    cl::desc("Write machine-readable results to this file ('-' for stdout)"),
+    cl::value_desc("results.json"),
+    cl::cat(BenchCategory));
+
+namespace {
+
+struct BenchResult {
+  std::string Name;
+  std::string Unit;       // what one item is: remark, instruction, ...
+  uint64_t    Items = 0;  // items processed per run
+  double      MedianMs = 0;
+  double      MinMs    = 0;
+  uint64_t    PeakRSSKB = 0;
+
+  double itemsPerSecond() const {
+    return MedianMs > 0 ? Items / (MedianMs / 1000.0) : 0;
+  }
+};
+
+// Linux resets the VmHWM high-water mark when "5" is written to clear_refs;
+// elsewhere the process-wide peak from getrusage is reported instead
+void resetPeakRSS() {
+  std::ofstream ClearRefs("/proc/self/clear_refs");
+  if (ClearRefs)
+    ClearRefs << "5";
+}
+
+uint64_t readPeakRSSKB() {
+  std::ifstream Status("/proc/self/status");
+  std::string Line;
+  while (std::getline(Status, Line))
+    if (StringRef(Line).starts_with("VmHWM:")) {
+      uint64_t KB = 0;
+      if (!StringRef(Line).drop_front(6).trim().split(' ').first.getAsInteger(10, KB))
+        return KB;
+    }
+  struct rusage RU;
+  ::getrusage(RUSAGE_SELF, &RU);
+  return static_cast<uint64_t>(RU.ru_maxrss);
+}
+
+bool selected(StringRef Name) {
+  if (Filter.empty())
+    return true;
+  return llvm::any_of(Filter, [&](const std::string &F) { return Name.contains(F); });
+}
+
+// one warm-up run, then Repetitions timed runs; Run returns the item count
+BenchResult measure(StringRef Name, StringRef Unit,
+                    const std::function<uint64_t()> &Run) {
+  BenchResult R;
+  R.Name = Name.str();
+  R.Unit = Unit.str();
+
+  resetPeakRSS();
+  R.Items = Run();
+
+  std::vector<double> Times;
+  for (unsigned I = 0; I < std::max(1u, unsigned(Repetitions)); ++I) {
+    auto Start = std::chrono::steady_clock::now();
+    Run();
+    Times.push_back(std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - Start)
+                        .count());
+  }
+  R.PeakRSSKB = readPeakRSSKB();
+
+  std::sort(Times.begin(), Times.end());
+  R.MinMs    = Times.front();
+  R.MedianMs = Times[Times.size() / 2];
+  return R;
+}
+
+Expected<std::string> writeTempFile(StringRef Prefix, StringRef Suffix,
+                                    function_ref<void(raw_ostream &)> Body) {
+  SmallString<128> Path;
+  int FD;
+  if (std::error_code EC = sys::fs::createTemporaryFile(Prefix, Suffix, FD, Path))
+    return makeStringError("Cannot create temporary file: " + EC.message());
+  raw_fd_ostream OS(FD, /*shouldClose=*/true);
+  Body(OS);
+  return std::string(Path);
+}
+
+std::unique_ptr<Module> parseModule(StringRef IR, LLVMContext &Ctx) {
+  SMDiagnostic Err;
+  auto M = parseAssemblyString(IR, Err, Ctx);
+  if (!M)
+    Err.print("aion-bench", errs());
+  return M;
+}
+
+uint64_t countInstructions(const Module &M) {
+  uint64_t N = 0;
+  for (const Function &F : M)
+    N += F.getInstructionCount();
+  return N;
+}
+
+void printResults(const std::vector<BenchResult> &Results, raw_ostream &OS) {
+  OS << left_justify("benchmark", 22) << right_justify("items", 13)
+     << right_justify("median ms", 13) << right_justify("min ms", 13)
+     << right_justify("items/s", 17) << right_justify("peak RSS KB", 13) << "\n";
+  for (const BenchResult &R : Results)
+    OS << format("%-22s %12llu %12.2f %12.2f %16.0f %12llu\n", R.Name.c_str(),
+                 static_cast<unsigned long long>(R.Items), R.MedianMs, R.MinMs,
+                 R.itemsPerSecond(), static_cast<unsigned long long>(R.PeakRSSKB));
+}
+
+void writeResultsJSON(const std::vector<BenchResult> &Results,
+                      const CorpusConfig &C, raw_ostream &OS) {
+  json::OStream J(OS, 2);
+  J.object([&] {
+    J.attribute("tool", std::string("Aion ") + AionVersion);
+    J.attributeObject("config", [&] {
+      J.attribute("functions", int64_t(C.Functions));
+      J.attribute("blocks", int64_t(C.BlocksPerFunction));
+      J.attribute("instructions", int64_t(C.InstructionsPerBlock));
+      J.attribute("changed_percent", int64_t(C.ChangedPercent));
+      J.attribute("remarks", int64_t(C.RemarkCount));
+      J.attribute("seed", int64_t(C.Seed));
+      J.attribute("repeat", int64_t(Repetitions));
+    });
+    J.attributeArray("results", [&] {
+      for (const BenchResult &R : Results)
+        J.object([&] {
+          J.attribute("name", R.Name);
+          J.attribute("unit", R.Unit);
+          J.attribute("items", int64_t(R.Items));
+          J.attribute("median_ms", R.MedianMs);
+          J.attribute("min_ms", R.MinMs);
+          J.attribute("items_per_second", R.itemsPerSecond());
+          J.attribute("peak_rss_kb", int64_t(R.PeakRSSKB));
+        });
+    });
+  });
+  OS << "\n";
+}
+
+}
+
+// entry point for the aion-bench executable
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::HideUnrelatedOptions(BenchCategory);
+  cl::ParseCommandLineOptions(
+      argc, argv,
+      "aion-bench: throughput and memory benchmarks for each Aion stage\n\n"
+      "Inputs are generated from the size options, so a given command line\n"
+      "always measures the same work.\n\n"
+      "Examples:\n"
+      "  aion-bench\n"
+      "  aion-bench --remarks=200000 --filter=yaml,match\n"
+      "  aion-bench --functions=2000 --json=results.json\n");
+
+  CorpusConfig C;
+  C.Functions            = NumFunctions;
+  C.BlocksPerFunction    = NumBlocks;
+  C.InstructionsPerBlock = NumInstructions;
+  C.ChangedPercent       = ChangedPercent;
+  C.RemarkCount          = NumRemarks;
+  C.Seed                 = Seed;
+
+  std::string BeforeIR, AfterIR;
+  {
+    raw_string_ostream B(BeforeIR), A(AfterIR);
+    writeSyntheticModule(C, /*After=*/false, B);
+    writeSyntheticModule(C, /*After=*/true, A);
+  }
+  auto YAMLPathOrErr = writeTempFile("aion-bench", "opt.yaml", [&](raw_ostream &OS) {
+    writeSyntheticRemarks(C, OS);
+  });
+  if (!YAMLPathOrErr) {
+    WithColor::error(errs(), "aion-bench") << toString(YAMLPathOrErr.takeError()) << "\n";
+    return 1;
+  }
+  std::string YAMLPath = *YAMLPathOrErr;
+
+  LLVMContext BeforeCtx, AfterCtx;
+  auto Before = parseModule(BeforeIR, BeforeCtx);
+  auto After  = parseModule(AfterIR, AfterCtx);
+  auto RemarksOrErr = PassAnalyzer::parseRemarksYAML(YAMLPath);
+  if (!Before || !After || !RemarksOrErr) {
+    if (!RemarksOrErr)
+      WithColor::error(errs(), "aion-bench") << toString(RemarksOrErr.takeError()) << "\n";
+    sys::fs::remove(YAMLPath);
+    return 1;
+  }
+
+  IRDiffEngine     DiffEngine;
+  DiagnosticEngine DiagEngine;
+
+  AnalysisSession Session;
+  Session.PassPipelineUsed = "synthetic";
+  Session.Remarks          = std::move(*RemarksOrErr);
+  Session.Diff             = DiffEngine.diff(*Before, *After);
+  Session.Diagnostics      = DiagEngine.analyze(Session.Remarks, Session.Diff);
+
+  ReportConfig RCfg;
+  RCfg.UseColor = false;
+
+  std::vector<BenchResult> Results;
+  auto Run = [&](StringRef Name, StringRef Unit,
+                 const std::function<uint64_t()> &Body) {
+    if (!selected(Name))
+      return;
+    errs() << "running " << Name << "...\n";
+    Results.push_back(measure(Name, Unit, Body));
+  };
+
+  Run("yaml-parse", "remark", [&] {
+    auto R = PassAnalyzer::parseRemarksYAML(YAMLPath);
+    if (!R) {
+      consumeError(R.takeError());
+      return uint64_t(0);
+    }
+    return uint64_t(R->size());
+  });
+
+  Run("ir-parse", "instruction", [&] {
+    LLVMContext Ctx;
+    auto M = parseModule(BeforeIR, Ctx);
+    return M ? countInstructions(*M) : 0;
+  });
+
+  Run("ir-diff", "instruction", [&] {
+    ModuleDiff D = DiffEngine.diff(*Before, *After);
+    return D.TotalBeforeInstructions + D.TotalAfterInstructions;
+  });
+
+  Run("pattern-match", "remark", [&] {
+    std::vector<DiagnosticResult> D =
+        DiagEngine.analyze(Session.Remarks, ModuleDiff{});
+    return uint64_t(Session.Remarks.size());
+  });
+
+  Run("report-terminal", "diagnostic", [&] {
+    raw_null_ostream Null;
+    TerminalReporter(Null, RCfg).report(Session);
+    return uint64_t(Session.Diagnostics.size());
+  });
+
+  Run("report-json", "diagnostic", [&] {
+    raw_null_ostream Null;
+    JSONReporter(Null, JSONFormat::NDJSON).report(Session, RCfg);
+    return uint64_t(Session.Diagnostics.size());
+  });
+
+  Run("report-sarif", "diagnostic", [&] {
+    raw_null_ostream Null;
+    SARIFReporter(Null).report(Session, RCfg);
+    return uint64_t(Session.Diagnostics.size());
+  });
+
+  Run("report-html", "diagnostic", [&] {
+    raw_null_ostream Null;
+    HTMLReporter(Null).report(Session, RCfg);
+    return uint64_t(Session.Diagnostics.size());
+  });
+
+  // macro benchmark: diff, remark import and diagnosis of a before/after
+  // pair as --before/--after runs it, minus the file reads
+  Run("end-to-end", "remark", [&] {
+    PassAnalyzer Analyzer;
+    auto BCtx = std::make_unique<LLVMContext>();
+    auto ACtx = std::make_unique<LLVMContext>();
+    auto B = parseModule(BeforeIR, *BCtx);
+    auto A = parseModule(AfterIR, *ACtx);
+    auto R = PassAnalyzer::parseRemarksYAML(YAMLPath);
+    if (!B || !A || !R) {
+      if (!R)
+        consumeError(R.takeError());
+      return uint64_t(0);
+    }
+    uint64_t N = R->size();
+    auto S = Analyzer.runFromModules(std::move(B), std::move(A), std::move(*R));
+    if (!S)
+      consumeError(S.takeError());
+    return N;
+  });
+
+  sys::fs::remove(YAMLPath);
+
+  // the table moves to stderr when stdout carries the JSON
+  printResults(Results, JSONOutput == "-" ? errs() : outs());
+
+  if (JSONOutput == "-") {
+    writeResultsJSON(Results, C, outs());
+  } else if (!JSONOutput.empty()) {
+    std::error_code EC;
+    raw_fd_ostream OS(JSONOutput, EC, sys::fs::OF_Text);
+    if (EC) {
+      WithColor::error(errs(), "aion-bench")
+          << "Cannot open '" << JSONOutput << "': " << EC.message() << "\n";
+      return 1;
+    }
+    writeResultsJSON(Results, C, OS);
+  }
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include "OptDebugger/DiagnosticEngine.h"
+#include "OptDebugger/PatternDB.h"
+#include "OptDebugger/Support.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace optdbg;
+
+static cl::SubCommand CompileCmd("compile",
+                                 "Compile pattern sources into an index");
+static cl::SubCommand ListCmd("list",
+                              "List the patterns of a source file or index");
+
+static cl::list<std::string> CompileInputs(
+    cl::Positional, cl::OneOrMore,
+    cl::desc("<pattern files>"),
+    cl::sub(CompileCmd));
+
+static cl::opt<std::string> CompileOutput(
+    "o", cl::Required,
+    cl::desc("Index file to write"),
+    cl::value_desc("patterns.aionpdb"),
+    cl::sub(CompileCmd));
+
+static cl::list<std::string> ListInputs(
+    cl::Positional, cl::OneOrMore,
+    cl::desc("<pattern files or one index>"),
+    cl::sub(ListCmd));
+
+namespace {
+
+int runCompile() {
+  PatternDBCompiler Compiler;
+  for (const std::string &Input : CompileInputs) {
+    if (auto Err = Compiler.addSourceFile(Input)) {
+      WithColor::error(errs(), "aion-patterns") << toString(std::move(Err)) << "\n";
+      return 1;
+    }
+  }
+  if (auto Err = Compiler.write(CompileOutput)) {
+    WithColor::error(errs(), "aion-patterns") << toString(std::move(Err)) << "\n";
+    return 1;
+  }
+  outs() << "Compiled " << Compiler.size() << " patterns from "
+         << CompileInputs.size() << " files into " << CompileOutput << "\n";
+  return 0;
+}
+
+// sources are compiled in memory, so this also checks them for errors
+int runList() {
+  std::vector<std::string> Paths(ListInputs.begin(), ListInputs.end());
+  auto DBOrErr = PatternDB::load(Paths, /*CacheDir=*/"");
+  if (!DBOrErr) {
+    WithColor::error(errs(), "aion-patterns") << toString(DBOrErr.takeError()) << "\n";
+    return 1;
+  }
+  const PatternDB &DB = **DBOrErr;
+  for (uint32_t Id = 0; Id < DB.size(); ++Id) {
+    const OptimizationPattern &P = DB.pattern(Id);
+    outs() << P.ruleID() << " [" << severityToString(P.Severity) << "]";
+    if (!P.PassNameSubstr.empty())
+      outs() << " pass~'" << P.PassNameSubstr << "'";
+    if (!P.RemarkNameSubstr.empty())
+      outs() << " remark~'" << P.RemarkNameSubstr << "'";
+    if (!P.MessageSubstr.empty())
+      outs() << " message~'" << P.MessageSubstr << "'";
+    outs() << "\n    " << P.ShortReason << "\n";
+  }
+  outs() << DB.size() << " patterns, sources " << DB.digest().take_front(16)
+         << "\n";
+  return 0;
+}
+
+}
+
+// entry point for the aion-patterns executable
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(
+      argc, argv,
+      "aion-patterns: compile custom diagnostic patterns for opt-debugger\n\n"
+      "Examples:\n"
+      "  aion-patterns compile team.aionpat -o team.aionpdb\n"
+      "  aion-patterns list team.aionpat\n"
+      "  opt-debugger input.ll --patterns=team.aionpdb\n");
+
+  if (CompileCmd)
+    return runCompile();
+  if (ListCmd)
+    return runList();
+
+  cl::PrintHelpMessage();
+  return 1;
+}
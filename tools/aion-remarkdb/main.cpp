@@ -0,0 +1,246 @@
+#include "OptDebugger/RemarkDB.h"
+#include "OptDebugger/Support.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/WithColor.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace llvm;
+using namespace optdbg;
+
+static cl::SubCommand IngestCmd("ingest",
+                                "Build a remark database from .opt.yaml files");
+static cl::SubCommand QueryCmd("query", "Filter remarks in a database");
+
+static cl::list<std::string> IngestInputs(
+    cl::Positional, cl::OneOrMore,
+    cl::desc("<.opt.yaml files or directories>"),
+    cl::sub(IngestCmd));
+
+static cl::opt<std::string> IngestOutput(
+    "o", cl::Required,
+    cl::desc("Database file to write"),
+    cl::value_desc("remarks.db"),
+    cl::sub(IngestCmd));
+
+static cl::opt<std::string> QueryDB(
+    cl::Positional, cl::Required,
+    cl::desc("<database>"),
+    cl::sub(QueryCmd));
+
+static cl::list<std::string> QueryPasses(
+    "pass", cl::CommaSeparated,
+    cl::desc("Only remarks from these passes (e.g. loop-vectorize)"),
+    cl::sub(QueryCmd));
+
+static cl::list<std::string> QueryNames(
+    "name", cl::CommaSeparated,
+    cl::desc("Only remarks with these remark names"),
+    cl::sub(QueryCmd));
+
+static cl::opt<std::string> QueryFunction(
+    "function",
+    cl::desc("Only remarks in functions matching this regex"),
+    cl::value_desc("regex"),
+    cl::sub(QueryCmd));
+
+static cl::opt<std::string> QueryFile(
+    "file",
+    cl::desc("Only remarks whose source file starts with this prefix"),
+    cl::value_desc("prefix"),
+    cl::sub(QueryCmd));
+
+static cl::list<std::string> QueryKinds(
+    "kind", cl::CommaSeparated,
+    cl::desc("Only these kinds: missed, passed, analysis"),
+    cl::sub(QueryCmd));
+
+static cl::opt<unsigned> QueryLimit(
+    "limit", cl::init(0),
+    cl::desc("Stop after this many matches"),
+    cl::sub(QueryCmd));
+
+static cl::opt<bool> QueryCount(
+    "count", cl::init(false),
+    cl::desc("Print only the number of matches"),
+    cl::sub(QueryCmd));
+
+static cl::opt<bool> QueryJSON(
+    "json", cl::init(false),
+    cl::desc("Print one JSON object per match"),
+    cl::sub(QueryCmd));
+
+namespace {
+
+StringRef kindName(RemarkKind K) {
+  switch (K) {
+  case RemarkKind::Applied:           return "passed";
+  case RemarkKind::Missed:            return "missed";
+  case RemarkKind::Analysis:
+  case RemarkKind::AnalysisAliasing:
+  case RemarkKind::AnalysisFPCommute: return "analysis";
+  }
+  return "analysis";
+}
+
+// expands directories to the .opt.yaml files below them
+Error collectYAMLFiles(StringRef Input, std::vector<std::string> &Out) {
+  if (!sys::fs::is_directory(Input)) {
+    Out.push_back(Input.str());
+    return Error::success();
+  }
+  std::error_code EC;
+  for (sys::fs::recursive_directory_iterator It(Input, EC), End;
+       It != End && !EC; It.increment(EC))
+    if (StringRef(It->path()).ends_with(".opt.yaml"))
+      Out.push_back(It->path());
+  if (EC)
+    return makeStringError("Cannot walk '" + Input + "': " + EC.message());
+  return Error::success();
+}
+
+int runIngest() {
+  std::vector<std::string> Files;
+  for (const std::string &Input : IngestInputs) {
+    if (auto Err = collectYAMLFiles(Input, Files)) {
+      WithColor::error(errs(), "aion-remarkdb") << toString(std::move(Err)) << "\n";
+      return 1;
+    }
+  }
+  std::sort(Files.begin(), Files.end());
+
+  RemarkDBWriter Writer;
+  unsigned Failed = 0;
+  for (const std::string &F : Files) {
+    if (auto Err = Writer.addYAMLFile(F)) {
+      WithColor::warning(errs(), "aion-remarkdb") << toString(std::move(Err)) << "\n";
+      ++Failed;
+    }
+  }
+
+  if (auto Err = Writer.write(IngestOutput)) {
+    WithColor::error(errs(), "aion-remarkdb") << toString(std::move(Err)) << "\n";
+    return 1;
+  }
+  outs() << "Ingested " << Writer.size() << " remarks from "
+         << Files.size() - Failed << " files into " << IngestOutput << "\n";
+  return Failed ? 1 : 0;
+}
+
+int runQuery() {
+  auto Start = std::chrono::steady_clock::now();
+
+  auto DBOrErr = RemarkDB::open(QueryDB);
+  if (!DBOrErr) {
+    WithColor::error(errs(), "aion-remarkdb") << toString(DBOrErr.takeError()) << "\n";
+    return 1;
+  }
+  const RemarkDB &DB = **DBOrErr;
+
+  RemarkQuery Q;
+  Q.Passes.assign(QueryPasses.begin(), QueryPasses.end());
+  Q.Names.assign(QueryNames.begin(), QueryNames.end());
+  Q.FunctionRegex = QueryFunction;
+  Q.FilePrefix    = QueryFile;
+  Q.Limit         = QueryLimit;
+  if (!QueryKinds.empty()) {
+    Q.KindMask = 0;
+    for (StringRef K : QueryKinds) {
+      if (K == "missed")
+        Q.KindMask |= 1u << unsigned(RemarkKind::Missed);
+      else if (K == "passed")
+        Q.KindMask |= 1u << unsigned(RemarkKind::Applied);
+      else if (K == "analysis")
+        Q.KindMask |= (1u << unsigned(RemarkKind::Analysis)) |
+                      (1u << unsigned(RemarkKind::AnalysisAliasing)) |
+                      (1u << unsigned(RemarkKind::AnalysisFPCommute));
+      else {
+        WithColor::error(errs(), "aion-remarkdb")
+            << "unknown remark kind '" << K << "'\n";
+        return 1;
+      }
+    }
+  }
+
+  auto RowsOrErr = DB.query(Q);
+  if (!RowsOrErr) {
+    WithColor::error(errs(), "aion-remarkdb") << toString(RowsOrErr.takeError()) << "\n";
+    return 1;
+  }
+
+  if (QueryCount) {
+    outs() << RowsOrErr->size() << "\n";
+  } else {
+    for (uint32_t Row : *RowsOrErr) {
+      SourceLocation Loc = DB.location(Row);
+      if (QueryJSON) {
+        json::OStream J(outs());
+        J.object([&] {
+          J.attribute("kind", kindName(DB.kind(Row)));
+          J.attribute("pass", DB.value(RemarkColumn::Pass, Row));
+          J.attribute("name", DB.value(RemarkColumn::Name, Row));
+          J.attribute("function", DB.value(RemarkColumn::Function, Row));
+          J.attribute("file", Loc.File);
+          J.attribute("line", static_cast<int64_t>(Loc.Line));
+          J.attribute("column", static_cast<int64_t>(Loc.Column));
+          J.attribute("message", DB.value(RemarkColumn::Message, Row));
+          J.attribute("origin", DB.value(RemarkColumn::Origin, Row));
+          if (std::optional<float> Hot = DB.hotness(Row))
+            J.attribute("hotness", *Hot);
+          J.attributeArray("args", [&] {
+            for (const RemarkArgument &A : DB.args(Row))
+              J.object([&] {
+                J.attribute("key", A.Key);
+                J.attribute("value", A.Value);
+                if (A.Loc.isValid())
+                  J.attribute("loc", A.Loc.format());
+              });
+          });
+        });
+        outs() << "\n";
+        continue;
+      }
+      outs() << Loc.format() << ": " << kindName(DB.kind(Row)) << ": "
+             << DB.value(RemarkColumn::Pass, Row) << "/"
+             << DB.value(RemarkColumn::Name, Row) << " in "
+             << DB.value(RemarkColumn::Function, Row) << ": "
+             << DB.value(RemarkColumn::Message, Row) << "\n";
+    }
+  }
+
+  auto Elapsed = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - Start);
+  errs() << RowsOrErr->size() << " of " << DB.size() << " remarks matched in "
+         << format("%.2f", Elapsed.count()) << " ms\n";
+  return 0;
+}
+
+}
+
+// entry point for the aion-remarkdb executable
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(
+      argc, argv,
+      "aion-remarkdb: build-wide optimization remark database\n\n"
+      "Examples:\n"
+      "  aion-remarkdb ingest -o remarks.db build/\n"
+      "  aion-remarkdb query remarks.db --pass=loop-vectorize --kind=missed "
+      "--file=src/codec/\n"
+      "  aion-remarkdb query remarks.db --function='^decode_' --count\n");
+
+  if (IngestCmd)
+    return runIngest();
+  if (QueryCmd)
+    return runQuery();
+
+  cl::PrintHelpMessage();
+  return 1;
+}
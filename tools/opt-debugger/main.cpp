@@ -1,16 +1,35 @@
+#include "OptDebugger/AnalysisCache.h"
+#include "OptDebugger/AnalysisServer.h"
+#include "OptDebugger/Baseline.h"
+#include "OptDebugger/BatchDriver.h"
+#include "OptDebugger/Bisect.h"
+#include "OptDebugger/InlineCostReport.h"
+#include "OptDebugger/LoopReport.h"
+#include "OptDebugger/MemoryReport.h"
 #include "OptDebugger/OptReport.h"
 #include "OptDebugger/PassAnalyzer.h"
+#include "OptDebugger/PatternDB.h"
+#include "OptDebugger/RemarkCompare.h"
+#include "OptDebugger/SelfProfile.h"
+#include "OptDebugger/SessionIO.h"
 #include "OptDebugger/Support.h"
+#include "OptDebugger/WhatIf.h"
 
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/InitLLVM.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/WithColor.h"
 
+#include <ctime>
+
 using namespace llvm;
 using namespace optdbg;
 
@@ -60,6 +79,218 @@ static cl::opt<std::string> HTMLOutput(
     cl::value_desc("report.html"),
     cl::cat(OptDbgCategory));
 
+static cl::opt<bool> HTMLChunked(
+    "html-chunked",
+    cl::desc("Write --html as a small page plus compressed data chunks that "
+             "are loaded on demand (for very large reports)"),
+    cl::init(false),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> JSONOutput(
+    "json",
+    cl::desc("Stream machine-readable diagnostics, remarks and diffs to this "
+             "file ('-' for stdout, which suppresses the terminal report)"),
+    cl::value_desc("report.json"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<JSONFormat> JSONStyle(
+    "json-format",
+    cl::desc("Layout of the --json output"),
+    cl::values(
+        clEnumValN(JSONFormat::NDJSON, "ndjson",
+                   "One JSON record per line (default)"),
+        clEnumValN(JSONFormat::Document, "json",
+                   "A single JSON document with one array per record kind")),
+    cl::init(JSONFormat::NDJSON),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> SARIFOutput(
+    "sarif",
+    cl::desc("Write a SARIF 2.1.0 log for code-review tooling to this file "
+             "('-' for stdout, which suppresses the terminal report)"),
+    cl::value_desc("report.sarif"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> CacheDir(
+    "cache-dir",
+    cl::desc("Reuse analysis results stored in this directory for identical "
+             "inputs, pipeline and options, and store new results there"),
+    cl::value_desc("dir"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> SaveSession(
+    "save-session",
+    cl::desc("Write the analysis results to a binary session snapshot"),
+    cl::value_desc("file.aion"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> LoadSession(
+    "load-session",
+    cl::desc("Render reports from a session snapshot instead of analyzing IR"),
+    cl::value_desc("file.aion"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> BatchRoot(
+    "batch",
+    cl::desc("Analyze every TU found through a compile_commands.json or under "
+             "a directory (.ll/.bc with .opt.yaml remarks) into one report"),
+    cl::value_desc("compile_commands.json|dir"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> BaselineFile(
+    "baseline",
+    cl::desc("Leave out diagnostics recorded in this baseline file"),
+    cl::value_desc("file"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> WriteBaseline(
+    "write-baseline",
+    cl::desc("Record every current diagnostic in a baseline file"),
+    cl::value_desc("file"),
+    cl::cat(OptDbgCategory));
+
+static cl::list<std::string> PatternFiles(
+    "patterns", cl::CommaSeparated,
+    cl::desc("Match remarks against the custom patterns in these files as "
+             "well (pattern sources, or one index built by aion-patterns)"),
+    cl::value_desc("file,..."),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> BudgetSpec(
+    "budget",
+    cl::desc("Diagnostics allowed per severity before exiting with 2 "
+             "(e.g. critical=0,high=5; default critical=0); hot=N counts "
+             "only diagnostics whose profile count is at least N"),
+    cl::value_desc("level=N,..."),
+    cl::cat(OptDbgCategory));
+
+static cl::list<std::string> CompareBuilds(
+    "compare", cl::multi_val(2),
+    cl::desc("Compare the remarks of two builds (YAML files, directories of "
+             ".opt.yaml files, session snapshots or remark databases) and "
+             "exit with 1 when optimizations are newly missed"),
+    cl::value_desc("old new"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> ServeSocket(
+    "serve",
+    cl::desc("Run as a resident analysis server on this Unix domain socket"),
+    cl::value_desc("socket"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<unsigned> ServeIdleTimeout(
+    "serve-idle-timeout",
+    cl::desc("With --serve, close connections that send nothing for this "
+             "many seconds (0 = never)"),
+    cl::init(30),
+    cl::value_desc("seconds"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> ConnectSocket(
+    "connect",
+    cl::desc("Send the analysis to a server started with --serve instead of "
+             "running it in this process"),
+    cl::value_desc("socket"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<bool> StopServer(
+    "stop-server",
+    cl::desc("With --connect, ask the server to shut down"),
+    cl::init(false),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> SelfProfilePath(
+    "self-profile",
+    cl::desc("Time every analysis phase, write a Chrome trace to this file "
+             "and print a per-phase summary to stderr"),
+    cl::value_desc("trace.json"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<unsigned> SelfProfileGranularity(
+    "self-profile-granularity",
+    cl::desc("Leave events shorter than this many microseconds out of the "
+             "--self-profile trace (default: 0, keep all)"),
+    cl::init(0),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<bool> PrintMemoryReport(
+    "memory-report",
+    cl::desc("Print the bytes held by remarks, the IR diff, diagnostics, "
+             "LLVM modules and report buffers to stderr"),
+    cl::init(false),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<bool> InlineCostGaps(
+    "inline-cost",
+    cl::desc("Recompute the inline cost of every missed inlining call site "
+             "and rank callees by how far they are over the threshold "
+             "(bypasses --cache-dir, which keeps no modules)"),
+    cl::init(false),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<bool> LoopReportView(
+    "loop-report",
+    cl::desc("Summarize every loop of the input: trip count, whether it was "
+             "vectorized, unrolled, interchanged or had LICM applied, and "
+             "which remarks blocked each transformation (bypasses "
+             "--cache-dir)"),
+    cl::init(false),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> BisectSpec(
+    "bisect",
+    cl::desc("Find the pass invocation of the -O (or --passes) pipeline that "
+             "makes a predicate true: changed:FN, grew:FN[:N], "
+             "vectorized:FN or remark:PASS[/NAME][@FN]. Probes run in "
+             "parallel with --jobs (bypasses --cache-dir)"),
+    cl::value_desc("predicate"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<bool> RunCodegen(
+    "codegen",
+    cl::desc("Lower the optimized IR in-process and report the backend's "
+             "remarks with register spills/reloads, stack size and code "
+             "size per function"),
+    cl::init(false),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> CodegenTriple(
+    "codegen-triple",
+    cl::desc("Target triple for --codegen (default: the module's, else the "
+             "host's); implies --codegen"),
+    cl::value_desc("triple"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<std::string> CodegenCPU(
+    "codegen-cpu",
+    cl::desc("Target CPU for --codegen, or 'native' for the host's "
+             "(default: the target's generic CPU); implies --codegen"),
+    cl::value_desc("cpu"),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<bool> WhatIfExperiments(
+    "what-if",
+    cl::desc("Apply the IR equivalent of each suggestion (noalias, "
+             "alwaysinline, inline threshold, readnone callees) to a copy of "
+             "the input, re-run the -O pipeline on every copy in parallel and "
+             "report which ones turn a missed remark into a passed one "
+             "(bypasses --cache-dir)"),
+    cl::init(false),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<unsigned> WhatIfLimit(
+    "what-if-limit",
+    cl::desc("Number of missed remarks --what-if runs experiments on "
+             "(default: 16)"),
+    cl::init(16),
+    cl::cat(OptDbgCategory));
+
+static cl::opt<unsigned> Jobs(
+    "jobs",
+    cl::desc("Number of worker threads (default: one per core)"),
+    cl::init(0),
+    cl::cat(OptDbgCategory));
+
 static cl::opt<bool> Verbose(
     "verbose",
     cl::desc("Print full detailed explanations (not just root cause)"),
@@ -150,12 +381,110 @@ void printUsageError(StringRef Msg) {
   errs() << "Run 'opt-debugger --help' for usage information.\n";
 }
 
+// the terminal report goes to stdout unless --json=- or --sarif=- claims it
+bool terminalOnStdout() { return JSONOutput != "-" && SARIFOutput != "-"; }
+
+// where the views printed after the main report go
+raw_ostream &reportStream() { return terminalOnStdout() ? outs() : errs(); }
+
 // validates command line flags for incompatible option combinations
 bool hasConflictingOptions() {
   bool HasInput        = !InputFile.empty();
   bool HasBeforeAfter  = !BeforeFile.empty() && !AfterFile.empty();
   bool HasBeforeOnly   = !BeforeFile.empty() && AfterFile.empty();
   bool HasAfterOnly    = BeforeFile.empty() && !AfterFile.empty();
+  bool HasSnapshot     = !LoadSession.empty();
+
+  if (JSONOutput == "-" && SARIFOutput == "-") {
+    printUsageError("--json=- and --sarif=- would both write to stdout; send "
+                    "one of them to a file");
+    return true;
+  }
+
+  bool OtherMode = !CompareBuilds.empty() || !ServeSocket.empty() ||
+                   !BatchRoot.empty() || HasSnapshot || !ConnectSocket.empty();
+  auto needsSingleInput = [&](bool Requested, StringRef Flag) {
+    if (!Requested || !OtherMode)
+      return false;
+    printUsageError(Flag.str() + " needs the IR of one input and cannot be "
+                    "used with --compare, --serve, --batch, --load-session or "
+                    "--connect");
+    return true;
+  };
+  if (needsSingleInput(InlineCostGaps, "--inline-cost") ||
+      needsSingleInput(LoopReportView, "--loop-report") ||
+      needsSingleInput(WhatIfExperiments, "--what-if") ||
+      needsSingleInput(!BisectSpec.empty(), "--bisect"))
+    return true;
+
+  bool WantsCodegen =
+      RunCodegen || !CodegenTriple.empty() || !CodegenCPU.empty();
+  if (WantsCodegen && (!CompareBuilds.empty() || !ServeSocket.empty() ||
+                       HasSnapshot || !ConnectSocket.empty())) {
+    printUsageError("--codegen lowers IR analyzed in this process and cannot "
+                    "be used with --compare, --serve, --load-session or "
+                    "--connect");
+    return true;
+  }
+
+  if (!CompareBuilds.empty()) {
+    if (HasInput || HasBeforeAfter || HasBeforeOnly || HasAfterOnly ||
+        HasSnapshot || !BatchRoot.empty() || !ServeSocket.empty() ||
+        !ConnectSocket.empty()) {
+      printUsageError("--compare reads its own two inputs and cannot be "
+                      "combined with other inputs or modes");
+      return true;
+    }
+    if (!HTMLOutput.empty() || !SARIFOutput.empty() || !SaveSession.empty()) {
+      printUsageError("--compare only writes a terminal or --json report");
+      return true;
+    }
+    return false;
+  }
+
+  if (!ServeSocket.empty()) {
+    if (HasInput || HasBeforeAfter || HasBeforeOnly || HasAfterOnly ||
+        HasSnapshot || !ConnectSocket.empty()) {
+      printUsageError("--serve takes no inputs; send them with --connect");
+      return true;
+    }
+    return false;
+  }
+
+  if (StopServer) {
+    if (ConnectSocket.empty()) {
+      printUsageError("--stop-server requires --connect");
+      return true;
+    }
+    return false;
+  }
+
+  if (!BatchRoot.empty()) {
+    if (HasInput || HasBeforeAfter || HasBeforeOnly || HasAfterOnly ||
+        HasSnapshot || !ConnectSocket.empty()) {
+      printUsageError("--batch discovers its own inputs and cannot be combined "
+                      "with other inputs or --connect");
+      return true;
+    }
+    return false;
+  }
+
+  if (HasSnapshot && !BaselineFile.empty()) {
+    printUsageError("--baseline applies during analysis and cannot be used "
+                    "with --load-session");
+    return true;
+  }
+
+  if (HasSnapshot && !PatternFiles.empty()) {
+    printUsageError("--patterns applies during analysis and cannot be used "
+                    "with --load-session");
+    return true;
+  }
+
+  if (HasSnapshot && !ConnectSocket.empty()) {
+    printUsageError("--load-session cannot be combined with --connect");
+    return true;
+  }
 
   if (HasBeforeOnly) {
     printUsageError("--before requires --after");
@@ -167,6 +496,14 @@ bool hasConflictingOptions() {
     return true;
   }
 
+  if (HasSnapshot && (HasInput || HasBeforeAfter)) {
+    printUsageError("--load-session cannot be combined with IR inputs");
+    return true;
+  }
+
+  if (HasSnapshot)
+    return false;
+
   if (HasInput && HasBeforeAfter) {
     printUsageError("Cannot specify both a positional input file and --before/--after");
     return true;
@@ -180,6 +517,238 @@ bool hasConflictingOptions() {
   return false;
 }
 
+// maps the pipeline flags onto the analyzer configuration
+AnalysisConfig buildAnalysisConfig() {
+  AnalysisConfig ACfg;
+  ACfg.PassPipeline        = Passes;
+  ACfg.OptLevel            = OptLevel;
+  ACfg.EnableAllRemarks    = true;
+  ACfg.EnableVectorization = EnableVectorization;
+  ACfg.EnableUnrolling     = EnableUnrolling;
+  ACfg.VerifyEachPass      = VerifyEach;
+  ACfg.ExternalRemarksPath = RemarksFile;
+  return ACfg;
+}
+
+std::string makeAbsolute(StringRef Path) {
+  SmallString<256> Abs(Path);
+  sys::fs::make_absolute(Abs);
+  return std::string(Abs);
+}
+
+// forwards this invocation to a running server and prints its report
+int runClient(const ReportConfig &RCfg, const SeverityBudget &Budget) {
+  if (StopServer) {
+    if (auto Err = sendShutdownRequest(ConnectSocket)) {
+      WithColor::error(errs(), "opt-debugger") << toString(std::move(Err)) << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  if (!HTMLOutput.empty() || !SaveSession.empty() || !WriteBaseline.empty() ||
+      PrintMemoryReport) {
+    printUsageError("--html, --save-session, --write-baseline and "
+                    "--memory-report are not available with --connect");
+    return 1;
+  }
+  if (!PatternFiles.empty()) {
+    printUsageError("--patterns is not available with --connect; start the "
+                    "server with --patterns instead");
+    return 1;
+  }
+  if (!JSONOutput.empty() && !SARIFOutput.empty()) {
+    printUsageError("--connect produces one report; choose --json or --sarif");
+    return 1;
+  }
+
+  AnalysisRequest Req;
+  Req.Analysis    = buildAnalysisConfig();
+  Req.Report      = RCfg;
+  Req.SummaryOnly = PrintSummaryOnly;
+  Req.Budget      = Budget;
+  if (!BaselineFile.empty())
+    Req.BaselinePath = makeAbsolute(BaselineFile);
+  if (!JSONOutput.empty())
+    Req.Format = JSONStyle == JSONFormat::Document ? RequestFormat::JSON
+                                                   : RequestFormat::NDJSON;
+  else if (!SARIFOutput.empty())
+    Req.Format = RequestFormat::SARIF;
+
+  if (!BeforeFile.empty()) {
+    Req.BeforePath = makeAbsolute(BeforeFile);
+    Req.AfterPath  = makeAbsolute(AfterFile);
+    if (!RemarksFile.empty())
+      Req.RemarksPath = makeAbsolute(RemarksFile);
+  } else if (InputFile == "-") {
+    auto BufOrErr = MemoryBuffer::getSTDIN();
+    if (!BufOrErr) {
+      WithColor::error(errs(), "opt-debugger")
+          << "Cannot read IR from stdin: " << BufOrErr.getError().message() << "\n";
+      return 1;
+    }
+    Req.IRText = (*BufOrErr)->getBuffer().str();
+  } else {
+    Req.InputPath = makeAbsolute(InputFile);
+  }
+  if (!Req.Analysis.ExternalRemarksPath.empty())
+    Req.Analysis.ExternalRemarksPath = makeAbsolute(RemarksFile);
+
+  StringRef OutPath = !JSONOutput.empty() ? StringRef(JSONOutput)
+                                          : StringRef(SARIFOutput);
+  std::error_code EC;
+  std::unique_ptr<raw_fd_ostream> OutFile;
+  if (!OutPath.empty() && OutPath != "-") {
+    OutFile = std::make_unique<raw_fd_ostream>(OutPath, EC, sys::fs::OF_Text);
+    if (EC) {
+      WithColor::error(errs(), "opt-debugger")
+          << "Cannot open '" << OutPath << "': " << EC.message() << "\n";
+      return 1;
+    }
+  }
+
+  Expected<int> ExitCode =
+      sendAnalysisRequest(ConnectSocket, Req, OutFile ? *OutFile : outs());
+  if (!ExitCode) {
+    WithColor::error(errs(), "opt-debugger") << toString(ExitCode.takeError()) << "\n";
+    return 1;
+  }
+  return *ExitCode;
+}
+
+unsigned defaultWorkerCount() {
+  return Jobs ? Jobs : hardware_concurrency().compute_thread_count();
+}
+
+// the backend settings of --codegen, or none when it was not requested
+std::optional<CodegenOptions> buildCodegenOptions() {
+  if (!RunCodegen && CodegenTriple.empty() && CodegenCPU.empty())
+    return std::nullopt;
+  CodegenOptions Opts;
+  Opts.Triple   = CodegenTriple;
+  Opts.CPU      = CodegenCPU;
+  Opts.OptLevel = OptLevel;
+  return Opts;
+}
+
+// discovers and analyzes all TUs under --batch and merges them into one session
+Expected<AnalysisSession> runBatch(const AnalysisCache *Cache,
+                                   const DiagnosticBaseline *Baseline,
+                                   const PatternDB *UserPatterns,
+                                   const CodegenOptions *Codegen,
+                                   bool KeepDiffs, unsigned &NumFailures) {
+  ProfileScope PS("Batch");
+  auto UnitsOrErr = BatchDriver::discover(BatchRoot);
+  if (!UnitsOrErr)
+    return UnitsOrErr.takeError();
+  if (UnitsOrErr->empty())
+    return createStringError(inconvertibleErrorCode(),
+                             "No .ll or .bc inputs found under '%s'",
+                             BatchRoot.c_str());
+
+  AnalysisConfig ACfg      = buildAnalysisConfig();
+  ACfg.ExternalRemarksPath.clear();
+  BatchDriver Driver(ACfg, defaultWorkerCount(), Cache);
+  Driver.setBaseline(Baseline);
+  Driver.setUserPatterns(UserPatterns);
+  Driver.setCodegen(Codegen);
+
+  std::vector<BatchFailure> Failures;
+  AnalysisSession Session =
+      Driver.run(std::move(*UnitsOrErr), KeepDiffs, Failures, Verbose);
+  for (const BatchFailure &F : Failures)
+    WithColor::warning(errs(), "opt-debugger")
+        << F.IRPath << ": " << F.Message << "\n";
+  NumFailures = Failures.size();
+  return Session;
+}
+
+// diffs the remarks of two builds; newly missed optimizations fail the run
+int runCompare(bool UseColor) {
+  ProfileScope PS("Compare");
+  auto ComparisonOrErr = compareRemarkSets(CompareBuilds[0], CompareBuilds[1]);
+  if (!ComparisonOrErr) {
+    WithColor::error(errs(), "opt-debugger")
+        << toString(ComparisonOrErr.takeError()) << "\n";
+    return 1;
+  }
+
+  if (JSONOutput != "-")
+    printRemarkComparison(*ComparisonOrErr, outs(), UseColor);
+  if (JSONOutput == "-") {
+    writeRemarkComparisonJSON(*ComparisonOrErr, outs());
+  } else if (!JSONOutput.empty()) {
+    std::error_code EC;
+    raw_fd_ostream JSONFile(JSONOutput, EC, sys::fs::OF_Text);
+    if (EC) {
+      WithColor::error(errs(), "opt-debugger")
+          << "Cannot open '" << JSONOutput << "': " << EC.message() << "\n";
+      return 1;
+    }
+    writeRemarkComparisonJSON(*ComparisonOrErr, JSONFile);
+  }
+  return ComparisonOrErr->hasRegressions() ? 1 : 0;
+}
+
+// records where a snapshot came from so archived sessions stay identifiable
+void stampSessionMetadata(AnalysisSession &Session) {
+  char Created[32];
+  std::time_t Now = std::time(nullptr);
+  std::strftime(Created, sizeof(Created), "%Y-%m-%dT%H:%M:%SZ",
+                std::gmtime(&Now));
+
+  Session.Metadata.clear();
+  Session.Metadata.emplace_back("tool", std::string("Aion ") + AionVersion);
+  Session.Metadata.emplace_back("created", Created);
+  if (!BatchRoot.empty()) {
+    Session.Metadata.emplace_back("batch", BatchRoot);
+  } else if (!InputFile.empty()) {
+    Session.Metadata.emplace_back("input", InputFile);
+  } else {
+    Session.Metadata.emplace_back("before", BeforeFile);
+    Session.Metadata.emplace_back("after", AfterFile);
+    if (!RemarksFile.empty())
+      Session.Metadata.emplace_back("remarks", RemarksFile);
+  }
+}
+
+// compiled indexes live under <cache-dir>/patterns when --cache-dir is given,
+// otherwise in the user cache directory
+Expected<std::unique_ptr<PatternDB>> loadUserPatterns() {
+  ProfileScope PS("LoadPatterns");
+  std::string IndexDir;
+  if (!CacheDir.empty()) {
+    SmallString<256> Dir(CacheDir);
+    sys::path::append(Dir, "patterns");
+    IndexDir = std::string(Dir);
+  } else {
+    IndexDir = PatternDB::defaultCacheDirectory();
+  }
+
+  std::vector<std::string> Paths(PatternFiles.begin(), PatternFiles.end());
+  auto PatternsOrErr = PatternDB::load(Paths, IndexDir);
+  if (PatternsOrErr && Verbose)
+    WithColor::note(errs(), "opt-debugger")
+        << "loaded " << (*PatternsOrErr)->size() << " custom patterns"
+        << ((*PatternsOrErr)->loadedFromCache() ? " from the index cache" : "")
+        << "\n";
+  return PatternsOrErr;
+}
+
+// writes the --self-profile trace and summary on every path out of main
+struct SelfProfileWriter {
+  ~SelfProfileWriter() {
+    if (!SelfProfiler::isActive())
+      return;
+    if (auto Err = SelfProfiler::finish(SelfProfilePath)) {
+      WithColor::warning(errs(), "opt-debugger") << toString(std::move(Err)) << "\n";
+      return;
+    }
+    SelfProfiler::printSummary(errs());
+    errs() << "Self profile written to: " << SelfProfilePath << "\n";
+  }
+};
+
 }
 
 // entry point for the opt-debugger executable
@@ -200,11 +769,44 @@ int main(int argc, char **argv) {
       "  opt-debugger input.ll\n"
       "  opt-debugger input.ll --passes=inline,loop-vectorize\n"
       "  opt-debugger --before=before.ll --after=after.ll --remarks=r.yaml\n"
-      "  opt-debugger input.ll -O3 --html=report.html --verbose\n");
+      "  opt-debugger input.ll -O3 --html=report.html --verbose\n"
+      "  opt-debugger input.ll --json=- --json-format=ndjson\n"
+      "  opt-debugger input.ll --cache-dir=.aion-cache\n"
+      "  opt-debugger input.ll --save-session=build.aion\n"
+      "  opt-debugger --load-session=build.aion --html=report.html\n"
+      "  opt-debugger --batch=build/compile_commands.json --jobs=16\n"
+      "  opt-debugger --compare old/remarks.db new/remarks.db\n"
+      "  opt-debugger input.ll --baseline=aion.baseline --budget=high=0\n"
+      "  opt-debugger input.ll --patterns=team.aionpat\n"
+      "  opt-debugger input.ll --remarks=input.opt.yaml --inline-cost\n"
+      "  opt-debugger --before=input.ll --after=input.O2.ll "
+      "--remarks=input.opt.yaml --loop-report\n"
+      "  opt-debugger input.ll --remarks=input.opt.yaml --what-if --jobs=8\n"
+      "  opt-debugger input.ll -O3 --codegen-cpu=native\n"
+      "  opt-debugger input.ll -O3 --bisect=vectorized:saxpy --jobs=8\n"
+      "  opt-debugger input.ll --self-profile=trace.json\n"
+      "  opt-debugger --serve=/tmp/aion.sock --jobs=8\n"
+      "  opt-debugger --connect=/tmp/aion.sock input.ll\n");
 
   if (hasConflictingOptions())
     return 1;
 
+  std::optional<BisectPredicate> Bisection;
+  if (!BisectSpec.empty()) {
+    auto PredicateOrErr = BisectPredicate::parse(BisectSpec);
+    if (!PredicateOrErr) {
+      printUsageError(toString(PredicateOrErr.takeError()));
+      return 1;
+    }
+    Bisection = std::move(*PredicateOrErr);
+  }
+
+  SelfProfileWriter ProfileWriter;
+  if (!SelfProfilePath.empty())
+    SelfProfiler::start("opt-debugger", SelfProfileGranularity);
+  if (PrintMemoryReport)
+    MemoryAccounting::enable();
+
   bool UseColor = !NoColor && llvm::sys::Process::StandardOutIsDisplayed();
 
   ReportConfig RCfg;
@@ -219,22 +821,87 @@ int main(int argc, char **argv) {
   RCfg.MaxSuggestions  = MaxSuggestions;
   RCfg.MinSeverity     = parseSeverityLevel(MinSeverity);
 
-  PassAnalyzer Analyzer;
+  if (!CompareBuilds.empty())
+    return runCompare(UseColor);
+
+  SeverityBudget Budget;
+  if (!BudgetSpec.empty()) {
+    auto BudgetOrErr = SeverityBudget::parse(BudgetSpec);
+    if (!BudgetOrErr) {
+      printUsageError(toString(BudgetOrErr.takeError()));
+      return 1;
+    }
+    Budget = *BudgetOrErr;
+  }
+
+  if (!ConnectSocket.empty())
+    return runClient(RCfg, Budget);
+
+  std::optional<AnalysisCache> Cache;
+  if (!CacheDir.empty())
+    Cache.emplace(CacheDir);
+
+  std::unique_ptr<PatternDB> UserPatterns;
+  if (!PatternFiles.empty()) {
+    auto PatternsOrErr = loadUserPatterns();
+    if (!PatternsOrErr) {
+      WithColor::error(errs(), "opt-debugger")
+          << toString(PatternsOrErr.takeError()) << "\n";
+      return 1;
+    }
+    UserPatterns = std::move(*PatternsOrErr);
+  }
+
+  if (!ServeSocket.empty()) {
+    AnalysisServer Server(ServeSocket, defaultWorkerCount(),
+                          Cache ? &*Cache : nullptr);
+    Server.setUserPatterns(UserPatterns.get());
+    Server.setIdleTimeout(ServeIdleTimeout);
+    if (auto Err = Server.serve()) {
+      WithColor::error(errs(), "opt-debugger") << toString(std::move(Err)) << "\n";
+      return 1;
+    }
+    return 0;
+  }
 
+  std::optional<DiagnosticBaseline> Baseline;
+  if (!BaselineFile.empty()) {
+    auto BaselineOrErr = DiagnosticBaseline::load(BaselineFile);
+    if (!BaselineOrErr) {
+      WithColor::error(errs(), "opt-debugger")
+          << toString(BaselineOrErr.takeError()) << "\n";
+      return 1;
+    }
+    Baseline = std::move(*BaselineOrErr);
+  }
+
+  PassAnalyzer Analyzer;
+  if (Cache && !InlineCostGaps && !LoopReportView && !WhatIfExperiments &&
+      !Bisection)
+    Analyzer.setCache(&*Cache);
+  if (Baseline)
+    Analyzer.setBaseline(&*Baseline);
+  Analyzer.setUserPatterns(UserPatterns.get());
+  std::optional<CodegenOptions> CodegenOpts = buildCodegenOptions();
+  if (CodegenOpts)
+    Analyzer.setCodegen(&*CodegenOpts);
+
+  unsigned BatchFailures = 0;
   Expected<AnalysisSession> SessionOrErr = [&]() -> Expected<AnalysisSession> {
+    if (!LoadSession.empty())
+      return loadSession(LoadSession);
+
+    if (!BatchRoot.empty())
+      return runBatch(Cache ? &*Cache : nullptr, Baseline ? &*Baseline : nullptr,
+                      UserPatterns.get(), CodegenOpts ? &*CodegenOpts : nullptr,
+                      ShowDiff && !PrintSummaryOnly,
+                      BatchFailures);
+
     if (!BeforeFile.empty()) {
       return Analyzer.runFromBeforeAfter(BeforeFile, AfterFile, RemarksFile);
     }
 
-    AnalysisConfig ACfg;
-    ACfg.PassPipeline        = Passes;
-    ACfg.OptLevel            = OptLevel;
-    ACfg.EnableAllRemarks    = true;
-    ACfg.EnableVectorization = EnableVectorization;
-    ACfg.EnableUnrolling     = EnableUnrolling;
-    ACfg.VerifyEachPass      = VerifyEach;
-
-    return Analyzer.runFromFile(InputFile, ACfg);
+    return Analyzer.runFromFile(InputFile, buildAnalysisConfig());
   }();
 
   if (!SessionOrErr) {
@@ -244,22 +911,101 @@ int main(int argc, char **argv) {
   }
 
   AnalysisSession &Session = *SessionOrErr;
+  if (Verbose && Session.LoadedFromCache)
+    WithColor::note(errs(), "opt-debugger")
+        << "reusing cached analysis from " << Cache->getDirectory() << "\n";
+
+  if (!SaveSession.empty()) {
+    if (LoadSession.empty())
+      stampSessionMetadata(Session);
+    if (auto Err = saveSession(Session, SaveSession)) {
+      WithColor::error(errs(), "opt-debugger") << toString(std::move(Err)) << "\n";
+      return 1;
+    }
+  }
+
+  if (!WriteBaseline.empty()) {
+    ProfileScope PS("WriteBaseline");
+    if (auto Err = DiagnosticBaseline::write(Session.Remarks, WriteBaseline)) {
+      WithColor::error(errs(), "opt-debugger") << toString(std::move(Err)) << "\n";
+      return 1;
+    }
+  }
 
+  // --summary-only trims every report, not just the terminal one
   if (PrintSummaryOnly) {
-    ReportConfig SummaryCfg = RCfg;
-    SummaryCfg.ShowDiff       = false;
-    SummaryCfg.ShowSuggestions = false;
-    SummaryCfg.ShowIRSnippets  = false;
-    TerminalReporter TR(outs(), SummaryCfg);
-    TR.report(Session);
-  } else {
-    generateReport(Session, RCfg, outs(), HTMLOutput);
+    RCfg.ShowDiff        = false;
+    RCfg.ShowSuggestions = false;
+    RCfg.ShowIRSnippets  = false;
+  }
+  ReportOutputs Outputs;
+  Outputs.HTMLPath     = HTMLOutput;
+  Outputs.HTMLChunked  = HTMLChunked;
+  Outputs.JSONPath     = JSONOutput;
+  Outputs.SARIFPath    = SARIFOutput;
+  Outputs.JSONStyle    = JSONStyle;
+  Outputs.UserPatterns = UserPatterns.get();
+  Outputs.EmitTerminal = terminalOnStdout();
+  generateReport(Session, RCfg, outs(), Outputs);
+
+  if (InlineCostGaps && Session.BeforeModule) {
+    InlineCostReport Gaps =
+        analyzeInlineCosts(*Session.BeforeModule, Session.Remarks, OptLevel);
+    printInlineCostReport(Gaps, reportStream(), Verbose);
+  }
+
+  if (LoopReportView && Session.BeforeModule) {
+    LoopReport Loops = buildLoopReport(*Session.BeforeModule,
+                                       Session.AfterModule.get(),
+                                       Session.Remarks);
+    printLoopReport(Loops, reportStream(), Verbose);
+  }
+
+  if (WhatIfExperiments) {
+    DiagnosticEngine Engine;
+    Engine.setUserPatterns(UserPatterns.get());
+    WhatIfConfig WCfg;
+    WCfg.OptLevel   = OptLevel;
+    WCfg.Threads    = defaultWorkerCount();
+    WCfg.MaxRemarks = WhatIfLimit;
+    auto ExperimentsOrErr = runWhatIfExperiments(
+        Session.BeforeIR, Session.Remarks, Engine, Session.Diff, WCfg);
+    if (!ExperimentsOrErr) {
+      WithColor::error(errs(), "opt-debugger")
+          << toString(ExperimentsOrErr.takeError()) << "\n";
+      return 1;
+    }
+    printWhatIfReport(*ExperimentsOrErr, reportStream(), Verbose);
+  }
+
+  if (Bisection) {
+    BisectConfig BCfg;
+    BCfg.PassPipeline = Passes;
+    BCfg.OptLevel     = OptLevel;
+    BCfg.Threads      = defaultWorkerCount();
+    auto ResultOrErr = runBisection(Session.BeforeIR, *Bisection, BCfg);
+    if (!ResultOrErr) {
+      WithColor::error(errs(), "opt-debugger")
+          << toString(ResultOrErr.takeError()) << "\n";
+      return 1;
+    }
+    printBisectReport(*ResultOrErr, *Bisection, reportStream(),
+                      UseColor && terminalOnStdout(), Verbose);
   }
 
-  bool HadCritical = false;
-  for (const DiagnosticResult &D : Session.Diagnostics)
-    if (D.Severity == SeverityLevel::Critical)
-      HadCritical = true;
+  if (PrintMemoryReport) {
+    outs().flush();
+    MemoryAccounting::print(Session, errs());
+  }
 
-  return HadCritical ? 2 : 0;
+  unsigned OverBudget = 0;
+  if (auto Level = Budget.firstExceeded(Session.Diagnostics, &OverBudget)) {
+    if (!BudgetSpec.empty())
+      WithColor::error(errs(), "opt-debugger")
+          << OverBudget << " " << severityToString(*Level)
+          << " diagnostics exceed the budget of "
+          << Budget.Limits[static_cast<unsigned>(*Level)] << "\n";
+    return 2;
+  }
+  return BatchFailures ? 1 : 0;
 }